@@ -0,0 +1,111 @@
+
+#ifndef ARD_PACKET_BENCHMARK_H
+#define ARD_PACKET_BENCHMARK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Seconds since an arbitrary epoch
+ */
+inline double ArdPacketBenchmarkSeconds()
+{
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Time stamp counter, 0 where there is none
+ *
+ * Counts reference cycles at a constant rate on current x86 processors, close to core cycles without frequency
+ * scaling.
+ */
+inline uint64_t ArdPacketBenchmarkCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Result of one benchmark case
+ */
+struct ArdPacketBenchmarkResult
+{
+    std::string name;
+    double ns_per_packet = 0.0;
+    double mb_per_s = 0.0;
+    double cycles_per_byte = 0.0;
+};
+
+/**
+ * @brief Keep a result for the JSON report and the baseline comparison
+ *
+ * @param name unique over all benchmarks, compared across runs
+ * @param seconds
+ * @param cycles @c ArdPacketBenchmarkCycles elapsed
+ * @param packets
+ * @param bytes payload bytes
+ */
+void ArdPacketBenchmarkRecord(const std::string &name, double seconds, uint64_t cycles, size_t packets, size_t bytes);
+
+/**
+ * @brief Binary symmetric channel flipping each bit with a given probability
+ */
+class ArdPacketBenchmarkBitErrorChannel
+{
+   public:
+    ArdPacketBenchmarkBitErrorChannel(const double bit_error_rate, const uint32_t seed)
+        : m_random(seed), m_gap(bit_error_rate > 0.0 ? bit_error_rate : 1.0), m_enabled(bit_error_rate > 0.0)
+    {
+    }
+
+    /**
+     * @brief Flip bits of @c data in place
+     *
+     * @return number of flipped bits
+     */
+    size_t Apply(uint8_t *data, const size_t size)
+    {
+        size_t flipped = 0;
+        if (m_enabled)
+        {
+            // skip ahead to the next flipped bit
+            size_t bit = m_gap(m_random);
+            while (bit < 8 * size)
+            {
+                data[bit / 8] ^= static_cast<uint8_t>(1U << (bit % 8));
+                flipped++;
+                bit += 1 + m_gap(m_random);
+            }
+        }
+        return flipped;
+    }
+
+   private:
+    std::mt19937 m_random;
+    std::geometric_distribution<size_t> m_gap;
+    bool m_enabled;
+};
+
+/**
+ * @brief Benchmarks (one function per benchmark file)
+ */
+void ArdPacketBenchmarkCodec();
+void ArdPacketBenchmarkCompress();
+void ArdPacketBenchmarkFec();
+void ArdPacketBenchmarkLink();
+void ArdPacketBenchmarkServer();
+
+#endif
@@ -0,0 +1,314 @@
+
+#ifndef ARD_PACKET_LINK_SIMULATOR_H
+#define ARD_PACKET_LINK_SIMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <random>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief One direction of a simulated link
+ */
+struct ArdPacketLinkConfig
+{
+    /**
+     * @brief Bits per second on the wire, 10 bits per byte as with 8N1 framing
+     */
+    double baud_rate = 115200.0;
+
+    /**
+     * @brief Bytes the sending driver buffers, reported by @c availableForWrite
+     */
+    size_t tx_fifo_size = 64;
+
+    /**
+     * @brief Bytes the receiving driver buffers, bytes arriving at a full buffer are lost
+     */
+    size_t rx_fifo_size = 64;
+
+    /**
+     * @brief Wire time before a write that finds the wire idle, such as a Bluetooth or TCP segment header
+     */
+    double write_overhead_us = 0.0;
+
+    /**
+     * @brief Delay from the end of a byte on the wire to its arrival
+     */
+    double latency_us = 0.0;
+
+    /**
+     * @brief Largest random extra delay per write call, arrivals keep their order
+     */
+    double jitter_us = 0.0;
+
+    /**
+     * @brief Probability of flipping each bit
+     */
+    double bit_error_rate = 0.0;
+
+    /**
+     * @brief Probability of losing a byte
+     */
+    double drop_rate = 0.0;
+
+    /**
+     * @brief Arrived bytes become available in bursts of this many bytes, 1 for a UART
+     *
+     * A shorter burst is released once nothing else is on the way.
+     */
+    size_t burst_size = 1;
+};
+
+/**
+ * @brief Byte counts of one direction of a simulated link
+ */
+struct ArdPacketLinkCounters
+{
+    size_t written = 0;
+    size_t delivered = 0;
+    size_t flipped_bits = 0;
+    size_t dropped = 0;
+    size_t overflowed = 0;
+};
+
+/**
+ * @brief Duplex link on a virtual microsecond clock, deterministic for a given seed
+ *
+ * Each end is an @c ArdPacketStreamInterface. Bytes written wait in the transmit buffer until the wire is free, take
+ * 10 bits of time each at the baud rate, then arrive after the latency and become readable from the receive buffer.
+ * Time only moves on @c Advance, so the stream calls cost no simulated time.
+ */
+class ArdPacketLinkSimulator
+{
+   public:
+    class End : public ArdPacketStreamInterface
+    {
+       public:
+        int available() override;
+        int read() override;
+        size_t read(uint8_t *buffer, size_t size) override;
+
+        int availableForWrite() override;
+        size_t write(uint8_t value) override;
+        size_t write(const uint8_t *buffer, size_t size) override;
+
+       private:
+        friend class ArdPacketLinkSimulator;
+
+        End(ArdPacketLinkSimulator &link, const size_t tx, const size_t rx) : m_link(link), m_tx(tx), m_rx(rx) {}
+
+        ArdPacketLinkSimulator &m_link;
+        const size_t m_tx;
+        const size_t m_rx;
+    };
+
+    /**
+     * @brief Create a link
+     *
+     * @param a_to_b direction written by @c A and read by @c B
+     * @param b_to_a direction written by @c B and read by @c A
+     * @param seed
+     */
+    ArdPacketLinkSimulator(const ArdPacketLinkConfig &a_to_b, const ArdPacketLinkConfig &b_to_a, const uint32_t seed)
+        : m_random(seed), m_a(*this, 0, 1), m_b(*this, 1, 0)
+    {
+        m_directions[0].config = a_to_b;
+        m_directions[1].config = b_to_a;
+    }
+
+    End &A()
+    {
+        return m_a;
+    }
+
+    End &B()
+    {
+        return m_b;
+    }
+
+    /**
+     * @brief Virtual time in microseconds
+     */
+    double Now() const
+    {
+        return m_now_us;
+    }
+
+    /**
+     * @brief Move the virtual time forward and deliver what arrived meanwhile
+     *
+     * @param us
+     */
+    void Advance(double us);
+
+    /**
+     * @brief Byte counts of the direction written by @c A (0) or @c B (1)
+     */
+    const ArdPacketLinkCounters &Counters(const size_t direction) const
+    {
+        return m_directions[direction].counters;
+    }
+
+   private:
+    struct Byte
+    {
+        uint8_t value;
+        double time_us;
+    };
+
+    struct Direction
+    {
+        ArdPacketLinkConfig config;
+        ArdPacketLinkCounters counters;
+        // waiting for the wire, by departure time
+        std::deque<Byte> tx;
+        // on the wire, by arrival time
+        std::deque<Byte> flight;
+        std::deque<uint8_t> rx;
+        double wire_free_us = 0.0;
+        double last_arrival_us = 0.0;
+    };
+
+    void Update(Direction &direction);
+    size_t Write(Direction &direction, const uint8_t *buffer, size_t size);
+
+    std::mt19937 m_random;
+    std::uniform_real_distribution<double> m_uniform{0.0, 1.0};
+    double m_now_us = 0.0;
+    Direction m_directions[2];
+    End m_a;
+    End m_b;
+};
+
+// inline methods
+
+inline int ArdPacketLinkSimulator::End::available()
+{
+    return static_cast<int>(m_link.m_directions[m_rx].rx.size());
+}
+
+inline int ArdPacketLinkSimulator::End::read()
+{
+    std::deque<uint8_t> &rx = m_link.m_directions[m_rx].rx;
+    int value = -1;
+    if (!rx.empty())
+    {
+        value = rx.front();
+        rx.pop_front();
+    }
+    return value;
+}
+
+inline size_t ArdPacketLinkSimulator::End::read(uint8_t *buffer, const size_t size)
+{
+    std::deque<uint8_t> &rx = m_link.m_directions[m_rx].rx;
+    size_t bytes_read = 0;
+    while (bytes_read < size && !rx.empty())
+    {
+        buffer[bytes_read++] = rx.front();
+        rx.pop_front();
+    }
+    return bytes_read;
+}
+
+inline int ArdPacketLinkSimulator::End::availableForWrite()
+{
+    const Direction &direction = m_link.m_directions[m_tx];
+    return static_cast<int>(direction.config.tx_fifo_size - direction.tx.size());
+}
+
+inline size_t ArdPacketLinkSimulator::End::write(const uint8_t value)
+{
+    return m_link.Write(m_link.m_directions[m_tx], &value, 1);
+}
+
+inline size_t ArdPacketLinkSimulator::End::write(const uint8_t *buffer, const size_t size)
+{
+    return m_link.Write(m_link.m_directions[m_tx], buffer, size);
+}
+
+inline void ArdPacketLinkSimulator::Advance(const double us)
+{
+    m_now_us += us;
+    Update(m_directions[0]);
+    Update(m_directions[1]);
+}
+
+inline size_t ArdPacketLinkSimulator::Write(Direction &direction, const uint8_t *buffer, const size_t size)
+{
+    const ArdPacketLinkConfig &config = direction.config;
+    const size_t room = config.tx_fifo_size - direction.tx.size();
+    const size_t accepted = (size < room ? size : room);
+    if (accepted > 0)
+    {
+        const double byte_us = 10.0 * 1e6 / config.baud_rate;
+        // writes queued behind a transmission join its segment
+        if (direction.wire_free_us <= m_now_us)
+        {
+            direction.wire_free_us = m_now_us + config.write_overhead_us;
+        }
+        const double jitter_us = config.jitter_us * m_uniform(m_random);
+        for (size_t k = 0; k < accepted; ++k)
+        {
+            // departure is when the byte leaves the transmit buffer, arrival adds its wire time and the latency
+            direction.tx.push_back({buffer[k], direction.wire_free_us});
+            direction.wire_free_us += byte_us;
+            double arrival_us = direction.wire_free_us + config.latency_us + jitter_us;
+            arrival_us = (arrival_us > direction.last_arrival_us ? arrival_us : direction.last_arrival_us);
+            direction.last_arrival_us = arrival_us;
+            direction.flight.push_back({buffer[k], arrival_us});
+        }
+        direction.counters.written += accepted;
+    }
+    return accepted;
+}
+
+inline void ArdPacketLinkSimulator::Update(Direction &direction)
+{
+    const ArdPacketLinkConfig &config = direction.config;
+    while (!direction.tx.empty() && direction.tx.front().time_us <= m_now_us)
+    {
+        direction.tx.pop_front();
+    }
+
+    // bytes that arrived, released in whole bursts unless nothing else is on the way
+    size_t arrived = 0;
+    while (arrived < direction.flight.size() && direction.flight[arrived].time_us <= m_now_us)
+    {
+        arrived++;
+    }
+    const size_t burst_size = (config.burst_size > 0 ? config.burst_size : 1);
+    const size_t release = (arrived == direction.flight.size() ? arrived : arrived - arrived % burst_size);
+    for (size_t k = 0; k < release; ++k)
+    {
+        uint8_t value = direction.flight.front().value;
+        direction.flight.pop_front();
+        for (int bit = 0; bit < 8 && config.bit_error_rate > 0.0; ++bit)
+        {
+            if (m_uniform(m_random) < config.bit_error_rate)
+            {
+                value ^= static_cast<uint8_t>(1U << bit);
+                direction.counters.flipped_bits++;
+            }
+        }
+        if (config.drop_rate > 0.0 && m_uniform(m_random) < config.drop_rate)
+        {
+            direction.counters.dropped++;
+        }
+        else if (direction.rx.size() >= config.rx_fifo_size)
+        {
+            direction.counters.overflowed++;
+        }
+        else
+        {
+            direction.rx.push_back(value);
+            direction.counters.delivered++;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "ArdCrc.h"
+#include "ArdPacketBenchmark.h"
+#include "ArdPacketBuffer.h"
+
+namespace
+{
+
+constexpr size_t kBytesPerCase = 1 << 20;
+constexpr size_t kMinPackets = 16;
+constexpr size_t kMaxPackets = 200000;
+constexpr size_t kRepetitions = 3;
+
+const uint8_t kFieldBytes[] = {1, 2, 4};
+const size_t kPayloadSizes[] = {1, 16, 128, 255, 1024, 8192, 65535, 65536};
+
+size_t PacketCount(const size_t payload_size)
+{
+    size_t packets = kBytesPerCase / payload_size;
+    packets = (packets < kMinPackets ? kMinPackets : packets);
+    return (packets > kMaxPackets ? kMaxPackets : packets);
+}
+
+size_t MaxPayloadSize(const uint8_t payload_size_bytes)
+{
+    return (payload_size_bytes == 1 ? 255 : (payload_size_bytes == 2 ? 65535 : 65536));
+}
+
+void FillPayload(std::vector<uint8_t> &payload)
+{
+    uint32_t value = 2654435761U;
+    for (uint8_t &byte : payload)
+    {
+        value = value * 1103515245U + 12345U;
+        byte = static_cast<uint8_t>(value >> 24);
+    }
+}
+
+struct CodecCase
+{
+    ArdPacketConfig config;
+    std::string name;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> encoded;
+    size_t encoded_size = 0;
+    size_t packets = 0;
+};
+
+// fastest of a few runs over every packet of a case, fails the case if a packet is not done
+template <typename Operation>
+bool Measure(const CodecCase &codec, const char *operation_name, Operation operation)
+{
+    bool passed = true;
+    double seconds = 0.0;
+    uint64_t cycles = 0;
+    for (size_t repetition = 0; repetition < kRepetitions && passed; ++repetition)
+    {
+        const double start = ArdPacketBenchmarkSeconds();
+        const uint64_t start_cycles = ArdPacketBenchmarkCycles();
+        for (size_t k = 0; k < codec.packets && passed; ++k)
+        {
+            passed = (operation() == kArdPacketStatusDone);
+        }
+        const uint64_t run_cycles = ArdPacketBenchmarkCycles() - start_cycles;
+        const double run_seconds = ArdPacketBenchmarkSeconds() - start;
+        seconds = (repetition == 0 || run_seconds < seconds ? run_seconds : seconds);
+        cycles = (repetition == 0 || run_cycles < cycles ? run_cycles : cycles);
+    }
+    if (passed)
+    {
+        ArdPacketBenchmarkRecord(codec.name + "/" + operation_name, seconds, cycles, codec.packets,
+                                 codec.packets * codec.payload.size());
+    }
+    else
+    {
+        fprintf(stderr, "%s/%s failed\n", codec.name.c_str(), operation_name);
+    }
+    return passed;
+}
+
+bool Run(CodecCase &codec)
+{
+    ArdPacketBuffer stream;
+    ArdPacket packet(stream);
+    packet.Configure(codec.config);
+    const ArdPacketPayloadInfo info = {.message_type = 1, .payload_size = codec.payload.size()};
+    ArdPacketPayloadInfo received_info;
+
+    bool passed = Measure(codec, "send", [&]() {
+        stream.set_write_buffer(codec.encoded.data(), codec.encoded.size());
+        return packet.SendPayload(info, codec.payload.data());
+    });
+    codec.encoded_size = codec.encoded.size() - static_cast<size_t>(stream.availableForWrite());
+
+    passed = passed && Measure(codec, "receive", [&]() {
+                 stream.set_read_buffer(codec.encoded.data(), codec.encoded_size);
+                 return packet.ReceivePayload(codec.received.size(), received_info, codec.received.data());
+             });
+    passed = passed && (memcmp(codec.payload.data(), codec.received.data(), codec.payload.size()) == 0);
+
+    size_t packet_size = 0;
+    passed = passed && Measure(codec, "write_buffer", [&]() {
+                 return packet.WritePacketToBuffer(info, codec.payload.data(), codec.encoded.size(),
+                                                   codec.encoded.data(), packet_size);
+             });
+    passed = passed && Measure(codec, "read_buffer", [&]() {
+                 return packet.ReadPacketFromBuffer(codec.encoded.data(), packet_size, codec.received.size(),
+                                                    received_info, codec.received.data());
+             });
+    return passed;
+}
+
+void Crc(const size_t payload_size)
+{
+    std::vector<uint8_t> data(payload_size);
+    FillPayload(data);
+    const size_t packets = PacketCount(payload_size);
+    crc_t crc = crc_init();
+    double seconds = 0.0;
+    uint64_t cycles = 0;
+    for (size_t repetition = 0; repetition < kRepetitions; ++repetition)
+    {
+        const double start = ArdPacketBenchmarkSeconds();
+        const uint64_t start_cycles = ArdPacketBenchmarkCycles();
+        for (size_t k = 0; k < packets; ++k)
+        {
+            crc = crc_update(crc, data.data(), data.size());
+        }
+        const uint64_t run_cycles = ArdPacketBenchmarkCycles() - start_cycles;
+        const double run_seconds = ArdPacketBenchmarkSeconds() - start;
+        seconds = (repetition == 0 || run_seconds < seconds ? run_seconds : seconds);
+        cycles = (repetition == 0 || run_cycles < cycles ? run_cycles : cycles);
+    }
+    // keep the loop from being optimized out
+    data[0] = static_cast<uint8_t>(crc_finalize(crc));
+    ArdPacketBenchmarkRecord("crc/" + std::to_string(payload_size), seconds, cycles, packets, packets * payload_size);
+}
+
+}  // namespace
+
+void ArdPacketBenchmarkCodec()
+{
+    size_t failures = 0;
+    for (const uint8_t message_type_bytes : kFieldBytes)
+    {
+        for (const uint8_t payload_size_bytes : kFieldBytes)
+        {
+            for (const bool crc : {false, true})
+            {
+                for (const size_t payload_size : kPayloadSizes)
+                {
+                    if (payload_size <= MaxPayloadSize(payload_size_bytes))
+                    {
+                        CodecCase codec;
+                        codec.config.delimiter = '|';
+                        codec.config.message_type_bytes = message_type_bytes;
+                        codec.config.payload_size_bytes = payload_size_bytes;
+                        codec.config.max_payload_size = payload_size;
+                        codec.config.crc = crc;
+                        codec.name = "codec/t" + std::to_string(message_type_bytes) + "s" +
+                                     std::to_string(payload_size_bytes) + (crc ? "c1/" : "c0/") +
+                                     std::to_string(payload_size);
+                        codec.payload.resize(payload_size);
+                        FillPayload(codec.payload);
+                        codec.received.resize(payload_size);
+                        codec.encoded.resize(payload_size + 16);
+                        codec.packets = PacketCount(payload_size);
+                        failures += (Run(codec) ? 0 : 1);
+                    }
+                }
+            }
+        }
+    }
+    for (const size_t payload_size : kPayloadSizes)
+    {
+        Crc(payload_size);
+    }
+    if (failures > 0)
+    {
+        printf("%zu codec cases failed\n", failures);
+    }
+}
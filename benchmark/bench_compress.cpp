@@ -0,0 +1,198 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "ArdPacketBenchmark.h"
+#include "ArdPacketLzss.h"
+
+namespace
+{
+
+constexpr size_t kCorpusSize = 1 << 16;
+constexpr size_t kRepetitions = 3;
+
+const size_t kPayloadSizes[] = {64, 128, 255};
+
+struct Corpus
+{
+    const char *name;
+    std::vector<uint8_t> data;
+};
+
+void Append(std::vector<uint8_t> &data, const std::string &text)
+{
+    data.insert(data.end(), text.begin(), text.end());
+}
+
+// status log lines with slowly changing values
+std::vector<uint8_t> MakeLog()
+{
+    static const char *const kStates[] = {"ok", "ok", "ok", "warn", "ok", "fault"};
+    std::vector<uint8_t> data;
+    for (uint32_t k = 0; data.size() < kCorpusSize; ++k)
+    {
+        char line[96];
+        snprintf(line, sizeof(line), "t=%lu node=%u temp=%u.%u state=%s\n", static_cast<unsigned long>(1000 + 250 * k),
+                 k % 4, 20 + (k / 16) % 5, k % 10, kStates[k % 6]);
+        Append(data, line);
+    }
+    data.resize(kCorpusSize);
+    return data;
+}
+
+// configuration records in JSON
+std::vector<uint8_t> MakeJson()
+{
+    std::vector<uint8_t> data;
+    for (uint32_t k = 0; data.size() < kCorpusSize; ++k)
+    {
+        char record[160];
+        snprintf(record, sizeof(record),
+                 "{\"id\":%u,\"rate_hz\":%u,\"enabled\":%s,\"channels\":[%u,%u,%u],\"label\":\"sensor-%u\"}", k,
+                 10 * (1 + k % 5), (k % 3 == 0 ? "false" : "true"), k % 8, (k + 1) % 8, (k + 2) % 8, k % 16);
+        Append(data, record);
+    }
+    data.resize(kCorpusSize);
+    return data;
+}
+
+// little endian 16 bit samples of a noisy sine
+std::vector<uint8_t> MakeSamples()
+{
+    std::vector<uint8_t> data;
+    uint32_t noise = 12345;
+    for (uint32_t k = 0; data.size() < kCorpusSize; ++k)
+    {
+        noise = noise * 1103515245U + 12345U;
+        const int16_t sample =
+            static_cast<int16_t>(2000.0 * sin(0.01 * static_cast<double>(k)) + static_cast<double>((noise >> 16) % 8));
+        data.push_back(static_cast<uint8_t>(static_cast<uint16_t>(sample) & 0xFF));
+        data.push_back(static_cast<uint8_t>(static_cast<uint16_t>(sample) >> 8));
+    }
+    data.resize(kCorpusSize);
+    return data;
+}
+
+std::vector<uint8_t> MakeRandom()
+{
+    std::vector<uint8_t> data(kCorpusSize);
+    uint32_t value = 2654435761U;
+    for (uint8_t &byte : data)
+    {
+        value = value * 1103515245U + 12345U;
+        byte = static_cast<uint8_t>(value >> 24);
+    }
+    return data;
+}
+
+struct Result
+{
+    size_t compressed = 0;
+    size_t sent = 0;
+    bool passed = true;
+};
+
+// fastest of a few runs over the corpus in payload sized pieces
+template <typename Operation>
+double Fastest(uint64_t &cycles, Operation operation)
+{
+    double seconds = 0.0;
+    for (size_t repetition = 0; repetition < kRepetitions; ++repetition)
+    {
+        const double start = ArdPacketBenchmarkSeconds();
+        const uint64_t start_cycles = ArdPacketBenchmarkCycles();
+        operation();
+        const uint64_t run_cycles = ArdPacketBenchmarkCycles() - start_cycles;
+        const double run_seconds = ArdPacketBenchmarkSeconds() - start;
+        seconds = (repetition == 0 || run_seconds < seconds ? run_seconds : seconds);
+        cycles = (repetition == 0 || run_cycles < cycles ? run_cycles : cycles);
+    }
+    return seconds;
+}
+
+void Run(const Corpus &corpus, const size_t window_bits, const size_t payload_size)
+{
+    const size_t payloads = corpus.data.size() / payload_size;
+    const size_t corpus_size = payloads * payload_size;
+    std::vector<uint8_t> compressed(payloads * (2 * payload_size));
+    std::vector<size_t> sizes(payloads);
+    std::vector<uint8_t> decompressed(payload_size);
+    ArdPacketLzssEncoder encoder;
+    ArdPacketLzssDecoder decoder;
+    Result result;
+
+    uint64_t compress_cycles = 0;
+    const double compress_seconds = Fastest(compress_cycles, [&]() {
+        for (size_t k = 0; k < payloads; ++k)
+        {
+            encoder.Begin(window_bits, &compressed[k * 2 * payload_size], 2 * payload_size);
+            encoder.Sink(&corpus.data[k * payload_size], payload_size);
+            encoder.Finish();
+            sizes[k] = encoder.Size();
+        }
+    });
+
+    uint64_t decompress_cycles = 0;
+    const double decompress_seconds = Fastest(decompress_cycles, [&]() {
+        for (size_t k = 0; k < payloads; ++k)
+        {
+            decoder.Begin(window_bits, decompressed.data(), decompressed.size());
+            decoder.Decode(&compressed[k * 2 * payload_size], sizes[k]);
+            result.passed = result.passed && decoder.Finish() && decoder.Size() == payload_size &&
+                            memcmp(decompressed.data(), &corpus.data[k * payload_size], payload_size) == 0;
+        }
+    });
+
+    // payloads that do not shrink are sent raw, see ArdPacketCompress
+    for (const size_t size : sizes)
+    {
+        result.compressed += size;
+        result.sent += (size < payload_size ? size : payload_size);
+    }
+
+    const std::string name = std::string("lzss/") + corpus.name + "/w" + std::to_string(window_bits) + "/p" +
+                             std::to_string(payload_size);
+    if (result.passed)
+    {
+        ArdPacketBenchmarkRecord(name + "/compress", compress_seconds, compress_cycles, payloads, corpus_size);
+        ArdPacketBenchmarkRecord(name + "/decompress", decompress_seconds, decompress_cycles, payloads, corpus_size);
+    }
+    else
+    {
+        fprintf(stderr, "%s failed\n", name.c_str());
+    }
+    const double corpus_mb = static_cast<double>(corpus_size) / 1e6;
+    printf("%-8s %6zu %8zu %8.3f %8.3f %14.1f %16.1f\n", corpus.name, window_bits, payload_size,
+           static_cast<double>(result.compressed) / static_cast<double>(corpus_size),
+           static_cast<double>(result.sent) / static_cast<double>(corpus_size), corpus_mb / compress_seconds,
+           corpus_mb / decompress_seconds);
+}
+
+}  // namespace
+
+void ArdPacketBenchmarkCompress()
+{
+    const Corpus corpora[] = {
+        {"log", MakeLog()},
+        {"json", MakeJson()},
+        {"samples", MakeSamples()},
+        {"random", MakeRandom()},
+    };
+
+    printf("each payload compressed on its own, ratio = compressed / raw, sent = raw if not smaller\n\n");
+    printf("%-8s %6s %8s %8s %8s %14s %16s\n", "corpus", "window", "payload", "ratio", "sent", "compress MB/s",
+           "decompress MB/s");
+    for (const Corpus &corpus : corpora)
+    {
+        for (size_t window_bits = 6; window_bits <= kArdPacketLzssMaxWindowBits; ++window_bits)
+        {
+            for (const size_t payload_size : kPayloadSizes)
+            {
+                Run(corpus, window_bits, payload_size);
+            }
+        }
+    }
+}
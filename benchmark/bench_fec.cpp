@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "ArdPacketBenchmark.h"
+#include "ArdPacketBuffer.h"
+
+namespace
+{
+
+constexpr size_t kPayloadSize = 200;
+constexpr size_t kThroughputPackets = 20000;
+constexpr size_t kGoodputPackets = 4000;
+constexpr size_t kReadChunkSize = 64;
+
+struct FecSetting
+{
+    const char *name;
+    uint8_t parity_bytes;
+    uint8_t block_size;
+};
+
+const FecSetting kSettings[] = {
+    {"none", 0, 32},
+    {"rs 4/64", 4, 64},
+    {"rs 8/64", 8, 64},
+    {"rs 16/48", 16, 48},
+};
+
+const double kBitErrorRates[] = {0.0, 1e-5, 1e-4, 1e-3, 3e-3};
+
+ArdPacketConfig MakeConfig(const FecSetting &setting)
+{
+    ArdPacketConfig config;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = kPayloadSize;
+    config.crc = true;
+    config.fec_parity_bytes = setting.parity_bytes;
+    config.fec_block_size = setting.block_size;
+    return config;
+}
+
+void FillPayload(const uint32_t message_type, uint8_t *payload)
+{
+    uint32_t value = 2654435761U * (message_type + 1);
+    for (size_t k = 0; k < kPayloadSize; ++k)
+    {
+        value = value * 1103515245U + 12345U;
+        payload[k] = static_cast<uint8_t>(value >> 24);
+    }
+}
+
+void Throughput(const FecSetting &setting)
+{
+    ArdPacketBuffer stream;
+    ArdPacket packet(stream);
+    packet.Configure(MakeConfig(setting));
+
+    uint8_t payload[kPayloadSize];
+    FillPayload(0, payload);
+    const ArdPacketPayloadInfo info = {.message_type = 0, .payload_size = kPayloadSize};
+    uint8_t encoded[2 * kPayloadSize];
+    size_t encoded_size = 0;
+
+    double start = ArdPacketBenchmarkSeconds();
+    for (size_t k = 0; k < kThroughputPackets; ++k)
+    {
+        packet.WritePacketToBuffer(info, payload, sizeof(encoded), encoded, encoded_size);
+    }
+    const double encode_seconds = ArdPacketBenchmarkSeconds() - start;
+
+    uint8_t received[kPayloadSize];
+    ArdPacketPayloadInfo received_info;
+    size_t failures = 0;
+    start = ArdPacketBenchmarkSeconds();
+    for (size_t k = 0; k < kThroughputPackets; ++k)
+    {
+        failures += (packet.ReadPacketFromBuffer(encoded, encoded_size, sizeof(received), received_info, received) !=
+                     kArdPacketStatusDone);
+    }
+    const double decode_seconds = ArdPacketBenchmarkSeconds() - start;
+
+    // worst case: every block carries as many errors as can be corrected
+    std::vector<uint8_t> corrupted(encoded, encoded + encoded_size);
+    if (setting.parity_bytes > 0)
+    {
+        const size_t header_codeword = 2 + 2 + 2 + setting.parity_bytes;
+        const size_t block_codeword = setting.block_size + setting.parity_bytes;
+        for (size_t k = 0; k < setting.parity_bytes / 2; ++k)
+        {
+            corrupted[1 + k] ^= 0x55;
+            for (size_t index = 1 + header_codeword + k; index < encoded_size; index += block_codeword)
+            {
+                corrupted[index] ^= 0x55;
+            }
+        }
+    }
+    start = ArdPacketBenchmarkSeconds();
+    for (size_t k = 0; k < kThroughputPackets; ++k)
+    {
+        failures += (packet.ReadPacketFromBuffer(corrupted.data(), encoded_size, sizeof(received), received_info,
+                                                 received) != kArdPacketStatusDone) &&
+                    (setting.parity_bytes > 0);
+    }
+    const double correct_seconds = ArdPacketBenchmarkSeconds() - start;
+
+    const double payload_mb = static_cast<double>(kThroughputPackets * kPayloadSize) / 1e6;
+    printf("%-10s %6zu %12.1f %12.1f %12.1f %9zu\n", setting.name, encoded_size, payload_mb / encode_seconds,
+           payload_mb / decode_seconds, payload_mb / correct_seconds, failures);
+}
+
+void Goodput(const FecSetting &setting, const double bit_error_rate)
+{
+    ArdPacketBuffer stream;
+    ArdPacket sender(stream);
+    ArdPacket receiver(stream);
+    sender.Configure(MakeConfig(setting));
+    receiver.Configure(MakeConfig(setting));
+
+    // send every packet into one stream
+    std::vector<uint8_t> wire(kGoodputPackets * 2 * kPayloadSize);
+    stream.set_write_buffer(wire.data(), wire.size());
+    uint8_t payload[kPayloadSize];
+    for (uint32_t message_type = 0; message_type < kGoodputPackets; ++message_type)
+    {
+        FillPayload(message_type, payload);
+        const ArdPacketPayloadInfo info = {.message_type = message_type, .payload_size = kPayloadSize};
+        sender.SendPayload(info, payload);
+    }
+    const size_t wire_size = wire.size() - stream.availableForWrite();
+    wire.resize(wire_size);
+
+    ArdPacketBenchmarkBitErrorChannel channel(bit_error_rate, 1234);
+    const size_t flipped = channel.Apply(wire.data(), wire.size());
+
+    // receive in chunks
+    size_t delivered = 0;
+    size_t wire_index = 0;
+    bool progress = true;
+    uint8_t received[kPayloadSize];
+    ArdPacketPayloadInfo received_info;
+    while (wire_index < wire_size && progress)
+    {
+        const size_t chunk = (wire_size - wire_index < kReadChunkSize ? wire_size - wire_index : kReadChunkSize);
+        stream.set_read_buffer(&wire[wire_index], chunk);
+        eArdPacketStatus status = kArdPacketStatusStart;
+        while (stream.available() > 0 && status != kArdPacketStatusNotEnoughAvailable)
+        {
+            status = receiver.ReceivePayload(sizeof(received), received_info, received);
+            if (status == kArdPacketStatusDone && received_info.message_type < kGoodputPackets)
+            {
+                FillPayload(received_info.message_type, payload);
+                delivered += (received_info.payload_size == kPayloadSize &&
+                              memcmp(payload, received, kPayloadSize) == 0);
+            }
+        }
+        const size_t consumed = chunk - static_cast<size_t>(stream.available());
+        progress = (consumed > 0);
+        wire_index += consumed;
+    }
+
+    printf("%-10s %8.0e %9zu %9.1f %10.3f\n", setting.name, bit_error_rate, flipped,
+           100.0 * static_cast<double>(delivered) / kGoodputPackets,
+           static_cast<double>(delivered * kPayloadSize) / static_cast<double>(wire_size));
+}
+
+}  // namespace
+
+void ArdPacketBenchmarkFec()
+{
+    printf("%zu byte payload, header and payload CRC\n\n", kPayloadSize);
+    printf("%-10s %6s %12s %12s %12s %9s\n", "fec", "bytes", "encode MB/s", "decode MB/s", "correct MB/s",
+           "failures");
+    for (const FecSetting &setting : kSettings)
+    {
+        Throughput(setting);
+    }
+
+    printf("\n%-10s %8s %9s %9s %10s\n", "fec", "ber", "flipped", "recv %", "goodput");
+    for (const double bit_error_rate : kBitErrorRates)
+    {
+        for (const FecSetting &setting : kSettings)
+        {
+            Goodput(setting, bit_error_rate);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ArdPacketBenchmark.h"
+#include "ArdPacketLinkSimulator.h"
+
+namespace
+{
+
+constexpr size_t kPayloadSize = 32;
+constexpr size_t kPackets = 500;
+constexpr double kTickUs = 50.0;
+constexpr double kDrainUs = 1e6;
+
+struct LinkSetting
+{
+    const char *name;
+    ArdPacketLinkConfig config;
+};
+
+struct FramingSetting
+{
+    const char *name;
+    eArdPacketFraming framing;
+    bool crc;
+    eArdPacketHeaderEncoding header_encoding;
+};
+
+std::vector<LinkSetting> MakeLinks()
+{
+    std::vector<LinkSetting> links;
+    LinkSetting uart = {"uart 115200", ArdPacketLinkConfig()};
+    links.push_back(uart);
+
+    LinkSetting fast_uart = {"uart 921600", ArdPacketLinkConfig()};
+    fast_uart.config.baud_rate = 921600.0;
+    fast_uart.config.tx_fifo_size = 128;
+    fast_uart.config.rx_fifo_size = 256;
+    links.push_back(fast_uart);
+
+    LinkSetting noisy_uart = {"uart noisy", ArdPacketLinkConfig()};
+    noisy_uart.config.bit_error_rate = 1e-4;
+    noisy_uart.config.drop_rate = 1e-4;
+    links.push_back(noisy_uart);
+
+    // about 700 kbit/s of SPP payload, L2CAP packets every few ms
+    LinkSetting bluetooth = {"bt spp", ArdPacketLinkConfig()};
+    bluetooth.config.baud_rate = 700000.0;
+    bluetooth.config.tx_fifo_size = 512;
+    bluetooth.config.rx_fifo_size = 1024;
+    bluetooth.config.write_overhead_us = 600.0;
+    bluetooth.config.latency_us = 8000.0;
+    bluetooth.config.jitter_us = 8000.0;
+    bluetooth.config.burst_size = 127;
+    bluetooth.config.bit_error_rate = 1e-6;
+    links.push_back(bluetooth);
+
+    LinkSetting wifi = {"wifi tcp", ArdPacketLinkConfig()};
+    wifi.config.baud_rate = 10e6;
+    wifi.config.tx_fifo_size = 2048;
+    wifi.config.rx_fifo_size = 8192;
+    wifi.config.write_overhead_us = 200.0;
+    wifi.config.latency_us = 2000.0;
+    wifi.config.jitter_us = 3000.0;
+    wifi.config.burst_size = 1460;
+    links.push_back(wifi);
+    return links;
+}
+
+const FramingSetting kFramings[] = {
+    {"delimiter", kArdPacketFramingDelimiter, false, kArdPacketHeaderFixed},
+    {"delimiter+crc", kArdPacketFramingDelimiter, true, kArdPacketHeaderFixed},
+    {"varint+crc", kArdPacketFramingDelimiter, true, kArdPacketHeaderVarint},
+    {"cobs+crc", kArdPacketFramingCobs, true, kArdPacketHeaderFixed},
+};
+
+ArdPacketConfig MakeConfig(const FramingSetting &setting)
+{
+    ArdPacketConfig config;
+    config.delimiter = (setting.framing == kArdPacketFramingCobs ? 0 : '|');
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = kPayloadSize;
+    config.crc = setting.crc;
+    config.framing = setting.framing;
+    config.header_encoding = setting.header_encoding;
+    return config;
+}
+
+void FillPayload(const uint32_t sequence, uint8_t *payload)
+{
+    uint32_t value = 2654435761U * (sequence + 1);
+    for (size_t k = 0; k < kPayloadSize; ++k)
+    {
+        value = value * 1103515245U + 12345U;
+        payload[k] = static_cast<uint8_t>(value >> 24);
+    }
+}
+
+double Percentile(std::vector<double> &values, const double fraction)
+{
+    double result = 0.0;
+    if (!values.empty())
+    {
+        const size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+        result = values[index];
+    }
+    return result;
+}
+
+void Run(const LinkSetting &link_setting, const FramingSetting &framing_setting)
+{
+    ArdPacketLinkSimulator link(link_setting.config, link_setting.config, 1234);
+    ArdPacket sender(link.A());
+    ArdPacket receiver(link.B());
+    sender.Configure(MakeConfig(framing_setting));
+    receiver.Configure(MakeConfig(framing_setting));
+
+    std::vector<double> sent_us(kPackets, 0.0);
+    std::vector<double> latencies_us;
+    size_t sent = 0;
+    size_t delivered = 0;
+    size_t corrupted = 0;
+    double last_sent_us = 0.0;
+    double last_received_us = 0.0;
+    bool sending = false;
+    uint8_t payload[kPayloadSize];
+    uint8_t received[kPayloadSize];
+    uint8_t expected[kPayloadSize];
+    ArdPacketPayloadInfo received_info;
+
+    // poll both ends every tick like a main loop, until the link is quiet
+    while (sent < kPackets || link.Now() < last_sent_us + kDrainUs)
+    {
+        if (sent < kPackets)
+        {
+            const ArdPacketPayloadInfo info = {.message_type = static_cast<uint32_t>(sent), .payload_size = kPayloadSize};
+            if (!sending)
+            {
+                FillPayload(static_cast<uint32_t>(sent), payload);
+                sent_us[sent] = link.Now();
+                sending = true;
+            }
+            if (sender.SendPayload(info, payload) == kArdPacketStatusDone)
+            {
+                sending = false;
+                sent++;
+                last_sent_us = link.Now();
+            }
+        }
+
+        eArdPacketStatus status = kArdPacketStatusStart;
+        while (status != kArdPacketStatusNotAvailable && status != kArdPacketStatusNotEnoughAvailable &&
+               status != kArdPacketStatusHeaderInProgress && status != kArdPacketStatusPayloadInProgress &&
+               status != kArdPacketStatusNoDelimiter)
+        {
+            status = receiver.ReceivePayload(sizeof(received), received_info, received);
+            if (status == kArdPacketStatusDone && received_info.message_type < kPackets)
+            {
+                FillPayload(received_info.message_type, expected);
+                const bool intact = (received_info.payload_size == kPayloadSize &&
+                                     memcmp(expected, received, kPayloadSize) == 0);
+                delivered += (intact ? 1 : 0);
+                corrupted += (intact ? 0 : 1);
+                latencies_us.push_back(link.Now() - sent_us[received_info.message_type]);
+                last_received_us = link.Now();
+            }
+            else if (status == kArdPacketStatusDone)
+            {
+                corrupted++;
+            }
+        }
+        link.Advance(kTickUs);
+    }
+
+    const double seconds = (last_received_us - sent_us[0]) / 1e6;
+    const double goodput = (seconds > 0.0 ? static_cast<double>(delivered * kPayloadSize) / seconds / 1e3 : 0.0);
+    printf("%-12s %-14s %10.1f %9.2f %9.2f %8.1f %9zu %9zu\n", link_setting.name, framing_setting.name, goodput,
+           Percentile(latencies_us, 0.5) / 1e3, Percentile(latencies_us, 0.99) / 1e3,
+           100.0 * static_cast<double>(kPackets - delivered) / kPackets, corrupted,
+           link.Counters(0).dropped + link.Counters(0).overflowed);
+}
+
+}  // namespace
+
+void ArdPacketBenchmarkLink()
+{
+    printf("%zu packets of %zu bytes on a virtual clock, both ends polled every %.0f us\n\n", kPackets, kPayloadSize,
+           kTickUs);
+    printf("%-12s %-14s %10s %9s %9s %8s %9s %9s\n", "link", "framing", "kB/s", "p50 ms", "p99 ms", "loss %",
+           "corrupt", "lost B");
+    for (const LinkSetting &link : MakeLinks())
+    {
+        for (const FramingSetting &framing : kFramings)
+        {
+            Run(link, framing);
+        }
+    }
+}
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ArdPacketBenchmark.h"
+#include "ArdPacketServer.h"
+#include "ArdPacketUring.h"
+
+namespace
+{
+
+constexpr size_t kPayloadSize = 32;
+constexpr double kLoadSeconds = 1.0;
+constexpr double kIdleSeconds = 0.5;
+const size_t kClientCounts[] = {100, 1000, 4000};
+const size_t kWorkerCounts[] = {1, 2, 4};
+
+ArdPacketConfig MakeConfig()
+{
+    ArdPacketConfig config;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = kPayloadSize;
+    config.crc = true;
+    return config;
+}
+
+double CpuSeconds()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return static_cast<double>(time.tv_sec) + 1e-9 * static_cast<double>(time.tv_nsec);
+}
+
+size_t MaxClients()
+{
+    // two descriptors per loopback client
+    struct rlimit limit = {};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return (limit.rlim_cur > 128 ? (limit.rlim_cur - 128) / 2 : 0);
+}
+
+class EchoHandler : public ArdPacketServerHandler
+{
+   public:
+    void OnPayload(ArdPacketServerConnection &connection, const ArdPacketPayloadInfo &info,
+                   const uint8_t *payload) override
+    {
+        connection.Send(info, payload);
+    }
+};
+
+// one connection per client, a request is sent once the previous one came back
+struct Client
+{
+    Client() : packet(stream) {}
+
+    ArdPacketTcp stream;
+    ArdPacket packet;
+    ArdPacketPayloadInfo info;
+    uint8_t payload[kPayloadSize] = {0};
+};
+
+class Clients
+{
+   public:
+    bool Connect(const size_t count, const uint16_t port)
+    {
+        m_epoll_fd = epoll_create1(0);
+        bool success = (m_epoll_fd >= 0);
+        for (size_t k = 0; k < count && success; ++k)
+        {
+            m_clients.emplace_back(new Client());
+            Client &client = *m_clients.back();
+            success = client.stream.Connect("127.0.0.1", port);
+            client.packet.Configure(MakeConfig());
+            struct epoll_event event = {};
+            event.events = EPOLLIN | EPOLLET;
+            event.data.ptr = &client;
+            success = success && epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, client.stream.Fd(), &event) == 0;
+        }
+        return success;
+    }
+
+    ~Clients()
+    {
+        m_clients.clear();
+        if (m_epoll_fd >= 0)
+        {
+            close(m_epoll_fd);
+        }
+    }
+
+    // round trips completed in a given time
+    size_t Run(const double seconds)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = 1, .payload_size = kPayloadSize};
+        const uint8_t payload[kPayloadSize] = {0};
+        for (std::unique_ptr<Client> &client : m_clients)
+        {
+            client->packet.SendPayload(info, payload);
+        }
+
+        size_t round_trips = 0;
+        size_t in_flight = m_clients.size();
+        std::vector<struct epoll_event> events(256);
+        const double end = ArdPacketBenchmarkSeconds() + seconds;
+        bool sending = true;
+        while (in_flight > 0)
+        {
+            sending = sending && (ArdPacketBenchmarkSeconds() < end);
+            const int count = epoll_wait(m_epoll_fd, events.data(), static_cast<int>(events.size()), 10);
+            for (int k = 0; k < count; ++k)
+            {
+                Client &client = *static_cast<Client *>(events[k].data.ptr);
+                while (client.packet.ReceivePayload(kPayloadSize, client.info, client.payload) ==
+                       kArdPacketStatusDone)
+                {
+                    round_trips++;
+                    if (sending)
+                    {
+                        client.packet.SendPayload(info, payload);
+                    }
+                    else
+                    {
+                        in_flight--;
+                    }
+                }
+            }
+        }
+        return round_trips;
+    }
+
+   private:
+    int m_epoll_fd = -1;
+    std::vector<std::unique_ptr<Client>> m_clients;
+};
+
+// one thread calling ReceivePayload on every connection in turn
+class PollingServer
+{
+   public:
+    bool Start()
+    {
+        m_listen_fd = ArdPacketTcp::Listen("127.0.0.1", 0);
+        m_running = true;
+        m_thread = std::thread([this]() { Run(); });
+        return (m_listen_fd >= 0);
+    }
+
+    void Stop()
+    {
+        m_running = false;
+        m_thread.join();
+        m_clients.clear();
+        close(m_listen_fd);
+    }
+
+    uint16_t Port() const
+    {
+        return ArdPacketTcp::LocalPort(m_listen_fd);
+    }
+
+   private:
+    void Run()
+    {
+        while (m_running)
+        {
+            bool accepted = true;
+            while (accepted)
+            {
+                std::unique_ptr<Client> client(new Client());
+                accepted = client->stream.Accept(m_listen_fd);
+                if (accepted)
+                {
+                    client->packet.Configure(MakeConfig());
+                    m_clients.push_back(std::move(client));
+                }
+            }
+            for (std::unique_ptr<Client> &connection : m_clients)
+            {
+                if (connection->packet.ReceivePayload(kPayloadSize, connection->info, connection->payload) ==
+                    kArdPacketStatusDone)
+                {
+                    connection->packet.SendPayload(connection->info, connection->payload);
+                }
+            }
+        }
+    }
+
+    int m_listen_fd = -1;
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+    std::vector<std::unique_ptr<Client>> m_clients;
+};
+
+void Report(const char *name, const size_t workers, const size_t client_count, Clients &clients)
+{
+    const double start = ArdPacketBenchmarkSeconds();
+    const size_t round_trips = clients.Run(kLoadSeconds);
+    const double seconds = ArdPacketBenchmarkSeconds() - start;
+
+    // clients sleep, only the server runs
+    const double cpu_start = CpuSeconds();
+    usleep(static_cast<useconds_t>(kIdleSeconds * 1e6));
+    const double idle_cpu = (CpuSeconds() - cpu_start) / kIdleSeconds;
+
+    printf("%-8s %8zu %8zu %14.0f %10.1f\n", name, workers, client_count,
+           static_cast<double>(round_trips) / seconds, 100.0 * idle_cpu);
+}
+
+}  // namespace
+
+void ArdPacketBenchmarkServer()
+{
+    const size_t max_clients = MaxClients();
+    printf("%zu byte echo over loopback TCP, %u hardware threads, up to %zu clients\n\n", kPayloadSize,
+           std::thread::hardware_concurrency(), max_clients);
+    printf("%-8s %8s %8s %14s %10s\n", "server", "workers", "clients", "round trips/s", "idle cpu %");
+
+    for (const size_t client_count : kClientCounts)
+    {
+        if (client_count <= max_clients)
+        {
+            PollingServer polling;
+            Clients polling_clients;
+            if (polling.Start() && polling_clients.Connect(client_count, polling.Port()))
+            {
+                Report("polling", 1, client_count, polling_clients);
+            }
+            polling.Stop();
+
+            for (const size_t workers : kWorkerCounts)
+            {
+                EchoHandler handler;
+                ArdPacketServer server(handler);
+                ArdPacketServerConfig config;
+                config.packet = MakeConfig();
+                config.host = "127.0.0.1";
+                config.port = 0;
+                config.worker_threads = workers;
+                Clients clients;
+                if (server.Start(config) && clients.Connect(client_count, server.Port()))
+                {
+                    Report("epoll", workers, client_count, clients);
+                }
+            }
+
+            for (const size_t workers : kWorkerCounts)
+            {
+                EchoHandler handler;
+                ArdPacketUringServer server(handler);
+                ArdPacketServerConfig config;
+                config.packet = MakeConfig();
+                config.host = "127.0.0.1";
+                config.port = 0;
+                config.worker_threads = workers;
+                ArdPacketUringConfig uring_config;
+                uring_config.max_connections = static_cast<uint32_t>(client_count);
+                Clients clients;
+                if (server.Start(config, uring_config) && clients.Connect(client_count, server.Port()))
+                {
+                    Report("io_uring", workers, client_count, clients);
+                }
+            }
+        }
+    }
+}
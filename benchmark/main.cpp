@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ArdPacketBenchmark.h"
+
+struct ArdPacketBenchmarkEntry
+{
+    const char *name;
+    void (*run)();
+};
+
+static const ArdPacketBenchmarkEntry kBenchmarks[] = {
+    {"codec", ArdPacketBenchmarkCodec},
+    {"compress", ArdPacketBenchmarkCompress},
+    {"fec", ArdPacketBenchmarkFec},
+    {"link", ArdPacketBenchmarkLink},
+    {"server", ArdPacketBenchmarkServer},
+};
+
+static std::vector<ArdPacketBenchmarkResult> g_results;
+
+void ArdPacketBenchmarkRecord(const std::string &name, const double seconds, const uint64_t cycles,
+                              const size_t packets, const size_t bytes)
+{
+    ArdPacketBenchmarkResult result;
+    result.name = name;
+    result.ns_per_packet = (packets > 0 ? 1e9 * seconds / static_cast<double>(packets) : 0.0);
+    result.mb_per_s = (seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0);
+    result.cycles_per_byte = (bytes > 0 ? static_cast<double>(cycles) / static_cast<double>(bytes) : 0.0);
+    printf("%-32s %12.1f ns/packet %10.1f MB/s %8.2f cycles/byte\n", result.name.c_str(), result.ns_per_packet,
+           result.mb_per_s, result.cycles_per_byte);
+    g_results.push_back(result);
+}
+
+// one result per line, so a baseline is read back without a JSON parser
+static bool WriteJson(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file != nullptr)
+    {
+        fprintf(file, "{\"results\": [\n");
+        for (size_t k = 0; k < g_results.size(); ++k)
+        {
+            const ArdPacketBenchmarkResult &result = g_results[k];
+            fprintf(file,
+                    "  {\"name\": \"%s\", \"ns_per_packet\": %.3f, \"mb_per_s\": %.3f, "
+                    "\"cycles_per_byte\": %.4f}%s\n",
+                    result.name.c_str(), result.ns_per_packet, result.mb_per_s, result.cycles_per_byte,
+                    (k + 1 < g_results.size() ? "," : ""));
+        }
+        fprintf(file, "]}\n");
+        fclose(file);
+    }
+    return (file != nullptr);
+}
+
+static bool ReadJson(const char *path, std::map<std::string, double> &ns_per_packet)
+{
+    FILE *file = fopen(path, "r");
+    if (file != nullptr)
+    {
+        char line[512];
+        char name[256];
+        double value = 0.0;
+        while (fgets(line, sizeof(line), file) != nullptr)
+        {
+            if (sscanf(line, " {\"name\": \"%255[^\"]\", \"ns_per_packet\": %lf", name, &value) == 2)
+            {
+                ns_per_packet[name] = value;
+            }
+        }
+        fclose(file);
+    }
+    return (file != nullptr);
+}
+
+// flags cases slower than the baseline by more than threshold percent
+static size_t Compare(const std::map<std::string, double> &baseline, const double threshold)
+{
+    size_t regressions = 0;
+    size_t compared = 0;
+    for (const ArdPacketBenchmarkResult &result : g_results)
+    {
+        const auto found = baseline.find(result.name);
+        if (found != baseline.end() && found->second > 0.0)
+        {
+            const double change = 100.0 * (result.ns_per_packet - found->second) / found->second;
+            compared++;
+            if (change > threshold)
+            {
+                printf("REGRESSION %-32s %12.1f -> %12.1f ns/packet (%+.1f%%)\n", result.name.c_str(), found->second,
+                       result.ns_per_packet, change);
+                regressions++;
+            }
+        }
+    }
+    printf("%zu of %zu cases compared to the baseline regressed by more than %.1f%%\n", regressions, compared,
+           threshold);
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    // options, then benchmark names
+    const char *json_path = nullptr;
+    const char *baseline_path = nullptr;
+    double threshold = 10.0;
+    std::vector<const char *> names;
+    for (int k = 1; k < argc; ++k)
+    {
+        if (strncmp(argv[k], "--json=", 7) == 0)
+        {
+            json_path = &argv[k][7];
+        }
+        else if (strncmp(argv[k], "--baseline=", 11) == 0)
+        {
+            baseline_path = &argv[k][11];
+        }
+        else if (strncmp(argv[k], "--threshold=", 12) == 0)
+        {
+            threshold = atof(&argv[k][12]);
+        }
+        else
+        {
+            names.push_back(argv[k]);
+        }
+    }
+
+    // run every benchmark or only the ones named on the command line
+    int status = 0;
+    for (const ArdPacketBenchmarkEntry &entry : kBenchmarks)
+    {
+        bool selected = names.empty();
+        for (const char *name : names)
+        {
+            selected = selected || (strcmp(name, entry.name) == 0);
+        }
+        if (selected)
+        {
+            printf("== %s ==\n", entry.name);
+            entry.run();
+        }
+    }
+    for (const char *name : names)
+    {
+        bool found = false;
+        for (const ArdPacketBenchmarkEntry &entry : kBenchmarks)
+        {
+            found = found || (strcmp(name, entry.name) == 0);
+        }
+        if (!found)
+        {
+            fprintf(stderr, "unknown benchmark: %s\n", name);
+            status = 1;
+        }
+    }
+
+    if (json_path != nullptr && !WriteJson(json_path))
+    {
+        fprintf(stderr, "cannot write %s\n", json_path);
+        status = 1;
+    }
+    std::map<std::string, double> baseline;
+    if (baseline_path != nullptr && !ReadJson(baseline_path, baseline))
+    {
+        fprintf(stderr, "cannot read %s\n", baseline_path);
+        status = 1;
+    }
+    else if (baseline_path != nullptr && Compare(baseline, threshold) > 0)
+    {
+        status = 2;
+    }
+    return status;
+}
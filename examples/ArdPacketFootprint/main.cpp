@@ -0,0 +1,70 @@
+
+// Echo packets on the serial port, the smallest complete use of ArdPacket for measuring its flash and RAM.
+// Natively the serial port is replaced by a buffer holding one packet.
+
+#ifdef NATIVE_TEST_BUILD
+#include "ArdPacketBuffer.h"
+#else
+#include <Arduino.h>
+
+#include "ArdPacketSerial.h"
+#endif
+
+#ifdef NATIVE_TEST_BUILD
+ArdPacketBuffer g_stream;
+uint8_t g_packet_in[64] = {0};
+uint8_t g_packet_out[64] = {0};
+size_t g_packet_in_size = 0;
+#else
+ArdPacketSerial g_stream(Serial);
+#endif
+
+ArdPacket g_packet(g_stream);
+uint8_t g_payload[32] = {0};
+ArdPacketPayloadInfo g_payload_info = {};
+
+void setup()
+{
+#ifndef NATIVE_TEST_BUILD
+    Serial.begin(SERIAL_BAUDRATE);
+#endif
+    ArdPacketConfig packet_config = {};
+    packet_config.crc = true;
+    packet_config.delimiter = '|';
+    packet_config.max_payload_size = sizeof(g_payload);
+    packet_config.message_type_bytes = 1;
+    packet_config.payload_size_bytes = 1;
+    g_packet.Configure(packet_config);
+
+#ifdef NATIVE_TEST_BUILD
+    ArdPacketPayloadInfo info;
+    info.message_type = 1;
+    info.payload_size = 4;
+    g_packet.WritePacketToBuffer(info, reinterpret_cast<const uint8_t *>("ping"), sizeof(g_packet_in), g_packet_in,
+                                 g_packet_in_size);
+#endif
+}
+
+void loop()
+{
+#ifdef NATIVE_TEST_BUILD
+    g_stream.set_read_buffer(g_packet_in, g_packet_in_size);
+    g_stream.set_write_buffer(g_packet_out, sizeof(g_packet_out));
+#endif
+    if (g_packet.ReceivePayload(sizeof(g_payload), g_payload_info, g_payload) == kArdPacketStatusDone)
+    {
+        g_packet.SendPayload(g_payload_info, g_payload);
+    }
+}
+
+#ifdef NATIVE_TEST_BUILD
+int main()
+{
+    setup();
+    for (int k = 0; k < 4; ++k)
+    {
+        loop();
+    }
+    return 0;
+}
+#endif
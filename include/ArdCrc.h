@@ -57,6 +57,17 @@ extern "C" {
 #define CRC_ALGO_TABLE_DRIVEN 1
 
 
+/**
+ * Bits of data per table lookup.
+ *
+ * 8 uses a 256-entry table (512 bytes), 4 a 16-entry table (32 bytes) at
+ * about half the speed. On AVR the table is kept in flash.
+ */
+#ifndef ARD_CRC_TABLE_BITS
+#define ARD_CRC_TABLE_BITS 8
+#endif
+
+
 /**
  * The type of the CRC values.
  *
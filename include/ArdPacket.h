@@ -3,9 +3,7 @@
 #ifndef ARD_PACKET_H
 #define ARD_PACKET_H
 
-#ifdef NATIVE_TEST_BUILD
-#include <arpa/inet.h>
-#else
+#ifndef NATIVE_TEST_BUILD
 #include <Arduino.h>
 #endif
 
@@ -13,6 +11,101 @@
 #include <string.h>
 
 #include "ArdCrc.h"
+#include "ArdPacketCobs.h"
+#include "ArdPacketFec.h"
+
+/**
+ * @brief Size of the receive sync buffer
+ *
+ * Holds bytes read ahead of the current packet in COBS framing. In delimiter framing it is the lookback window of
+ * the bytes consumed for the current packet, rescanned for the next delimiter when the packet fails.
+ */
+#ifndef ARD_PACKET_SYNC_BUFFER_SIZE
+#if defined(__AVR__)
+#define ARD_PACKET_SYNC_BUFFER_SIZE 16
+#else
+#define ARD_PACKET_SYNC_BUFFER_SIZE 64
+#endif
+#endif
+
+/**
+ * @brief Keep receive and send statistics, see @c ArdPacket::GetStats
+ */
+#ifndef ARD_PACKET_STATS
+#if defined(__AVR__)
+#define ARD_PACKET_STATS 0
+#else
+#define ARD_PACKET_STATS 1
+#endif
+#endif
+
+/**
+ * @brief Number of log2 buckets of the statistics histograms, the last one also counts all larger values
+ */
+#ifndef ARD_PACKET_STATS_BUCKETS
+#define ARD_PACKET_STATS_BUCKETS 16
+#endif
+
+/**
+ * @brief Report state machine transitions to an @c ArdPacketTraceSink, see @c ArdPacket::SetTraceSink
+ */
+#ifndef ARD_PACKET_TRACE
+#define ARD_PACKET_TRACE 0
+#endif
+
+/**
+ * @brief Packet framing
+ */
+enum eArdPacketFraming
+{
+    /**
+     * @brief Delimiter followed by raw header and payload
+     */
+    kArdPacketFramingDelimiter = 0,
+    /**
+     * @brief Delimiter followed by COBS encoded header and payload
+     *
+     * The delimiter never appears inside a packet, so the receiver resynchronizes on the next packet after any
+     * error. Overhead is one byte per packet plus one byte per 254 bytes.
+     */
+    kArdPacketFramingCobs
+};
+
+/**
+ * @brief Encoding of the message type and payload size header fields
+ */
+enum eArdPacketHeaderEncoding
+{
+    /**
+     * @brief Big-endian fields of @c message_type_bytes and @c payload_size_bytes bytes
+     */
+    kArdPacketHeaderFixed = 0,
+    /**
+     * @brief Unsigned LEB128 fields, seven bits per byte with the least significant group first
+     *
+     * Values below 128 take one byte and values below 16384 two bytes. @c message_type_bytes and
+     * @c payload_size_bytes still bound the values, so a field takes at most one byte more than with fixed fields.
+     * Only available with delimiter framing without forward error correction.
+     */
+    kArdPacketHeaderVarint
+};
+
+/**
+ * @brief Millisecond clock compatible with Arduino's @c millis, or a microsecond clock where noted
+ */
+using ArdPacketClock = uint32_t (*)();
+
+/**
+ * @brief Payload size range of a message type
+ *
+ * Set both sizes equal for fixed size messages.
+ */
+struct ArdPacketSizeLimit
+{
+    uint32_t message_type = 0;
+    size_t min_payload_size = 1;
+    size_t max_payload_size = 0;
+};
 
 /**
  * @brief Packet Configuration
@@ -48,6 +141,137 @@ struct ArdPacketConfig
      * @brief Option to use CRC
      */
     bool crc = false;
+
+    /**
+     * @brief Packet framing
+     */
+    eArdPacketFraming framing = kArdPacketFramingDelimiter;
+
+    /**
+     * @brief Encoding of the message type and payload size fields
+     */
+    eArdPacketHeaderEncoding header_encoding = kArdPacketHeaderFixed;
+
+    /**
+     * @brief Number of Reed-Solomon parity bytes per block, zero to disable forward error correction
+     *
+     * Must be even, up to 16. Half as many corrupted bytes per block are corrected. Only available with
+     * delimiter framing.
+     */
+    uint8_t fec_parity_bytes = 0;
+
+    /**
+     * @brief Number of payload bytes per forward error correction block
+     *
+     * Up to @c ARD_PACKET_FEC_MAX_BLOCK_SIZE and at most 255 bytes including parity.
+     */
+    uint8_t fec_block_size = 32;
+
+    /**
+     * @brief Payload size ranges per message type sorted by message type, nullptr for none
+     *
+     * Packets whose payload size is outside the range of their message type are dropped as
+     * @c kArdPacketStatusInvalidPayloadSize right after the payload size field, before any payload byte is read.
+     * Message types not in the table accept 1 to @c max_payload_size bytes. The table is owned by the caller and
+     * may live in flash.
+     */
+    const ArdPacketSizeLimit *size_limits = nullptr;
+
+    /**
+     * @brief Number of entries in @c size_limits
+     */
+    size_t size_limit_count = 0;
+
+    /**
+     * @brief Drop a partial packet when no byte arrived for this long, 0 to wait forever
+     *
+     * Bounds recovery after a sender stops mid packet, which otherwise consumes the next packet as the rest of the
+     * stale one. Only a call that finds no new bytes in the stream times out, so bytes already waiting are read
+     * first however late the call. Poll at least every @c frame_timeout_ms for the drop to happen before the
+     * sender restarts.
+     */
+    uint32_t frame_timeout_ms = 0;
+
+    /**
+     * @brief Millisecond clock for @c frame_timeout_ms, defaults to @c millis on Arduino
+     */
+    ArdPacketClock clock = nullptr;
+
+    /**
+     * @brief Microsecond clock for the receive time statistics and tracing, defaults to @c micros on Arduino
+     */
+    ArdPacketClock clock_us = nullptr;
+};
+
+/**
+ * @brief Cumulative receive and send statistics
+ *
+ * @c ReceivePayload completes at most one packet per call, so @c frames_received / @c receive_calls shows how many
+ * calls find a packet. Histogram bucket @c i counts values of @c i significant bits: 0, 1, 2-3, 4-7 and so on.
+ */
+struct ArdPacketStats
+{
+    /**
+     * @brief Calls of @c ReceivePayload with bytes available
+     */
+    uint32_t receive_calls = 0;
+
+    /**
+     * @brief Packets received, including skipped ones
+     */
+    uint32_t frames_received = 0;
+
+    /**
+     * @brief Packets skipped by the receive filter
+     */
+    uint32_t frames_skipped = 0;
+
+    /**
+     * @brief Bytes read from the stream
+     */
+    uint32_t bytes_received = 0;
+
+    /**
+     * @brief Packets sent
+     */
+    uint32_t frames_sent = 0;
+
+    /**
+     * @brief Bytes the stream accepted
+     */
+    uint32_t bytes_sent = 0;
+
+    /**
+     * @brief Bytes dropped while searching for a delimiter
+     */
+    uint32_t discarded_bytes = 0;
+
+    uint32_t header_crc_failures = 0;
+    uint32_t payload_crc_failures = 0;
+
+    /**
+     * @brief Packets dropped for their payload size
+     */
+    uint32_t invalid_sizes = 0;
+
+    uint32_t read_failures = 0;
+
+    /**
+     * @brief Writes the stream accepted fewer bytes of than promised by @c availableForWrite
+     */
+    uint32_t short_writes = 0;
+
+    uint32_t frame_timeouts = 0;
+
+    /**
+     * @brief Payload sizes of received packets
+     */
+    uint32_t payload_size_log2[ARD_PACKET_STATS_BUCKETS] = {0};
+
+    /**
+     * @brief Microseconds from delimiter to received packet, with a @c clock_us only
+     */
+    uint32_t receive_time_log2[ARD_PACKET_STATS_BUCKETS] = {0};
 };
 
 /**
@@ -75,7 +299,19 @@ enum eArdPacketConfigStatus
     kArdPacketConfigSuccess = 0,
     kArdPacketConfigInvalidMessageTypeBytes,
     kArdPacketConfigInvalidPayloadSizeBytes,
-    kArdPacketConfigInvalidMaxPayloadSize
+    kArdPacketConfigInvalidMaxPayloadSize,
+    // new statuses go at the end so stored or compared values stay stable
+    kArdPacketConfigInvalidFraming,
+    kArdPacketConfigInvalidFec,
+    kArdPacketConfigInvalidWindowSize,
+    kArdPacketConfigInvalidStorage,
+    kArdPacketConfigInvalidClock,
+    kArdPacketConfigInvalidCredit,
+    kArdPacketConfigInvalidWriteEstimate,
+    kArdPacketConfigInvalidQuantum,
+    kArdPacketConfigInvalidSizeLimits,
+    kArdPacketConfigInvalidCompression,
+    kArdPacketConfigInvalidDelta
 };
 
 /**
@@ -95,9 +331,40 @@ enum eArdPacketStatus
     kArdPacketStatusCrcFailed,
     kArdPacketStatusHeaderInProgress,
     kArdPacketStatusPayloadInProgress,
-    kArdPacketStatusDone
+    kArdPacketStatusDone,
+    // new statuses go at the end so stored or compared values stay stable
+    kArdPacketStatusInvalidFraming,
+    kArdPacketStatusFecFailed,
+    kArdPacketStatusWindowFull,
+    kArdPacketStatusNoCredit,
+    kArdPacketStatusSkipped,
+    kArdPacketStatusFrameTimeout,
+    kArdPacketStatusCompressionFailed,
+    kArdPacketStatusDeltaBaseMissing
 };
 
+/**
+ * @brief Whether a receive status reports a frame that was read and dropped as invalid
+ *
+ * The bytes of the frame were consumed and the stream resynchronized, so the next frame may already be waiting.
+ */
+inline bool ArdPacketStatusFrameError(const eArdPacketStatus status)
+{
+    return (status == kArdPacketStatusCrcFailed || status == kArdPacketStatusInvalidPayloadSize ||
+            status == kArdPacketStatusInvalidMessageType || status == kArdPacketStatusInvalidFraming ||
+            status == kArdPacketStatusFecFailed || status == kArdPacketStatusFrameTimeout);
+}
+
+/**
+ * @brief Whether a receive status ends a frame, so reading may continue with the next one
+ *
+ * True for a received or skipped payload and for every @c ArdPacketStatusFrameError status.
+ */
+inline bool ArdPacketStatusFrameConsumed(const eArdPacketStatus status)
+{
+    return (status == kArdPacketStatusDone || status == kArdPacketStatusSkipped || ArdPacketStatusFrameError(status));
+}
+
 /**
  * @brief Abstract class compatible with Arduino's @c Serial interface.
  *
@@ -119,63 +386,159 @@ class ArdPacketStreamInterface
     virtual size_t write(const uint8_t *buffer, size_t size) = 0;
 };
 
-class ArdPacket
+/**
+ * @brief Decides per message type whether a received payload is copied
+ */
+class ArdPacketReceiveFilter
 {
    public:
-    explicit ArdPacket(ArdPacketStreamInterface &stream) : m_stream(stream) {}
+    ArdPacketReceiveFilter() = default;
 
     /**
-     * @brief Configure packet
+     * @brief Largest payload accepted for a message type
      *
-     * @param config
-     * @return
+     * @param message_type
+     * @return size in bytes, 0 to skip the payload without copying it
      */
-    eArdPacketConfigStatus Configure(const ArdPacketConfig &config);
+    virtual size_t MaxPayloadSize(uint32_t message_type) = 0;
+};
 
+#if ARD_PACKET_TRACE
+/**
+ * @brief Direction of a traced state machine
+ */
+enum eArdPacketTraceDirection
+{
+    kArdPacketTraceReceive = 0,
+    kArdPacketTraceSend
+};
+
+/**
+ * @brief State machine transition
+ */
+struct ArdPacketTraceEvent
+{
     /**
-     * @brief Receive payload from data stream
+     * @brief Time of the transition from @c clock_us, 0 without a clock
+     */
+    uint32_t time_us = 0;
+
+    eArdPacketTraceDirection direction = kArdPacketTraceReceive;
+
+    /**
+     * @brief States left and entered, see @c ArdPacket::GetStateName
+     */
+    uint8_t from_state = 0;
+    uint8_t to_state = 0;
+
+    /**
+     * @brief Bytes available to the state left, and bytes it consumed from them
+     */
+    size_t available = 0;
+    size_t consumed = 0;
+};
+
+/**
+ * @brief Receives state machine transitions of a packet
+ */
+class ArdPacketTraceSink
+{
+   public:
+    ArdPacketTraceSink() = default;
+
+    virtual void OnStateChange(const ArdPacketTraceEvent &event) = 0;
+};
+#endif
+
+/**
+ * @brief Configuration, packet layout and statistics shared by @c ArdPacketReceiver, @c ArdPacketSender and
+ * @c ArdPacket
+ *
+ * The receive and send state machines are separate parts, so an endpoint that only receives or only sends carries
+ * only the state it needs and only pulls in the code it calls.
+ */
+class ArdPacketBase
+{
+   public:
+    /**
+     * @brief Configuration set by @c Configure
+     */
+    const ArdPacketConfig &GetConfig() const
+    {
+        return m_config;
+    }
+
+    /**
+     * @brief Largest number of bytes a packet with @c payload_size bytes of payload occupies on the stream
      *
-     * @param max_payload_size
-     * @param payload
-     * @param info
-     * @return
+     * Exact for delimiter framing, an upper bound for COBS framing.
+     *
+     * @param payload_size
+     * @return size in bytes
      */
-    eArdPacketStatus ReceivePayload(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+    size_t GetMaxPacketSize(size_t payload_size) const;
 
     /**
-     * @brief Write payload to data stream
+     * @brief Largest payload accepted for a message type, to size receive buffers per message type
      *
      * @param message_type
-     * @param payload_size
-     * @param payload
-     * @return
+     * @return size from @c size_limits, otherwise @c max_payload_size
      */
-    eArdPacketStatus SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+    size_t GetMaxPayloadSize(uint32_t message_type) const;
 
     /**
-     * @brief Reset state
+     * @brief Largest message type the header can carry
      */
-    void Reset()
+    uint32_t GetMaxMessageType() const
     {
-        ResetRead();
-        ResetWrite();
+        return static_cast<uint32_t>(m_max_message_type_value);
     }
 
     /**
-     * @brief Reset read state
+     * @brief Whether the payload size is within the @c size_limits of its message type
+     *
+     * @param info
+     * @return true also for message types without a limit
      */
-    void ResetRead()
+    bool PayloadSizeAllowed(const ArdPacketPayloadInfo &info) const;
+
+#if ARD_PACKET_TRACE
+    /**
+     * @brief Report every state transition of @c ReceivePayload and @c SendPayload
+     *
+     * @param sink owned by the caller, nullptr to stop tracing
+     */
+    void SetTraceSink(ArdPacketTraceSink *sink)
     {
-        ResetState(m_read);
+        m_trace = sink;
     }
 
     /**
-     * @brief Reset write state
+     * @brief Name of a traced state
+     *
+     * @param state
+     * @return name, "Unknown" for values that are no state
      */
-    void ResetWrite()
+    static const char *GetStateName(uint8_t state);
+#endif
+
+#if ARD_PACKET_STATS
+    /**
+     * @brief Copy of the statistics since @c Configure or @c ResetStats
+     */
+    ArdPacketStats GetStats() const
     {
-        ResetState(m_write);
+        return m_stats;
+    }
+
+    /**
+     * @brief Clear the statistics
+     */
+    void ResetStats()
+    {
+        m_stats = ArdPacketStats();
     }
+#endif
 
     /**
      * @brief Copy payload into external packet buffer
@@ -202,13 +565,57 @@ class ArdPacket
     eArdPacketStatus ReadPacketFromBuffer(const uint8_t *packet, const size_t packet_size, ArdPacketPayloadInfo &info,
                                           size_t &payload_index) const;
 
-   private:
+    /**
+     * @brief Copy payload from external packet buffer
+     *
+     * Supports every framing. COBS framed packets can only be read with this method since their payload is not
+     * stored contiguously in the packet.
+     *
+     * @param packet
+     * @param packet_size
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return eArdPacketStatus
+     */
+    eArdPacketStatus ReadPacketFromBuffer(const uint8_t *packet, size_t packet_size, size_t max_payload_size,
+                                          ArdPacketPayloadInfo &info, uint8_t *payload) const
+    {
+        size_t packet_used = 0;
+        return ReadPacketFromBuffer(packet, packet_size, max_payload_size, info, payload, packet_used);
+    }
+
+    /**
+     * @brief Copy payload of the first packet in an external buffer holding one or more packets
+     *
+     * @param packet
+     * @param packet_size
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @param packet_used set to the size of the packet read, the next packet starts right after it
+     * @return eArdPacketStatus
+     */
+    eArdPacketStatus ReadPacketFromBuffer(const uint8_t *packet, size_t packet_size, size_t max_payload_size,
+                                          ArdPacketPayloadInfo &info, uint8_t *payload, size_t &packet_used) const;
+
+   protected:
+    // relays packets through the read and write state machines
+    friend class ArdPacketForward;
+
+    explicit ArdPacketBase(ArdPacketStreamInterface &stream) : m_stream(stream) {}
+
     static constexpr size_t kArdPacketDelimiterBytes = 1;
     static constexpr size_t kArdPacketCrcBytes = 2;
     static constexpr size_t kArdPacketMaxPayloadSizeBytes = 4;
     static constexpr size_t kArdPacketMaxMessageTypeBytes = 4;
-    static constexpr size_t kArdPacketMaxHeaderSize =
-        1 + kArdPacketMaxPayloadSizeBytes + kArdPacketMaxMessageTypeBytes + 2 * kArdPacketCrcBytes;
+    static constexpr size_t kArdPacketMaxVarintBytes = 5;
+    static constexpr uint8_t kArdPacketVarintMore = 0x80;
+    static constexpr size_t kArdPacketMaxHeaderSize = 1 + 2 * kArdPacketMaxVarintBytes + 2 * kArdPacketCrcBytes;
+    static constexpr size_t kArdPacketSyncBufferSize = ARD_PACKET_SYNC_BUFFER_SIZE;
+    static constexpr size_t kArdPacketCobsWriteChunkSize = 32;
+    static constexpr size_t kArdPacketFecChunkSize = 32;
+    static constexpr size_t kArdPacketSkipChunkSize = 32;
 
     enum eArdPacketState
     {
@@ -218,6 +625,8 @@ class ArdPacket
         kArdPacketStateHeaderCrc,
         kArdPacketStatePayload,
         kArdPacketStatePayloadCrc,
+        kArdPacketStateEncoded,
+        kArdPacketStateFec,
         kArdPacketStateDone
     };
 
@@ -227,83 +636,390 @@ class ArdPacket
         size_t available = 0;
         size_t payload_index = 0;
         crc_t crc = 0;
+        bool skip = false;
+        // variable length header field in progress
+        uint8_t field_index = 0;
+        uint32_t field_value = 0;
+    };
+
+    /**
+     * @brief Receive state machine, every method takes the endpoint it belongs to
+     */
+    class ReadMachine
+    {
+       public:
+        void Begin(ArdPacketBase &owner);
+        eArdPacketStatus Receive(ArdPacketBase &owner, size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                 uint8_t *payload);
+
+        eArdPacketStatus FilterPayload(const ArdPacketPayloadInfo &info);
+        int ReadByte(ArdPacketBase &owner);
+        size_t ReadBytes(ArdPacketBase &owner, uint8_t *data, size_t size);
+        eArdPacketStatus ReadVarint(ArdPacketBase &owner, size_t value_bytes, eArdPacketStatus invalid_status);
+        void RecordLookback(ArdPacketBase &owner, const uint8_t *data, size_t size);
+        void Resync(ArdPacketBase &owner);
+        void StartBody(ArdPacketBase &owner);
+        void StatsFrameStart(ArdPacketBase &owner);
+        void StatsReceived(ArdPacketBase &owner, eArdPacketStatus status, const ArdPacketPayloadInfo &info);
+
+        eArdPacketStatus ProcessReadStateDelimiter(ArdPacketBase &owner);
+        eArdPacketStatus ProcessReadStateHeaderCrc(ArdPacketBase &owner);
+        eArdPacketStatus ProcessReadStateMessageType(ArdPacketBase &owner, ArdPacketPayloadInfo &info);
+        eArdPacketStatus ProcessReadStatePayloadSize(ArdPacketBase &owner, size_t max_payload_size,
+                                                     ArdPacketPayloadInfo &info);
+        eArdPacketStatus ProcessReadStatePayload(ArdPacketBase &owner, const ArdPacketPayloadInfo &info,
+                                                 uint8_t *payload);
+        eArdPacketStatus ProcessReadStatePayloadCrc(ArdPacketBase &owner);
+        eArdPacketStatus ProcessReadStateEncoded(ArdPacketBase &owner, size_t max_payload_size,
+                                                 ArdPacketPayloadInfo &info, uint8_t *payload);
+        eArdPacketStatus ProcessReadStateFec(ArdPacketBase &owner, size_t max_payload_size,
+                                             ArdPacketPayloadInfo &info, uint8_t *payload);
+
+        ArdPacketStateData m_read = {};
+
+        // receive sync buffer
+        uint8_t m_sync[kArdPacketSyncBufferSize] = {0};
+        size_t m_sync_index = 0;
+        size_t m_sync_size = 0;
+        size_t m_lookback_size = 0;
+
+#if ARD_PACKET_COBS
+        ArdPacketCobsDecoder m_cobs_read = {};
+#endif
+#if ARD_PACKET_FEC
+        ArdPacketFecDecoder m_fec_read = {};
+#endif
+
+        // receive filter
+        ArdPacketReceiveFilter *m_filter = nullptr;
+
+        // partial packet timeout, on the clock of the configuration
+        uint32_t m_read_ms = 0;
+        size_t m_read_pending = 0;
+        uint32_t m_frame_timeouts = 0;
+
+#if ARD_PACKET_STATS
+        uint32_t m_read_start_us = 0;
+#endif
     };
 
+    /**
+     * @brief Send state machine, every method takes the endpoint it belongs to
+     */
+    class WriteMachine
+    {
+       public:
+        void Begin();
+        eArdPacketStatus Send(ArdPacketBase &owner, const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+        size_t WriteBytes(ArdPacketBase &owner, const uint8_t *data, size_t size);
+
+        eArdPacketStatus ProcessWriteStateDelimiter(ArdPacketBase &owner, const ArdPacketPayloadInfo &info);
+        eArdPacketStatus ProcessWriteStateHeaderCrc(ArdPacketBase &owner);
+        eArdPacketStatus ProcessWriteStateMessageType(ArdPacketBase &owner, const ArdPacketPayloadInfo &info);
+        eArdPacketStatus ProcessWriteStatePayloadSize(ArdPacketBase &owner, const ArdPacketPayloadInfo &info);
+        eArdPacketStatus ProcessWriteStatePayload(ArdPacketBase &owner, const ArdPacketPayloadInfo &info,
+                                                  const uint8_t *payload);
+        eArdPacketStatus ProcessWriteStatePayloadCrc(ArdPacketBase &owner);
+        eArdPacketStatus ProcessWriteStateEncoded(ArdPacketBase &owner, const uint8_t *payload);
+        eArdPacketStatus ProcessWriteStateFec(ArdPacketBase &owner, const uint8_t *payload);
+
+        ArdPacketStateData m_write = {};
+
+#if ARD_PACKET_COBS
+        ArdPacketCobsEncoder m_cobs_write = {};
+#endif
+#if ARD_PACKET_FEC
+        ArdPacketFecEncoder m_fec_write = {};
+#endif
+    };
+
+    /**
+     * @brief Validate and store a configuration, the state machines are reset by the caller
+     *
+     * @param config
+     * @return status
+     */
+    eArdPacketConfigStatus SetConfig(const ArdPacketConfig &config);
+
     static void ConvertToBigEndian(const uint32_t value, const size_t value_bytes, uint8_t *data);
     static uint32_t ConvertFromBigEndian(const uint8_t *data, const size_t value_bytes);
     static void ResetState(ArdPacketStateData &state);
-
-    eArdPacketStatus ProcessReadStateDelimiter();
-    eArdPacketStatus ProcessReadStateHeaderCrc();
-    eArdPacketStatus ProcessReadStateMessageType(ArdPacketPayloadInfo &info);
-    eArdPacketStatus ProcessReadStatePayloadSize(size_t max_payload_size, ArdPacketPayloadInfo &info);
-    eArdPacketStatus ProcessReadStatePayload(const ArdPacketPayloadInfo &info, uint8_t *payload);
-    eArdPacketStatus ProcessReadStatePayloadCrc();
-
-    eArdPacketStatus ProcessWriteStateDelimiter();
-    eArdPacketStatus ProcessWriteStateHeaderCrc();
-    eArdPacketStatus ProcessWriteStateMessageType(const ArdPacketPayloadInfo &info);
-    eArdPacketStatus ProcessWriteStatePayloadSize(const ArdPacketPayloadInfo &info);
-    eArdPacketStatus ProcessWriteStatePayload(const ArdPacketPayloadInfo &info, const uint8_t *payload);
-    eArdPacketStatus ProcessWriteStatePayloadCrc();
+    static size_t StatsBucket(uint32_t value);
+    static bool AddVarintByte(uint8_t data, size_t index, size_t value_bytes, uint32_t &value);
+
+    size_t GetMinFieldSize(size_t value_bytes) const;
+    size_t GetFieldSize(uint32_t value, size_t value_bytes) const;
+    size_t WriteField(uint32_t value, size_t value_bytes, uint8_t *data) const;
+    eArdPacketStatus ReadField(const uint8_t *data, size_t size, size_t value_bytes, eArdPacketStatus invalid_status,
+                               uint32_t &value, size_t &field_size) const;
+    size_t GetHeaderFieldsSize() const;
+    size_t WriteHeaderFields(const ArdPacketPayloadInfo &info, uint8_t *fields) const;
+    eArdPacketStatus ReadHeaderFields(const uint8_t *fields, size_t max_payload_size, ArdPacketPayloadInfo &info) const;
+    const ArdPacketSizeLimit *FindSizeLimit(uint32_t message_type) const;
+    void Trace(bool receive, eArdPacketState from_state, eArdPacketState to_state, size_t available_before,
+               size_t available_after);
 
     // configuration
     ArdPacketConfig m_config = {};
     size_t m_max_message_type_value = 0;
 
-    // read and write state
-    ArdPacketStateData m_read = {};
-    ArdPacketStateData m_write = {};
+    // statistics and tracing
+    ArdPacketClock m_clock_us = nullptr;
+#if ARD_PACKET_STATS
+    ArdPacketStats m_stats = {};
+#endif
+#if ARD_PACKET_TRACE
+    ArdPacketTraceSink *m_trace = nullptr;
+#endif
 
     // stream interface
     ArdPacketStreamInterface &m_stream;
 };
 
-// inline methods
+/**
+ * @brief Receive-only endpoint, for loggers and other nodes that never send
+ */
+class ArdPacketReceiver : public ArdPacketBase
+{
+   public:
+    explicit ArdPacketReceiver(ArdPacketStreamInterface &stream) : ArdPacketBase(stream) {}
+
+    /**
+     * @brief Configure packet
+     *
+     * @param config
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketConfig &config);
+
+    /**
+     * @brief Receive payload from data stream
+     *
+     * @param max_payload_size
+     * @param payload
+     * @param info
+     * @return
+     */
+    eArdPacketStatus ReceivePayload(const size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload)
+    {
+        return m_reader.Receive(*this, max_payload_size, info, payload);
+    }
+
+    /**
+     * @brief Filter received payloads by message type, see @c ArdPacket::SetReceiveFilter
+     *
+     * @param filter owned by the caller, nullptr to copy every payload
+     */
+    void SetReceiveFilter(ArdPacketReceiveFilter *filter)
+    {
+        m_reader.m_filter = filter;
+    }
+
+    /**
+     * @brief Reset state
+     */
+    void Reset()
+    {
+        ResetRead();
+    }
+
+    /**
+     * @brief Reset read state
+     */
+    void ResetRead()
+    {
+        ResetState(m_reader.m_read);
+    }
 
-inline void ArdPacket::ConvertToBigEndian(const uint32_t value, const size_t value_bytes, uint8_t *data)
+    /**
+     * @brief Number of partial packets dropped after @c frame_timeout_ms without a byte
+     */
+    uint32_t GetFrameTimeouts() const
+    {
+        return m_reader.m_frame_timeouts;
+    }
+
+   private:
+    // relays packets through the read state machine
+    friend class ArdPacketForward;
+
+    ReadMachine m_reader = {};
+};
+
+/**
+ * @brief Send-only endpoint, for sensor nodes and other nodes that never receive
+ */
+class ArdPacketSender : public ArdPacketBase
 {
-    // copy from data to packet
-    if (value_bytes == 1)
+   public:
+    explicit ArdPacketSender(ArdPacketStreamInterface &stream) : ArdPacketBase(stream) {}
+
+    /**
+     * @brief Configure packet
+     *
+     * @param config
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketConfig &config);
+
+    /**
+     * @brief Write payload to data stream
+     *
+     * @param info
+     * @param payload
+     * @return
+     */
+    eArdPacketStatus SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload)
     {
-        data[0] = static_cast<uint8_t>(value);
+        return m_writer.Send(*this, info, payload);
     }
-    else if (value_bytes == 2)
+
+    /**
+     * @brief Reset state
+     */
+    void Reset()
     {
-        uint16_t swapped_value = htons(static_cast<uint16_t>(value));
-        memcpy(data, &swapped_value, value_bytes);
+        ResetWrite();
     }
-    else if (value_bytes == 4)
+
+    /**
+     * @brief Reset write state
+     */
+    void ResetWrite()
     {
-        uint32_t swapped_value = htonl(value);
-        memcpy(data, &swapped_value, value_bytes);
+        ResetState(m_writer.m_write);
     }
-}
 
-inline uint32_t ArdPacket::ConvertFromBigEndian(const uint8_t *data, const size_t value_bytes)
+   private:
+    WriteMachine m_writer = {};
+};
+
+/**
+ * @brief Endpoint that receives and sends, the parts of @c ArdPacketReceiver and @c ArdPacketSender on one stream
+ */
+class ArdPacket : public ArdPacketBase
 {
-    uint32_t retval = 0;
-    // copy from data to packet
-    if (value_bytes == 1)
+   public:
+    explicit ArdPacket(ArdPacketStreamInterface &stream) : ArdPacketBase(stream) {}
+
+    /**
+     * @brief Configure packet
+     *
+     * @param config
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketConfig &config);
+
+    /**
+     * @brief Receive payload from data stream
+     *
+     * @param max_payload_size
+     * @param payload
+     * @param info
+     * @return
+     */
+    eArdPacketStatus ReceivePayload(const size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload)
     {
-        retval = static_cast<uint32_t>(data[0]);
+        return m_reader.Receive(*this, max_payload_size, info, payload);
     }
-    else if (value_bytes == 2)
+
+    /**
+     * @brief Write payload to data stream
+     *
+     * @param message_type
+     * @param payload_size
+     * @param payload
+     * @return
+     */
+    eArdPacketStatus SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload)
     {
-        uint16_t swap_value = 0;
-        memcpy(&swap_value, data, value_bytes);
-        retval = static_cast<uint32_t>(ntohs(swap_value));
+        return m_writer.Send(*this, info, payload);
     }
-    else if (value_bytes == 4)
+
+    /**
+     * @brief Filter received payloads by message type
+     *
+     * Skipped payloads are read past (and their CRC checked) in chunks, and @c ReceivePayload returns
+     * @c kArdPacketStatusSkipped instead of copying them. With COBS or FEC framing they are still decoded through the
+     * payload buffer.
+     *
+     * @param filter owned by the caller, nullptr to copy every payload
+     */
+    void SetReceiveFilter(ArdPacketReceiveFilter *filter)
     {
-        uint32_t swap_value = 0;
-        memcpy(&swap_value, data, value_bytes);
-        retval = ntohl(swap_value);
+        m_reader.m_filter = filter;
+    }
+
+    /**
+     * @brief Reset state
+     */
+    void Reset()
+    {
+        ResetRead();
+        ResetWrite();
+    }
+
+    /**
+     * @brief Reset read state
+     */
+    void ResetRead()
+    {
+        ResetState(m_reader.m_read);
+    }
+
+    /**
+     * @brief Reset write state
+     */
+    void ResetWrite()
+    {
+        ResetState(m_writer.m_write);
+    }
+
+    /**
+     * @brief Number of partial packets dropped after @c frame_timeout_ms without a byte
+     */
+    uint32_t GetFrameTimeouts() const
+    {
+        return m_reader.m_frame_timeouts;
+    }
+
+   private:
+    // relays packets through the read and write state machines
+    friend class ArdPacketForward;
+
+    ReadMachine m_reader = {};
+    WriteMachine m_writer = {};
+};
+
+#if ARD_PACKET_STATS
+#define ARD_PACKET_STATS_ADD(counter, value) (owner.m_stats.counter += (value))
+#else
+#define ARD_PACKET_STATS_ADD(counter, value)
+#endif
+
+// inline methods
+
+inline void ArdPacketBase::ConvertToBigEndian(const uint32_t value, const size_t value_bytes, uint8_t *data)
+{
+    // most significant byte first, independent of the host byte order
+    for (size_t k = 0; k < value_bytes; ++k)
+    {
+        data[k] = static_cast<uint8_t>(value >> (8 * (value_bytes - 1 - k)));
+    }
+}
+
+inline uint32_t ArdPacketBase::ConvertFromBigEndian(const uint8_t *data, const size_t value_bytes)
+{
+    uint32_t retval = 0;
+    for (size_t k = 0; k < value_bytes; ++k)
+    {
+        retval = (retval << 8) | data[k];
     }
     return retval;
 }
 
-inline eArdPacketConfigStatus ArdPacket::Configure(const ArdPacketConfig &config)
+inline eArdPacketConfigStatus ArdPacketBase::SetConfig(const ArdPacketConfig &config)
 {
     eArdPacketConfigStatus status = kArdPacketConfigSuccess;
 
@@ -318,6 +1034,31 @@ inline eArdPacketConfigStatus ArdPacket::Configure(const ArdPacketConfig &config
         status = kArdPacketConfigInvalidPayloadSizeBytes;
     }
 
+    if (status == kArdPacketConfigSuccess && config.framing != kArdPacketFramingDelimiter &&
+        ((ARD_PACKET_COBS == 0) || (config.framing != kArdPacketFramingCobs) ||
+         (config.header_encoding != kArdPacketHeaderFixed)))
+    {
+        status = kArdPacketConfigInvalidFraming;
+    }
+
+    if (status == kArdPacketConfigSuccess && config.header_encoding != kArdPacketHeaderFixed &&
+        config.header_encoding != kArdPacketHeaderVarint)
+    {
+        status = kArdPacketConfigInvalidFraming;
+    }
+
+    if (status == kArdPacketConfigSuccess && config.fec_parity_bytes != 0)
+    {
+        const size_t codeword_size = static_cast<size_t>(config.fec_block_size) + config.fec_parity_bytes;
+        if ((ARD_PACKET_FEC == 0) || (config.framing != kArdPacketFramingDelimiter) ||
+            (config.header_encoding != kArdPacketHeaderFixed) || (config.fec_parity_bytes % 2 != 0) ||
+            (config.fec_parity_bytes > kArdPacketFecMaxParityBytes) || (config.fec_block_size == 0) ||
+            (config.fec_block_size > kArdPacketFecMaxBlockSize) || (codeword_size > kArdPacketFecMaxCodewordSize))
+        {
+            status = kArdPacketConfigInvalidFec;
+        }
+    }
+
     size_t header_size = 0;
     size_t header_and_crc_size = 0;
     if (status == kArdPacketConfigSuccess)
@@ -353,6 +1094,34 @@ inline eArdPacketConfigStatus ArdPacket::Configure(const ArdPacketConfig &config
         }
     }
 
+    ArdPacketClock clock = config.clock;
+#ifndef NATIVE_TEST_BUILD
+    if (clock == nullptr)
+    {
+        clock = []() -> uint32_t { return static_cast<uint32_t>(millis()); };
+    }
+#endif
+    if (status == kArdPacketConfigSuccess && clock == nullptr && config.frame_timeout_ms != 0)
+    {
+        status = kArdPacketConfigInvalidClock;
+    }
+
+    if (status == kArdPacketConfigSuccess && ((config.size_limits == nullptr) != (config.size_limit_count == 0)))
+    {
+        status = kArdPacketConfigInvalidSizeLimits;
+    }
+    for (size_t index = 0; status == kArdPacketConfigSuccess && index < config.size_limit_count; ++index)
+    {
+        // sorted for the binary search in FindSizeLimit
+        const ArdPacketSizeLimit &limit = config.size_limits[index];
+        if ((limit.min_payload_size == 0) || (limit.min_payload_size > limit.max_payload_size) ||
+            (limit.max_payload_size > config.max_payload_size) ||
+            (index > 0 && limit.message_type <= config.size_limits[index - 1].message_type))
+        {
+            status = kArdPacketConfigInvalidSizeLimits;
+        }
+    }
+
     if (status == kArdPacketConfigSuccess)
     {
         // max message type
@@ -370,62 +1139,150 @@ inline eArdPacketConfigStatus ArdPacket::Configure(const ArdPacketConfig &config
         }
 
         m_config = config;
+        m_config.clock = clock;
+        m_clock_us = config.clock_us;
+#ifndef NATIVE_TEST_BUILD
+        if (m_clock_us == nullptr)
+        {
+            m_clock_us = []() -> uint32_t { return static_cast<uint32_t>(micros()); };
+        }
+#endif
+#if ARD_PACKET_STATS
+        m_stats = ArdPacketStats();
+#endif
+    }
+
+    return status;
+}
+
+inline void ArdPacketBase::ReadMachine::Begin(ArdPacketBase &owner)
+{
+    ResetState(m_read);
+    m_sync_index = 0;
+    m_sync_size = 0;
+    m_lookback_size = 0;
+    m_read_ms = (owner.m_config.clock != nullptr ? owner.m_config.clock() : 0);
+    m_read_pending = 0;
+    m_frame_timeouts = 0;
+}
+
+inline void ArdPacketBase::WriteMachine::Begin()
+{
+    ResetState(m_write);
+}
+
+inline eArdPacketConfigStatus ArdPacketReceiver::Configure(const ArdPacketConfig &config)
+{
+    const eArdPacketConfigStatus status = SetConfig(config);
+    if (status == kArdPacketConfigSuccess)
+    {
+        m_reader.Begin(*this);
+    }
+    return status;
+}
 
-        ResetState(m_read);
-        ResetState(m_write);
+inline eArdPacketConfigStatus ArdPacketSender::Configure(const ArdPacketConfig &config)
+{
+    const eArdPacketConfigStatus status = SetConfig(config);
+    if (status == kArdPacketConfigSuccess)
+    {
+        m_writer.Begin();
     }
+    return status;
+}
 
+inline eArdPacketConfigStatus ArdPacket::Configure(const ArdPacketConfig &config)
+{
+    const eArdPacketConfigStatus status = SetConfig(config);
+    if (status == kArdPacketConfigSuccess)
+    {
+        m_reader.Begin(*this);
+        m_writer.Begin();
+    }
     return status;
 }
 
-inline eArdPacketStatus ArdPacket::ReceivePayload(const size_t max_payload_size, ArdPacketPayloadInfo &info,
-                                                  uint8_t *payload)
+inline eArdPacketStatus ArdPacketBase::ReadMachine::Receive(ArdPacketBase &owner, const size_t max_payload_size,
+                                                            ArdPacketPayloadInfo &info, uint8_t *payload)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
-    const int read_size = m_stream.available();
-    if (m_config.max_payload_size == 0)
+    const int stream_size = owner.m_stream.available();
+    const size_t stream_bytes = (stream_size > 0 ? static_cast<size_t>(stream_size) : 0);
+    const size_t read_size = stream_bytes + (m_sync_size - m_sync_index);
+    const bool timeout = (owner.m_config.frame_timeout_ms != 0);
+    const uint32_t now = (timeout ? owner.m_config.clock() : 0);
+    const bool in_packet = (m_read.state != kArdPacketStateDelimiter && m_read.state != kArdPacketStateDone);
+
+    // bytes that arrived since the last call restart the timeout, however late the call
+    const bool arrived = (stream_bytes > m_read_pending);
+    if (timeout && arrived)
+    {
+        m_read_ms = now;
+    }
+
+    if (owner.m_config.max_payload_size == 0)
     {
         status = kArdPacketStatusNotConfigured;
     }
-    else if (read_size <= 0)
+    else if (timeout && in_packet && !arrived && (now - m_read_ms) >= owner.m_config.frame_timeout_ms)
+    {
+        // the sender stopped mid packet, the next bytes start a new one
+        status = kArdPacketStatusFrameTimeout;
+        const eArdPacketState state = m_read.state;
+        ResetState(m_read);
+        owner.Trace(true, state, m_read.state, read_size, read_size);
+        m_lookback_size = 0;
+        m_read_ms = now;
+        m_frame_timeouts++;
+        ARD_PACKET_STATS_ADD(frame_timeouts, 1);
+    }
+    else if (read_size == 0)
     {
         status = kArdPacketStatusNotAvailable;
     }
     else
     {
-        m_read.available = static_cast<size_t>(read_size);
+        if (m_read.state == kArdPacketStateDone)
+        {
+            // start next packet
+            ResetState(m_read);
+            owner.Trace(true, kArdPacketStateDone, m_read.state, read_size, read_size);
+        }
+        m_read.available = read_size;
         bool continue_read = true;
         while (m_read.available > 0 && continue_read)
         {
+            const eArdPacketState state = m_read.state;
+            const size_t available = m_read.available;
             // state machine
             switch (m_read.state)
             {
                 case kArdPacketStateDelimiter:
                 {
-                    status = ProcessReadStateDelimiter();
+                    status = ProcessReadStateDelimiter(owner);
                     break;
                 }
                 case kArdPacketStateMessageType:
                 {
-                    if (m_read.available < m_config.message_type_bytes)
+                    if (m_read.available < owner.GetMinFieldSize(owner.m_config.message_type_bytes))
                     {
                         status = kArdPacketStatusNotEnoughAvailable;
                     }
                     else
                     {
-                        status = ProcessReadStateMessageType(info);
+                        status = ProcessReadStateMessageType(owner, info);
                     }
                     break;
                 }
                 case kArdPacketStatePayloadSize:
                 {
-                    if (m_read.available < m_config.payload_size_bytes)
+                    if (m_read.available < owner.GetMinFieldSize(owner.m_config.payload_size_bytes))
                     {
                         status = kArdPacketStatusNotEnoughAvailable;
                     }
                     else
                     {
-                        status = ProcessReadStatePayloadSize(max_payload_size, info);
+                        status = ProcessReadStatePayloadSize(owner, max_payload_size, info);
                     }
                     break;
                 }
@@ -437,13 +1294,13 @@ inline eArdPacketStatus ArdPacket::ReceivePayload(const size_t max_payload_size,
                     }
                     else
                     {
-                        status = ProcessReadStateHeaderCrc();
+                        status = ProcessReadStateHeaderCrc(owner);
                     }
                     break;
                 }
                 case kArdPacketStatePayload:
                 {
-                    status = ProcessReadStatePayload(info, payload);
+                    status = ProcessReadStatePayload(owner, info, payload);
                     break;
                 }
                 case kArdPacketStatePayloadCrc:
@@ -454,10 +1311,20 @@ inline eArdPacketStatus ArdPacket::ReceivePayload(const size_t max_payload_size,
                     }
                     else
                     {
-                        status = ProcessReadStatePayloadCrc();
+                        status = ProcessReadStatePayloadCrc(owner);
                     }
                     break;
                 }
+                case kArdPacketStateEncoded:
+                {
+                    status = ProcessReadStateEncoded(owner, max_payload_size, info, payload);
+                    break;
+                }
+                case kArdPacketStateFec:
+                {
+                    status = ProcessReadStateFec(owner, max_payload_size, info, payload);
+                    break;
+                }
                 case kArdPacketStateDone:
                 {
                     status = kArdPacketStatusDone;
@@ -470,18 +1337,28 @@ inline eArdPacketStatus ArdPacket::ReceivePayload(const size_t max_payload_size,
                     break;
                 }
             }
+            owner.Trace(true, state, m_read.state, available, m_read.available);
             continue_read = (status == kArdPacketStatusHeaderInProgress || status == kArdPacketStatusPayloadInProgress);
         }
+        StatsReceived(owner, status, info);
+    }
+
+    if (timeout)
+    {
+        // bytes left in the stream, the next call times out only if no more arrive
+        const int pending = owner.m_stream.available();
+        m_read_pending = (pending > 0 ? static_cast<size_t>(pending) : 0);
     }
 
     return status;
 }
 
-inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+inline eArdPacketStatus ArdPacketBase::WriteMachine::Send(ArdPacketBase &owner, const ArdPacketPayloadInfo &info,
+                                                          const uint8_t *payload)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
-    const int write_size = m_stream.availableForWrite();
-    if (m_config.max_payload_size == 0)
+    const int write_size = owner.m_stream.availableForWrite();
+    if (owner.m_config.max_payload_size == 0)
     {
         status = kArdPacketStatusNotConfigured;
     }
@@ -489,7 +1366,7 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
     {
         status = kArdPacketStatusNotAvailable;
     }
-    else if (info.message_type > m_max_message_type_value)
+    else if (info.message_type > owner.m_max_message_type_value)
     {
         status = kArdPacketStatusInvalidMessageType;
     }
@@ -498,46 +1375,56 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
         status = kArdPacketStatusNotEnoughAvailable;
         ResetState(m_write);
     }
-    else if (info.payload_size > m_config.max_payload_size)
+    else if (info.payload_size > owner.m_config.max_payload_size)
     {
         status = kArdPacketStatusInvalidPayloadSize;
         ResetState(m_write);
     }
     else
     {
+        if (m_write.state == kArdPacketStateDone)
+        {
+            // start next packet
+            ResetState(m_write);
+            owner.Trace(false, kArdPacketStateDone, m_write.state, static_cast<size_t>(write_size),
+                  static_cast<size_t>(write_size));
+        }
         m_write.available = static_cast<size_t>(write_size);
         bool continue_write = true;
         while (m_write.available > 0 && continue_write)
         {
+            const eArdPacketState state = m_write.state;
+            const size_t available = m_write.available;
             // state machine
             switch (m_write.state)
             {
                 case kArdPacketStateDelimiter:
                 {
-                    status = ProcessWriteStateDelimiter();
+                    status = ProcessWriteStateDelimiter(owner, info);
                     break;
                 }
                 case kArdPacketStateMessageType:
                 {
-                    if (m_write.available < m_config.message_type_bytes)
+                    if (m_write.available < owner.GetFieldSize(info.message_type, owner.m_config.message_type_bytes))
                     {
                         status = kArdPacketStatusNotEnoughAvailable;
                     }
                     else
                     {
-                        status = ProcessWriteStateMessageType(info);
+                        status = ProcessWriteStateMessageType(owner, info);
                     }
                     break;
                 }
                 case kArdPacketStatePayloadSize:
                 {
-                    if (m_write.available < m_config.payload_size_bytes)
+                    if (m_write.available <
+                        owner.GetFieldSize(static_cast<uint32_t>(info.payload_size), owner.m_config.payload_size_bytes))
                     {
                         status = kArdPacketStatusNotEnoughAvailable;
                     }
                     else
                     {
-                        status = ProcessWriteStatePayloadSize(info);
+                        status = ProcessWriteStatePayloadSize(owner, info);
                     }
                     break;
                 }
@@ -549,13 +1436,13 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
                     }
                     else
                     {
-                        status = ProcessWriteStateHeaderCrc();
+                        status = ProcessWriteStateHeaderCrc(owner);
                     }
                     break;
                 }
                 case kArdPacketStatePayload:
                 {
-                    status = ProcessWriteStatePayload(info, payload);
+                    status = ProcessWriteStatePayload(owner, info, payload);
                     break;
                 }
                 case kArdPacketStatePayloadCrc:
@@ -566,10 +1453,20 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
                     }
                     else
                     {
-                        status = ProcessWriteStatePayloadCrc();
+                        status = ProcessWriteStatePayloadCrc(owner);
                     }
                     break;
                 }
+                case kArdPacketStateEncoded:
+                {
+                    status = ProcessWriteStateEncoded(owner, payload);
+                    break;
+                }
+                case kArdPacketStateFec:
+                {
+                    status = ProcessWriteStateFec(owner, payload);
+                    break;
+                }
                 case kArdPacketStateDone:
                 {
                     status = kArdPacketStatusDone;
@@ -582,9 +1479,11 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
                     break;
                 }
             }
+            owner.Trace(false, state, m_write.state, available, m_write.available);
             continue_write =
                 (status == kArdPacketStatusHeaderInProgress || status == kArdPacketStatusPayloadInProgress);
         }
+        ARD_PACKET_STATS_ADD(frames_sent, (status == kArdPacketStatusDone ? 1 : 0));
     }
 
     return status;
@@ -593,29 +1492,512 @@ inline eArdPacketStatus ArdPacket::SendPayload(const ArdPacketPayloadInfo &info,
 // Private inline methods
 // ----------------------
 
-inline void ArdPacket::ResetState(ArdPacketStateData &data_state)
+inline void ArdPacketBase::ResetState(ArdPacketStateData &data_state)
 {
     data_state.state = kArdPacketStateDelimiter;
     data_state.payload_index = 0;
+    data_state.skip = false;
+    data_state.field_index = 0;
+}
+
+#if ARD_PACKET_TRACE
+inline const char *ArdPacketBase::GetStateName(const uint8_t state)
+{
+    static const char *const kNames[] = {"Delimiter",  "MessageType", "PayloadSize", "HeaderCrc", "Payload",
+                                         "PayloadCrc", "Encoded",     "Fec",         "Done"};
+    return (state < sizeof(kNames) / sizeof(kNames[0]) ? kNames[state] : "Unknown");
+}
+#endif
+
+inline size_t ArdPacketBase::StatsBucket(uint32_t value)
+{
+    size_t bucket = 0;
+    while (value != 0 && bucket < ARD_PACKET_STATS_BUCKETS - 1)
+    {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+inline size_t ArdPacketBase::GetMaxPacketSize(const size_t payload_size) const
+{
+    const size_t fields_size = GetHeaderFieldsSize();
+    const size_t body_size = payload_size + (m_config.crc ? kArdPacketCrcBytes : 0);
+    size_t packet_size = kArdPacketDelimiterBytes + fields_size + body_size;
+    if (m_config.framing == kArdPacketFramingCobs)
+    {
+#if ARD_PACKET_COBS
+        packet_size = kArdPacketDelimiterBytes + ArdPacketCobsMaxEncodedSize(fields_size + body_size);
+#endif
+    }
+#if ARD_PACKET_FEC
+    else if (m_config.fec_parity_bytes != 0)
+    {
+        packet_size = kArdPacketDelimiterBytes + ArdPacketFecEncodedSize(fields_size, body_size,
+                                                                         m_config.fec_parity_bytes,
+                                                                         m_config.fec_block_size);
+    }
+#endif
+    return packet_size;
+}
+
+inline size_t ArdPacketBase::GetMaxPayloadSize(const uint32_t message_type) const
+{
+    const ArdPacketSizeLimit *limit = FindSizeLimit(message_type);
+    return (limit != nullptr ? limit->max_payload_size : m_config.max_payload_size);
+}
+
+inline bool ArdPacketBase::AddVarintByte(const uint8_t data, const size_t index, const size_t value_bytes,
+                                         uint32_t &value)
+{
+    // seven bits per byte, least significant group first, the group must fit in value_bytes
+    const uint32_t group = data & static_cast<uint8_t>(~kArdPacketVarintMore);
+    const size_t shift = 7 * index;
+    const size_t value_bits = 8 * value_bytes;
+    const bool fits = (shift < value_bits) && ((value_bits - shift) >= 7 || (group >> (value_bits - shift)) == 0);
+    if (fits)
+    {
+        value = (index == 0 ? 0 : value) | (group << shift);
+    }
+    return fits;
+}
+
+inline size_t ArdPacketBase::GetMinFieldSize(const size_t value_bytes) const
+{
+    return (m_config.header_encoding == kArdPacketHeaderVarint ? 1 : value_bytes);
+}
+
+inline size_t ArdPacketBase::GetFieldSize(uint32_t value, const size_t value_bytes) const
+{
+    size_t field_size = value_bytes;
+    if (m_config.header_encoding == kArdPacketHeaderVarint)
+    {
+        field_size = 1;
+        while (value >= kArdPacketVarintMore)
+        {
+            value >>= 7;
+            field_size++;
+        }
+    }
+    return field_size;
+}
+
+inline size_t ArdPacketBase::WriteField(uint32_t value, const size_t value_bytes, uint8_t *data) const
+{
+    size_t field_size = value_bytes;
+    if (m_config.header_encoding == kArdPacketHeaderVarint)
+    {
+        field_size = 0;
+        while (value >= kArdPacketVarintMore)
+        {
+            data[field_size++] = static_cast<uint8_t>(value | kArdPacketVarintMore);
+            value >>= 7;
+        }
+        data[field_size++] = static_cast<uint8_t>(value);
+    }
+    else
+    {
+        ConvertToBigEndian(value, value_bytes, data);
+    }
+    return field_size;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadField(const uint8_t *data, const size_t size, const size_t value_bytes,
+                                                 const eArdPacketStatus invalid_status, uint32_t &value,
+                                                 size_t &field_size) const
+{
+    eArdPacketStatus status = kArdPacketStatusPacketSizeTooSmall;
+    if (m_config.header_encoding == kArdPacketHeaderVarint)
+    {
+        size_t index = 0;
+        bool more = true;
+        while (index < size && more && status == kArdPacketStatusPacketSizeTooSmall)
+        {
+            if (!AddVarintByte(data[index], index, value_bytes, value))
+            {
+                status = invalid_status;
+            }
+            more = ((data[index] & kArdPacketVarintMore) != 0);
+            index++;
+        }
+        if (!more && status == kArdPacketStatusPacketSizeTooSmall)
+        {
+            field_size = index;
+            status = kArdPacketStatusDone;
+        }
+    }
+    else if (size >= value_bytes)
+    {
+        value = ConvertFromBigEndian(data, value_bytes);
+        field_size = value_bytes;
+        status = kArdPacketStatusDone;
+    }
+    return status;
+}
+
+inline size_t ArdPacketBase::GetHeaderFieldsSize() const
+{
+    // largest size, variable length fields are never longer
+    size_t message_type_size = m_config.message_type_bytes;
+    size_t payload_size_size = m_config.payload_size_bytes;
+    if (m_config.header_encoding == kArdPacketHeaderVarint)
+    {
+        message_type_size = (8 * message_type_size + 6) / 7;
+        payload_size_size = (8 * payload_size_size + 6) / 7;
+    }
+    return message_type_size + payload_size_size + (m_config.crc ? kArdPacketCrcBytes : 0);
+}
+
+inline size_t ArdPacketBase::WriteHeaderFields(const ArdPacketPayloadInfo &info, uint8_t *fields) const
+{
+    size_t fields_index = 0;
+    fields_index += WriteField(info.message_type, m_config.message_type_bytes, &fields[fields_index]);
+    fields_index += WriteField(static_cast<uint32_t>(info.payload_size), m_config.payload_size_bytes,
+                               &fields[fields_index]);
+    if (m_config.crc)
+    {
+        crc_t crc = crc_init();
+        crc = crc_update(crc, &m_config.delimiter, kArdPacketDelimiterBytes);
+        crc = crc_update(crc, fields, fields_index);
+        crc = crc_finalize(crc);
+        memcpy(&fields[fields_index], reinterpret_cast<uint8_t *>(&crc), kArdPacketCrcBytes);
+        fields_index += kArdPacketCrcBytes;
+    }
+    return fields_index;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadHeaderFields(const uint8_t *fields, const size_t max_payload_size,
+                                                    ArdPacketPayloadInfo &info) const
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+    if (m_config.crc)
+    {
+        crc_t crc = crc_init();
+        crc = crc_update(crc, &m_config.delimiter, kArdPacketDelimiterBytes);
+        crc = crc_update(crc, fields, GetHeaderFieldsSize());
+        crc = crc_finalize(crc);
+        if (crc != 0)
+        {
+            status = kArdPacketStatusCrcFailed;
+        }
+    }
+    if (status == kArdPacketStatusPayloadInProgress)
+    {
+        info.message_type = ConvertFromBigEndian(fields, m_config.message_type_bytes);
+        info.payload_size = ConvertFromBigEndian(&fields[m_config.message_type_bytes], m_config.payload_size_bytes);
+        if ((info.payload_size == 0) || (info.payload_size > m_config.max_payload_size) ||
+            (max_payload_size < info.payload_size) || !PayloadSizeAllowed(info))
+        {
+            status = kArdPacketStatusInvalidPayloadSize;
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadMachine::FilterPayload(const ArdPacketPayloadInfo &info)
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+    if (m_filter != nullptr)
+    {
+        const size_t type_max_payload_size = m_filter->MaxPayloadSize(info.message_type);
+        m_read.skip = (type_max_payload_size == 0);
+        if (!m_read.skip && info.payload_size > type_max_payload_size)
+        {
+            status = kArdPacketStatusInvalidPayloadSize;
+        }
+    }
+    return status;
+}
+
+inline const ArdPacketSizeLimit *ArdPacketBase::FindSizeLimit(const uint32_t message_type) const
+{
+    const ArdPacketSizeLimit *found = nullptr;
+    size_t low = 0;
+    size_t high = m_config.size_limit_count;
+    while (low < high && found == nullptr)
+    {
+        const size_t middle = low + (high - low) / 2;
+        const ArdPacketSizeLimit &limit = m_config.size_limits[middle];
+        if (limit.message_type < message_type)
+        {
+            low = middle + 1;
+        }
+        else if (limit.message_type > message_type)
+        {
+            high = middle;
+        }
+        else
+        {
+            found = &limit;
+        }
+    }
+    return found;
+}
+
+inline bool ArdPacketBase::PayloadSizeAllowed(const ArdPacketPayloadInfo &info) const
+{
+    const ArdPacketSizeLimit *limit = FindSizeLimit(info.message_type);
+    return (limit == nullptr ||
+            (info.payload_size >= limit->min_payload_size && info.payload_size <= limit->max_payload_size));
+}
+
+inline int ArdPacketBase::ReadMachine::ReadByte(ArdPacketBase &owner)
+{
+    int read_byte = -1;
+    if (m_sync_index < m_sync_size)
+    {
+        read_byte = m_sync[m_sync_index];
+        m_sync_index++;
+    }
+    else
+    {
+        read_byte = owner.m_stream.read();
+        ARD_PACKET_STATS_ADD(bytes_received, (read_byte >= 0 ? 1 : 0));
+    }
+    if (read_byte >= 0 && m_read.available > 0)
+    {
+        m_read.available--;
+    }
+    if (read_byte >= 0 && m_read.state != kArdPacketStateDelimiter)
+    {
+        const uint8_t data = static_cast<uint8_t>(read_byte);
+        RecordLookback(owner, &data, 1);
+    }
+    return read_byte;
+}
+
+inline size_t ArdPacketBase::ReadMachine::ReadBytes(ArdPacketBase &owner, uint8_t *data, const size_t size)
+{
+    size_t bytes_read = 0;
+    const size_t sync_remaining = m_sync_size - m_sync_index;
+    if (sync_remaining > 0)
+    {
+        bytes_read = (size < sync_remaining ? size : sync_remaining);
+        memcpy(data, &m_sync[m_sync_index], bytes_read);
+        m_sync_index += bytes_read;
+    }
+    if (bytes_read < size)
+    {
+        const size_t stream_read = owner.m_stream.read(&data[bytes_read], size - bytes_read);
+        ARD_PACKET_STATS_ADD(bytes_received, stream_read);
+        bytes_read += stream_read;
+    }
+    m_read.available = (bytes_read < m_read.available ? m_read.available - bytes_read : 0);
+    if (m_read.state != kArdPacketStateDelimiter)
+    {
+        RecordLookback(owner, data, bytes_read);
+    }
+    return bytes_read;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ReadVarint(ArdPacketBase &owner, const size_t value_bytes,
+                                                               const eArdPacketStatus invalid_status)
+{
+    // byte by byte, the field may span several calls
+    eArdPacketStatus status = kArdPacketStatusHeaderInProgress;
+    while (status == kArdPacketStatusHeaderInProgress && m_read.available > 0)
+    {
+        const int read_byte = ReadByte(owner);
+        if (read_byte < 0)
+        {
+            status = kArdPacketStatusReadFailed;
+            ResetState(m_read);
+        }
+        else
+        {
+            const uint8_t data = static_cast<uint8_t>(read_byte);
+            if (owner.m_config.crc)
+            {
+                m_read.crc = crc_update(m_read.crc, &data, 1);
+            }
+            if (!AddVarintByte(data, m_read.field_index, value_bytes, m_read.field_value))
+            {
+                status = invalid_status;
+                Resync(owner);
+            }
+            else if ((data & kArdPacketVarintMore) == 0)
+            {
+                status = kArdPacketStatusDone;
+                m_read.field_index = 0;
+            }
+            else
+            {
+                m_read.field_index++;
+            }
+        }
+    }
+    return status;
+}
+
+inline void ArdPacketBase::ReadMachine::RecordLookback(ArdPacketBase &owner, const uint8_t *data, size_t size)
+{
+    if (owner.m_config.framing == kArdPacketFramingDelimiter)
+    {
+        // keep the most recent bytes
+        if (size > kArdPacketSyncBufferSize)
+        {
+            m_lookback_size += size - kArdPacketSyncBufferSize;
+            data = &data[size - kArdPacketSyncBufferSize];
+            size = kArdPacketSyncBufferSize;
+        }
+        // ring buffer only wraps once replayed bytes are consumed
+        const size_t position = m_lookback_size % kArdPacketSyncBufferSize;
+        const size_t first_size =
+            (size < kArdPacketSyncBufferSize - position ? size : kArdPacketSyncBufferSize - position);
+        memcpy(&m_sync[position], data, first_size);
+        memcpy(m_sync, &data[first_size], size - first_size);
+        m_lookback_size += size;
+    }
+}
+
+inline void ArdPacketBase::ReadMachine::Resync(ArdPacketBase &owner)
+{
+    // oldest consumed byte first
+    size_t lookback_size = m_lookback_size;
+    if (lookback_size > kArdPacketSyncBufferSize)
+    {
+        uint8_t lookback[kArdPacketSyncBufferSize];
+        const size_t position = lookback_size % kArdPacketSyncBufferSize;
+        memcpy(lookback, &m_sync[position], kArdPacketSyncBufferSize - position);
+        memcpy(&lookback[kArdPacketSyncBufferSize - position], m_sync, position);
+        memcpy(m_sync, lookback, kArdPacketSyncBufferSize);
+        lookback_size = kArdPacketSyncBufferSize;
+    }
+    // followed by bytes not replayed yet
+    const size_t pending_size = m_sync_size - m_sync_index;
+    memmove(&m_sync[lookback_size], &m_sync[m_sync_index], pending_size);
+    const size_t scan_size = lookback_size + pending_size;
+
+    // replay from the next delimiter candidate
+    const uint8_t *found = static_cast<const uint8_t *>(memchr(m_sync, owner.m_config.delimiter, scan_size));
+    const size_t replay_start = (found != nullptr ? static_cast<size_t>(found - m_sync) + 1 : scan_size);
+    const size_t replay_size = scan_size - replay_start;
+    memmove(m_sync, &m_sync[replay_start], replay_size);
+    m_sync_index = 0;
+    m_sync_size = replay_size;
+    m_lookback_size = 0;
+    m_read.available = m_read.available - pending_size + replay_size;
+
+    ResetState(m_read);
+    if (found != nullptr)
+    {
+        StatsFrameStart(owner);
+        StartBody(owner);
+    }
+}
+
+inline void ArdPacketBase::ReadMachine::StartBody(ArdPacketBase &owner)
+{
+    if (owner.m_config.fec_parity_bytes != 0)
+    {
+#if ARD_PACKET_FEC
+        m_read.state = kArdPacketStateFec;
+        m_fec_read.Begin(owner.GetHeaderFieldsSize(), owner.m_config.crc, owner.m_config.fec_parity_bytes,
+                         owner.m_config.fec_block_size);
+#endif
+    }
+    else
+    {
+        m_read.state = kArdPacketStateMessageType;
+        if (owner.m_config.crc)
+        {
+            // initial crc for header
+            m_read.crc = crc_init();
+            m_read.crc = crc_update(m_read.crc, &owner.m_config.delimiter, kArdPacketDelimiterBytes);
+        }
+    }
+}
+
+inline void ArdPacketBase::ReadMachine::StatsFrameStart(ArdPacketBase &owner)
+{
+#if ARD_PACKET_STATS
+    m_read_start_us = (owner.m_clock_us != nullptr ? owner.m_clock_us() : 0);
+#else
+    (void)owner;
+#endif
+}
+
+inline void ArdPacketBase::ReadMachine::StatsReceived(ArdPacketBase &owner, const eArdPacketStatus status,
+                                                      const ArdPacketPayloadInfo &info)
+{
+#if ARD_PACKET_STATS
+    owner.m_stats.receive_calls++;
+    if (status == kArdPacketStatusDone || status == kArdPacketStatusSkipped)
+    {
+        owner.m_stats.frames_received++;
+        owner.m_stats.frames_skipped += (status == kArdPacketStatusSkipped ? 1 : 0);
+        owner.m_stats.payload_size_log2[StatsBucket(static_cast<uint32_t>(info.payload_size))]++;
+        if (owner.m_clock_us != nullptr)
+        {
+            owner.m_stats.receive_time_log2[StatsBucket(owner.m_clock_us() - m_read_start_us)]++;
+        }
+    }
+    owner.m_stats.invalid_sizes += (status == kArdPacketStatusInvalidPayloadSize ? 1 : 0);
+    owner.m_stats.read_failures += (status == kArdPacketStatusReadFailed ? 1 : 0);
+#else
+    (void)owner;
+    (void)status;
+    (void)info;
+#endif
+}
+
+inline void ArdPacketBase::Trace(const bool receive, const eArdPacketState from_state, const eArdPacketState to_state,
+                                 const size_t available_before, const size_t available_after)
+{
+#if ARD_PACKET_TRACE
+    if (m_trace != nullptr && from_state != to_state)
+    {
+        ArdPacketTraceEvent event;
+        event.time_us = (m_clock_us != nullptr ? m_clock_us() : 0);
+        event.direction = (receive ? kArdPacketTraceReceive : kArdPacketTraceSend);
+        event.from_state = static_cast<uint8_t>(from_state);
+        event.to_state = static_cast<uint8_t>(to_state);
+        event.available = available_before;
+        // a resync replays consumed bytes
+        event.consumed = (available_after < available_before ? available_before - available_after : 0);
+        m_trace->OnStateChange(event);
+    }
+#else
+    (void)receive;
+    (void)from_state;
+    (void)to_state;
+    (void)available_before;
+    (void)available_after;
+#endif
+}
+
+inline size_t ArdPacketBase::WriteMachine::WriteBytes(ArdPacketBase &owner, const uint8_t *data, const size_t size)
+{
+    m_write.available = (size < m_write.available ? m_write.available - size : 0);
+    const size_t bytes_written = owner.m_stream.write(data, size);
+    ARD_PACKET_STATS_ADD(bytes_sent, bytes_written);
+    ARD_PACKET_STATS_ADD(short_writes, (bytes_written < size ? 1 : 0));
+    return bytes_written;
 }
 
 // Read State Processing
 
-inline eArdPacketStatus ArdPacket::ProcessReadStateDelimiter()
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStateDelimiter(ArdPacketBase &owner)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
     bool found_delimiter = false;
     bool read_failed = false;
-    for (size_t k = 0; k < m_read.available && (!found_delimiter) && (!read_failed); ++k)
+    while (m_read.available > 0 && (!found_delimiter) && (!read_failed))
     {
-        const int read_byte = m_stream.read();
+        const int read_byte = ReadByte(owner);
         if (read_byte < 0)
         {
             read_failed = true;
         }
-        else if (static_cast<uint8_t>(read_byte) == m_config.delimiter)
+        else if (static_cast<uint8_t>(read_byte) == owner.m_config.delimiter)
         {
             found_delimiter = true;
+            StatsFrameStart(owner);
+        }
+        else
+        {
+            ARD_PACKET_STATS_ADD(discarded_bytes, 1);
         }
     }
 
@@ -623,16 +2005,19 @@ inline eArdPacketStatus ArdPacket::ProcessReadStateDelimiter()
     {
         status = kArdPacketStatusReadFailed;
     }
+    else if (found_delimiter && owner.m_config.framing == kArdPacketFramingCobs)
+    {
+        status = kArdPacketStatusHeaderInProgress;
+        m_read.state = kArdPacketStateEncoded;
+#if ARD_PACKET_COBS
+        m_cobs_read.Begin(owner.GetHeaderFieldsSize(), owner.m_config.crc, owner.m_config.delimiter);
+#endif
+    }
     else if (found_delimiter)
     {
         status = kArdPacketStatusHeaderInProgress;
-        m_read.state = kArdPacketStateMessageType;
-        if (m_config.crc)
-        {
-            // initial crc for header
-            m_read.crc = crc_init();
-            m_read.crc = crc_update(m_read.crc, &m_config.delimiter, kArdPacketDelimiterBytes);
-        }
+        m_lookback_size = 0;
+        StartBody(owner);
     }
     else
     {
@@ -642,76 +2027,114 @@ inline eArdPacketStatus ArdPacket::ProcessReadStateDelimiter()
     return status;
 }
 
-inline eArdPacketStatus ArdPacket::ProcessReadStateMessageType(ArdPacketPayloadInfo &info)
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStateMessageType(ArdPacketBase &owner,
+                                                                                ArdPacketPayloadInfo &info)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
 
-    uint8_t read_data[kArdPacketMaxMessageTypeBytes];
-    const size_t bytes_read = m_stream.read(read_data, m_config.message_type_bytes);
-    if (bytes_read != m_config.message_type_bytes)
+    if (owner.m_config.header_encoding == kArdPacketHeaderVarint)
     {
-        status = kArdPacketStatusReadFailed;
-        ResetState(m_read);
+        status = ReadVarint(owner, owner.m_config.message_type_bytes, kArdPacketStatusInvalidMessageType);
+        if (status == kArdPacketStatusDone)
+        {
+            info.message_type = m_read.field_value;
+            // advance state
+            status = kArdPacketStatusHeaderInProgress;
+            m_read.state = kArdPacketStatePayloadSize;
+        }
     }
     else
     {
-        if (m_config.crc)
+        uint8_t read_data[kArdPacketMaxMessageTypeBytes];
+        const size_t bytes_read = ReadBytes(owner, read_data, owner.m_config.message_type_bytes);
+        if (bytes_read != owner.m_config.message_type_bytes)
         {
-            m_read.crc = crc_update(m_read.crc, read_data, m_config.message_type_bytes);
+            status = kArdPacketStatusReadFailed;
+            ResetState(m_read);
+        }
+        else
+        {
+            if (owner.m_config.crc)
+            {
+                m_read.crc = crc_update(m_read.crc, read_data, owner.m_config.message_type_bytes);
+            }
+            // copy message type from data
+            info.message_type = ConvertFromBigEndian(read_data, owner.m_config.message_type_bytes);
+            // advance state
+            status = kArdPacketStatusHeaderInProgress;
+            m_read.state = kArdPacketStatePayloadSize;
         }
-        // copy message type from data
-        info.message_type = ConvertFromBigEndian(read_data, m_config.message_type_bytes);
-        // advance state
-        status = kArdPacketStatusHeaderInProgress;
-        m_read.state = kArdPacketStatePayloadSize;
     }
 
     return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessReadStatePayloadSize(const size_t max_payload_size, ArdPacketPayloadInfo &info)
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStatePayloadSize(ArdPacketBase &owner,
+                                                                                const size_t max_payload_size,
+                                                                                ArdPacketPayloadInfo &info)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
 
-    uint8_t read_data[kArdPacketMaxPayloadSizeBytes];
-    const size_t bytes_read = m_stream.read(read_data, m_config.payload_size_bytes);
-    if (bytes_read != m_config.payload_size_bytes)
+    if (owner.m_config.header_encoding == kArdPacketHeaderVarint)
     {
-        status = kArdPacketStatusReadFailed;
-        ResetState(m_read);
+        status = ReadVarint(owner, owner.m_config.payload_size_bytes, kArdPacketStatusInvalidPayloadSize);
+        if (status == kArdPacketStatusDone)
+        {
+            info.payload_size = m_read.field_value;
+        }
     }
     else
     {
-        if (m_config.crc)
+        uint8_t read_data[kArdPacketMaxPayloadSizeBytes];
+        const size_t bytes_read = ReadBytes(owner, read_data, owner.m_config.payload_size_bytes);
+        if (bytes_read != owner.m_config.payload_size_bytes)
+        {
+            status = kArdPacketStatusReadFailed;
+            ResetState(m_read);
+        }
+        else
         {
-            m_read.crc = crc_update(m_read.crc, read_data, m_config.payload_size_bytes);
+            if (owner.m_config.crc)
+            {
+                m_read.crc = crc_update(m_read.crc, read_data, owner.m_config.payload_size_bytes);
+            }
+            // copy from data to packet
+            info.payload_size = ConvertFromBigEndian(read_data, owner.m_config.payload_size_bytes);
+            status = kArdPacketStatusDone;
         }
-        // copy from data to packet
-        info.payload_size = ConvertFromBigEndian(read_data, m_config.payload_size_bytes);
+    }
+
+    if (status == kArdPacketStatusDone)
+    {
+        // skipped payloads never reach the payload buffer
+        const size_t type_max_payload_size = (m_filter != nullptr ? m_filter->MaxPayloadSize(info.message_type) : 0);
+        m_read.skip = (m_filter != nullptr && type_max_payload_size == 0);
+        size_t limit = (m_read.skip ? owner.m_config.max_payload_size : max_payload_size);
+        limit = (m_filter != nullptr && !m_read.skip && type_max_payload_size < limit ? type_max_payload_size : limit);
         // check payload size
-        if ((info.payload_size == 0) || (info.payload_size > m_config.max_payload_size) ||
-            (max_payload_size < info.payload_size))
+        if ((info.payload_size == 0) || (info.payload_size > owner.m_config.max_payload_size) ||
+            (limit < info.payload_size) || !owner.PayloadSizeAllowed(info))
         {
             status = kArdPacketStatusInvalidPayloadSize;
-            ResetState(m_read);
+            Resync(owner);
         }
         else
         {
             // advance state
-            status = (m_config.crc ? kArdPacketStatusHeaderInProgress : kArdPacketStatusPayloadInProgress);
-            m_read.state = (m_config.crc ? kArdPacketStateHeaderCrc : kArdPacketStatePayload);
+            status = (owner.m_config.crc ? kArdPacketStatusHeaderInProgress : kArdPacketStatusPayloadInProgress);
+            m_read.state = (owner.m_config.crc ? kArdPacketStateHeaderCrc : kArdPacketStatePayload);
         }
     }
 
     return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessReadStateHeaderCrc()
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStateHeaderCrc(ArdPacketBase &owner)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
 
     uint8_t read_data[kArdPacketCrcBytes];
-    const size_t bytes_read = m_stream.read(read_data, kArdPacketCrcBytes);
+    const size_t bytes_read = ReadBytes(owner, read_data, kArdPacketCrcBytes);
     if (bytes_read != kArdPacketCrcBytes)
     {
         status = kArdPacketStatusReadFailed;
@@ -735,24 +2158,32 @@ eArdPacketStatus ArdPacket::ProcessReadStateHeaderCrc()
         else
         {
             status = kArdPacketStatusCrcFailed;
-            ResetState(m_read);
+            ARD_PACKET_STATS_ADD(header_crc_failures, 1);
+            Resync(owner);
         }
     }
 
     return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessReadStatePayload(const ArdPacketPayloadInfo &info, uint8_t *payload)
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStatePayload(ArdPacketBase &owner,
+                                                                            const ArdPacketPayloadInfo &info,
+                                                                            uint8_t *payload)
 {
     eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
 
     const size_t remaining_payload = info.payload_size - m_read.payload_index;
-    const size_t bytes_to_read = (remaining_payload < m_read.available ? remaining_payload : m_read.available);
+    size_t bytes_to_read = (remaining_payload < m_read.available ? remaining_payload : m_read.available);
+
+    // skipped payloads are read in chunks that are only checked
+    uint8_t skipped[kArdPacketSkipChunkSize];
+    bytes_to_read = (m_read.skip && bytes_to_read > kArdPacketSkipChunkSize ? kArdPacketSkipChunkSize : bytes_to_read);
+    uint8_t *read_data = (m_read.skip ? skipped : &payload[m_read.payload_index]);
 
-    const size_t bytes_read = m_stream.read(&payload[m_read.payload_index], bytes_to_read);
-    if (m_config.crc && bytes_read > 0)
+    const size_t bytes_read = ReadBytes(owner, read_data, bytes_to_read);
+    if (owner.m_config.crc && bytes_read > 0)
     {
-        m_read.crc = crc_update(m_read.crc, &payload[m_read.payload_index], bytes_read);
+        m_read.crc = crc_update(m_read.crc, read_data, bytes_read);
     }
     m_read.payload_index += bytes_read;
 
@@ -761,21 +2192,25 @@ eArdPacketStatus ArdPacket::ProcessReadStatePayload(const ArdPacketPayloadInfo &
         status = kArdPacketStatusReadFailed;
         ResetState(m_read);
     }
+    else if (m_read.payload_index == info.payload_size && owner.m_config.crc)
+    {
+        m_read.state = kArdPacketStatePayloadCrc;
+    }
     else if (m_read.payload_index == info.payload_size)
     {
-        status = (m_config.crc ? kArdPacketStatusPayloadInProgress : kArdPacketStatusDone);
-        m_read.state = (m_config.crc ? kArdPacketStatePayloadCrc : kArdPacketStateDone);
+        status = (m_read.skip ? kArdPacketStatusSkipped : kArdPacketStatusDone);
+        m_read.state = kArdPacketStateDone;
     }
 
     return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessReadStatePayloadCrc()
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStatePayloadCrc(ArdPacketBase &owner)
 {
     eArdPacketStatus status = kArdPacketStatusStart;
 
     uint8_t read_data[kArdPacketCrcBytes];
-    const size_t bytes_read = m_stream.read(read_data, kArdPacketCrcBytes);
+    const size_t bytes_read = ReadBytes(owner, read_data, kArdPacketCrcBytes);
     if (bytes_read != kArdPacketCrcBytes)
     {
         status = kArdPacketStatusReadFailed;
@@ -791,76 +2226,256 @@ eArdPacketStatus ArdPacket::ProcessReadStatePayloadCrc()
         if (m_read.crc == 0)
         {
             // passed crc
-            status = kArdPacketStatusDone;
+            status = (m_read.skip ? kArdPacketStatusSkipped : kArdPacketStatusDone);
             m_read.state = kArdPacketStateDone;
         }
         else
         {
             status = kArdPacketStatusCrcFailed;
+            ARD_PACKET_STATS_ADD(payload_crc_failures, 1);
+            Resync(owner);
+        }
+    }
+
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStateEncoded(ArdPacketBase &owner,
+                                                                            const size_t max_payload_size,
+                                                                            ArdPacketPayloadInfo &info,
+                                                                            uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+#if ARD_PACKET_COBS
+
+    if (m_sync_index == m_sync_size)
+    {
+        // read ahead without going past the end of the packet
+        size_t read_ahead = m_cobs_read.RemainingEncoded();
+        read_ahead = (read_ahead < m_read.available ? read_ahead : m_read.available);
+        read_ahead = (read_ahead < kArdPacketSyncBufferSize ? read_ahead : kArdPacketSyncBufferSize);
+        m_sync_index = 0;
+        m_sync_size = owner.m_stream.read(m_sync, read_ahead);
+        ARD_PACKET_STATS_ADD(bytes_received, m_sync_size);
+    }
+
+    size_t consumed = 0;
+    const eArdPacketCobsEvent event =
+        m_cobs_read.Decode(&m_sync[m_sync_index], m_sync_size - m_sync_index, payload, consumed);
+    m_sync_index += consumed;
+    m_read.available = (consumed < m_read.available ? m_read.available - consumed : 0);
+
+    if (event == kArdPacketCobsNeedMore && consumed == 0)
+    {
+        status = kArdPacketStatusReadFailed;
+        ResetState(m_read);
+    }
+    else if (event == kArdPacketCobsHeader)
+    {
+        status = owner.ReadHeaderFields(m_cobs_read.Header(), max_payload_size, info);
+        ARD_PACKET_STATS_ADD(header_crc_failures, (status == kArdPacketStatusCrcFailed ? 1 : 0));
+        status = (status == kArdPacketStatusPayloadInProgress ? FilterPayload(info) : status);
+        if (status == kArdPacketStatusPayloadInProgress)
+        {
+            m_cobs_read.SetPayloadSize(info.payload_size);
+        }
+        else
+        {
+            ResetState(m_read);
+        }
+    }
+    else if (event == kArdPacketCobsDone)
+    {
+        if (owner.m_config.crc && m_cobs_read.PayloadCrc() != 0)
+        {
+            status = kArdPacketStatusCrcFailed;
+            ARD_PACKET_STATS_ADD(payload_crc_failures, 1);
             ResetState(m_read);
         }
+        else
+        {
+            status = (m_read.skip ? kArdPacketStatusSkipped : kArdPacketStatusDone);
+            m_read.state = kArdPacketStateDone;
+        }
+    }
+    else if (event == kArdPacketCobsDelimiter)
+    {
+        // packet cut short by the start of the next packet
+        status = kArdPacketStatusInvalidFraming;
+        m_cobs_read.Begin(owner.GetHeaderFieldsSize(), owner.m_config.crc, owner.m_config.delimiter);
+    }
+    else if (event == kArdPacketCobsInvalid)
+    {
+        status = kArdPacketStatusInvalidFraming;
+        ResetState(m_read);
     }
 
+#else
+    (void)owner;
+    (void)max_payload_size;
+    (void)info;
+    (void)payload;
+    status = kArdPacketStatusInvalidFraming;
+    ResetState(m_read);
+#endif
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketBase::ReadMachine::ProcessReadStateFec(ArdPacketBase &owner,
+                                                                        const size_t max_payload_size,
+                                                                        ArdPacketPayloadInfo &info, uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+#if ARD_PACKET_FEC
+    // never read past the block that completes the header or the body
+    uint8_t encoded[kArdPacketFecChunkSize];
+    size_t read_size = m_fec_read.RemainingEncoded();
+    read_size = (read_size < m_read.available ? read_size : m_read.available);
+    read_size = (read_size < kArdPacketFecChunkSize ? read_size : kArdPacketFecChunkSize);
+    const size_t bytes_read = ReadBytes(owner, encoded, read_size);
+
+    size_t consumed = 0;
+    const eArdPacketFecEvent event = m_fec_read.Decode(encoded, bytes_read, payload, consumed);
+
+    if (bytes_read == 0)
+    {
+        status = kArdPacketStatusReadFailed;
+        ResetState(m_read);
+    }
+    else if (event == kArdPacketFecHeader)
+    {
+        status = owner.ReadHeaderFields(m_fec_read.Header(), max_payload_size, info);
+        ARD_PACKET_STATS_ADD(header_crc_failures, (status == kArdPacketStatusCrcFailed ? 1 : 0));
+        status = (status == kArdPacketStatusPayloadInProgress ? FilterPayload(info) : status);
+        if (status == kArdPacketStatusPayloadInProgress)
+        {
+            m_fec_read.SetPayloadSize(info.payload_size);
+        }
+        else
+        {
+            Resync(owner);
+        }
+    }
+    else if (event == kArdPacketFecDone)
+    {
+        if (owner.m_config.crc && m_fec_read.PayloadCrc() != 0)
+        {
+            status = kArdPacketStatusCrcFailed;
+            ARD_PACKET_STATS_ADD(payload_crc_failures, 1);
+            Resync(owner);
+        }
+        else
+        {
+            status = (m_read.skip ? kArdPacketStatusSkipped : kArdPacketStatusDone);
+            m_read.state = kArdPacketStateDone;
+        }
+    }
+    else if (event == kArdPacketFecUncorrectable)
+    {
+        status = kArdPacketStatusFecFailed;
+        Resync(owner);
+    }
+#else
+    (void)owner;
+    (void)max_payload_size;
+    (void)info;
+    (void)payload;
+    status = kArdPacketStatusFecFailed;
+    ResetState(m_read);
+#endif
     return status;
 }
 
 // Write State Processing
 
-eArdPacketStatus ArdPacket::ProcessWriteStateDelimiter()
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStateDelimiter(ArdPacketBase &owner,
+                                                                                const ArdPacketPayloadInfo &info)
 {
+    eArdPacketStatus status = kArdPacketStatusHeaderInProgress;
     // write
-    m_stream.write(m_config.delimiter);
-    // crc update
-    if (m_config.crc)
+    WriteBytes(owner, &owner.m_config.delimiter, kArdPacketDelimiterBytes);
+    if (owner.m_config.framing == kArdPacketFramingCobs)
     {
-        m_write.crc = crc_update(m_write.crc, &m_config.delimiter, sizeof(uint8_t));
+#if ARD_PACKET_COBS
+        // encode header and payload
+        uint8_t fields[kArdPacketCobsMaxHeaderSize];
+        const size_t fields_size = owner.WriteHeaderFields(info, fields);
+        m_cobs_write.Begin(fields, fields_size, info.payload_size, owner.m_config.crc, owner.m_config.delimiter);
+#else
+        (void)info;
+#endif
+        m_write.state = kArdPacketStateEncoded;
+        status = kArdPacketStatusPayloadInProgress;
     }
-    // advance state
-    m_write.state = kArdPacketStateMessageType;
-    return kArdPacketStatusHeaderInProgress;
+#if ARD_PACKET_FEC
+    else if (owner.m_config.fec_parity_bytes != 0)
+    {
+        // header and payload blocks with parity
+        uint8_t fields[kArdPacketFecMaxHeaderSize];
+        const size_t fields_size = owner.WriteHeaderFields(info, fields);
+        m_fec_write.Begin(fields, fields_size, info.payload_size, owner.m_config.crc, owner.m_config.fec_parity_bytes,
+                          owner.m_config.fec_block_size);
+        m_write.state = kArdPacketStateFec;
+        status = kArdPacketStatusPayloadInProgress;
+    }
+#endif
+    else
+    {
+        // crc update
+        if (owner.m_config.crc)
+        {
+            m_write.crc = crc_init();
+            m_write.crc = crc_update(m_write.crc, &owner.m_config.delimiter, kArdPacketDelimiterBytes);
+        }
+        // advance state
+        m_write.state = kArdPacketStateMessageType;
+    }
+    return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessWriteStateMessageType(const ArdPacketPayloadInfo &info)
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStateMessageType(ArdPacketBase &owner,
+                                                                                  const ArdPacketPayloadInfo &info)
 {
     // copy from message type to data
-    // host endian copy (TODO: ensure consistent endianness)
-    uint8_t write_data[kArdPacketMaxMessageTypeBytes];
-    ConvertToBigEndian(info.message_type, m_config.message_type_bytes, write_data);
+    uint8_t write_data[kArdPacketMaxVarintBytes];
+    const size_t field_size = owner.WriteField(info.message_type, owner.m_config.message_type_bytes, write_data);
     // write
-    m_stream.write(write_data, m_config.message_type_bytes);
+    WriteBytes(owner, write_data, field_size);
     // crc update
-    if (m_config.crc)
+    if (owner.m_config.crc)
     {
-        m_write.crc = crc_update(m_write.crc, write_data, m_config.message_type_bytes);
+        m_write.crc = crc_update(m_write.crc, write_data, field_size);
     }
     // advance state
     m_write.state = kArdPacketStatePayloadSize;
     return kArdPacketStatusHeaderInProgress;
 }
 
-eArdPacketStatus ArdPacket::ProcessWriteStatePayloadSize(const ArdPacketPayloadInfo &info)
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStatePayloadSize(ArdPacketBase &owner,
+                                                                                  const ArdPacketPayloadInfo &info)
 {
     // copy from payload size to data
-    uint8_t write_data[kArdPacketMaxMessageTypeBytes];
-    ConvertToBigEndian(info.payload_size, m_config.payload_size_bytes, write_data);
+    uint8_t write_data[kArdPacketMaxVarintBytes];
+    const size_t field_size =
+        owner.WriteField(static_cast<uint32_t>(info.payload_size), owner.m_config.payload_size_bytes, write_data);
     // write
-    m_stream.write(write_data, m_config.payload_size_bytes);
+    WriteBytes(owner, write_data, field_size);
     // crc update
-    if (m_config.crc)
+    if (owner.m_config.crc)
     {
-        m_write.crc = crc_update(m_write.crc, write_data, m_config.payload_size_bytes);
+        m_write.crc = crc_update(m_write.crc, write_data, field_size);
     }
     // advance state
-    m_write.state = (m_config.crc ? kArdPacketStateHeaderCrc : kArdPacketStatePayload);
-    return (m_config.crc ? kArdPacketStatusHeaderInProgress : kArdPacketStatusPayloadInProgress);
+    m_write.state = (owner.m_config.crc ? kArdPacketStateHeaderCrc : kArdPacketStatePayload);
+    return (owner.m_config.crc ? kArdPacketStatusHeaderInProgress : kArdPacketStatusPayloadInProgress);
 }
 
-eArdPacketStatus ArdPacket::ProcessWriteStateHeaderCrc()
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStateHeaderCrc(ArdPacketBase &owner)
 {
     // finalize crc
     m_write.crc = crc_finalize(m_write.crc);
     // write
-    m_stream.write(reinterpret_cast<uint8_t *>(&m_write.crc), kArdPacketCrcBytes);
+    WriteBytes(owner, reinterpret_cast<uint8_t *>(&m_write.crc), kArdPacketCrcBytes);
     // reset crc
     m_write.crc = crc_init();
     // advance state
@@ -868,16 +2483,18 @@ eArdPacketStatus ArdPacket::ProcessWriteStateHeaderCrc()
     return kArdPacketStatusPayloadInProgress;
 }
 
-eArdPacketStatus ArdPacket::ProcessWriteStatePayload(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStatePayload(ArdPacketBase &owner,
+                                                                              const ArdPacketPayloadInfo &info,
+                                                                              const uint8_t *payload)
 {
     eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
     // remaining bytes
     const size_t remaining_payload = info.payload_size - m_write.payload_index;
     const size_t bytes_to_write = (remaining_payload < m_write.available ? remaining_payload : m_write.available);
     // write
-    m_stream.write(&payload[m_write.payload_index], bytes_to_write);
+    WriteBytes(owner, &payload[m_write.payload_index], bytes_to_write);
     // crc update
-    if (m_config.crc)
+    if (owner.m_config.crc)
     {
         m_write.crc = crc_update(m_write.crc, &payload[m_write.payload_index], bytes_to_write);
     }
@@ -885,25 +2502,78 @@ eArdPacketStatus ArdPacket::ProcessWriteStatePayload(const ArdPacketPayloadInfo
     m_write.payload_index += bytes_to_write;
     if (m_write.payload_index == info.payload_size)
     {
-        status = (m_config.crc ? kArdPacketStatusPayloadInProgress : kArdPacketStatusDone);
-        m_write.state = (m_config.crc ? kArdPacketStatePayloadCrc : kArdPacketStateDone);
+        status = (owner.m_config.crc ? kArdPacketStatusPayloadInProgress : kArdPacketStatusDone);
+        m_write.state = (owner.m_config.crc ? kArdPacketStatePayloadCrc : kArdPacketStateDone);
     }
 
     return status;
 }
 
-eArdPacketStatus ArdPacket::ProcessWriteStatePayloadCrc()
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStatePayloadCrc(ArdPacketBase &owner)
 {
     // finalize crc
     m_write.crc = crc_finalize(m_write.crc);
     // write
-    m_stream.write(reinterpret_cast<uint8_t *>(&m_write.crc), kArdPacketCrcBytes);
+    WriteBytes(owner, reinterpret_cast<uint8_t *>(&m_write.crc), kArdPacketCrcBytes);
     // advance state
     m_write.state = kArdPacketStateDone;
     return kArdPacketStatusDone;
 }
 
-inline eArdPacketStatus ArdPacket::WritePacketToBuffer(const ArdPacketPayloadInfo &info, const uint8_t *payload,
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStateEncoded(ArdPacketBase &owner,
+                                                                              const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+#if ARD_PACKET_COBS
+    uint8_t encoded[kArdPacketCobsWriteChunkSize];
+    while (m_write.available > 0 && !m_cobs_write.Done())
+    {
+        const size_t max_size =
+            (m_write.available < kArdPacketCobsWriteChunkSize ? m_write.available : kArdPacketCobsWriteChunkSize);
+        const size_t encoded_size = m_cobs_write.Encode(payload, encoded, max_size);
+        WriteBytes(owner, encoded, encoded_size);
+    }
+    if (m_cobs_write.Done())
+    {
+        status = kArdPacketStatusDone;
+        m_write.state = kArdPacketStateDone;
+    }
+#else
+    (void)owner;
+    (void)payload;
+    status = kArdPacketStatusInvalidFraming;
+    ResetState(m_write);
+#endif
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketBase::WriteMachine::ProcessWriteStateFec(ArdPacketBase &owner, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+#if ARD_PACKET_FEC
+    uint8_t encoded[kArdPacketFecChunkSize];
+    while (m_write.available > 0 && !m_fec_write.Done())
+    {
+        const size_t max_size =
+            (m_write.available < kArdPacketFecChunkSize ? m_write.available : kArdPacketFecChunkSize);
+        const size_t encoded_size = m_fec_write.Encode(payload, encoded, max_size);
+        WriteBytes(owner, encoded, encoded_size);
+    }
+    if (m_fec_write.Done())
+    {
+        status = kArdPacketStatusDone;
+        m_write.state = kArdPacketStateDone;
+    }
+#else
+    (void)owner;
+    (void)payload;
+    status = kArdPacketStatusInvalidFraming;
+    ResetState(m_write);
+#endif
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketBase::WritePacketToBuffer(const ArdPacketPayloadInfo &info, const uint8_t *payload,
                                                        const size_t max_packet_size, uint8_t *packet,
                                                        size_t &packet_size) const
 {
@@ -926,12 +2596,63 @@ inline eArdPacketStatus ArdPacket::WritePacketToBuffer(const ArdPacketPayloadInf
     }
     else
     {
-        const size_t header_size = kArdPacketDelimiterBytes + m_config.message_type_bytes + m_config.payload_size_bytes;
+        const size_t header_size =
+            kArdPacketDelimiterBytes + GetFieldSize(info.message_type, m_config.message_type_bytes) +
+            GetFieldSize(static_cast<uint32_t>(info.payload_size), m_config.payload_size_bytes);
         const size_t header_and_two_crc_size = header_size + (m_config.crc ? 2 * kArdPacketCrcBytes : 0.0);
         if ((max_packet_size - info.payload_size) < header_and_two_crc_size)
         {
             status = eArdPacketStatus::kArdPacketStatusPacketSizeTooSmall;
         }
+        else if (m_config.framing == kArdPacketFramingCobs)
+        {
+#if ARD_PACKET_COBS
+            // delimiter
+            packet[0] = m_config.delimiter;
+            // encoded header and payload
+            uint8_t fields[kArdPacketCobsMaxHeaderSize];
+            const size_t fields_size = WriteHeaderFields(info, fields);
+            ArdPacketCobsEncoder encoder;
+            encoder.Begin(fields, fields_size, info.payload_size, m_config.crc, m_config.delimiter);
+            const size_t encoded_size =
+                encoder.Encode(payload, &packet[kArdPacketDelimiterBytes], max_packet_size - kArdPacketDelimiterBytes);
+            if (encoder.Done())
+            {
+                packet_size = kArdPacketDelimiterBytes + encoded_size;
+                status = kArdPacketStatusDone;
+            }
+            else
+            {
+                status = kArdPacketStatusPacketSizeTooSmall;
+            }
+#else
+            status = kArdPacketStatusInvalidFraming;
+#endif
+        }
+#if ARD_PACKET_FEC
+        else if (m_config.fec_parity_bytes != 0)
+        {
+            // delimiter
+            packet[0] = m_config.delimiter;
+            // header and payload blocks with parity
+            uint8_t fields[kArdPacketFecMaxHeaderSize];
+            const size_t fields_size = WriteHeaderFields(info, fields);
+            ArdPacketFecEncoder encoder;
+            encoder.Begin(fields, fields_size, info.payload_size, m_config.crc, m_config.fec_parity_bytes,
+                          m_config.fec_block_size);
+            const size_t encoded_size =
+                encoder.Encode(payload, &packet[kArdPacketDelimiterBytes], max_packet_size - kArdPacketDelimiterBytes);
+            if (encoder.Done())
+            {
+                packet_size = kArdPacketDelimiterBytes + encoded_size;
+                status = kArdPacketStatusDone;
+            }
+            else
+            {
+                status = kArdPacketStatusPacketSizeTooSmall;
+            }
+        }
+#endif
         else
         {
             // Create packet
@@ -942,12 +2663,11 @@ inline eArdPacketStatus ArdPacket::WritePacketToBuffer(const ArdPacketPayloadInf
             packet_index += 1;
 
             // message type
-            ConvertToBigEndian(info.message_type, m_config.message_type_bytes, &packet[packet_index]);
-            packet_index += m_config.message_type_bytes;
+            packet_index += WriteField(info.message_type, m_config.message_type_bytes, &packet[packet_index]);
 
             // payload size
-            ConvertToBigEndian(info.payload_size, m_config.payload_size_bytes, &packet[packet_index]);
-            packet_index += m_config.payload_size_bytes;
+            packet_index += WriteField(static_cast<uint32_t>(info.payload_size), m_config.payload_size_bytes,
+                                       &packet[packet_index]);
 
             // header crc
             if (m_config.crc)
@@ -984,23 +2704,22 @@ inline eArdPacketStatus ArdPacket::WritePacketToBuffer(const ArdPacketPayloadInf
     return status;
 }
 
-inline eArdPacketStatus ArdPacket::ReadPacketFromBuffer(const uint8_t *packet, const size_t packet_size,
+inline eArdPacketStatus ArdPacketBase::ReadPacketFromBuffer(const uint8_t *packet, const size_t packet_size,
                                                         ArdPacketPayloadInfo &info, size_t &payload_index) const
 {
     eArdPacketStatus status = kArdPacketStatusStart;
-    const size_t header_size = kArdPacketDelimiterBytes + m_config.message_type_bytes + m_config.payload_size_bytes;
-    size_t header_and_crc_size = header_size;
-    size_t header_and_two_crc_size = header_size;
-    if (m_config.crc)
-    {
-        header_and_crc_size += kArdPacketCrcBytes;
-        header_and_two_crc_size += 2 * kArdPacketCrcBytes;
-    }
+    const size_t min_header_size = kArdPacketDelimiterBytes + GetMinFieldSize(m_config.message_type_bytes) +
+                                   GetMinFieldSize(m_config.payload_size_bytes);
     if (m_config.max_payload_size == 0)
     {
         status = kArdPacketStatusNotConfigured;
     }
-    else if (packet_size <= header_and_crc_size)
+    else if ((m_config.framing != kArdPacketFramingDelimiter) || (m_config.fec_parity_bytes != 0))
+    {
+        // payload is not contiguous in the packet
+        status = kArdPacketStatusInvalidFraming;
+    }
+    else if (packet_size <= min_header_size + (m_config.crc ? kArdPacketCrcBytes : 0))
     {
         status = kArdPacketStatusPacketSizeTooSmall;
     }
@@ -1014,15 +2733,38 @@ inline eArdPacketStatus ArdPacket::ReadPacketFromBuffer(const uint8_t *packet, c
         size_t packet_index = kArdPacketDelimiterBytes;
 
         // message type
-        info.message_type = ConvertFromBigEndian(&packet[packet_index], m_config.message_type_bytes);
-        packet_index += m_config.message_type_bytes;
+        size_t field_size = 0;
+        status = ReadField(&packet[packet_index], packet_size - packet_index, m_config.message_type_bytes,
+                           kArdPacketStatusInvalidMessageType, info.message_type, field_size);
+        packet_index += field_size;
 
         // payload size
-        info.payload_size = ConvertFromBigEndian(&packet[packet_index], m_config.payload_size_bytes);
-        packet_index += m_config.payload_size_bytes;
+        uint32_t payload_size = 0;
+        if (status == kArdPacketStatusDone)
+        {
+            field_size = 0;
+            status = ReadField(&packet[packet_index], packet_size - packet_index, m_config.payload_size_bytes,
+                               kArdPacketStatusInvalidPayloadSize, payload_size, field_size);
+            packet_index += field_size;
+            info.payload_size = payload_size;
+        }
 
-        // header crc
+        const size_t header_size = packet_index;
+        size_t header_and_crc_size = header_size;
+        size_t header_and_two_crc_size = header_size;
         if (m_config.crc)
+        {
+            header_and_crc_size += kArdPacketCrcBytes;
+            header_and_two_crc_size += 2 * kArdPacketCrcBytes;
+        }
+        status = (status == kArdPacketStatusDone ? kArdPacketStatusStart : status);
+        if (kArdPacketStatusStart == status && packet_size <= header_and_crc_size)
+        {
+            status = kArdPacketStatusPacketSizeTooSmall;
+        }
+
+        // header crc
+        if ((kArdPacketStatusStart == status) && m_config.crc)
         {
             crc_t crc = crc_init();
             crc = crc_update(crc, packet, header_and_crc_size);
@@ -1037,14 +2779,14 @@ inline eArdPacketStatus ArdPacket::ReadPacketFromBuffer(const uint8_t *packet, c
         // check payload size
         if (kArdPacketStatusStart == status)
         {
-            if ((info.payload_size > (packet_size - header_and_two_crc_size)) ||
-                (info.payload_size > m_config.max_payload_size))
+            if ((info.payload_size == 0) || (info.payload_size > (packet_size - header_and_two_crc_size)) ||
+                (info.payload_size > m_config.max_payload_size) || !PayloadSizeAllowed(info))
             {
                 status = kArdPacketStatusInvalidPayloadSize;
             }
         }
 
-        // header crc
+        // payload crc
         if ((kArdPacketStatusStart == status) && m_config.crc)
         {
             crc_t crc = crc_init();
@@ -1067,4 +2809,125 @@ inline eArdPacketStatus ArdPacket::ReadPacketFromBuffer(const uint8_t *packet, c
     return status;
 }
 
+inline eArdPacketStatus ArdPacketBase::ReadPacketFromBuffer(const uint8_t *packet, const size_t packet_size,
+                                                        const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                        uint8_t *payload, size_t &packet_used) const
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_config.max_payload_size == 0)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if ((m_config.framing == kArdPacketFramingDelimiter) && (m_config.fec_parity_bytes == 0))
+    {
+        size_t payload_index = 0;
+        status = ReadPacketFromBuffer(packet, packet_size, info, payload_index);
+        if (status == kArdPacketStatusDone && info.payload_size > max_payload_size)
+        {
+            status = kArdPacketStatusInvalidPayloadSize;
+        }
+        else if (status == kArdPacketStatusDone)
+        {
+            memcpy(payload, &packet[payload_index], info.payload_size);
+            packet_used = payload_index + info.payload_size + (m_config.crc ? kArdPacketCrcBytes : 0);
+        }
+    }
+    else if (packet_size <= kArdPacketDelimiterBytes)
+    {
+        status = kArdPacketStatusPacketSizeTooSmall;
+    }
+    else if (packet[0] != m_config.delimiter)
+    {
+        status = kArdPacketStatusNoDelimiter;
+    }
+#if ARD_PACKET_FEC
+    else if (m_config.fec_parity_bytes != 0)
+    {
+        ArdPacketFecDecoder decoder;
+        decoder.Begin(GetHeaderFieldsSize(), m_config.crc, m_config.fec_parity_bytes, m_config.fec_block_size);
+        size_t packet_index = kArdPacketDelimiterBytes;
+        while (status == kArdPacketStatusStart)
+        {
+            size_t consumed = 0;
+            const eArdPacketFecEvent event =
+                decoder.Decode(&packet[packet_index], packet_size - packet_index, payload, consumed);
+            packet_index += consumed;
+            if (event == kArdPacketFecNeedMore)
+            {
+                status = kArdPacketStatusPacketSizeTooSmall;
+            }
+            else if (event == kArdPacketFecHeader)
+            {
+                const eArdPacketStatus header_status = ReadHeaderFields(decoder.Header(), max_payload_size, info);
+                if (header_status == kArdPacketStatusPayloadInProgress)
+                {
+                    decoder.SetPayloadSize(info.payload_size);
+                }
+                else
+                {
+                    status = header_status;
+                }
+            }
+            else if (event == kArdPacketFecDone)
+            {
+                status = ((m_config.crc && decoder.PayloadCrc() != 0) ? kArdPacketStatusCrcFailed
+                                                                       : kArdPacketStatusDone);
+                packet_used = packet_index;
+            }
+            else
+            {
+                status = kArdPacketStatusFecFailed;
+            }
+        }
+    }
+#endif
+    else
+    {
+#if ARD_PACKET_COBS
+        ArdPacketCobsDecoder decoder;
+        decoder.Begin(GetHeaderFieldsSize(), m_config.crc, m_config.delimiter);
+        size_t packet_index = kArdPacketDelimiterBytes;
+        while (status == kArdPacketStatusStart)
+        {
+            size_t consumed = 0;
+            const eArdPacketCobsEvent event =
+                decoder.Decode(&packet[packet_index], packet_size - packet_index, payload, consumed);
+            packet_index += consumed;
+            if (event == kArdPacketCobsNeedMore)
+            {
+                status = kArdPacketStatusPacketSizeTooSmall;
+            }
+            else if (event == kArdPacketCobsHeader)
+            {
+                const eArdPacketStatus header_status = ReadHeaderFields(decoder.Header(), max_payload_size, info);
+                if (header_status == kArdPacketStatusPayloadInProgress)
+                {
+                    decoder.SetPayloadSize(info.payload_size);
+                }
+                else
+                {
+                    status = header_status;
+                }
+            }
+            else if (event == kArdPacketCobsDone)
+            {
+                status = ((m_config.crc && decoder.PayloadCrc() != 0) ? kArdPacketStatusCrcFailed
+                                                                       : kArdPacketStatusDone);
+                packet_used = packet_index;
+            }
+            else
+            {
+                status = kArdPacketStatusInvalidFraming;
+            }
+        }
+#else
+        status = kArdPacketStatusInvalidFraming;
+#endif
+    }
+
+    return status;
+}
+
+#undef ARD_PACKET_STATS_ADD
+
 #endif
@@ -6,6 +6,7 @@
 #include <BluetoothSerial.h>
 
 #include "ArdPacket.h"
+#include "ArdPacketWriteEstimate.h"
 
 class ArdPacketBluetooth : public ArdPacketStreamInterface
 {
@@ -22,54 +23,55 @@ class ArdPacketBluetooth : public ArdPacketStreamInterface
     }
     size_t read(uint8_t *buffer, size_t size) override;
 
-    int availableForWrite() override;
+    int availableForWrite() override
+    {
+        return m_write_estimate.Available();
+    }
     size_t write(uint8_t value) override
     {
-        return m_bt.write(value);
+        return write(&value, 1);
     }
-    size_t write(const uint8_t *buffer, size_t size) override
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    /**
+     * @brief Use a fixed writable size instead of estimating it
+     *
+     * @param size
+     */
+    void SetAvailableForWrite(int size)
     {
-        return m_bt.write(buffer, size);
+        m_write_estimate.SetFixed(size);
     }
 
-    void SetAvailableForWrite(int size);
+    /**
+     * @brief Writable size estimate, configure it to tune or restart estimating
+     */
+    ArdPacketWriteEstimate &WriteEstimate()
+    {
+        return m_write_estimate;
+    }
 
    private:
     BluetoothSerial &m_bt;
-    int m_available_for_write = 64;
+    ArdPacketWriteEstimate m_write_estimate;
 };
 
 inline size_t ArdPacketBluetooth::read(uint8_t *buffer, const size_t size)
 {
-    size_t read_index = 0;
-    int read_byte = 0;
-    while (read_byte >= 0 && read_index < size)
-    {
-        read_byte = m_bt.read();
-        if (read_byte >= 0)
-        {
-            buffer[read_index] = static_cast<uint8_t>(read_byte);
-            read_index++;
-        }
-    }
-    return read_index;
-}
-
-inline int ArdPacketBluetooth::availableForWrite()
-{
-    return m_available_for_write;
+    // one bulk copy from the receive queue; readBytes waits for missing bytes, so only ask for what arrived
+    const int available_size = m_bt.available();
+    size_t read_size = (available_size > 0 ? static_cast<size_t>(available_size) : 0);
+    read_size = (read_size < size ? read_size : size);
+    return (read_size > 0 ? m_bt.readBytes(buffer, read_size) : 0);
 }
 
-inline void ArdPacketBluetooth::SetAvailableForWrite(const int size)
+inline size_t ArdPacketBluetooth::write(const uint8_t *buffer, const size_t size)
 {
-    if (size > 0)
-    {
-        m_available_for_write = size;
-    }
-    else
-    {
-        m_available_for_write = 0;
-    }
+    // the stream takes fewer bytes or blocks while the link drains, either shrinks the estimate
+    const uint32_t start_us = m_write_estimate.Now();
+    const size_t written = m_bt.write(buffer, size);
+    m_write_estimate.Written(size, written, start_us);
+    return written;
 }
 
 #endif
@@ -0,0 +1,504 @@
+
+#ifndef ARD_PACKET_COBS_H
+#define ARD_PACKET_COBS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdCrc.h"
+
+/**
+ * @brief Consistent Overhead Byte Stuffing (COBS) of a packet body
+ *
+ * The packet body is the message type, payload size, optional header CRC, payload and optional payload CRC.
+ * Zero bytes are removed from the body by splitting it into groups of at most 254 bytes, each prefixed with a
+ * code byte. Every encoded byte is XOR'ed with the packet delimiter so the delimiter can never appear inside an
+ * encoded body, whatever its value.
+ *
+ * No terminating delimiter is sent: the decoder knows the body size once the header fields are decoded.
+ */
+
+/**
+ * @brief Enable COBS framing
+ *
+ * Disable to leave out the encoder and decoder state and code where only delimiter framing is used.
+ */
+#ifndef ARD_PACKET_COBS
+#define ARD_PACKET_COBS 1
+#endif
+
+/**
+ * @brief Maximum size of message type, payload size and header CRC fields
+ */
+static constexpr size_t kArdPacketCobsMaxHeaderSize = 10;
+
+/**
+ * @brief Size of the payload CRC trailer
+ */
+static constexpr size_t kArdPacketCobsTrailerSize = 2;
+
+/**
+ * @brief Largest COBS code (a full group of 254 non-zero bytes)
+ */
+static constexpr uint8_t kArdPacketCobsMaxCode = 0xFF;
+
+/**
+ * @brief Decoder events
+ */
+enum eArdPacketCobsEvent
+{
+    kArdPacketCobsNeedMore = 0,
+    kArdPacketCobsHeader,
+    kArdPacketCobsDone,
+    kArdPacketCobsDelimiter,
+    kArdPacketCobsInvalid
+};
+
+/**
+ * @brief Maximum encoded size of a body of @c body_size bytes
+ */
+inline size_t ArdPacketCobsMaxEncodedSize(const size_t body_size)
+{
+    return body_size + body_size / (kArdPacketCobsMaxCode - 1) + 1;
+}
+
+/**
+ * @brief Streaming COBS encoder
+ *
+ * Header fields are copied into the encoder. The payload is scanned in place and the payload CRC is updated
+ * while scanning so the body is read exactly once.
+ */
+class ArdPacketCobsEncoder
+{
+   public:
+    ArdPacketCobsEncoder() = default;
+
+    /**
+     * @brief Start encoding a new body
+     *
+     * @param header message type, payload size and optional header CRC
+     * @param header_size size of @c header
+     * @param payload_size size of payload
+     * @param crc append payload CRC
+     * @param delimiter packet delimiter
+     */
+    void Begin(const uint8_t *header, size_t header_size, size_t payload_size, bool crc, uint8_t delimiter);
+
+    /**
+     * @brief Encode up to @c max_size bytes
+     *
+     * @param payload payload (same pointer for every call of the body)
+     * @param encoded output
+     * @param max_size maximum output size
+     * @return number of encoded bytes
+     */
+    size_t Encode(const uint8_t *payload, uint8_t *encoded, size_t max_size);
+
+    /**
+     * @brief All bytes encoded
+     */
+    bool Done() const
+    {
+        return m_done;
+    }
+
+   private:
+    const uint8_t *Segment(const uint8_t *payload, size_t index, size_t &size) const;
+    uint8_t Scan(const uint8_t *payload);
+    void FinishGroup();
+
+    uint8_t m_header[kArdPacketCobsMaxHeaderSize] = {0};
+    uint8_t m_trailer[kArdPacketCobsTrailerSize] = {0};
+    size_t m_header_size = 0;
+    size_t m_payload_end = 0;
+    size_t m_body_size = 0;
+    size_t m_index = 0;
+    size_t m_scan_index = 0;
+    crc_t m_crc_value = 0;
+    uint8_t m_group_remaining = 0;
+    uint8_t m_xor = 0;
+    bool m_crc = false;
+    bool m_group_zero = false;
+    bool m_need_group = false;
+    bool m_done = true;
+};
+
+/**
+ * @brief Streaming COBS decoder
+ *
+ * Decoding stops with @c kArdPacketCobsHeader once the header fields are complete so the caller can validate them
+ * and set the payload size.
+ */
+class ArdPacketCobsDecoder
+{
+   public:
+    ArdPacketCobsDecoder() = default;
+
+    /**
+     * @brief Start decoding a new body (the delimiter has already been read)
+     *
+     * @param header_size size of message type, payload size and optional header CRC
+     * @param crc payload CRC is appended
+     * @param delimiter packet delimiter
+     */
+    void Begin(size_t header_size, bool crc, uint8_t delimiter);
+
+    /**
+     * @brief Set payload size after @c kArdPacketCobsHeader
+     */
+    void SetPayloadSize(size_t payload_size);
+
+    /**
+     * @brief Decode encoded bytes
+     *
+     * @param encoded encoded bytes
+     * @param encoded_size number of encoded bytes
+     * @param payload payload output
+     * @param consumed number of encoded bytes consumed (including a delimiter)
+     * @return event
+     */
+    eArdPacketCobsEvent Decode(const uint8_t *encoded, size_t encoded_size, uint8_t *payload, size_t &consumed);
+
+    /**
+     * @brief Decoded header fields
+     */
+    const uint8_t *Header() const
+    {
+        return m_header;
+    }
+
+    /**
+     * @brief CRC of payload and trailer, zero when the payload CRC passed
+     */
+    crc_t PayloadCrc() const
+    {
+        return crc_finalize(m_crc_value);
+    }
+
+    /**
+     * @brief Number of encoded bytes that are at least left in the body
+     */
+    size_t RemainingEncoded() const;
+
+   private:
+    uint8_t *Segment(uint8_t *payload, size_t index, size_t &size);
+    eArdPacketCobsEvent PutZero(uint8_t *payload);
+    eArdPacketCobsEvent FinishGroup(uint8_t *payload);
+
+    uint8_t m_header[kArdPacketCobsMaxHeaderSize] = {0};
+    uint8_t m_trailer[kArdPacketCobsTrailerSize] = {0};
+    size_t m_header_size = 0;
+    size_t m_payload_end = 0;
+    size_t m_body_size = 0;
+    size_t m_index = 0;
+    crc_t m_crc_value = 0;
+    uint8_t m_code = 0;
+    uint8_t m_group_remaining = 0;
+    uint8_t m_delimiter = 0;
+    bool m_crc = false;
+    bool m_header_done = false;
+    bool m_finish_pending = false;
+};
+
+// Encoder
+
+inline void ArdPacketCobsEncoder::Begin(const uint8_t *header, const size_t header_size, const size_t payload_size,
+                                        const bool crc, const uint8_t delimiter)
+{
+    memcpy(m_header, header, header_size);
+    m_header_size = header_size;
+    m_payload_end = header_size + payload_size;
+    m_body_size = m_payload_end + (crc ? kArdPacketCobsTrailerSize : 0);
+    m_index = 0;
+    m_scan_index = 0;
+    m_crc = crc;
+    m_crc_value = crc_init();
+    m_group_remaining = 0;
+    m_xor = delimiter;
+    m_group_zero = false;
+    m_need_group = true;
+    m_done = false;
+}
+
+inline const uint8_t *ArdPacketCobsEncoder::Segment(const uint8_t *payload, const size_t index, size_t &size) const
+{
+    const uint8_t *segment = nullptr;
+    if (index < m_header_size)
+    {
+        segment = &m_header[index];
+        size = m_header_size - index;
+    }
+    else if (index < m_payload_end)
+    {
+        segment = &payload[index - m_header_size];
+        size = m_payload_end - index;
+    }
+    else
+    {
+        segment = &m_trailer[index - m_payload_end];
+        size = m_body_size - index;
+    }
+    return segment;
+}
+
+inline uint8_t ArdPacketCobsEncoder::Scan(const uint8_t *payload)
+{
+    size_t group_size = 0;
+    bool zero = false;
+    size_t index = m_scan_index;
+    while (group_size < (kArdPacketCobsMaxCode - 1) && index < m_body_size && !zero)
+    {
+        if (m_crc && index == m_payload_end)
+        {
+            // payload scanned: trailer is final
+            const crc_t crc = crc_finalize(m_crc_value);
+            memcpy(m_trailer, &crc, kArdPacketCobsTrailerSize);
+        }
+        size_t segment_size = 0;
+        const uint8_t *segment = Segment(payload, index, segment_size);
+        const size_t limit =
+            (segment_size < (kArdPacketCobsMaxCode - 1) - group_size ? segment_size
+                                                                      : (kArdPacketCobsMaxCode - 1) - group_size);
+        const uint8_t *found = static_cast<const uint8_t *>(memchr(segment, 0, limit));
+        const size_t run = (found != nullptr ? static_cast<size_t>(found - segment) : limit);
+        if (m_crc && index >= m_header_size && index < m_payload_end)
+        {
+            m_crc_value = crc_update(m_crc_value, segment, run + (found != nullptr ? 1 : 0));
+        }
+        group_size += run;
+        index += run;
+        if (found != nullptr)
+        {
+            zero = true;
+            index += 1;
+        }
+    }
+    m_index = m_scan_index;
+    m_scan_index = index;
+    m_group_remaining = static_cast<uint8_t>(group_size);
+    m_group_zero = zero;
+    return static_cast<uint8_t>(group_size + 1);
+}
+
+inline void ArdPacketCobsEncoder::FinishGroup()
+{
+    // skip zero replaced by the next code
+    m_index = m_scan_index;
+    if (m_group_zero)
+    {
+        m_need_group = true;
+    }
+    else if (m_index >= m_body_size)
+    {
+        m_done = true;
+    }
+    else
+    {
+        m_need_group = true;
+    }
+}
+
+inline size_t ArdPacketCobsEncoder::Encode(const uint8_t *payload, uint8_t *encoded, const size_t max_size)
+{
+    size_t encoded_size = 0;
+    while (!m_done && encoded_size < max_size)
+    {
+        if (m_need_group)
+        {
+            encoded[encoded_size] = Scan(payload) ^ m_xor;
+            encoded_size += 1;
+            m_need_group = false;
+            if (m_group_remaining == 0)
+            {
+                FinishGroup();
+            }
+        }
+        else
+        {
+            size_t segment_size = 0;
+            const uint8_t *segment = Segment(payload, m_index, segment_size);
+            size_t copy_size = (segment_size < m_group_remaining ? segment_size : m_group_remaining);
+            copy_size = (copy_size < (max_size - encoded_size) ? copy_size : (max_size - encoded_size));
+            if (m_xor == 0)
+            {
+                memcpy(&encoded[encoded_size], segment, copy_size);
+            }
+            else
+            {
+                for (size_t k = 0; k < copy_size; ++k)
+                {
+                    encoded[encoded_size + k] = segment[k] ^ m_xor;
+                }
+            }
+            encoded_size += copy_size;
+            m_index += copy_size;
+            m_group_remaining = static_cast<uint8_t>(m_group_remaining - copy_size);
+            if (m_group_remaining == 0)
+            {
+                FinishGroup();
+            }
+        }
+    }
+    return encoded_size;
+}
+
+// Decoder
+
+inline void ArdPacketCobsDecoder::Begin(const size_t header_size, const bool crc, const uint8_t delimiter)
+{
+    m_header_size = header_size;
+    m_payload_end = header_size;
+    m_body_size = header_size;
+    m_index = 0;
+    m_crc = crc;
+    m_crc_value = crc_init();
+    m_code = 0;
+    m_group_remaining = 0;
+    m_delimiter = delimiter;
+    m_header_done = false;
+    m_finish_pending = false;
+}
+
+inline void ArdPacketCobsDecoder::SetPayloadSize(const size_t payload_size)
+{
+    m_payload_end = m_header_size + payload_size;
+    m_body_size = m_payload_end + (m_crc ? kArdPacketCobsTrailerSize : 0);
+    m_header_done = true;
+}
+
+inline size_t ArdPacketCobsDecoder::RemainingEncoded() const
+{
+    // every decoded byte takes at least one encoded byte, payload is at least one byte and a code byte may be due
+    const size_t code_size = (m_group_remaining == 0 ? 1 : 0);
+    return (m_header_done ? m_body_size - m_index : m_header_size - m_index + 1) + code_size;
+}
+
+inline uint8_t *ArdPacketCobsDecoder::Segment(uint8_t *payload, const size_t index, size_t &size)
+{
+    uint8_t *segment = nullptr;
+    if (index < m_header_size)
+    {
+        segment = &m_header[index];
+        size = m_header_size - index;
+    }
+    else if (index < m_payload_end)
+    {
+        segment = &payload[index - m_header_size];
+        size = m_payload_end - index;
+    }
+    else
+    {
+        segment = &m_trailer[index - m_payload_end];
+        size = m_body_size - index;
+    }
+    return segment;
+}
+
+inline eArdPacketCobsEvent ArdPacketCobsDecoder::PutZero(uint8_t *payload)
+{
+    eArdPacketCobsEvent event = kArdPacketCobsNeedMore;
+    if (m_index >= m_body_size)
+    {
+        event = kArdPacketCobsInvalid;
+    }
+    else
+    {
+        size_t segment_size = 0;
+        uint8_t *segment = Segment(payload, m_index, segment_size);
+        segment[0] = 0;
+        if (m_crc && m_index >= m_header_size)
+        {
+            m_crc_value = crc_update(m_crc_value, segment, 1);
+        }
+        m_index += 1;
+        if (!m_header_done && m_index == m_header_size)
+        {
+            event = kArdPacketCobsHeader;
+        }
+    }
+    return event;
+}
+
+inline eArdPacketCobsEvent ArdPacketCobsDecoder::FinishGroup(uint8_t *payload)
+{
+    eArdPacketCobsEvent event = kArdPacketCobsNeedMore;
+    if (m_header_done && m_index == m_body_size)
+    {
+        event = kArdPacketCobsDone;
+    }
+    else if (m_code != kArdPacketCobsMaxCode)
+    {
+        event = PutZero(payload);
+    }
+    return event;
+}
+
+inline eArdPacketCobsEvent ArdPacketCobsDecoder::Decode(const uint8_t *encoded, const size_t encoded_size,
+                                                        uint8_t *payload, size_t &consumed)
+{
+    eArdPacketCobsEvent event = kArdPacketCobsNeedMore;
+    consumed = 0;
+    if (m_finish_pending)
+    {
+        // group ended together with the header
+        m_finish_pending = false;
+        event = FinishGroup(payload);
+    }
+    while (event == kArdPacketCobsNeedMore && consumed < encoded_size)
+    {
+        if (encoded[consumed] == m_delimiter)
+        {
+            // start of another packet
+            consumed += 1;
+            event = kArdPacketCobsDelimiter;
+        }
+        else if (m_group_remaining == 0)
+        {
+            // code byte
+            m_code = encoded[consumed] ^ m_delimiter;
+            m_group_remaining = static_cast<uint8_t>(m_code - 1);
+            consumed += 1;
+            if (m_group_remaining == 0)
+            {
+                event = FinishGroup(payload);
+            }
+        }
+        else if (m_index >= m_body_size)
+        {
+            event = kArdPacketCobsInvalid;
+        }
+        else
+        {
+            // data bytes
+            size_t segment_size = 0;
+            uint8_t *segment = Segment(payload, m_index, segment_size);
+            size_t copy_size = (segment_size < m_group_remaining ? segment_size : m_group_remaining);
+            copy_size = (copy_size < (encoded_size - consumed) ? copy_size : (encoded_size - consumed));
+            size_t k = 0;
+            while (k < copy_size && encoded[consumed + k] != m_delimiter)
+            {
+                segment[k] = encoded[consumed + k] ^ m_delimiter;
+                k++;
+            }
+            if (m_crc && m_index >= m_header_size)
+            {
+                m_crc_value = crc_update(m_crc_value, segment, k);
+            }
+            consumed += k;
+            m_index += k;
+            m_group_remaining = static_cast<uint8_t>(m_group_remaining - k);
+            if (!m_header_done && m_index == m_header_size)
+            {
+                event = kArdPacketCobsHeader;
+                m_finish_pending = (m_group_remaining == 0);
+            }
+            else if (m_group_remaining == 0)
+            {
+                event = FinishGroup(payload);
+            }
+        }
+    }
+    return event;
+}
+
+#endif
@@ -0,0 +1,261 @@
+
+#ifndef ARD_PACKET_COMPRESS_H
+#define ARD_PACKET_COMPRESS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+#include "ArdPacketLzss.h"
+
+/**
+ * @brief Payload compression configuration
+ */
+struct ArdPacketCompressConfig
+{
+    /**
+     * @brief Message type bit marking compressed frames
+     *
+     * A single bit within the message type field of the packet, such as 0x80 with one byte message types. Both ends
+     * must use the same bit and application message types must leave it clear.
+     */
+    uint32_t compressed_flag = 0;
+
+    /**
+     * @brief Maximum size of application payload, before compression
+     *
+     * Up to the packet @c max_payload_size, since payloads that do not shrink are sent raw.
+     */
+    size_t max_payload_size = 0;
+
+    /**
+     * @brief Back reference distance bits, from @c kArdPacketLzssMinWindowBits to @c ARD_PACKET_LZSS_WINDOW_BITS
+     *
+     * Both ends must use the same. A larger window finds more repeats in longer payloads, at more encoder time.
+     */
+    uint8_t window_bits = ARD_PACKET_LZSS_WINDOW_BITS;
+
+    /**
+     * @brief Payloads smaller than this are sent raw without trying to compress them
+     */
+    size_t min_compress_size = 16;
+};
+
+/**
+ * @brief LZSS payload compression on top of @c ArdPacket
+ *
+ * Each payload is compressed on its own, see @c ArdPacketLzssEncoder. It is sent compressed with the
+ * @c compressed_flag bit set in its message type only if that makes it shorter, otherwise it is sent raw, so
+ * compressed and raw frames share the stream and an incompressible payload never grows. The receiver clears the
+ * bit and returns the decompressed payload. Framing, CRC and all packet options are unchanged.
+ *
+ * RAM is the encoder window of 2^ARD_PACKET_LZSS_WINDOW_BITS bytes plus the caller provided storage for one
+ * compressed frame each way.
+ */
+class ArdPacketCompress
+{
+   public:
+    explicit ArdPacketCompress(ArdPacket &packet) : m_packet(packet) {}
+
+    /**
+     * @brief Storage size needed for one outgoing and one incoming frame
+     *
+     * @param max_payload_size maximum size of application payload
+     * @return size in bytes
+     */
+    static size_t StorageSize(const size_t max_payload_size)
+    {
+        return 2 * max_payload_size;
+    }
+
+    /**
+     * @brief Configure compression (the packet must already be configured)
+     *
+     * @param config
+     * @param storage at least @c StorageSize bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketCompressConfig &config, uint8_t *storage, size_t storage_size);
+
+    /**
+     * @brief Compress payload and write it to the data stream
+     *
+     * Like @c ArdPacket::SendPayload, call again with the same arguments while the frame is in progress. The payload
+     * is compressed on the first call only.
+     *
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusInvalidMessageType if the message type has the compressed flag set, otherwise the
+     * status of @c SendPayload
+     */
+    eArdPacketStatus Send(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief Receive the next payload and decompress it
+     *
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusCompressionFailed if a compressed frame does not decompress into
+     * @c max_payload_size bytes, otherwise the status of @c ReceivePayload
+     */
+    eArdPacketStatus Receive(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+
+    /**
+     * @brief Drop the frame in progress
+     */
+    void Reset()
+    {
+        m_sending = false;
+        m_packet.Reset();
+    }
+
+    /**
+     * @brief Payload bytes given to @c Send and bytes sent for them, since @c Configure
+     */
+    uint32_t GetPayloadBytes() const
+    {
+        return m_payload_bytes;
+    }
+
+    uint32_t GetSentBytes() const
+    {
+        return m_sent_bytes;
+    }
+
+   private:
+    // configuration
+    ArdPacketCompressConfig m_config = {};
+    uint8_t *m_tx = nullptr;
+    uint8_t *m_rx = nullptr;
+
+    // frame being written, compressed into m_tx or pointing at the raw payload
+    ArdPacketLzssEncoder m_encoder = {};
+    ArdPacketPayloadInfo m_tx_info = {};
+    const uint8_t *m_tx_payload = nullptr;
+    bool m_sending = false;
+    uint32_t m_payload_bytes = 0;
+    uint32_t m_sent_bytes = 0;
+
+    // frame being read
+    ArdPacketPayloadInfo m_rx_info = {};
+
+    // packet
+    ArdPacket &m_packet;
+};
+
+// inline methods
+
+inline eArdPacketConfigStatus ArdPacketCompress::Configure(const ArdPacketCompressConfig &config, uint8_t *storage,
+                                                           const size_t storage_size)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    const size_t message_type_bits = 8 * static_cast<size_t>(m_packet.GetConfig().message_type_bytes);
+    const uint32_t flag = config.compressed_flag;
+
+    if (config.max_payload_size == 0 || config.max_payload_size > m_packet.GetConfig().max_payload_size)
+    {
+        status = kArdPacketConfigInvalidMaxPayloadSize;
+    }
+    else if (flag == 0 || (flag & (flag - 1)) != 0 || (message_type_bits < 32 && (flag >> message_type_bits) != 0) ||
+             config.window_bits < kArdPacketLzssMinWindowBits || config.window_bits > kArdPacketLzssMaxWindowBits)
+    {
+        status = kArdPacketConfigInvalidCompression;
+    }
+    else if (storage == nullptr || storage_size < StorageSize(config.max_payload_size))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else
+    {
+        m_config = config;
+        m_tx = storage;
+        m_rx = &storage[config.max_payload_size];
+        m_sending = false;
+        m_payload_bytes = 0;
+        m_sent_bytes = 0;
+    }
+
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketCompress::Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_tx == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if ((info.message_type & m_config.compressed_flag) != 0)
+    {
+        status = kArdPacketStatusInvalidMessageType;
+    }
+    else if (info.payload_size > m_config.max_payload_size)
+    {
+        status = kArdPacketStatusInvalidPayloadSize;
+    }
+    else
+    {
+        if (!m_sending)
+        {
+            // compressed only if it saves at least a byte
+            m_tx_info = info;
+            m_tx_payload = payload;
+            if (info.payload_size >= m_config.min_compress_size &&
+                m_encoder.Begin(m_config.window_bits, m_tx, info.payload_size - 1) &&
+                m_encoder.Sink(payload, info.payload_size) && m_encoder.Finish())
+            {
+                m_tx_info.message_type |= m_config.compressed_flag;
+                m_tx_info.payload_size = m_encoder.Size();
+                m_tx_payload = m_tx;
+            }
+        }
+        status = m_packet.SendPayload(m_tx_info, m_tx_payload);
+        m_sending = (status == kArdPacketStatusHeaderInProgress || status == kArdPacketStatusPayloadInProgress ||
+                     status == kArdPacketStatusNotEnoughAvailable);
+        if (status == kArdPacketStatusDone)
+        {
+            m_payload_bytes += static_cast<uint32_t>(info.payload_size);
+            m_sent_bytes += static_cast<uint32_t>(m_tx_info.payload_size);
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketCompress::Receive(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                   uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_rx == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else
+    {
+        status = m_packet.ReceivePayload(m_config.max_payload_size, m_rx_info, m_rx);
+        if (status == kArdPacketStatusDone && (m_rx_info.message_type & m_config.compressed_flag) != 0)
+        {
+            ArdPacketLzssDecoder decoder;
+            const bool decoded = decoder.Begin(m_config.window_bits, payload, max_payload_size) &&
+                                 decoder.Decode(m_rx, m_rx_info.payload_size) && decoder.Finish() &&
+                                 decoder.Size() > 0;
+            info.message_type = m_rx_info.message_type & ~m_config.compressed_flag;
+            info.payload_size = decoder.Size();
+            status = (decoded ? kArdPacketStatusDone : kArdPacketStatusCompressionFailed);
+        }
+        else if (status == kArdPacketStatusDone)
+        {
+            info = m_rx_info;
+            status = (m_rx_info.payload_size <= max_payload_size ? kArdPacketStatusDone
+                                                                 : kArdPacketStatusInvalidPayloadSize);
+            if (status == kArdPacketStatusDone)
+            {
+                memcpy(payload, m_rx, m_rx_info.payload_size);
+            }
+        }
+    }
+    return status;
+}
+
+#endif
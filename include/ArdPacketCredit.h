@@ -0,0 +1,423 @@
+
+#ifndef ARD_PACKET_CREDIT_H
+#define ARD_PACKET_CREDIT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Size of a credit frame payload: receive limit followed by the total sent, both 32 bit little endian
+ */
+static constexpr size_t kArdPacketCreditControlSize = 8;
+
+/**
+ * @brief Unit of flow control credit
+ */
+enum eArdPacketCreditUnit
+{
+    /**
+     * @brief One credit per frame
+     */
+    kArdPacketCreditUnitFrames = 0,
+
+    /**
+     * @brief One credit per byte on the stream, see @c ArdPacket::GetMaxPacketSize
+     */
+    kArdPacketCreditUnitBytes
+};
+
+/**
+ * @brief Credit flow control configuration
+ */
+struct ArdPacketCreditConfig
+{
+    /**
+     * @brief Unit of credit, both ends must use the same unit
+     */
+    eArdPacketCreditUnit unit = kArdPacketCreditUnitFrames;
+
+    /**
+     * @brief Frames or bytes this end can hold before the application reads them
+     *
+     * Typically the receive buffer of the serial port, less the size of one credit frame. In bytes, it must hold at
+     * least one packet of @c max_payload_size.
+     */
+    uint32_t receive_credit = 0;
+
+    /**
+     * @brief Maximum size of application payload
+     */
+    size_t max_payload_size = 0;
+
+    /**
+     * @brief Message type reserved for credit frames
+     */
+    uint32_t credit_message_type = 0;
+
+    /**
+     * @brief Interval at which credit is advertised again, 0 to advertise only when it grows
+     *
+     * Repeating the advertisement recovers from lost credit frames and lost data frames.
+     */
+    uint32_t refresh_interval_ms = 250;
+
+    /**
+     * @brief Millisecond clock, defaults to @c millis on Arduino
+     */
+    ArdPacketClock clock = nullptr;
+};
+
+/**
+ * @brief Receiver advertised credit flow control on top of @c ArdPacket
+ *
+ * Each end advertises how many frames or bytes it accepts in credit frames holding a cumulative receive limit.
+ * @c Send returns @c kArdPacketStatusNoCredit instead of writing a frame the far end has no room for, so a fast
+ * sender cannot overrun the receive buffer of a slow one. Credit is returned when the application reads a frame.
+ *
+ * Credit frames also carry the total the sender has sent. Since frames are read in order, the receiver uses it to
+ * return the credit of frames lost on the link. Data frames are sent unchanged.
+ */
+class ArdPacketCredit
+{
+   public:
+    explicit ArdPacketCredit(ArdPacket &packet) : m_packet(packet) {}
+
+    /**
+     * @brief Storage size needed to hold one incoming frame
+     *
+     * @param max_payload_size maximum size of application payload
+     * @return size in bytes
+     */
+    static size_t StorageSize(size_t max_payload_size)
+    {
+        return (max_payload_size > kArdPacketCreditControlSize ? max_payload_size : kArdPacketCreditControlSize);
+    }
+
+    /**
+     * @brief Configure flow control (the packet must already be configured)
+     *
+     * @param config
+     * @param storage at least @c StorageSize bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketCreditConfig &config, uint8_t *storage, size_t storage_size);
+
+    /**
+     * @brief Write payload to data stream if the far end has credit for it
+     *
+     * Like @c ArdPacket::SendPayload, call again with the same arguments while the frame is in progress.
+     *
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusNoCredit when the far end has no room, otherwise the status of @c SendPayload
+     */
+    eArdPacketStatus Send(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief Receive the next payload and return its credit
+     *
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusDone when a payload is copied, @c kArdPacketStatusNotAvailable otherwise
+     */
+    eArdPacketStatus Receive(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+
+    /**
+     * @brief Read credit frames and advertise credit
+     */
+    void Poll();
+
+    /**
+     * @brief Frames or bytes that can be sent before the far end advertises more
+     */
+    uint32_t Credit() const
+    {
+        const int32_t credit = static_cast<int32_t>(m_tx_limit - m_tx_sent);
+        return (credit > 0 ? static_cast<uint32_t>(credit) : 0);
+    }
+
+    /**
+     * @brief Frames or bytes charged for a payload of @c payload_size bytes
+     */
+    uint32_t Cost(size_t payload_size) const
+    {
+        return static_cast<uint32_t>(m_config.unit == kArdPacketCreditUnitBytes ? m_packet.GetMaxPacketSize(payload_size)
+                                                                                 : 1);
+    }
+
+   private:
+    enum eArdPacketCreditWrite
+    {
+        kArdPacketCreditWriteNone,
+        kArdPacketCreditWriteData,
+        kArdPacketCreditWriteControl
+    };
+
+    static void WriteUint32(uint32_t value, uint8_t *data);
+    static uint32_t ReadUint32(const uint8_t *data);
+
+    uint32_t ReceiveLimit() const
+    {
+        return m_rx_consumed + m_config.receive_credit;
+    }
+
+    void PollRead();
+    void PollWrite();
+    bool ControlDue() const;
+
+    // configuration
+    ArdPacketCreditConfig m_config = {};
+    ArdPacketClock m_clock = nullptr;
+    uint8_t *m_storage = nullptr;
+
+    // sending: totals since Configure
+    uint32_t m_tx_sent = 0;
+    uint32_t m_tx_limit = 0;
+
+    // receiving: totals since Configure
+    uint32_t m_rx_consumed = 0;
+    uint32_t m_rx_advertised = 0;
+    bool m_advertise = false;
+    uint32_t m_control_ms = 0;
+
+    // frame being read, held until the application reads it
+    ArdPacketPayloadInfo m_read_info = {};
+    bool m_read_held = false;
+
+    // frame being written
+    eArdPacketCreditWrite m_write = kArdPacketCreditWriteNone;
+    uint8_t m_control[kArdPacketCreditControlSize] = {0};
+
+    // packet
+    ArdPacket &m_packet;
+};
+
+// inline methods
+
+inline eArdPacketConfigStatus ArdPacketCredit::Configure(const ArdPacketCreditConfig &config, uint8_t *storage,
+                                                         const size_t storage_size)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    ArdPacketClock clock = config.clock;
+#ifndef NATIVE_TEST_BUILD
+    if (clock == nullptr)
+    {
+        clock = []() -> uint32_t { return static_cast<uint32_t>(millis()); };
+    }
+#endif
+
+    if (config.max_payload_size == 0)
+    {
+        status = kArdPacketConfigInvalidMaxPayloadSize;
+    }
+    else if (config.receive_credit == 0 || (config.unit == kArdPacketCreditUnitBytes &&
+                                            config.receive_credit < m_packet.GetMaxPacketSize(config.max_payload_size)))
+    {
+        status = kArdPacketConfigInvalidCredit;
+    }
+    else if (storage == nullptr || storage_size < StorageSize(config.max_payload_size))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else if (clock == nullptr && config.refresh_interval_ms != 0)
+    {
+        status = kArdPacketConfigInvalidClock;
+    }
+    else
+    {
+        m_config = config;
+        m_clock = clock;
+        m_storage = storage;
+
+        m_tx_sent = 0;
+        m_tx_limit = 0;
+        m_rx_consumed = 0;
+        m_rx_advertised = 0;
+        m_advertise = true;
+        m_control_ms = 0;
+        m_read_held = false;
+        m_write = kArdPacketCreditWriteNone;
+    }
+
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketCredit::Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_storage == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if (info.message_type == m_config.credit_message_type)
+    {
+        status = kArdPacketStatusInvalidMessageType;
+    }
+    else
+    {
+        if (m_write != kArdPacketCreditWriteData)
+        {
+            Poll();
+        }
+
+        if (m_write == kArdPacketCreditWriteControl)
+        {
+            // credit frame still waiting for room in the stream
+            status = kArdPacketStatusNotAvailable;
+        }
+        else if (m_write == kArdPacketCreditWriteNone && Credit() < Cost(info.payload_size))
+        {
+            status = kArdPacketStatusNoCredit;
+        }
+        else
+        {
+            status = m_packet.SendPayload(info, payload);
+            const bool written = (status == kArdPacketStatusDone || status == kArdPacketStatusHeaderInProgress ||
+                                  status == kArdPacketStatusPayloadInProgress);
+            if (written && m_write == kArdPacketCreditWriteNone)
+            {
+                // charged once the first byte is on the stream
+                m_tx_sent += Cost(info.payload_size);
+            }
+            m_write = (written && status != kArdPacketStatusDone ? kArdPacketCreditWriteData
+                                                                 : kArdPacketCreditWriteNone);
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketCredit::Receive(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                 uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusNotAvailable;
+    if (m_storage == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else
+    {
+        PollRead();
+        if (m_read_held)
+        {
+            status = (m_read_info.payload_size <= max_payload_size ? kArdPacketStatusDone
+                                                                   : kArdPacketStatusInvalidPayloadSize);
+            info = m_read_info;
+            if (status == kArdPacketStatusDone)
+            {
+                memcpy(payload, m_storage, m_read_info.payload_size);
+            }
+            // delivered (or dropped): return its credit
+            m_read_held = false;
+            m_rx_consumed += Cost(m_read_info.payload_size);
+        }
+        PollWrite();
+    }
+    return status;
+}
+
+inline void ArdPacketCredit::Poll()
+{
+    if (m_storage != nullptr)
+    {
+        PollRead();
+        PollWrite();
+    }
+}
+
+// Private inline methods
+// ----------------------
+
+inline void ArdPacketCredit::WriteUint32(const uint32_t value, uint8_t *data)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline uint32_t ArdPacketCredit::ReadUint32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline void ArdPacketCredit::PollRead()
+{
+    // stop at the first data frame so the rest stays in the stream until the application reads
+    bool continue_read = !m_read_held;
+    while (continue_read)
+    {
+        const eArdPacketStatus status =
+            m_packet.ReceivePayload(StorageSize(m_config.max_payload_size), m_read_info, m_storage);
+        if (status == kArdPacketStatusDone && m_read_info.message_type == m_config.credit_message_type)
+        {
+            if (m_read_info.payload_size == kArdPacketCreditControlSize)
+            {
+                const uint32_t limit = ReadUint32(m_storage);
+                const uint32_t peer_sent = ReadUint32(&m_storage[4]);
+                if (static_cast<int32_t>(limit - m_tx_limit) > 0)
+                {
+                    m_tx_limit = limit;
+                }
+                if (static_cast<int32_t>(peer_sent - m_rx_consumed) > 0)
+                {
+                    // every frame sent before this one was read or lost
+                    m_rx_consumed = peer_sent;
+                }
+            }
+        }
+        else if (status == kArdPacketStatusDone)
+        {
+            m_read_held = true;
+        }
+        // errors consume bytes, keep reading what is left
+        continue_read = (!m_read_held && ArdPacketStatusFrameConsumed(status));
+    }
+}
+
+inline bool ArdPacketCredit::ControlDue() const
+{
+    // advertise once half of the receive credit has been returned, or on refresh
+    const uint32_t threshold = (m_config.receive_credit > 1 ? m_config.receive_credit / 2 : 1);
+    const bool grown = (ReceiveLimit() - m_rx_advertised >= threshold);
+    const bool refresh = (m_config.refresh_interval_ms != 0 && (m_clock() - m_control_ms) >= m_config.refresh_interval_ms);
+    return (m_advertise || grown || refresh);
+}
+
+inline void ArdPacketCredit::PollWrite()
+{
+    if (m_write == kArdPacketCreditWriteNone && ControlDue())
+    {
+        // no data frame in progress, so the sent total covers every frame before this one
+        WriteUint32(ReceiveLimit(), m_control);
+        WriteUint32(m_tx_sent, &m_control[4]);
+        m_rx_advertised = ReceiveLimit();
+        m_advertise = false;
+        m_control_ms = (m_clock != nullptr ? m_clock() : 0);
+        m_write = kArdPacketCreditWriteControl;
+    }
+    if (m_write == kArdPacketCreditWriteControl)
+    {
+        ArdPacketPayloadInfo control_info;
+        control_info.message_type = m_config.credit_message_type;
+        control_info.payload_size = kArdPacketCreditControlSize;
+        const eArdPacketStatus status = m_packet.SendPayload(control_info, m_control);
+        if (status == kArdPacketStatusDone)
+        {
+            m_write = kArdPacketCreditWriteNone;
+        }
+        else if (status != kArdPacketStatusHeaderInProgress && status != kArdPacketStatusPayloadInProgress &&
+                 status != kArdPacketStatusNotAvailable && status != kArdPacketStatusNotEnoughAvailable)
+        {
+            // frame cannot be sent with this packet configuration
+            m_packet.ResetWrite();
+            m_write = kArdPacketCreditWriteNone;
+        }
+    }
+}
+
+#endif
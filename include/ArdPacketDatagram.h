@@ -0,0 +1,299 @@
+
+#ifndef ARD_PACKET_DATAGRAM_H
+#define ARD_PACKET_DATAGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Abstract message transport that keeps message boundaries, such as UDP
+ */
+class ArdPacketDatagramInterface
+{
+   public:
+    ArdPacketDatagramInterface() = default;
+
+    /**
+     * @brief Copy the next received datagram
+     *
+     * @param buffer
+     * @param size size of buffer, longer datagrams are dropped
+     * @return size of the datagram, 0 if none is available
+     */
+    virtual size_t ReceiveDatagram(uint8_t *buffer, size_t size) = 0;
+
+    /**
+     * @brief Queue a datagram to send
+     *
+     * @param buffer
+     * @param size
+     * @return false if the datagram can not be queued right now
+     */
+    virtual bool SendDatagram(const uint8_t *buffer, size_t size) = 0;
+
+    /**
+     * @brief Send queued datagrams
+     */
+    virtual void FlushDatagrams() {}
+};
+
+/**
+ * @brief Datagram mode configuration
+ */
+struct ArdPacketDatagramConfig
+{
+    /**
+     * @brief Packet configuration
+     *
+     * The delimiter only marks the start of each packet and is never searched for.
+     */
+    ArdPacketConfig packet;
+
+    /**
+     * @brief Largest datagram sent or received, 1472 bytes fill an Ethernet or WiFi frame over IPv4
+     */
+    size_t max_datagram_size = 1472;
+
+    /**
+     * @brief Pack several packets into each datagram until @c Flush or until the next one does not fit
+     *
+     * Otherwise every packet is sent in its own datagram.
+     */
+    bool aggregate = false;
+};
+
+/**
+ * @brief Packets over a datagram transport
+ *
+ * A datagram holds one packet, or several packets back to back. Packets are parsed straight from the received
+ * datagram, so there is no delimiter search or stream reassembly and a lost or corrupted datagram never delays the
+ * next one. Calls never leave a packet in progress.
+ */
+class ArdPacketDatagram
+{
+   public:
+    explicit ArdPacketDatagram(ArdPacketDatagramInterface &transport) : m_transport(transport), m_packet(m_no_stream)
+    {
+    }
+
+    /**
+     * @brief Storage size needed for one received and one outgoing datagram
+     *
+     * @param max_datagram_size
+     * @return size in bytes
+     */
+    static size_t StorageSize(const size_t max_datagram_size)
+    {
+        return 2 * max_datagram_size;
+    }
+
+    /**
+     * @brief Configure packet and datagram mode
+     *
+     * @param config
+     * @param storage at least @c StorageSize bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketDatagramConfig &config, uint8_t *storage, size_t storage_size);
+
+    /**
+     * @brief Receive the next payload
+     *
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusDone when a payload is copied, @c kArdPacketStatusNotAvailable when no datagram is
+     * available, otherwise the error of a packet that is dropped with the rest of its datagram
+     */
+    eArdPacketStatus ReceivePayload(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+
+    /**
+     * @brief Add a packet to the outgoing datagram
+     *
+     * The packet is sent by @c Flush, or before it when the datagram is full or aggregation is off.
+     *
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusDone when the packet is queued, @c kArdPacketStatusNotEnoughAvailable when the
+     * transport can not take the full datagram yet
+     */
+    eArdPacketStatus SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief Send the outgoing datagram and every datagram queued by the transport
+     *
+     * @return false if the outgoing datagram could not be queued
+     */
+    bool Flush();
+
+    /**
+     * @brief Packet used to frame payloads
+     */
+    const ArdPacket &Packet() const
+    {
+        return m_packet;
+    }
+
+   private:
+    // datagram mode never touches the stream of the packet
+    class ArdPacketDatagramNoStream : public ArdPacketStreamInterface
+    {
+       public:
+        int available() override
+        {
+            return 0;
+        }
+        int read() override
+        {
+            return -1;
+        }
+        size_t read(uint8_t *buffer, size_t size) override
+        {
+            (void)buffer;
+            (void)size;
+            return 0;
+        }
+        int availableForWrite() override
+        {
+            return 0;
+        }
+        size_t write(uint8_t value) override
+        {
+            (void)value;
+            return 0;
+        }
+        size_t write(const uint8_t *buffer, size_t size) override
+        {
+            (void)buffer;
+            (void)size;
+            return 0;
+        }
+    };
+
+    bool SendPending();
+
+    ArdPacketDatagramInterface &m_transport;
+    ArdPacketDatagramNoStream m_no_stream;
+    ArdPacket m_packet;
+    bool m_aggregate = false;
+    size_t m_max_datagram_size = 0;
+
+    uint8_t *m_rx = nullptr;
+    size_t m_rx_size = 0;
+    size_t m_rx_index = 0;
+
+    uint8_t *m_tx = nullptr;
+    size_t m_tx_size = 0;
+};
+
+// ArdPacketDatagram inline methods
+
+inline eArdPacketConfigStatus ArdPacketDatagram::Configure(const ArdPacketDatagramConfig &config, uint8_t *storage,
+                                                           const size_t storage_size)
+{
+    eArdPacketConfigStatus status = m_packet.Configure(config.packet);
+    if (status == kArdPacketConfigSuccess &&
+        m_packet.GetMaxPacketSize(config.packet.max_payload_size) > config.max_datagram_size)
+    {
+        // a full payload must fit in one datagram
+        status = kArdPacketConfigInvalidMaxPayloadSize;
+    }
+    else if (status == kArdPacketConfigSuccess &&
+             (storage == nullptr || storage_size < StorageSize(config.max_datagram_size)))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+
+    if (status == kArdPacketConfigSuccess)
+    {
+        m_aggregate = config.aggregate;
+        m_max_datagram_size = config.max_datagram_size;
+        m_rx = storage;
+        m_rx_size = 0;
+        m_rx_index = 0;
+        m_tx = &storage[config.max_datagram_size];
+        m_tx_size = 0;
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketDatagram::ReceivePayload(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                          uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_rx == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else
+    {
+        if (m_rx_index >= m_rx_size)
+        {
+            m_rx_size = m_transport.ReceiveDatagram(m_rx, m_max_datagram_size);
+            m_rx_index = 0;
+        }
+        if (m_rx_size == 0)
+        {
+            status = kArdPacketStatusNotAvailable;
+        }
+        else
+        {
+            size_t packet_used = 0;
+            status = m_packet.ReadPacketFromBuffer(&m_rx[m_rx_index], m_rx_size - m_rx_index, max_payload_size, info,
+                                                   payload, packet_used);
+            // the rest of a datagram can not be trusted after a bad packet
+            m_rx_index = (status == kArdPacketStatusDone ? m_rx_index + packet_used : m_rx_size);
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketDatagram::SendPayload(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_tx == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if (m_tx_size + m_packet.GetMaxPacketSize(info.payload_size) > m_max_datagram_size && !SendPending())
+    {
+        status = kArdPacketStatusNotEnoughAvailable;
+    }
+    else
+    {
+        size_t packet_size = 0;
+        status = m_packet.WritePacketToBuffer(info, payload, m_max_datagram_size - m_tx_size, &m_tx[m_tx_size],
+                                              packet_size);
+        if (status == kArdPacketStatusDone)
+        {
+            m_tx_size += packet_size;
+            if (!m_aggregate)
+            {
+                // queued with the next datagram if the transport is full
+                SendPending();
+            }
+        }
+    }
+    return status;
+}
+
+inline bool ArdPacketDatagram::Flush()
+{
+    const bool sent = SendPending();
+    m_transport.FlushDatagrams();
+    return sent;
+}
+
+inline bool ArdPacketDatagram::SendPending()
+{
+    if (m_tx_size > 0 && m_transport.SendDatagram(m_tx, m_tx_size))
+    {
+        m_tx_size = 0;
+    }
+    return (m_tx_size == 0);
+}
+
+#endif
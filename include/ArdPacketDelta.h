@@ -0,0 +1,575 @@
+
+#ifndef ARD_PACKET_DELTA_H
+#define ARD_PACKET_DELTA_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Largest number of message types tracked in each direction
+ */
+#ifndef ARD_PACKET_DELTA_MAX_STREAMS
+#if defined(__AVR__)
+#define ARD_PACKET_DELTA_MAX_STREAMS 4
+#else
+#define ARD_PACKET_DELTA_MAX_STREAMS 16
+#endif
+#endif
+
+/**
+ * @brief Size of a resync request payload: the message type, 32 bit little endian
+ */
+static constexpr size_t kArdPacketDeltaControlSize = 4;
+
+/**
+ * @brief First payload byte of a delta coded frame: keyframe bit and 7 bit sequence number
+ */
+static constexpr uint8_t kArdPacketDeltaKeyframe = 0x80;
+static constexpr uint8_t kArdPacketDeltaSequenceMask = 0x7F;
+
+/**
+ * @brief Delta coding configuration
+ */
+struct ArdPacketDeltaConfig
+{
+    /**
+     * @brief Message type bit marking delta coded frames
+     *
+     * A single bit within the message type field of the packet, such as 0x80 with one byte message types. Both ends
+     * must use the same bit and application message types must leave it clear.
+     */
+    uint32_t delta_flag = 0;
+
+    /**
+     * @brief Message type reserved for resync requests, with @c delta_flag clear
+     */
+    uint32_t control_message_type = 0;
+
+    /**
+     * @brief Maximum size of application payload
+     *
+     * Frames carry one byte more, so the packet @c max_payload_size must be larger.
+     */
+    size_t max_payload_size = 0;
+
+    /**
+     * @brief Message types delta coded by @c Send and decoded by @c Receive, up to @c ARD_PACKET_DELTA_MAX_STREAMS
+     *
+     * Each takes @c max_payload_size bytes of storage for its last payload. Other message types are sent raw. The
+     * receiver needs at least as many as the sender.
+     */
+    size_t tx_streams = 0;
+    size_t rx_streams = 0;
+
+    /**
+     * @brief Every this many frames of a message type one is a keyframe, 0 for keyframes on resync requests only
+     */
+    uint32_t keyframe_interval = 50;
+};
+
+/**
+ * @brief Delta coding of successive payloads per message type on top of @c ArdPacket
+ *
+ * Both ends keep the last payload of each message type. A payload of the same size is sent as a bitmap of the bytes
+ * that changed followed by their new values, or as a keyframe holding the whole payload when that is not shorter.
+ * Delta coded frames have @c delta_flag set in their message type and start with a keyframe bit and a sequence
+ * number, so raw frames share the stream and framing is unchanged.
+ *
+ * A delta whose previous frame was lost is dropped with @c kArdPacketStatusDeltaBaseMissing and the receiver sends
+ * a resync request, the sender then sends a keyframe. Periodic keyframes recover one way links.
+ */
+class ArdPacketDelta
+{
+   public:
+    explicit ArdPacketDelta(ArdPacket &packet) : m_packet(packet) {}
+
+    /**
+     * @brief Storage size needed for one frame each way and the last payload of every stream
+     *
+     * @param max_payload_size maximum size of application payload
+     * @param tx_streams
+     * @param rx_streams
+     * @return size in bytes
+     */
+    static size_t StorageSize(const size_t max_payload_size, const size_t tx_streams, const size_t rx_streams)
+    {
+        return 2 * FrameSize(max_payload_size) + (tx_streams + rx_streams) * max_payload_size;
+    }
+
+    /**
+     * @brief Configure delta coding (the packet must already be configured)
+     *
+     * @param config
+     * @param storage at least @c StorageSize bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketDeltaConfig &config, uint8_t *storage, size_t storage_size);
+
+    /**
+     * @brief Write payload to data stream, as a delta to the last one of its message type if that is shorter
+     *
+     * Like @c ArdPacket::SendPayload, call again with the same arguments while the frame is in progress.
+     *
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusInvalidMessageType for the control message type or a message type with the delta
+     * flag set, otherwise the status of @c SendPayload
+     */
+    eArdPacketStatus Send(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief Receive the next payload and undo its delta coding
+     *
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusDone when a payload is copied, @c kArdPacketStatusDeltaBaseMissing when a delta
+     * is dropped (a keyframe is requested), @c kArdPacketStatusNotAvailable otherwise
+     */
+    eArdPacketStatus Receive(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+
+    /**
+     * @brief Read resync requests and send pending ones
+     */
+    void Poll();
+
+    /**
+     * @brief Payload bytes given to @c Send and bytes sent for them, since @c Configure
+     */
+    uint32_t GetPayloadBytes() const
+    {
+        return m_payload_bytes;
+    }
+
+    uint32_t GetSentBytes() const
+    {
+        return m_sent_bytes;
+    }
+
+   private:
+    enum eArdPacketDeltaWrite
+    {
+        kArdPacketDeltaWriteNone,
+        kArdPacketDeltaWriteData,
+        kArdPacketDeltaWriteControl
+    };
+
+    // last payload of one message type
+    struct Stream
+    {
+        uint32_t message_type = 0;
+        size_t size = 0;
+        uint32_t deltas = 0;
+        uint8_t sequence = 0;
+        bool used = false;
+        bool base = false;
+        bool resync = false;
+    };
+
+    static size_t FrameSize(const size_t max_payload_size)
+    {
+        return (max_payload_size + 1 > kArdPacketDeltaControlSize ? max_payload_size + 1 : kArdPacketDeltaControlSize);
+    }
+
+    static void WriteUint32(uint32_t value, uint8_t *data);
+    static uint32_t ReadUint32(const uint8_t *data);
+    static size_t FindStream(const Stream *streams, size_t count, uint32_t message_type);
+    static bool ApplyDelta(const uint8_t *frame, size_t frame_size, uint8_t *base, size_t size);
+
+    void PrepareFrame(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+    void CommitFrame(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+    eArdPacketStatus DecodeFrame(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+    void PollRead();
+    void PollWrite();
+
+    // configuration
+    ArdPacketDeltaConfig m_config = {};
+    uint8_t *m_tx_frame = nullptr;
+    uint8_t *m_rx_frame = nullptr;
+    uint8_t *m_tx_bases = nullptr;
+    uint8_t *m_rx_bases = nullptr;
+
+    // last payloads
+    Stream m_tx_streams[ARD_PACKET_DELTA_MAX_STREAMS];
+    Stream m_rx_streams[ARD_PACKET_DELTA_MAX_STREAMS];
+
+    // frame being read, held until the application reads it
+    ArdPacketPayloadInfo m_read_info = {};
+    bool m_read_held = false;
+
+    // frame being written, coded into m_tx_frame or pointing at the raw payload
+    eArdPacketDeltaWrite m_write = kArdPacketDeltaWriteNone;
+    ArdPacketPayloadInfo m_write_info = {};
+    const uint8_t *m_write_payload = nullptr;
+    size_t m_write_stream = 0;
+    uint8_t m_control[kArdPacketDeltaControlSize] = {0};
+    uint32_t m_payload_bytes = 0;
+    uint32_t m_sent_bytes = 0;
+
+    // packet
+    ArdPacket &m_packet;
+};
+
+// inline methods
+
+inline eArdPacketConfigStatus ArdPacketDelta::Configure(const ArdPacketDeltaConfig &config, uint8_t *storage,
+                                                        const size_t storage_size)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    const size_t message_type_bits = 8 * static_cast<size_t>(m_packet.GetConfig().message_type_bytes);
+    const uint32_t flag = config.delta_flag;
+
+    if (config.max_payload_size == 0 || FrameSize(config.max_payload_size) > m_packet.GetConfig().max_payload_size)
+    {
+        status = kArdPacketConfigInvalidMaxPayloadSize;
+    }
+    else if (flag == 0 || (flag & (flag - 1)) != 0 || (message_type_bits < 32 && (flag >> message_type_bits) != 0) ||
+             (config.control_message_type & flag) != 0 || config.tx_streams + config.rx_streams == 0 ||
+             config.tx_streams > ARD_PACKET_DELTA_MAX_STREAMS || config.rx_streams > ARD_PACKET_DELTA_MAX_STREAMS)
+    {
+        status = kArdPacketConfigInvalidDelta;
+    }
+    else if (storage == nullptr ||
+             storage_size < StorageSize(config.max_payload_size, config.tx_streams, config.rx_streams))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else
+    {
+        const size_t frame_size = FrameSize(config.max_payload_size);
+        m_config = config;
+        m_tx_frame = storage;
+        m_rx_frame = &storage[frame_size];
+        m_tx_bases = &storage[2 * frame_size];
+        m_rx_bases = &m_tx_bases[config.tx_streams * config.max_payload_size];
+
+        for (size_t index = 0; index < ARD_PACKET_DELTA_MAX_STREAMS; ++index)
+        {
+            m_tx_streams[index] = Stream();
+            m_rx_streams[index] = Stream();
+        }
+        m_read_held = false;
+        m_write = kArdPacketDeltaWriteNone;
+        m_payload_bytes = 0;
+        m_sent_bytes = 0;
+    }
+
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketDelta::Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_tx_frame == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if ((info.message_type & m_config.delta_flag) != 0 || info.message_type == m_config.control_message_type)
+    {
+        status = kArdPacketStatusInvalidMessageType;
+    }
+    else if (info.payload_size > m_config.max_payload_size)
+    {
+        status = kArdPacketStatusInvalidPayloadSize;
+    }
+    else
+    {
+        if (m_write != kArdPacketDeltaWriteData)
+        {
+            Poll();
+        }
+
+        if (m_write == kArdPacketDeltaWriteControl)
+        {
+            // resync request still waiting for room in the stream
+            status = kArdPacketStatusNotAvailable;
+        }
+        else
+        {
+            if (m_write == kArdPacketDeltaWriteNone)
+            {
+                PrepareFrame(info, payload);
+            }
+            status = m_packet.SendPayload(m_write_info, m_write_payload);
+            const bool written = (status == kArdPacketStatusDone || status == kArdPacketStatusHeaderInProgress ||
+                                  status == kArdPacketStatusPayloadInProgress);
+            if (written && m_write == kArdPacketDeltaWriteNone)
+            {
+                // the receiver moves on once the first byte is on the stream
+                CommitFrame(info, payload);
+            }
+            m_write = (written && status != kArdPacketStatusDone ? kArdPacketDeltaWriteData
+                                                                 : kArdPacketDeltaWriteNone);
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketDelta::Receive(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusNotAvailable;
+    if (m_rx_frame == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else
+    {
+        PollRead();
+        if (m_read_held)
+        {
+            status = DecodeFrame(max_payload_size, info, payload);
+            m_read_held = false;
+        }
+        PollWrite();
+    }
+    return status;
+}
+
+inline void ArdPacketDelta::Poll()
+{
+    if (m_rx_frame != nullptr)
+    {
+        PollRead();
+        PollWrite();
+    }
+}
+
+// Private inline methods
+// ----------------------
+
+inline void ArdPacketDelta::WriteUint32(const uint32_t value, uint8_t *data)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline uint32_t ArdPacketDelta::ReadUint32(const uint8_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline size_t ArdPacketDelta::FindStream(const Stream *streams, const size_t count, const uint32_t message_type)
+{
+    // the stream of the message type, otherwise the first free one, otherwise count
+    size_t found = count;
+    size_t free = count;
+    for (size_t index = 0; index < count && found == count; ++index)
+    {
+        found = (streams[index].used && streams[index].message_type == message_type ? index : count);
+        free = (!streams[index].used && free == count ? index : free);
+    }
+    return (found < count ? found : free);
+}
+
+inline bool ArdPacketDelta::ApplyDelta(const uint8_t *frame, const size_t frame_size, uint8_t *base,
+                                       const size_t size)
+{
+    // bitmap of changed bytes, then their new values
+    const size_t mask_size = (size + 7) / 8;
+    size_t index = 1 + mask_size;
+    bool valid = (frame_size >= index);
+    for (size_t k = 0; k < size && valid; ++k)
+    {
+        if ((frame[1 + k / 8] & (1U << (k % 8))) != 0)
+        {
+            valid = (index < frame_size);
+            base[k] = (valid ? frame[index++] : base[k]);
+        }
+    }
+    return (valid && index == frame_size);
+}
+
+inline void ArdPacketDelta::PrepareFrame(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    m_write_info = info;
+    m_write_payload = payload;
+    m_write_stream = FindStream(m_tx_streams, m_config.tx_streams, info.message_type);
+    if (m_write_stream < m_config.tx_streams && info.payload_size > 0)
+    {
+        const Stream &stream = m_tx_streams[m_write_stream];
+        const uint8_t *base = &m_tx_bases[m_write_stream * m_config.max_payload_size];
+        const uint8_t sequence = static_cast<uint8_t>((stream.sequence + 1) & kArdPacketDeltaSequenceMask);
+        bool keyframe = (!stream.used || stream.resync || stream.size != info.payload_size ||
+                         (m_config.keyframe_interval != 0 && stream.deltas + 1 >= m_config.keyframe_interval));
+        size_t frame_size = 0;
+        if (!keyframe)
+        {
+            // give up once the delta is no shorter than a keyframe
+            const size_t mask_size = (info.payload_size + 7) / 8;
+            memset(&m_tx_frame[1], 0, mask_size);
+            frame_size = 1 + mask_size;
+            for (size_t k = 0; k < info.payload_size && frame_size <= info.payload_size; ++k)
+            {
+                if (payload[k] != base[k])
+                {
+                    m_tx_frame[1 + k / 8] |= static_cast<uint8_t>(1U << (k % 8));
+                    m_tx_frame[frame_size++] = payload[k];
+                }
+            }
+            keyframe = (frame_size > info.payload_size);
+        }
+        if (keyframe)
+        {
+            m_tx_frame[0] = static_cast<uint8_t>(kArdPacketDeltaKeyframe | sequence);
+            memcpy(&m_tx_frame[1], payload, info.payload_size);
+            frame_size = 1 + info.payload_size;
+        }
+        else
+        {
+            m_tx_frame[0] = sequence;
+        }
+        m_write_info.message_type |= m_config.delta_flag;
+        m_write_info.payload_size = frame_size;
+        m_write_payload = m_tx_frame;
+    }
+    else
+    {
+        m_write_stream = m_config.tx_streams;
+    }
+}
+
+inline void ArdPacketDelta::CommitFrame(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    m_payload_bytes += static_cast<uint32_t>(info.payload_size);
+    m_sent_bytes += static_cast<uint32_t>(m_write_info.payload_size);
+    if (m_write_stream < m_config.tx_streams)
+    {
+        Stream &stream = m_tx_streams[m_write_stream];
+        const bool keyframe = ((m_tx_frame[0] & kArdPacketDeltaKeyframe) != 0);
+        stream.message_type = info.message_type;
+        stream.size = info.payload_size;
+        stream.deltas = (keyframe ? 0 : stream.deltas + 1);
+        stream.sequence = (m_tx_frame[0] & kArdPacketDeltaSequenceMask);
+        stream.used = true;
+        stream.resync = false;
+        memcpy(&m_tx_bases[m_write_stream * m_config.max_payload_size], payload, info.payload_size);
+    }
+}
+
+inline eArdPacketStatus ArdPacketDelta::DecodeFrame(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                    uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusDone;
+    const uint8_t *data = m_rx_frame;
+    info = m_read_info;
+    if ((m_read_info.message_type & m_config.delta_flag) != 0)
+    {
+        info.message_type &= ~m_config.delta_flag;
+        info.payload_size = 0;
+        const size_t index = FindStream(m_rx_streams, m_config.rx_streams, info.message_type);
+        const size_t frame_size = m_read_info.payload_size;
+        const bool keyframe = (frame_size > 1 && (m_rx_frame[0] & kArdPacketDeltaKeyframe) != 0 &&
+                               frame_size - 1 <= m_config.max_payload_size);
+        bool applied = false;
+        if (index < m_config.rx_streams)
+        {
+            Stream &stream = m_rx_streams[index];
+            uint8_t *base = &m_rx_bases[index * m_config.max_payload_size];
+            const uint8_t sequence = (frame_size > 0 ? (m_rx_frame[0] & kArdPacketDeltaSequenceMask) : 0);
+            if (keyframe)
+            {
+                stream.size = frame_size - 1;
+                memcpy(base, &m_rx_frame[1], stream.size);
+                applied = true;
+            }
+            else if (frame_size > 0 && stream.base &&
+                     sequence == ((stream.sequence + 1) & kArdPacketDeltaSequenceMask))
+            {
+                applied = ApplyDelta(m_rx_frame, frame_size, base, stream.size);
+            }
+
+            // without its base no later delta applies either, until a keyframe
+            stream.message_type = info.message_type;
+            stream.sequence = sequence;
+            stream.used = true;
+            stream.base = applied;
+            stream.resync = !applied;
+            data = base;
+            info.payload_size = (applied ? stream.size : 0);
+        }
+        status = (applied ? kArdPacketStatusDone : kArdPacketStatusDeltaBaseMissing);
+    }
+
+    if (status == kArdPacketStatusDone)
+    {
+        status = (info.payload_size <= max_payload_size ? kArdPacketStatusDone : kArdPacketStatusInvalidPayloadSize);
+    }
+    if (status == kArdPacketStatusDone)
+    {
+        memcpy(payload, data, info.payload_size);
+    }
+    return status;
+}
+
+inline void ArdPacketDelta::PollRead()
+{
+    // stop at the first data frame so the rest stays in the stream until the application reads
+    bool continue_read = !m_read_held;
+    while (continue_read)
+    {
+        const eArdPacketStatus status =
+            m_packet.ReceivePayload(FrameSize(m_config.max_payload_size), m_read_info, m_rx_frame);
+        if (status == kArdPacketStatusDone && m_read_info.message_type == m_config.control_message_type)
+        {
+            if (m_read_info.payload_size == kArdPacketDeltaControlSize)
+            {
+                // the next frame of the message type is a keyframe
+                const size_t index = FindStream(m_tx_streams, m_config.tx_streams, ReadUint32(m_rx_frame));
+                if (index < m_config.tx_streams && m_tx_streams[index].used)
+                {
+                    m_tx_streams[index].resync = true;
+                }
+            }
+        }
+        else if (status == kArdPacketStatusDone)
+        {
+            m_read_held = true;
+        }
+        // errors consume bytes, keep reading what is left
+        continue_read = (!m_read_held && ArdPacketStatusFrameConsumed(status));
+    }
+}
+
+inline void ArdPacketDelta::PollWrite()
+{
+    if (m_write == kArdPacketDeltaWriteNone)
+    {
+        // one resync request at a time, the next one on a later poll
+        for (size_t index = 0; index < m_config.rx_streams && m_write == kArdPacketDeltaWriteNone; ++index)
+        {
+            if (m_rx_streams[index].resync)
+            {
+                WriteUint32(m_rx_streams[index].message_type, m_control);
+                m_rx_streams[index].resync = false;
+                m_write = kArdPacketDeltaWriteControl;
+            }
+        }
+    }
+    if (m_write == kArdPacketDeltaWriteControl)
+    {
+        ArdPacketPayloadInfo control_info;
+        control_info.message_type = m_config.control_message_type;
+        control_info.payload_size = kArdPacketDeltaControlSize;
+        const eArdPacketStatus status = m_packet.SendPayload(control_info, m_control);
+        if (status == kArdPacketStatusDone)
+        {
+            m_write = kArdPacketDeltaWriteNone;
+        }
+        else if (status != kArdPacketStatusHeaderInProgress && status != kArdPacketStatusPayloadInProgress &&
+                 status != kArdPacketStatusNotAvailable && status != kArdPacketStatusNotEnoughAvailable)
+        {
+            // frame cannot be sent with this packet configuration
+            m_packet.ResetWrite();
+            m_write = kArdPacketDeltaWriteNone;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,247 @@
+
+#ifndef ARD_PACKET_DISPATCH_H
+#define ARD_PACKET_DISPATCH_H
+
+#include <stdint.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Message handler called with a received payload
+ */
+using ArdPacketDispatchCallback = void (*)(const ArdPacketPayloadInfo &info, const uint8_t *payload, void *context);
+
+/**
+ * @brief Slot of the dispatch table
+ */
+struct ArdPacketDispatchEntry
+{
+    uint32_t message_type = 0;
+    size_t max_payload_size = 0;
+    ArdPacketDispatchCallback callback = nullptr;
+    void *context = nullptr;
+};
+
+/**
+ * @brief Message type dispatch table with early discard of unsubscribed payloads
+ *
+ * Handlers are registered per message type with their own payload size limit. The packet consults the table once
+ * the header is read, so payloads of types without a handler are skipped without being copied, which keeps nodes on
+ * a shared bus from spending time on traffic for other nodes. Payloads larger than the limit of their type are
+ * dropped as @c kArdPacketStatusInvalidPayloadSize.
+ *
+ * With one entry per message type value (256 for 1 byte message types) the table is indexed directly, otherwise it
+ * is a hash table with linear probing.
+ */
+class ArdPacketDispatch : public ArdPacketReceiveFilter
+{
+   public:
+    explicit ArdPacketDispatch(ArdPacket &packet) : m_packet(packet) {}
+
+    /**
+     * @brief Configure the table and attach it to the packet (the packet must already be configured)
+     *
+     * @param entries table owned by the caller
+     * @param count number of entries, at least the number of message types to subscribe
+     * @param storage receive buffer of at least the largest subscribed payload, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(ArdPacketDispatchEntry *entries, size_t count, uint8_t *storage,
+                                     size_t storage_size);
+
+    /**
+     * @brief Register the handler of a message type, replacing the previous one
+     *
+     * @param message_type
+     * @param max_payload_size largest payload accepted, up to the storage size
+     * @param callback
+     * @param context passed to @c callback
+     * @return false if the table is full or the size is out of range
+     */
+    bool Subscribe(uint32_t message_type, size_t max_payload_size, ArdPacketDispatchCallback callback,
+                   void *context = nullptr);
+
+    /**
+     * @brief Remove the handler of a message type, its payloads are skipped from now on
+     *
+     * @param message_type
+     * @return false if the type had no handler
+     */
+    bool Unsubscribe(uint32_t message_type);
+
+    /**
+     * @brief Receive available packets and call their handlers, call from the main loop
+     *
+     * @return number of payloads dispatched
+     */
+    size_t Poll();
+
+    /**
+     * @brief Number of payloads skipped because their type has no handler
+     */
+    uint32_t Skipped() const
+    {
+        return m_skipped;
+    }
+
+    size_t MaxPayloadSize(uint32_t message_type) override;
+
+   private:
+    static constexpr size_t kArdPacketDispatchNotFound = SIZE_MAX;
+
+    size_t Home(uint32_t message_type) const;
+    size_t Find(uint32_t message_type) const;
+
+    ArdPacket &m_packet;
+    ArdPacketDispatchEntry *m_entries = nullptr;
+    size_t m_count = 0;
+    bool m_direct = false;
+    uint8_t *m_payload = nullptr;
+    size_t m_payload_size = 0;
+    ArdPacketPayloadInfo m_info = {};
+    uint32_t m_skipped = 0;
+};
+
+// inline methods
+
+inline eArdPacketConfigStatus ArdPacketDispatch::Configure(ArdPacketDispatchEntry *entries, const size_t count,
+                                                           uint8_t *storage, const size_t storage_size)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    if (entries == nullptr || count == 0 || storage == nullptr || storage_size == 0)
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else
+    {
+        m_entries = entries;
+        m_count = count;
+        m_direct = (m_packet.GetConfig().message_type_bytes == 1 && count > UINT8_MAX);
+        for (size_t index = 0; index < count; ++index)
+        {
+            m_entries[index] = ArdPacketDispatchEntry();
+        }
+        m_payload = storage;
+        m_payload_size = storage_size;
+        m_skipped = 0;
+        m_packet.SetReceiveFilter(this);
+    }
+    return status;
+}
+
+inline bool ArdPacketDispatch::Subscribe(const uint32_t message_type, const size_t max_payload_size,
+                                         const ArdPacketDispatchCallback callback, void *context)
+{
+    bool subscribed = false;
+    size_t index = Find(message_type);
+    if (index == kArdPacketDispatchNotFound && m_count > 0 && !m_direct)
+    {
+        // first free slot from the home slot
+        index = Home(message_type);
+        for (size_t probe = 0; probe < m_count && m_entries[index].callback != nullptr; ++probe)
+        {
+            index = (index + 1) % m_count;
+        }
+        index = (m_entries[index].callback == nullptr ? index : kArdPacketDispatchNotFound);
+    }
+    else if (index == kArdPacketDispatchNotFound && m_direct && message_type <= UINT8_MAX)
+    {
+        index = message_type;
+    }
+
+    if (index != kArdPacketDispatchNotFound && callback != nullptr && max_payload_size > 0 &&
+        max_payload_size <= m_payload_size)
+    {
+        m_entries[index].message_type = message_type;
+        m_entries[index].max_payload_size = max_payload_size;
+        m_entries[index].callback = callback;
+        m_entries[index].context = context;
+        subscribed = true;
+    }
+    return subscribed;
+}
+
+inline bool ArdPacketDispatch::Unsubscribe(const uint32_t message_type)
+{
+    size_t index = Find(message_type);
+    const bool found = (index != kArdPacketDispatchNotFound);
+    if (found)
+    {
+        m_entries[index] = ArdPacketDispatchEntry();
+    }
+    if (found && !m_direct)
+    {
+        // move later entries of the probe sequence into the gap
+        size_t next = (index + 1) % m_count;
+        while (m_entries[next].callback != nullptr)
+        {
+            const size_t home = Home(m_entries[next].message_type);
+            const bool movable = (index <= next ? (home <= index || home > next) : (home <= index && home > next));
+            if (movable)
+            {
+                m_entries[index] = m_entries[next];
+                m_entries[next] = ArdPacketDispatchEntry();
+                index = next;
+            }
+            next = (next + 1) % m_count;
+        }
+    }
+    return found;
+}
+
+inline size_t ArdPacketDispatch::Poll()
+{
+    size_t dispatched = 0;
+    bool continue_read = (m_entries != nullptr);
+    while (continue_read)
+    {
+        const eArdPacketStatus status = m_packet.ReceivePayload(m_payload_size, m_info, m_payload);
+        const size_t index = (status == kArdPacketStatusDone ? Find(m_info.message_type) : kArdPacketDispatchNotFound);
+        if (index != kArdPacketDispatchNotFound)
+        {
+            m_entries[index].callback(m_info, m_payload, m_entries[index].context);
+            dispatched++;
+        }
+        else if (status == kArdPacketStatusSkipped)
+        {
+            m_skipped++;
+        }
+        continue_read = ArdPacketStatusFrameConsumed(status);
+    }
+    return dispatched;
+}
+
+inline size_t ArdPacketDispatch::MaxPayloadSize(const uint32_t message_type)
+{
+    const size_t index = Find(message_type);
+    return (index != kArdPacketDispatchNotFound ? m_entries[index].max_payload_size : 0);
+}
+
+inline size_t ArdPacketDispatch::Home(const uint32_t message_type) const
+{
+    // multiplicative hash spreads clustered message types
+    return static_cast<size_t>((message_type * UINT32_C(2654435769)) % m_count);
+}
+
+inline size_t ArdPacketDispatch::Find(const uint32_t message_type) const
+{
+    size_t found = kArdPacketDispatchNotFound;
+    if (m_direct)
+    {
+        found = (message_type < m_count && m_entries[message_type].callback != nullptr ? message_type : found);
+    }
+    else if (m_count > 0)
+    {
+        size_t index = Home(message_type);
+        for (size_t probe = 0;
+             probe < m_count && m_entries[index].callback != nullptr && found == kArdPacketDispatchNotFound; ++probe)
+        {
+            found = (m_entries[index].message_type == message_type ? index : found);
+            index = (index + 1) % m_count;
+        }
+    }
+    return found;
+}
+
+#endif
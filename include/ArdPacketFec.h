@@ -0,0 +1,699 @@
+
+#ifndef ARD_PACKET_FEC_H
+#define ARD_PACKET_FEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdCrc.h"
+
+/**
+ * @brief Reed-Solomon forward error correction of a packet body
+ *
+ * The packet body is the message type, payload size, optional header CRC, payload and optional payload CRC. The
+ * header fields form one block, the payload and payload CRC are split into blocks of a configured size. Each block
+ * is sent unchanged followed by its parity bytes (systematic RS code over GF(256), shortened to the block size),
+ * so up to half the number of parity bytes of corrupted bytes can be corrected in every block.
+ *
+ * The CRCs are checked after correction and stay the final check.
+ */
+
+/**
+ * @brief Enable forward error correction
+ *
+ * Disabled on AVR where the Galois field tables would take more than a third of the RAM.
+ */
+#ifndef ARD_PACKET_FEC
+#if defined(__AVR__)
+#define ARD_PACKET_FEC 0
+#else
+#define ARD_PACKET_FEC 1
+#endif
+#endif
+
+/**
+ * @brief Largest block size (data bytes per block)
+ */
+#ifndef ARD_PACKET_FEC_MAX_BLOCK_SIZE
+#define ARD_PACKET_FEC_MAX_BLOCK_SIZE 64
+#endif
+
+/**
+ * @brief Largest number of parity bytes per block
+ */
+static constexpr size_t kArdPacketFecMaxParityBytes = 16;
+
+/**
+ * @brief Largest block size (data bytes per block)
+ */
+static constexpr size_t kArdPacketFecMaxBlockSize = ARD_PACKET_FEC_MAX_BLOCK_SIZE;
+
+/**
+ * @brief Maximum size of message type, payload size and header CRC fields
+ */
+static constexpr size_t kArdPacketFecMaxHeaderSize = 10;
+
+/**
+ * @brief Size of the payload CRC trailer
+ */
+static constexpr size_t kArdPacketFecTrailerSize = 2;
+
+/**
+ * @brief Largest codeword of a shortened RS code over GF(256)
+ */
+static constexpr size_t kArdPacketFecMaxCodewordSize = 255;
+
+static_assert(kArdPacketFecMaxBlockSize >= kArdPacketFecMaxHeaderSize, "FEC block must hold the header fields");
+static_assert(kArdPacketFecMaxBlockSize + kArdPacketFecMaxParityBytes <= kArdPacketFecMaxCodewordSize,
+              "FEC block and parity must fit a codeword");
+
+/**
+ * @brief Decoder events
+ */
+enum eArdPacketFecEvent
+{
+    kArdPacketFecNeedMore = 0,
+    kArdPacketFecHeader,
+    kArdPacketFecDone,
+    kArdPacketFecUncorrectable
+};
+
+/**
+ * @brief GF(256) exponent and logarithm tables (primitive polynomial 0x11D)
+ */
+struct ArdPacketFecTables
+{
+    ArdPacketFecTables()
+    {
+        unsigned value = 1;
+        for (size_t k = 0; k < 255; ++k)
+        {
+            exp[k] = static_cast<uint8_t>(value);
+            exp[k + 255] = static_cast<uint8_t>(value);
+            log[value] = static_cast<uint8_t>(k);
+            value <<= 1;
+            if (value & 0x100)
+            {
+                value ^= 0x11D;
+            }
+        }
+        log[0] = 0;
+    }
+
+    uint8_t exp[2 * 255] = {0};
+    uint8_t log[256] = {0};
+};
+
+/**
+ * @brief Shared GF(256) tables, built on first use
+ */
+inline const ArdPacketFecTables &ArdPacketFecGetTables()
+{
+    static const ArdPacketFecTables tables;
+    return tables;
+}
+
+/**
+ * @brief Multiply in GF(256)
+ */
+inline uint8_t ArdPacketFecMultiply(const uint8_t a, const uint8_t b)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    return (a == 0 || b == 0) ? 0 : tables.exp[tables.log[a] + tables.log[b]];
+}
+
+/**
+ * @brief Size of a body of @c body_size bytes (header fields excluded) once encoded
+ *
+ * @param header_size size of header fields
+ * @param body_size size of payload and payload CRC
+ * @param parity_bytes parity bytes per block
+ * @param block_size data bytes per block
+ */
+inline size_t ArdPacketFecEncodedSize(const size_t header_size, const size_t body_size, const size_t parity_bytes,
+                                      const size_t block_size)
+{
+    const size_t blocks = (body_size + block_size - 1) / block_size;
+    return header_size + parity_bytes + body_size + blocks * parity_bytes;
+}
+
+/**
+ * @brief Compute the RS generator polynomial with roots 1, a, ..., a^(parity_bytes - 1)
+ *
+ * @param parity_bytes number of parity bytes
+ * @param generator log of coefficients, highest degree first (@c parity_bytes + 1 values, leading 1 included)
+ */
+inline void ArdPacketFecGenerator(const size_t parity_bytes, uint8_t *generator)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    uint8_t poly[kArdPacketFecMaxParityBytes + 1] = {1};
+    for (size_t root = 0; root < parity_bytes; ++root)
+    {
+        // multiply by (x + a^root)
+        for (size_t k = root + 1; k > 0; --k)
+        {
+            poly[k] ^= ArdPacketFecMultiply(poly[k - 1], tables.exp[root]);
+        }
+    }
+    for (size_t k = 0; k <= parity_bytes; ++k)
+    {
+        generator[k] = tables.log[poly[k]];
+    }
+}
+
+/**
+ * @brief Update parity with data bytes of a block
+ *
+ * Parity starts zeroed for each block and holds the parity bytes once every data byte of the block is added.
+ *
+ * @param generator log of generator coefficients from @c ArdPacketFecGenerator
+ * @param parity_bytes number of parity bytes
+ * @param parity parity (remainder) register
+ * @param data data bytes
+ * @param size number of data bytes
+ */
+inline void ArdPacketFecUpdate(const uint8_t *generator, const size_t parity_bytes, uint8_t *parity,
+                               const uint8_t *data, const size_t size)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    for (size_t i = 0; i < size; ++i)
+    {
+        const uint8_t feedback = data[i] ^ parity[0];
+        memmove(parity, &parity[1], parity_bytes - 1);
+        parity[parity_bytes - 1] = 0;
+        if (feedback != 0)
+        {
+            const unsigned log_feedback = tables.log[feedback];
+            for (size_t k = 0; k < parity_bytes; ++k)
+            {
+                parity[k] ^= tables.exp[log_feedback + generator[k + 1]];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compute syndromes of a codeword
+ *
+ * @param codeword data bytes followed by parity bytes
+ * @param size codeword size
+ * @param parity_bytes number of parity bytes
+ * @param syndromes @c parity_bytes syndromes
+ * @return true if any syndrome is not zero
+ */
+inline bool ArdPacketFecSyndromes(const uint8_t *codeword, const size_t size, const size_t parity_bytes,
+                                  uint8_t *syndromes)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    bool has_errors = false;
+    for (size_t j = 0; j < parity_bytes; ++j)
+    {
+        // evaluate codeword at a^j
+        uint8_t value = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            value = (value == 0 ? 0 : tables.exp[tables.log[value] + j]) ^ codeword[i];
+        }
+        syndromes[j] = value;
+        has_errors = has_errors || (value != 0);
+    }
+    return has_errors;
+}
+
+/**
+ * @brief Compute the error locator polynomial (Berlekamp-Massey)
+ *
+ * @param syndromes syndromes
+ * @param parity_bytes number of parity bytes
+ * @param locator @c parity_bytes + 1 coefficients, lowest degree first
+ * @return number of errors (degree of the locator)
+ */
+inline size_t ArdPacketFecLocator(const uint8_t *syndromes, const size_t parity_bytes, uint8_t *locator)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    uint8_t previous[kArdPacketFecMaxParityBytes + 1] = {1};
+    uint8_t saved[kArdPacketFecMaxParityBytes + 1] = {0};
+    memset(locator, 0, parity_bytes + 1);
+    locator[0] = 1;
+    size_t errors = 0;
+    size_t shift = 1;
+    uint8_t previous_discrepancy = 1;
+    for (size_t r = 0; r < parity_bytes; ++r)
+    {
+        uint8_t discrepancy = syndromes[r];
+        for (size_t i = 1; i <= errors; ++i)
+        {
+            discrepancy ^= ArdPacketFecMultiply(locator[i], syndromes[r - i]);
+        }
+        if (discrepancy != 0)
+        {
+            const uint8_t scale = tables.exp[tables.log[discrepancy] + 255 - tables.log[previous_discrepancy]];
+            memcpy(saved, locator, parity_bytes + 1);
+            for (size_t i = shift; i <= parity_bytes; ++i)
+            {
+                locator[i] ^= ArdPacketFecMultiply(scale, previous[i - shift]);
+            }
+            if (2 * errors <= r)
+            {
+                errors = r + 1 - errors;
+                memcpy(previous, saved, parity_bytes + 1);
+                previous_discrepancy = discrepancy;
+                shift = 0;
+            }
+        }
+        shift++;
+    }
+    return errors;
+}
+
+/**
+ * @brief Evaluate a polynomial (lowest degree first) at a^power
+ */
+inline uint8_t ArdPacketFecEvaluate(const uint8_t *poly, const size_t degree, const size_t power)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    uint8_t value = 0;
+    for (size_t k = 0; k <= degree; ++k)
+    {
+        if (poly[k] != 0)
+        {
+            value ^= tables.exp[(tables.log[poly[k]] + power * k) % 255];
+        }
+    }
+    return value;
+}
+
+/**
+ * @brief Correct a codeword in place
+ *
+ * @param codeword data bytes followed by parity bytes
+ * @param size codeword size (at most 255)
+ * @param parity_bytes number of parity bytes
+ * @return number of corrected bytes, or -1 when the codeword cannot be corrected
+ */
+inline int ArdPacketFecCorrect(uint8_t *codeword, const size_t size, const size_t parity_bytes)
+{
+    const ArdPacketFecTables &tables = ArdPacketFecGetTables();
+    int result = 0;
+
+    uint8_t syndromes[kArdPacketFecMaxParityBytes] = {0};
+    uint8_t locator[kArdPacketFecMaxParityBytes + 1] = {0};
+    size_t errors = 0;
+    if (ArdPacketFecSyndromes(codeword, size, parity_bytes, syndromes))
+    {
+        errors = ArdPacketFecLocator(syndromes, parity_bytes, locator);
+        result = (2 * errors <= parity_bytes ? 0 : -1);
+    }
+
+    if (errors > 0 && result == 0)
+    {
+        // error evaluator: syndromes * locator mod x^parity_bytes
+        uint8_t evaluator[kArdPacketFecMaxParityBytes] = {0};
+        for (size_t k = 0; k < parity_bytes; ++k)
+        {
+            for (size_t i = 0; i <= k && i <= errors; ++i)
+            {
+                evaluator[k] ^= ArdPacketFecMultiply(locator[i], syndromes[k - i]);
+            }
+        }
+        // formal derivative of the locator: odd terms, lowest degree first
+        uint8_t derivative[kArdPacketFecMaxParityBytes] = {0};
+        for (size_t k = 1; k <= errors; k += 2)
+        {
+            derivative[k - 1] = locator[k];
+        }
+
+        // roots of the locator (Chien search) and error values (Forney)
+        size_t corrected = 0;
+        for (size_t i = 0; i < size && result == 0; ++i)
+        {
+            // byte i has locator a^power, evaluate at its inverse
+            const size_t power = size - 1 - i;
+            const size_t inverse = (255 - power) % 255;
+            if (ArdPacketFecEvaluate(locator, errors, inverse) == 0)
+            {
+                const uint8_t numerator = ArdPacketFecEvaluate(evaluator, parity_bytes - 1, inverse);
+                const uint8_t denominator = ArdPacketFecEvaluate(derivative, errors - 1, inverse);
+                if (denominator == 0)
+                {
+                    result = -1;
+                }
+                else if (numerator != 0)
+                {
+                    codeword[i] ^= tables.exp[(power + tables.log[numerator] + 255 - tables.log[denominator]) % 255];
+                }
+                corrected++;
+            }
+        }
+        if (result == 0)
+        {
+            result = (corrected == errors ? static_cast<int>(corrected) : -1);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Streaming RS encoder
+ *
+ * Header fields are copied into the encoder. The payload is read in place and the payload CRC is updated while
+ * encoding so the body is read exactly once.
+ */
+class ArdPacketFecEncoder
+{
+   public:
+    ArdPacketFecEncoder() = default;
+
+    /**
+     * @brief Start encoding a new body
+     *
+     * @param header message type, payload size and optional header CRC
+     * @param header_size size of @c header
+     * @param payload_size size of payload
+     * @param crc append payload CRC
+     * @param parity_bytes parity bytes per block
+     * @param block_size data bytes per payload block
+     */
+    void Begin(const uint8_t *header, size_t header_size, size_t payload_size, bool crc, size_t parity_bytes,
+               size_t block_size);
+
+    /**
+     * @brief Encode up to @c max_size bytes
+     *
+     * @param payload payload (same pointer for every call of the body)
+     * @param encoded output
+     * @param max_size maximum output size
+     * @return number of encoded bytes
+     */
+    size_t Encode(const uint8_t *payload, uint8_t *encoded, size_t max_size);
+
+    /**
+     * @brief All bytes encoded
+     */
+    bool Done() const
+    {
+        return m_done;
+    }
+
+   private:
+    const uint8_t *Segment(const uint8_t *payload, size_t index, size_t &size) const;
+
+    uint8_t m_header[kArdPacketFecMaxHeaderSize] = {0};
+    uint8_t m_trailer[kArdPacketFecTrailerSize] = {0};
+    uint8_t m_generator[kArdPacketFecMaxParityBytes + 1] = {0};
+    uint8_t m_parity[kArdPacketFecMaxParityBytes] = {0};
+    size_t m_header_size = 0;
+    size_t m_payload_end = 0;
+    size_t m_body_size = 0;
+    size_t m_index = 0;
+    size_t m_block_end = 0;
+    size_t m_parity_index = 0;
+    size_t m_parity_bytes = 0;
+    size_t m_block_size = 0;
+    crc_t m_crc_value = 0;
+    bool m_crc = false;
+    bool m_done = true;
+};
+
+/**
+ * @brief Streaming RS decoder
+ *
+ * Each block is collected and corrected before its bytes are passed on. Decoding stops with
+ * @c kArdPacketFecHeader once the header block is corrected so the caller can validate it and set the payload size.
+ */
+class ArdPacketFecDecoder
+{
+   public:
+    ArdPacketFecDecoder() = default;
+
+    /**
+     * @brief Start decoding a new body (the delimiter has already been read)
+     *
+     * @param header_size size of message type, payload size and optional header CRC
+     * @param crc payload CRC is appended
+     * @param parity_bytes parity bytes per block
+     * @param block_size data bytes per payload block
+     */
+    void Begin(size_t header_size, bool crc, size_t parity_bytes, size_t block_size);
+
+    /**
+     * @brief Set payload size after @c kArdPacketFecHeader
+     */
+    void SetPayloadSize(size_t payload_size);
+
+    /**
+     * @brief Decode encoded bytes
+     *
+     * Stops after the block completing the header or the body, so reading at most @c RemainingEncoded bytes
+     * guarantees every byte is consumed.
+     *
+     * @param encoded encoded bytes
+     * @param encoded_size number of encoded bytes
+     * @param payload payload output
+     * @param consumed number of encoded bytes consumed
+     * @return event
+     */
+    eArdPacketFecEvent Decode(const uint8_t *encoded, size_t encoded_size, uint8_t *payload, size_t &consumed);
+
+    /**
+     * @brief Corrected header fields
+     */
+    const uint8_t *Header() const
+    {
+        return m_header;
+    }
+
+    /**
+     * @brief CRC of payload and trailer, zero when the payload CRC passed
+     */
+    crc_t PayloadCrc() const
+    {
+        return crc_finalize(m_crc_value);
+    }
+
+    /**
+     * @brief Number of encoded bytes left before the next event
+     */
+    size_t RemainingEncoded() const
+    {
+        return m_block_data_size + m_parity_bytes - m_block_index;
+    }
+
+    /**
+     * @brief Number of bytes corrected since @c Begin
+     */
+    size_t Corrected() const
+    {
+        return m_corrected;
+    }
+
+   private:
+    eArdPacketFecEvent FinishBlock(uint8_t *payload);
+
+    uint8_t m_block[kArdPacketFecMaxBlockSize + kArdPacketFecMaxParityBytes] = {0};
+    uint8_t m_header[kArdPacketFecMaxHeaderSize] = {0};
+    uint8_t m_trailer[kArdPacketFecTrailerSize] = {0};
+    size_t m_header_size = 0;
+    size_t m_payload_size = 0;
+    size_t m_body_size = 0;
+    size_t m_body_index = 0;
+    size_t m_block_index = 0;
+    size_t m_block_data_size = 0;
+    size_t m_parity_bytes = 0;
+    size_t m_block_size = 0;
+    size_t m_corrected = 0;
+    crc_t m_crc_value = 0;
+    bool m_crc = false;
+    bool m_header_done = false;
+};
+
+// Encoder
+
+inline void ArdPacketFecEncoder::Begin(const uint8_t *header, const size_t header_size, const size_t payload_size,
+                                       const bool crc, const size_t parity_bytes, const size_t block_size)
+{
+    memcpy(m_header, header, header_size);
+    m_header_size = header_size;
+    m_payload_end = header_size + payload_size;
+    m_body_size = m_payload_end + (crc ? kArdPacketFecTrailerSize : 0);
+    m_index = 0;
+    m_block_end = header_size;
+    m_parity_index = parity_bytes;
+    m_parity_bytes = parity_bytes;
+    m_block_size = block_size;
+    m_crc = crc;
+    m_crc_value = crc_init();
+    m_done = false;
+    ArdPacketFecGenerator(parity_bytes, m_generator);
+    memset(m_parity, 0, parity_bytes);
+}
+
+inline const uint8_t *ArdPacketFecEncoder::Segment(const uint8_t *payload, const size_t index, size_t &size) const
+{
+    const uint8_t *segment = nullptr;
+    if (index < m_header_size)
+    {
+        segment = &m_header[index];
+        size = m_header_size - index;
+    }
+    else if (index < m_payload_end)
+    {
+        segment = &payload[index - m_header_size];
+        size = m_payload_end - index;
+    }
+    else
+    {
+        segment = &m_trailer[index - m_payload_end];
+        size = m_body_size - index;
+    }
+    return segment;
+}
+
+inline size_t ArdPacketFecEncoder::Encode(const uint8_t *payload, uint8_t *encoded, const size_t max_size)
+{
+    size_t encoded_size = 0;
+    while (!m_done && encoded_size < max_size)
+    {
+        if (m_index < m_block_end)
+        {
+            if (m_crc && m_index == m_payload_end)
+            {
+                // payload encoded: trailer is final
+                const crc_t crc = crc_finalize(m_crc_value);
+                memcpy(m_trailer, &crc, kArdPacketFecTrailerSize);
+            }
+            // data bytes
+            size_t segment_size = 0;
+            const uint8_t *segment = Segment(payload, m_index, segment_size);
+            size_t copy_size = (segment_size < m_block_end - m_index ? segment_size : m_block_end - m_index);
+            copy_size = (copy_size < (max_size - encoded_size) ? copy_size : (max_size - encoded_size));
+            memcpy(&encoded[encoded_size], segment, copy_size);
+            ArdPacketFecUpdate(m_generator, m_parity_bytes, m_parity, segment, copy_size);
+            if (m_crc && m_index >= m_header_size && m_index < m_payload_end)
+            {
+                m_crc_value = crc_update(m_crc_value, segment, copy_size);
+            }
+            encoded_size += copy_size;
+            m_index += copy_size;
+            if (m_index == m_block_end)
+            {
+                m_parity_index = 0;
+            }
+        }
+        else
+        {
+            // parity bytes
+            size_t copy_size = m_parity_bytes - m_parity_index;
+            copy_size = (copy_size < (max_size - encoded_size) ? copy_size : (max_size - encoded_size));
+            memcpy(&encoded[encoded_size], &m_parity[m_parity_index], copy_size);
+            encoded_size += copy_size;
+            m_parity_index += copy_size;
+            if (m_parity_index == m_parity_bytes)
+            {
+                // next block
+                memset(m_parity, 0, m_parity_bytes);
+                const size_t remaining = m_body_size - m_index;
+                m_block_end = m_index + (remaining < m_block_size ? remaining : m_block_size);
+                m_done = (remaining == 0);
+            }
+        }
+    }
+    return encoded_size;
+}
+
+// Decoder
+
+inline void ArdPacketFecDecoder::Begin(const size_t header_size, const bool crc, const size_t parity_bytes,
+                                       const size_t block_size)
+{
+    m_header_size = header_size;
+    m_payload_size = 0;
+    m_body_size = 0;
+    m_body_index = 0;
+    m_block_index = 0;
+    m_block_data_size = header_size;
+    m_parity_bytes = parity_bytes;
+    m_block_size = block_size;
+    m_corrected = 0;
+    m_crc = crc;
+    m_crc_value = crc_init();
+    m_header_done = false;
+}
+
+inline void ArdPacketFecDecoder::SetPayloadSize(const size_t payload_size)
+{
+    m_payload_size = payload_size;
+    m_body_size = payload_size + (m_crc ? kArdPacketFecTrailerSize : 0);
+    m_block_data_size = (m_body_size < m_block_size ? m_body_size : m_block_size);
+    m_header_done = true;
+}
+
+inline eArdPacketFecEvent ArdPacketFecDecoder::FinishBlock(uint8_t *payload)
+{
+    eArdPacketFecEvent event = kArdPacketFecNeedMore;
+    const int corrected = ArdPacketFecCorrect(m_block, m_block_data_size + m_parity_bytes, m_parity_bytes);
+    m_block_index = 0;
+    if (corrected < 0)
+    {
+        event = kArdPacketFecUncorrectable;
+    }
+    else if (!m_header_done)
+    {
+        m_corrected += static_cast<size_t>(corrected);
+        memcpy(m_header, m_block, m_header_size);
+        event = kArdPacketFecHeader;
+    }
+    else
+    {
+        m_corrected += static_cast<size_t>(corrected);
+        // payload part of the block
+        size_t payload_copy = 0;
+        if (m_body_index < m_payload_size)
+        {
+            const size_t payload_remaining = m_payload_size - m_body_index;
+            payload_copy = (m_block_data_size < payload_remaining ? m_block_data_size : payload_remaining);
+            memcpy(&payload[m_body_index], m_block, payload_copy);
+        }
+        // trailer part of the block
+        const size_t trailer_copy = m_block_data_size - payload_copy;
+        if (trailer_copy > 0)
+        {
+            memcpy(&m_trailer[m_body_index + payload_copy - m_payload_size], &m_block[payload_copy], trailer_copy);
+        }
+        if (m_crc)
+        {
+            m_crc_value = crc_update(m_crc_value, m_block, m_block_data_size);
+        }
+        m_body_index += m_block_data_size;
+        const size_t remaining = m_body_size - m_body_index;
+        m_block_data_size = (remaining < m_block_size ? remaining : m_block_size);
+        if (remaining == 0)
+        {
+            event = kArdPacketFecDone;
+        }
+    }
+    return event;
+}
+
+inline eArdPacketFecEvent ArdPacketFecDecoder::Decode(const uint8_t *encoded, const size_t encoded_size,
+                                                      uint8_t *payload, size_t &consumed)
+{
+    eArdPacketFecEvent event = kArdPacketFecNeedMore;
+    consumed = 0;
+    while (event == kArdPacketFecNeedMore && consumed < encoded_size)
+    {
+        const size_t remaining = RemainingEncoded();
+        const size_t copy_size = (remaining < encoded_size - consumed ? remaining : encoded_size - consumed);
+        memcpy(&m_block[m_block_index], &encoded[consumed], copy_size);
+        consumed += copy_size;
+        m_block_index += copy_size;
+        if (m_block_index == m_block_data_size + m_parity_bytes)
+        {
+            event = FinishBlock(payload);
+        }
+    }
+    return event;
+}
+
+#endif
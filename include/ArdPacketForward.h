@@ -0,0 +1,364 @@
+
+#ifndef ARD_PACKET_FORWARD_H
+#define ARD_PACKET_FORWARD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Largest number of payload bytes relayed per stream read and write
+ */
+#ifndef ARD_PACKET_FORWARD_CHUNK_SIZE
+#define ARD_PACKET_FORWARD_CHUNK_SIZE 32
+#endif
+
+/**
+ * @brief Cut-through forwarding of packets from one packet stream to another, such as a UART to WiFi bridge
+ *
+ * Payload bytes are written to the egress stream as soon as they are read from the ingress stream, without holding
+ * a full packet. The header is rewritten in the egress configuration, so both sides may use different field sizes,
+ * header encodings, delimiters and CRC settings. The ingress CRCs are checked on the fly. A payload that fails its
+ * CRC has already been relayed, so its CRC is passed on unchanged and the next receiver drops it too. Without an
+ * egress CRC there is nothing to tell the next receiver, the failure is only reported by @c Forward.
+ *
+ * Both packets must use delimiter framing without forward error correction. Do not receive on the ingress packet or
+ * send on the egress packet while forwarding.
+ */
+class ArdPacketForward
+{
+   public:
+    ArdPacketForward(ArdPacket &ingress, ArdPacketBase &egress)
+        : m_ingress(ingress), m_reader(ingress.m_reader), m_egress(egress)
+    {
+    }
+
+    /**
+     * @brief Forward from a receive-only endpoint, such as to an @c ArdPacketSender
+     */
+    ArdPacketForward(ArdPacketReceiver &ingress, ArdPacketBase &egress)
+        : m_ingress(ingress), m_reader(ingress.m_reader), m_egress(egress)
+    {
+    }
+
+    /**
+     * @brief Relay what the ingress stream has and the egress stream takes
+     *
+     * @return @c kArdPacketStatusDone when a packet was relayed, @c kArdPacketStatusCrcFailed when it was relayed
+     * but failed its CRC, in progress while a packet is relayed, otherwise the status of a dropped header
+     */
+    eArdPacketStatus Forward();
+
+    /**
+     * @brief Drop the packet in progress
+     */
+    void Reset()
+    {
+        ArdPacketBase::ResetState(m_reader.m_read);
+        m_state = kArdPacketForwardStateHeader;
+        m_pending_index = 0;
+        m_pending_size = 0;
+    }
+
+   private:
+    static constexpr size_t kArdPacketForwardChunkSize = ARD_PACKET_FORWARD_CHUNK_SIZE;
+
+    enum eArdPacketForwardState
+    {
+        kArdPacketForwardStateHeader,
+        kArdPacketForwardStatePayload,
+        kArdPacketForwardStatePayloadCrc,
+        kArdPacketForwardStateTrailer
+    };
+
+    static bool Supported(const ArdPacketConfig &config)
+    {
+        return (config.framing == kArdPacketFramingDelimiter && config.fec_parity_bytes == 0);
+    }
+
+    eArdPacketStatus ForwardHeader();
+    eArdPacketStatus ForwardPayload();
+    eArdPacketStatus ForwardPayloadCrc();
+    eArdPacketStatus ForwardTrailer();
+    void WritePending();
+
+    ArdPacketBase &m_ingress;
+    ArdPacketBase::ReadMachine &m_reader;
+    ArdPacketBase &m_egress;
+
+    eArdPacketForwardState m_state = kArdPacketForwardStateHeader;
+    ArdPacketPayloadInfo m_info = {};
+    size_t m_payload_index = 0;
+    bool m_crc_passed = false;
+
+    // egress crc, only computed when the ingress has none to pass through
+    crc_t m_crc = 0;
+
+    // egress header or crc not written yet
+    uint8_t m_pending[ArdPacketBase::kArdPacketMaxHeaderSize] = {0};
+    size_t m_pending_index = 0;
+    size_t m_pending_size = 0;
+    size_t m_write_available = 0;
+};
+
+// inline methods
+
+inline eArdPacketStatus ArdPacketForward::Forward()
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_ingress.m_config.max_payload_size == 0 || m_egress.m_config.max_payload_size == 0)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if (!Supported(m_ingress.m_config) || !Supported(m_egress.m_config))
+    {
+        status = kArdPacketStatusInvalidFraming;
+    }
+    else
+    {
+        const int stream_size = m_ingress.m_stream.available();
+        m_reader.m_read.available =
+            (stream_size > 0 ? static_cast<size_t>(stream_size) : 0) + (m_reader.m_sync_size - m_reader.m_sync_index);
+        const int write_size = m_egress.m_stream.availableForWrite();
+        m_write_available = (write_size > 0 ? static_cast<size_t>(write_size) : 0);
+
+        bool continue_forward = true;
+        while (continue_forward)
+        {
+            const eArdPacketForwardState state = m_state;
+            switch (m_state)
+            {
+                case kArdPacketForwardStateHeader:
+                {
+                    status = ForwardHeader();
+                    break;
+                }
+                case kArdPacketForwardStatePayload:
+                {
+                    status = ForwardPayload();
+                    break;
+                }
+                case kArdPacketForwardStatePayloadCrc:
+                {
+                    status = ForwardPayloadCrc();
+                    break;
+                }
+                case kArdPacketForwardStateTrailer:
+                {
+                    status = ForwardTrailer();
+                    break;
+                }
+                default:
+                {
+                    status = kArdPacketStatusStart;
+                    Reset();
+                    break;
+                }
+            }
+            // keep going while the packet advances
+            continue_forward = (m_state != state && (status == kArdPacketStatusHeaderInProgress ||
+                                                     status == kArdPacketStatusPayloadInProgress));
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketForward::ForwardHeader()
+{
+    eArdPacketStatus status = kArdPacketStatusNotAvailable;
+    ArdPacketBase::ArdPacketStateData &read = m_reader.m_read;
+    if (read.state == ArdPacketBase::kArdPacketStateDone)
+    {
+        ArdPacketBase::ResetState(read);
+    }
+
+    // same header states as ArdPacket::ReceivePayload
+    const size_t egress_max_payload_size = m_egress.m_config.max_payload_size;
+    const size_t max_payload_size = (m_ingress.m_config.max_payload_size < egress_max_payload_size
+                                         ? m_ingress.m_config.max_payload_size
+                                         : egress_max_payload_size);
+    bool continue_read = true;
+    while (read.available > 0 && continue_read)
+    {
+        switch (read.state)
+        {
+            case ArdPacketBase::kArdPacketStateDelimiter:
+            {
+                status = m_reader.ProcessReadStateDelimiter(m_ingress);
+                break;
+            }
+            case ArdPacketBase::kArdPacketStateMessageType:
+            {
+                status = (read.available < m_ingress.GetMinFieldSize(m_ingress.m_config.message_type_bytes)
+                              ? kArdPacketStatusNotEnoughAvailable
+                              : m_reader.ProcessReadStateMessageType(m_ingress, m_info));
+                break;
+            }
+            case ArdPacketBase::kArdPacketStatePayloadSize:
+            {
+                status = (read.available < m_ingress.GetMinFieldSize(m_ingress.m_config.payload_size_bytes)
+                              ? kArdPacketStatusNotEnoughAvailable
+                              : m_reader.ProcessReadStatePayloadSize(m_ingress, max_payload_size, m_info));
+                break;
+            }
+            case ArdPacketBase::kArdPacketStateHeaderCrc:
+            {
+                status = (read.available < ArdPacketBase::kArdPacketCrcBytes
+                              ? kArdPacketStatusNotEnoughAvailable
+                              : m_reader.ProcessReadStateHeaderCrc(m_ingress));
+                break;
+            }
+            default:
+            {
+                status = kArdPacketStatusStart;
+                ArdPacketBase::ResetState(read);
+                break;
+            }
+        }
+        continue_read =
+            (status == kArdPacketStatusHeaderInProgress && read.state != ArdPacketBase::kArdPacketStatePayload);
+    }
+
+    if (read.state == ArdPacketBase::kArdPacketStatePayload && m_info.message_type > m_egress.m_max_message_type_value)
+    {
+        status = kArdPacketStatusInvalidMessageType;
+        m_reader.Resync(m_ingress);
+    }
+    else if (read.state == ArdPacketBase::kArdPacketStatePayload)
+    {
+        // header in the egress configuration
+        m_pending[0] = m_egress.m_config.delimiter;
+        m_pending_size = ArdPacketBase::kArdPacketDelimiterBytes + m_egress.WriteHeaderFields(m_info, &m_pending[1]);
+        m_pending_index = 0;
+        m_payload_index = 0;
+        m_crc = crc_init();
+        status = kArdPacketStatusPayloadInProgress;
+        m_state = kArdPacketForwardStatePayload;
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketForward::ForwardPayload()
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+    ArdPacketBase::ArdPacketStateData &read = m_reader.m_read;
+    const bool ingress_crc = m_ingress.m_config.crc;
+    const bool compute_crc = m_egress.m_config.crc && !ingress_crc;
+
+    WritePending();
+    uint8_t chunk[kArdPacketForwardChunkSize];
+    bool read_failed = false;
+    while (m_pending_index == m_pending_size && m_payload_index < m_info.payload_size && read.available > 0 &&
+           m_write_available > 0 && !read_failed)
+    {
+        size_t chunk_size = m_info.payload_size - m_payload_index;
+        chunk_size = (chunk_size < read.available ? chunk_size : read.available);
+        chunk_size = (chunk_size < m_write_available ? chunk_size : m_write_available);
+        chunk_size = (chunk_size < kArdPacketForwardChunkSize ? chunk_size : kArdPacketForwardChunkSize);
+
+        const size_t bytes_read = m_reader.ReadBytes(m_ingress, chunk, chunk_size);
+        if (ingress_crc)
+        {
+            read.crc = crc_update(read.crc, chunk, bytes_read);
+        }
+        if (compute_crc)
+        {
+            m_crc = crc_update(m_crc, chunk, bytes_read);
+        }
+        m_egress.m_stream.write(chunk, bytes_read);
+        m_write_available -= bytes_read;
+        m_payload_index += bytes_read;
+        read_failed = (bytes_read == 0);
+    }
+
+    if (read_failed)
+    {
+        // the packet stays in progress, the stream reported bytes it did not have
+        status = kArdPacketStatusReadFailed;
+    }
+    else if (m_payload_index == m_info.payload_size && ingress_crc)
+    {
+        m_state = kArdPacketForwardStatePayloadCrc;
+    }
+    else if (m_payload_index == m_info.payload_size)
+    {
+        m_crc_passed = true;
+        m_pending_index = 0;
+        m_pending_size = 0;
+        if (m_egress.m_config.crc)
+        {
+            const crc_t crc = crc_finalize(m_crc);
+            memcpy(m_pending, reinterpret_cast<const uint8_t *>(&crc), ArdPacketBase::kArdPacketCrcBytes);
+            m_pending_size = ArdPacketBase::kArdPacketCrcBytes;
+        }
+        m_state = kArdPacketForwardStateTrailer;
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketForward::ForwardPayloadCrc()
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+    ArdPacketBase::ArdPacketStateData &read = m_reader.m_read;
+    if (read.available >= ArdPacketBase::kArdPacketCrcBytes)
+    {
+        uint8_t crc_data[ArdPacketBase::kArdPacketCrcBytes];
+        if (m_reader.ReadBytes(m_ingress, crc_data, ArdPacketBase::kArdPacketCrcBytes) !=
+            ArdPacketBase::kArdPacketCrcBytes)
+        {
+            status = kArdPacketStatusReadFailed;
+        }
+        else
+        {
+            read.crc = crc_finalize(crc_update(read.crc, crc_data, ArdPacketBase::kArdPacketCrcBytes));
+            m_crc_passed = (read.crc == 0);
+            if (m_crc_passed)
+            {
+                ArdPacketBase::ResetState(read);
+            }
+            else
+            {
+                // rescan the lookback window like a received packet
+                m_reader.Resync(m_ingress);
+            }
+
+            // the ingress crc covers the same payload, pass it through unchanged
+            m_pending_index = 0;
+            m_pending_size = 0;
+            if (m_egress.m_config.crc)
+            {
+                memcpy(m_pending, crc_data, ArdPacketBase::kArdPacketCrcBytes);
+                m_pending_size = ArdPacketBase::kArdPacketCrcBytes;
+            }
+            m_state = kArdPacketForwardStateTrailer;
+        }
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketForward::ForwardTrailer()
+{
+    eArdPacketStatus status = kArdPacketStatusPayloadInProgress;
+    WritePending();
+    if (m_pending_index == m_pending_size)
+    {
+        status = (m_crc_passed ? kArdPacketStatusDone : kArdPacketStatusCrcFailed);
+        m_state = kArdPacketForwardStateHeader;
+    }
+    return status;
+}
+
+inline void ArdPacketForward::WritePending()
+{
+    size_t write_size = m_pending_size - m_pending_index;
+    write_size = (write_size < m_write_available ? write_size : m_write_available);
+    if (write_size > 0)
+    {
+        m_egress.m_stream.write(&m_pending[m_pending_index], write_size);
+        m_pending_index += write_size;
+        m_write_available -= write_size;
+    }
+}
+
+#endif
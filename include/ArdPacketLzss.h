@@ -0,0 +1,345 @@
+
+#ifndef ARD_PACKET_LZSS_H
+#define ARD_PACKET_LZSS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief LZSS compression of payloads in bounded memory
+ *
+ * The compressed stream is a sequence of bit packed tokens, most significant bit first. A 1 bit is followed by a
+ * literal byte. A 0 bit is followed by a back reference to earlier output: the distance minus one in
+ * @c window_bits bits, then the length minus @c kArdPacketLzssMinMatch in @c kArdPacketLzssLengthBits bits. The
+ * last byte is padded with zero bits, too few for another token, so the stream needs no size or end marker.
+ *
+ * The encoder keeps the last 2^window_bits bytes of input and a short lookahead, so input is fed in chunks of any
+ * size. The decoder copies back references from its contiguous output and keeps no window of its own.
+ */
+
+/**
+ * @brief Largest encoder window in bits, the encoder holds 2^bits bytes of history
+ */
+#ifndef ARD_PACKET_LZSS_WINDOW_BITS
+#if defined(__AVR__)
+#define ARD_PACKET_LZSS_WINDOW_BITS 7
+#else
+#define ARD_PACKET_LZSS_WINDOW_BITS 8
+#endif
+#endif
+
+/**
+ * @brief Window size range in bits
+ */
+static constexpr size_t kArdPacketLzssMinWindowBits = 4;
+static constexpr size_t kArdPacketLzssMaxWindowBits = ARD_PACKET_LZSS_WINDOW_BITS;
+
+/**
+ * @brief Back reference length field in bits
+ */
+static constexpr size_t kArdPacketLzssLengthBits = 4;
+
+/**
+ * @brief Shortest and longest back reference
+ */
+static constexpr size_t kArdPacketLzssMinMatch = 2;
+static constexpr size_t kArdPacketLzssMaxMatch = kArdPacketLzssMinMatch + (1U << kArdPacketLzssLengthBits) - 1;
+
+static_assert(kArdPacketLzssMaxWindowBits >= kArdPacketLzssMinWindowBits && kArdPacketLzssMaxWindowBits <= 12,
+              "a back reference must stay shorter than two literals");
+
+/**
+ * @brief Streaming LZSS encoder
+ *
+ * Matches are found by a plain search of the window, the longest and then the nearest one wins. The work per input
+ * byte grows with the window size.
+ */
+class ArdPacketLzssEncoder
+{
+   public:
+    ArdPacketLzssEncoder() = default;
+
+    /**
+     * @brief Start a new stream
+     *
+     * @param window_bits back reference distance bits, from @c kArdPacketLzssMinWindowBits to
+     * @c ARD_PACKET_LZSS_WINDOW_BITS, the decoder must use the same
+     * @param output compressed stream
+     * @param max_size size of @c output
+     * @return false if @c window_bits is out of range
+     */
+    bool Begin(size_t window_bits, uint8_t *output, size_t max_size);
+
+    /**
+     * @brief Compress a chunk of input
+     *
+     * @param input
+     * @param size
+     * @return false once the output is full, the stream is then incomplete
+     */
+    bool Sink(const uint8_t *input, size_t size);
+
+    /**
+     * @brief Compress the rest of the lookahead and pad the last byte
+     *
+     * @return false if the output is full
+     */
+    bool Finish();
+
+    /**
+     * @brief Compressed bytes written, the whole stream after @c Finish
+     */
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+   private:
+    void EncodeToken();
+    void WriteBits(uint32_t value, size_t bits);
+
+    uint8_t m_window[1U << kArdPacketLzssMaxWindowBits] = {0};
+    uint8_t m_lookahead[kArdPacketLzssMaxMatch] = {0};
+    size_t m_window_bits = 0;
+    size_t m_window_fill = 0;
+    size_t m_window_index = 0;
+    size_t m_lookahead_size = 0;
+
+    uint8_t *m_output = nullptr;
+    size_t m_max_size = 0;
+    size_t m_size = 0;
+    uint32_t m_bits = 0;
+    size_t m_bit_count = 0;
+    bool m_overflow = true;
+};
+
+/**
+ * @brief Streaming LZSS decoder
+ */
+class ArdPacketLzssDecoder
+{
+   public:
+    ArdPacketLzssDecoder() = default;
+
+    /**
+     * @brief Start a new stream
+     *
+     * @param window_bits back reference distance bits of the encoder
+     * @param output decompressed data
+     * @param max_size size of @c output
+     * @return false if @c window_bits is out of range
+     */
+    bool Begin(size_t window_bits, uint8_t *output, size_t max_size);
+
+    /**
+     * @brief Decompress a chunk of the stream
+     *
+     * @param input
+     * @param size
+     * @return false on a back reference before the start of the output or output beyond @c max_size
+     */
+    bool Decode(const uint8_t *input, size_t size);
+
+    /**
+     * @brief The stream ended on a token, followed by zero padding only
+     */
+    bool Finish() const
+    {
+        return !m_failed && m_bit_count < 8 && (m_bits & ((1U << m_bit_count) - 1)) == 0;
+    }
+
+    /**
+     * @brief Decompressed bytes written
+     */
+    size_t Size() const
+    {
+        return m_size;
+    }
+
+   private:
+    uint8_t *m_output = nullptr;
+    size_t m_max_size = 0;
+    size_t m_size = 0;
+    size_t m_window_bits = 0;
+    uint32_t m_bits = 0;
+    size_t m_bit_count = 0;
+    bool m_failed = true;
+};
+
+// inline methods
+
+inline bool ArdPacketLzssEncoder::Begin(const size_t window_bits, uint8_t *output, const size_t max_size)
+{
+    const bool valid = (window_bits >= kArdPacketLzssMinWindowBits && window_bits <= kArdPacketLzssMaxWindowBits);
+    m_window_bits = window_bits;
+    m_window_fill = 0;
+    m_window_index = 0;
+    m_lookahead_size = 0;
+    m_output = output;
+    m_max_size = max_size;
+    m_size = 0;
+    m_bits = 0;
+    m_bit_count = 0;
+    m_overflow = !valid;
+    return valid;
+}
+
+inline bool ArdPacketLzssEncoder::Sink(const uint8_t *input, const size_t size)
+{
+    size_t index = 0;
+    while (index < size && !m_overflow)
+    {
+        m_lookahead[m_lookahead_size++] = input[index++];
+        if (m_lookahead_size == kArdPacketLzssMaxMatch)
+        {
+            EncodeToken();
+        }
+    }
+    return !m_overflow;
+}
+
+inline bool ArdPacketLzssEncoder::Finish()
+{
+    while (m_lookahead_size > 0 && !m_overflow)
+    {
+        EncodeToken();
+    }
+    if (m_bit_count > 0 && !m_overflow)
+    {
+        WriteBits(0, 8 - m_bit_count);
+    }
+    return !m_overflow;
+}
+
+inline void ArdPacketLzssEncoder::EncodeToken()
+{
+    // longest match, the nearest one of equal length
+    const size_t mask = (static_cast<size_t>(1) << m_window_bits) - 1;
+    size_t best_length = 0;
+    size_t best_distance = 0;
+    for (size_t distance = 1; distance <= m_window_fill && best_length < m_lookahead_size; ++distance)
+    {
+        // a match may run on into the lookahead it is copied to, most candidates fail on the first byte
+        const size_t start = m_window_index - distance;
+        size_t length = 0;
+        bool equal = (m_window[start & mask] == m_lookahead[0]);
+        while (length < m_lookahead_size && equal)
+        {
+            const uint8_t value =
+                (length < distance ? m_window[(start + length) & mask] : m_lookahead[length - distance]);
+            equal = (value == m_lookahead[length]);
+            length += (equal ? 1 : 0);
+        }
+        if (length > best_length)
+        {
+            best_length = length;
+            best_distance = distance;
+        }
+    }
+
+    if (best_length >= kArdPacketLzssMinMatch)
+    {
+        // 0 bit, distance and length
+        const uint32_t reference = (static_cast<uint32_t>(best_distance - 1) << kArdPacketLzssLengthBits) |
+                                   static_cast<uint32_t>(best_length - kArdPacketLzssMinMatch);
+        WriteBits(reference, 1 + m_window_bits + kArdPacketLzssLengthBits);
+    }
+    else
+    {
+        // 1 bit and literal
+        best_length = 1;
+        WriteBits(0x100U | m_lookahead[0], 9);
+    }
+
+    // consumed bytes move to the window
+    for (size_t k = 0; k < best_length; ++k)
+    {
+        m_window[m_window_index & mask] = m_lookahead[k];
+        m_window_index++;
+    }
+    m_window_fill = (m_window_fill + best_length < mask + 1 ? m_window_fill + best_length : mask + 1);
+    m_lookahead_size -= best_length;
+    memmove(m_lookahead, &m_lookahead[best_length], m_lookahead_size);
+}
+
+inline void ArdPacketLzssEncoder::WriteBits(const uint32_t value, const size_t bits)
+{
+    m_bits = (m_bits << bits) | value;
+    m_bit_count += bits;
+    while (m_bit_count >= 8 && !m_overflow)
+    {
+        m_bit_count -= 8;
+        if (m_size < m_max_size)
+        {
+            m_output[m_size++] = static_cast<uint8_t>(m_bits >> m_bit_count);
+        }
+        else
+        {
+            m_overflow = true;
+        }
+    }
+}
+
+inline bool ArdPacketLzssDecoder::Begin(const size_t window_bits, uint8_t *output, const size_t max_size)
+{
+    const bool valid = (window_bits >= kArdPacketLzssMinWindowBits && window_bits <= kArdPacketLzssMaxWindowBits);
+    m_output = output;
+    m_max_size = max_size;
+    m_size = 0;
+    m_window_bits = window_bits;
+    m_bits = 0;
+    m_bit_count = 0;
+    m_failed = !valid;
+    return valid;
+}
+
+inline bool ArdPacketLzssDecoder::Decode(const uint8_t *input, const size_t size)
+{
+    const size_t reference_bits = 1 + m_window_bits + kArdPacketLzssLengthBits;
+    const uint32_t length_mask = (1U << kArdPacketLzssLengthBits) - 1;
+    const uint32_t distance_mask = (1U << m_window_bits) - 1;
+    size_t index = 0;
+    while (index < size && !m_failed)
+    {
+        m_bits = (m_bits << 8) | input[index++];
+        m_bit_count += 8;
+
+        // every whole token, the rest waits for the next byte
+        bool token = true;
+        while (token && !m_failed)
+        {
+            const bool literal = (m_bit_count > 0 && ((m_bits >> (m_bit_count - 1)) & 1U) != 0);
+            if (literal && m_bit_count >= 9)
+            {
+                m_bit_count -= 9;
+                m_failed = (m_size == m_max_size);
+                if (!m_failed)
+                {
+                    m_output[m_size++] = static_cast<uint8_t>(m_bits >> m_bit_count);
+                }
+            }
+            else if (!literal && m_bit_count >= reference_bits)
+            {
+                m_bit_count -= reference_bits;
+                const uint32_t reference = m_bits >> m_bit_count;
+                const size_t length = (reference & length_mask) + kArdPacketLzssMinMatch;
+                const size_t distance = ((reference >> kArdPacketLzssLengthBits) & distance_mask) + 1;
+                m_failed = (distance > m_size || length > m_max_size - m_size);
+                for (size_t k = 0; k < length && !m_failed; ++k)
+                {
+                    // byte by byte, the copy may overlap its source
+                    m_output[m_size] = m_output[m_size - distance];
+                    m_size++;
+                }
+            }
+            else
+            {
+                token = false;
+            }
+        }
+    }
+    return !m_failed;
+}
+
+#endif
@@ -0,0 +1,450 @@
+
+#ifndef ARD_PACKET_POLLER_H
+#define ARD_PACKET_POLLER_H
+
+#include <stdint.h>
+
+#include "ArdPacket.h"
+
+class ArdPacketPoller;
+
+/**
+ * @brief Unit of the poller service budget
+ */
+enum eArdPacketPollerUnit
+{
+    /**
+     * @brief Packets received or sent
+     */
+    kArdPacketPollerUnitPackets = 0,
+
+    /**
+     * @brief Bytes read from or written to the stream
+     */
+    kArdPacketPollerUnitBytes
+};
+
+/**
+ * @brief Service counters of a poller endpoint
+ */
+struct ArdPacketPollerStats
+{
+    uint32_t packets_received = 0;
+    uint32_t packets_sent = 0;
+    uint32_t receive_errors = 0;
+
+    /**
+     * @brief Bytes read from and written to the stream
+     */
+    uint32_t bytes = 0;
+
+    /**
+     * @brief Time from the poll that first found a packet waiting to the poll that completed it
+     */
+    uint32_t last_latency_us = 0;
+    uint32_t max_latency_us = 0;
+
+    /**
+     * @brief Moving average of the latency, each packet weighs 1/8
+     */
+    uint32_t average_latency_us = 0;
+};
+
+/**
+ * @brief Packet stream serviced by @c ArdPacketPoller
+ */
+class ArdPacketPollerEndpoint
+{
+   public:
+    explicit ArdPacketPollerEndpoint(ArdPacketStreamInterface &stream) : m_budget(stream), m_packet(m_budget) {}
+
+    /**
+     * @brief Configure the packet and the service budget
+     *
+     * @param config
+     * @param quantum packets or bytes added to the budget each poll while the endpoint has work, at least 1
+     * @param storage receive buffer of at least @c max_payload_size bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketConfig &config, size_t quantum, uint8_t *storage,
+                                     size_t storage_size);
+
+    /**
+     * @brief Queue a payload, sent as the budget allows
+     *
+     * @param info
+     * @param payload kept by the caller until @c Sending returns false
+     * @return false while the previous payload is still sending
+     */
+    bool Send(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief A queued payload is not sent completely
+     */
+    bool Sending() const
+    {
+        return (m_send_payload != nullptr);
+    }
+
+    const ArdPacketPollerStats &Stats() const
+    {
+        return m_stats;
+    }
+
+    ArdPacket &Packet()
+    {
+        return m_packet;
+    }
+
+    /**
+     * @brief Application data attached to the endpoint
+     */
+    void *context = nullptr;
+
+   private:
+    friend class ArdPacketPoller;
+
+    // limits the bytes a packet call may move
+    class ArdPacketPollerBudgetStream : public ArdPacketStreamInterface
+    {
+       public:
+        explicit ArdPacketPollerBudgetStream(ArdPacketStreamInterface &stream) : m_stream(stream) {}
+
+        void Start(const size_t budget)
+        {
+            m_budget = budget;
+            m_used = 0;
+        }
+        size_t Used() const
+        {
+            return m_used;
+        }
+        int Waiting()
+        {
+            return m_stream.available();
+        }
+
+        int available() override
+        {
+            return Limit(m_stream.available());
+        }
+        int read() override
+        {
+            int value = -1;
+            if (m_used < m_budget)
+            {
+                value = m_stream.read();
+                m_used += (value >= 0 ? 1 : 0);
+            }
+            return value;
+        }
+        size_t read(uint8_t *buffer, size_t size) override
+        {
+            const size_t read_size = m_stream.read(buffer, (size < m_budget - m_used ? size : m_budget - m_used));
+            m_used += read_size;
+            return read_size;
+        }
+
+        int availableForWrite() override
+        {
+            return Limit(m_stream.availableForWrite());
+        }
+        size_t write(uint8_t value) override
+        {
+            return write(&value, 1);
+        }
+        size_t write(const uint8_t *buffer, size_t size) override
+        {
+            // packets write exactly what availableForWrite allowed
+            m_used += size;
+            return m_stream.write(buffer, size);
+        }
+
+       private:
+        int Limit(const int size) const
+        {
+            const size_t remaining = m_budget - m_used;
+            return (size > 0 && static_cast<size_t>(size) > remaining ? static_cast<int>(remaining) : size);
+        }
+
+        ArdPacketStreamInterface &m_stream;
+        size_t m_budget = 0;
+        size_t m_used = 0;
+    };
+
+    ArdPacketPollerBudgetStream m_budget;
+    ArdPacket m_packet;
+    size_t m_quantum = 1;
+    size_t m_deficit = 0;
+
+    uint8_t *m_payload = nullptr;
+    size_t m_payload_size = 0;
+    ArdPacketPayloadInfo m_info = {};
+    bool m_receive_waiting = false;
+    uint32_t m_receive_since = 0;
+
+    ArdPacketPayloadInfo m_send_info = {};
+    const uint8_t *m_send_payload = nullptr;
+    bool m_send_waiting = false;
+    uint32_t m_send_since = 0;
+
+    ArdPacketPollerStats m_stats;
+};
+
+/**
+ * @brief Callbacks of @c ArdPacketPoller
+ */
+class ArdPacketPollerHandler
+{
+   public:
+    ArdPacketPollerHandler() = default;
+
+    virtual void OnPayload(ArdPacketPollerEndpoint &endpoint, const ArdPacketPayloadInfo &info,
+                           const uint8_t *payload) = 0;
+
+    /**
+     * @brief A packet was dropped (CRC failure, invalid size or framing)
+     */
+    virtual void OnReceiveError(ArdPacketPollerEndpoint &endpoint, const eArdPacketStatus status)
+    {
+        (void)endpoint;
+        (void)status;
+    }
+};
+
+/**
+ * @brief Poller configuration
+ */
+struct ArdPacketPollerConfig
+{
+    /**
+     * @brief Unit of the endpoint quantum
+     */
+    eArdPacketPollerUnit unit = kArdPacketPollerUnitBytes;
+
+    /**
+     * @brief Microsecond clock for the service latency, defaults to @c micros on Arduino
+     */
+    ArdPacketClock clock_us = nullptr;
+};
+
+/**
+ * @brief Fair service of several packet streams from one loop
+ *
+ * Deficit round robin: each poll, an endpoint with bytes to read or a payload to send adds its quantum to its budget
+ * and is serviced until the budget is spent or it runs out of work. Budget left over is kept for the next poll while
+ * the endpoint stays busy, so large packets are not starved by small quanta, and dropped once it is idle. A busy link
+ * never delays the others by more than its quantum per poll.
+ */
+class ArdPacketPoller
+{
+   public:
+    explicit ArdPacketPoller(ArdPacketPollerHandler &handler) : m_handler(handler) {}
+
+    /**
+     * @brief Configure the poller (endpoints must already be configured)
+     *
+     * @param config
+     * @param endpoints owned by the caller
+     * @param count
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketPollerConfig &config, ArdPacketPollerEndpoint **endpoints,
+                                     size_t count);
+
+    /**
+     * @brief Service every endpoint once, call from the main loop
+     */
+    void Poll();
+
+   private:
+    void Service(ArdPacketPollerEndpoint &endpoint);
+    bool Receive(ArdPacketPollerEndpoint &endpoint, uint32_t now);
+    void Record(ArdPacketPollerEndpoint &endpoint, uint32_t since);
+
+    ArdPacketPollerHandler &m_handler;
+    eArdPacketPollerUnit m_unit = kArdPacketPollerUnitBytes;
+    ArdPacketClock m_clock = nullptr;
+    ArdPacketPollerEndpoint **m_endpoints = nullptr;
+    size_t m_count = 0;
+    size_t m_next = 0;
+};
+
+// ArdPacketPollerEndpoint inline methods
+
+inline eArdPacketConfigStatus ArdPacketPollerEndpoint::Configure(const ArdPacketConfig &config, const size_t quantum,
+                                                                 uint8_t *storage, const size_t storage_size)
+{
+    eArdPacketConfigStatus status = m_packet.Configure(config);
+    if (status == kArdPacketConfigSuccess && (storage == nullptr || storage_size < config.max_payload_size))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else if (status == kArdPacketConfigSuccess && quantum == 0)
+    {
+        status = kArdPacketConfigInvalidQuantum;
+    }
+
+    if (status == kArdPacketConfigSuccess)
+    {
+        m_quantum = quantum;
+        m_deficit = 0;
+        m_payload = storage;
+        m_payload_size = storage_size;
+        m_receive_waiting = false;
+        m_send_payload = nullptr;
+        m_send_waiting = false;
+        m_stats = ArdPacketPollerStats();
+    }
+    return status;
+}
+
+inline bool ArdPacketPollerEndpoint::Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    const bool queued = (m_send_payload == nullptr && payload != nullptr);
+    if (queued)
+    {
+        m_send_info = info;
+        m_send_payload = payload;
+    }
+    return queued;
+}
+
+// ArdPacketPoller inline methods
+
+inline eArdPacketConfigStatus ArdPacketPoller::Configure(const ArdPacketPollerConfig &config,
+                                                         ArdPacketPollerEndpoint **endpoints, const size_t count)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    ArdPacketClock clock = config.clock_us;
+#ifndef NATIVE_TEST_BUILD
+    if (clock == nullptr)
+    {
+        clock = []() -> uint32_t { return static_cast<uint32_t>(micros()); };
+    }
+#endif
+
+    if (endpoints == nullptr || count == 0)
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else if (clock == nullptr)
+    {
+        status = kArdPacketConfigInvalidClock;
+    }
+    else
+    {
+        m_unit = config.unit;
+        m_clock = clock;
+        m_endpoints = endpoints;
+        m_count = count;
+        m_next = 0;
+    }
+    return status;
+}
+
+inline void ArdPacketPoller::Poll()
+{
+    // rotate the first endpoint so none is always served last
+    for (size_t index = 0; index < m_count; ++index)
+    {
+        Service(*m_endpoints[(m_next + index) % m_count]);
+    }
+    m_next = (m_count > 0 ? (m_next + 1) % m_count : 0);
+}
+
+inline void ArdPacketPoller::Service(ArdPacketPollerEndpoint &endpoint)
+{
+    const uint32_t now = m_clock();
+    const bool receive_waiting = (endpoint.m_budget.Waiting() > 0);
+    if (receive_waiting && !endpoint.m_receive_waiting)
+    {
+        endpoint.m_receive_waiting = true;
+        endpoint.m_receive_since = now;
+    }
+    if (endpoint.m_send_payload != nullptr && !endpoint.m_send_waiting)
+    {
+        endpoint.m_send_waiting = true;
+        endpoint.m_send_since = now;
+    }
+
+    if (receive_waiting || endpoint.m_send_payload != nullptr)
+    {
+        endpoint.m_deficit += endpoint.m_quantum;
+    }
+    else
+    {
+        // idle endpoints keep no budget, bytes replayed after a failed packet are already in memory
+        endpoint.m_deficit = 0;
+        endpoint.m_budget.Start(0);
+        Receive(endpoint, now);
+    }
+
+    bool progress = true;
+    while (progress && endpoint.m_deficit > 0)
+    {
+        endpoint.m_budget.Start(m_unit == kArdPacketPollerUnitBytes ? endpoint.m_deficit : SIZE_MAX);
+        bool completed = false;
+        if (endpoint.m_send_payload != nullptr &&
+            endpoint.m_packet.SendPayload(endpoint.m_send_info, endpoint.m_send_payload) == kArdPacketStatusDone)
+        {
+            endpoint.m_send_payload = nullptr;
+            endpoint.m_send_waiting = false;
+            endpoint.m_stats.packets_sent++;
+            Record(endpoint, endpoint.m_send_since);
+            endpoint.m_deficit -= (m_unit == kArdPacketPollerUnitPackets ? 1 : 0);
+            completed = true;
+        }
+        if (endpoint.m_deficit > 0 &&
+            (m_unit == kArdPacketPollerUnitPackets || endpoint.m_budget.Used() < endpoint.m_deficit))
+        {
+            completed = Receive(endpoint, now) || completed;
+        }
+
+        const size_t used = endpoint.m_budget.Used();
+        endpoint.m_stats.bytes += static_cast<uint32_t>(used);
+        if (m_unit == kArdPacketPollerUnitBytes)
+        {
+            endpoint.m_deficit = (used < endpoint.m_deficit ? endpoint.m_deficit - used : 0);
+        }
+        progress = (used > 0 || completed);
+    }
+}
+
+inline bool ArdPacketPoller::Receive(ArdPacketPollerEndpoint &endpoint, const uint32_t now)
+{
+    const eArdPacketStatus status =
+        endpoint.m_packet.ReceivePayload(endpoint.m_payload_size, endpoint.m_info, endpoint.m_payload);
+    const bool completed = (status == kArdPacketStatusDone);
+    if (completed)
+    {
+        endpoint.m_stats.packets_received++;
+        Record(endpoint, endpoint.m_receive_since);
+        // bytes left behind belong to a packet that waited since this poll
+        endpoint.m_receive_waiting = (endpoint.m_budget.Waiting() > 0);
+        endpoint.m_receive_since = now;
+        endpoint.m_deficit -= (m_unit == kArdPacketPollerUnitPackets && endpoint.m_deficit > 0 ? 1 : 0);
+        m_handler.OnPayload(endpoint, endpoint.m_info, endpoint.m_payload);
+    }
+    else if (ArdPacketStatusFrameError(status))
+    {
+        endpoint.m_stats.receive_errors++;
+        m_handler.OnReceiveError(endpoint, status);
+    }
+    return completed;
+}
+
+inline void ArdPacketPoller::Record(ArdPacketPollerEndpoint &endpoint, const uint32_t since)
+{
+    ArdPacketPollerStats &stats = endpoint.m_stats;
+    const uint32_t latency = m_clock() - since;
+    stats.last_latency_us = latency;
+    stats.max_latency_us = (latency > stats.max_latency_us ? latency : stats.max_latency_us);
+    stats.average_latency_us =
+        (stats.packets_received + stats.packets_sent > 1 ? stats.average_latency_us - stats.average_latency_us / 8 +
+                                                               latency / 8
+                                                         : latency);
+}
+
+#endif
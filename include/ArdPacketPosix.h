@@ -0,0 +1,775 @@
+
+#ifndef ARD_PACKET_POSIX_H
+#define ARD_PACKET_POSIX_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ArdPacket.h"
+#include "ArdPacketDatagram.h"
+
+/**
+ * @brief Size of the write buffer of POSIX streams
+ *
+ * @c ArdPacket writes as many bytes as @c availableForWrite reports, so bytes the kernel does not accept right away
+ * are kept here and written on the next call.
+ */
+#ifndef ARD_PACKET_POSIX_WRITE_BUFFER_SIZE
+#define ARD_PACKET_POSIX_WRITE_BUFFER_SIZE 4096
+#endif
+
+/**
+ * @brief Size of the write buffer of POSIX streams
+ */
+static constexpr size_t kArdPacketPosixWriteBufferSize = ARD_PACKET_POSIX_WRITE_BUFFER_SIZE;
+
+/**
+ * @brief Number of datagrams received or sent per system call by @c ArdPacketUdp
+ */
+#ifndef ARD_PACKET_UDP_BATCH_SIZE
+#define ARD_PACKET_UDP_BATCH_SIZE 16
+#endif
+
+/**
+ * @brief Largest datagram handled by @c ArdPacketUdp
+ */
+#ifndef ARD_PACKET_UDP_MAX_DATAGRAM_SIZE
+#define ARD_PACKET_UDP_MAX_DATAGRAM_SIZE 1472
+#endif
+
+/**
+ * @brief Number of datagrams received or sent per system call by @c ArdPacketUdp
+ */
+static constexpr size_t kArdPacketUdpBatchSize = ARD_PACKET_UDP_BATCH_SIZE;
+
+/**
+ * @brief Largest datagram handled by @c ArdPacketUdp
+ */
+static constexpr size_t kArdPacketUdpMaxDatagramSize = ARD_PACKET_UDP_MAX_DATAGRAM_SIZE;
+
+/**
+ * @brief Make a file descriptor non-blocking
+ *
+ * @param fd
+ * @return true on success
+ */
+inline bool ArdPacketPosixSetNonBlocking(const int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+    return (flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+/**
+ * @brief Non-blocking stream over a file descriptor (pipe, pty, socket or serial port)
+ *
+ * @c available is backed by @c FIONREAD and reads and writes are single system calls. The descriptor is not owned
+ * and must be non-blocking.
+ */
+class ArdPacketFd : public ArdPacketStreamInterface
+{
+   public:
+    ArdPacketFd() = default;
+    explicit ArdPacketFd(const int fd) : m_fd(fd), m_connected(fd >= 0) {}
+    virtual ~ArdPacketFd() = default;
+
+    ArdPacketFd(const ArdPacketFd &) = delete;
+    ArdPacketFd &operator=(const ArdPacketFd &) = delete;
+
+    int available() override;
+    int read() override;
+    size_t read(uint8_t *buffer, size_t size) override;
+
+    int availableForWrite() override;
+    size_t write(uint8_t value) override
+    {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    /**
+     * @brief Write buffered bytes the kernel did not accept yet
+     *
+     * @return number of bytes still buffered
+     */
+    size_t Flush();
+
+    /**
+     * @brief Use another file descriptor, dropping buffered bytes
+     */
+    void SetFd(int fd);
+
+    /**
+     * @brief File descriptor, -1 if none
+     */
+    int Fd() const
+    {
+        return m_fd;
+    }
+
+    /**
+     * @brief False once the far end closed the stream or an error occurred
+     */
+    bool Connected() const
+    {
+        return m_connected;
+    }
+
+   protected:
+    /**
+     * @brief Write without blocking
+     *
+     * @return bytes written, 0 if the kernel buffer is full, -1 on error
+     */
+    virtual ssize_t WriteSome(const uint8_t *buffer, size_t size)
+    {
+        return ::write(m_fd, buffer, size);
+    }
+
+    int m_fd = -1;
+    bool m_connected = false;
+
+   private:
+    void ReadFailed(ssize_t result);
+
+    uint8_t m_write_buffer[kArdPacketPosixWriteBufferSize] = {0};
+    size_t m_write_start = 0;
+    size_t m_write_end = 0;
+};
+
+/**
+ * @brief Serial port (@c /dev/tty*) in raw mode
+ */
+class ArdPacketTty : public ArdPacketFd
+{
+   public:
+    ArdPacketTty() = default;
+    ~ArdPacketTty() override
+    {
+        Close();
+    }
+
+    /**
+     * @brief Open and configure a serial port: raw 8N1, no flow control
+     *
+     * @param path for example @c /dev/ttyUSB0
+     * @param baudrate one of the standard rates from 1200 to 921600
+     * @return true on success
+     */
+    bool Open(const char *path, uint32_t baudrate);
+
+    /**
+     * @brief Close the serial port
+     */
+    void Close();
+
+    /**
+     * @brief termios speed for a baudrate, @c B0 if not supported
+     */
+    static speed_t Speed(uint32_t baudrate);
+};
+
+/**
+ * @brief TCP connection with Nagle's algorithm disabled
+ */
+class ArdPacketTcp : public ArdPacketFd
+{
+   public:
+    ArdPacketTcp() = default;
+    ~ArdPacketTcp() override
+    {
+        Close();
+    }
+
+    /**
+     * @brief Connect to a server (blocks until connected)
+     *
+     * @param host name or address
+     * @param port
+     * @return true on success
+     */
+    bool Connect(const char *host, uint16_t port);
+
+    /**
+     * @brief Accept a pending connection from a listening socket
+     *
+     * @param listen_fd socket from @c Listen
+     * @return true on success, false if no connection is pending
+     */
+    bool Accept(int listen_fd);
+
+    /**
+     * @brief Close the connection
+     */
+    void Close();
+
+    /**
+     * @brief Create a non-blocking listening socket
+     *
+     * @param host address to bind, @c nullptr for any
+     * @param port 0 to choose a free port
+     * @return socket or -1 on error
+     */
+    static int Listen(const char *host, uint16_t port);
+
+    /**
+     * @brief Port a socket is bound to
+     *
+     * @param fd
+     * @return port or 0 on error
+     */
+    static uint16_t LocalPort(int fd);
+
+    /**
+     * @brief Prepare a connected socket: non-blocking and no delay
+     *
+     * @param fd
+     * @return true on success
+     */
+    static bool Setup(int fd);
+
+   protected:
+    ssize_t WriteSome(const uint8_t *buffer, size_t size) override
+    {
+        // closed connections report EPIPE instead of raising SIGPIPE
+        return ::send(m_fd, buffer, size, MSG_NOSIGNAL);
+    }
+};
+
+/**
+ * @brief Non-blocking UDP socket (IPv4) for @c ArdPacketDatagram
+ *
+ * Datagrams are received with @c recvmmsg and sent with @c sendmmsg, up to @c ARD_PACKET_UDP_BATCH_SIZE per system
+ * call. Sent datagrams are queued until @c FlushDatagrams or until the queue is full.
+ */
+class ArdPacketUdp : public ArdPacketDatagramInterface
+{
+   public:
+    ArdPacketUdp() = default;
+    ~ArdPacketUdp()
+    {
+        Close();
+    }
+
+    ArdPacketUdp(const ArdPacketUdp &) = delete;
+    ArdPacketUdp &operator=(const ArdPacketUdp &) = delete;
+
+    /**
+     * @brief Open a socket bound to a local address
+     *
+     * Until @c Connect is called, datagrams are sent to the sender of the last datagram received.
+     *
+     * @param host address to bind, @c nullptr for any
+     * @param port 0 to choose a free port
+     * @return true on success
+     */
+    bool Open(const char *host, uint16_t port);
+
+    /**
+     * @brief Send to and only receive from one peer
+     *
+     * @param host address
+     * @param port
+     * @return true on success
+     */
+    bool Connect(const char *host, uint16_t port);
+
+    /**
+     * @brief Send queued datagrams and close the socket
+     */
+    void Close();
+
+    /**
+     * @brief File descriptor, -1 if none
+     */
+    int Fd() const
+    {
+        return m_fd;
+    }
+
+    /**
+     * @brief Port the socket is bound to
+     */
+    uint16_t Port() const;
+
+    size_t ReceiveDatagram(uint8_t *buffer, size_t size) override;
+    bool SendDatagram(const uint8_t *buffer, size_t size) override;
+    void FlushDatagrams() override;
+
+   private:
+    int m_fd = -1;
+    bool m_connected = false;
+    struct sockaddr_in m_peer = {};
+
+    // received batch
+    uint8_t m_rx_buffers[kArdPacketUdpBatchSize][kArdPacketUdpMaxDatagramSize] = {{0}};
+    struct sockaddr_in m_rx_addresses[kArdPacketUdpBatchSize] = {};
+    struct iovec m_rx_iovecs[kArdPacketUdpBatchSize] = {};
+    struct mmsghdr m_rx_messages[kArdPacketUdpBatchSize] = {};
+    size_t m_rx_count = 0;
+    size_t m_rx_next = 0;
+
+    // queued batch
+    uint8_t m_tx_buffers[kArdPacketUdpBatchSize][kArdPacketUdpMaxDatagramSize] = {{0}};
+    struct sockaddr_in m_tx_addresses[kArdPacketUdpBatchSize] = {};
+    struct iovec m_tx_iovecs[kArdPacketUdpBatchSize] = {};
+    struct mmsghdr m_tx_messages[kArdPacketUdpBatchSize] = {};
+    size_t m_tx_count = 0;
+    size_t m_tx_sent = 0;
+};
+
+// ArdPacketFd inline methods
+
+inline int ArdPacketFd::available()
+{
+    int size = 0;
+    if (m_fd < 0 || ioctl(m_fd, FIONREAD, &size) != 0)
+    {
+        size = 0;
+    }
+    return size;
+}
+
+inline int ArdPacketFd::read()
+{
+    uint8_t value = 0;
+    return (read(&value, 1) == 1 ? value : -1);
+}
+
+inline size_t ArdPacketFd::read(uint8_t *buffer, const size_t size)
+{
+    size_t bytes_read = 0;
+    if (m_fd >= 0 && size > 0)
+    {
+        const ssize_t result = ::read(m_fd, buffer, size);
+        if (result > 0)
+        {
+            bytes_read = static_cast<size_t>(result);
+        }
+        else
+        {
+            ReadFailed(result);
+        }
+    }
+    return bytes_read;
+}
+
+inline void ArdPacketFd::ReadFailed(const ssize_t result)
+{
+    // end of stream, or an error other than no data yet
+    if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        m_connected = false;
+    }
+}
+
+inline int ArdPacketFd::availableForWrite()
+{
+    int size = 0;
+    if (m_fd >= 0 && m_connected)
+    {
+        Flush();
+        size = static_cast<int>(kArdPacketPosixWriteBufferSize - (m_write_end - m_write_start));
+    }
+    return size;
+}
+
+inline size_t ArdPacketFd::write(const uint8_t *buffer, const size_t size)
+{
+    size_t bytes_written = 0;
+    if (m_fd >= 0 && m_connected)
+    {
+        if (m_write_start > 0)
+        {
+            memmove(m_write_buffer, &m_write_buffer[m_write_start], m_write_end - m_write_start);
+            m_write_end -= m_write_start;
+            m_write_start = 0;
+        }
+        const size_t free_size = kArdPacketPosixWriteBufferSize - m_write_end;
+        bytes_written = (size < free_size ? size : free_size);
+        memcpy(&m_write_buffer[m_write_end], buffer, bytes_written);
+        m_write_end += bytes_written;
+        Flush();
+    }
+    return bytes_written;
+}
+
+inline size_t ArdPacketFd::Flush()
+{
+    bool continue_write = (m_fd >= 0 && m_connected);
+    while (continue_write && m_write_start < m_write_end)
+    {
+        const ssize_t result = WriteSome(&m_write_buffer[m_write_start], m_write_end - m_write_start);
+        if (result > 0)
+        {
+            m_write_start += static_cast<size_t>(result);
+        }
+        else if (result < 0 && errno == EINTR)
+        {
+            continue_write = true;
+        }
+        else
+        {
+            // kernel buffer is full, or the stream failed
+            m_connected = (result >= 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+            continue_write = false;
+        }
+    }
+    if (m_write_start == m_write_end)
+    {
+        m_write_start = 0;
+        m_write_end = 0;
+    }
+    return m_write_end - m_write_start;
+}
+
+inline void ArdPacketFd::SetFd(const int fd)
+{
+    m_fd = fd;
+    m_connected = (fd >= 0);
+    m_write_start = 0;
+    m_write_end = 0;
+}
+
+// ArdPacketTty inline methods
+
+inline speed_t ArdPacketTty::Speed(const uint32_t baudrate)
+{
+    speed_t speed = B0;
+    switch (baudrate)
+    {
+        case 1200:
+            speed = B1200;
+            break;
+        case 2400:
+            speed = B2400;
+            break;
+        case 4800:
+            speed = B4800;
+            break;
+        case 9600:
+            speed = B9600;
+            break;
+        case 19200:
+            speed = B19200;
+            break;
+        case 38400:
+            speed = B38400;
+            break;
+        case 57600:
+            speed = B57600;
+            break;
+        case 115200:
+            speed = B115200;
+            break;
+        case 230400:
+            speed = B230400;
+            break;
+#ifdef B460800
+        case 460800:
+            speed = B460800;
+            break;
+#endif
+#ifdef B921600
+        case 921600:
+            speed = B921600;
+            break;
+#endif
+        default:
+            speed = B0;
+            break;
+    }
+    return speed;
+}
+
+inline bool ArdPacketTty::Open(const char *path, const uint32_t baudrate)
+{
+    Close();
+    const speed_t speed = Speed(baudrate);
+    int fd = (speed != B0 ? open(path, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1);
+
+    struct termios options = {};
+    if (fd >= 0 && tcgetattr(fd, &options) == 0)
+    {
+        // raw 8N1, return immediately from read
+        cfmakeraw(&options);
+        options.c_cflag |= (CLOCAL | CREAD);
+        options.c_cflag &= ~(CSTOPB | CRTSCTS);
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        cfsetispeed(&options, speed);
+        cfsetospeed(&options, speed);
+    }
+    if (fd >= 0 && tcsetattr(fd, TCSANOW, &options) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        tcflush(fd, TCIOFLUSH);
+    }
+    SetFd(fd);
+    return (fd >= 0);
+}
+
+inline void ArdPacketTty::Close()
+{
+    if (m_fd >= 0)
+    {
+        Flush();
+        close(m_fd);
+    }
+    SetFd(-1);
+}
+
+// ArdPacketTcp inline methods
+
+inline bool ArdPacketTcp::Setup(const int fd)
+{
+    const int no_delay = 1;
+    return (ArdPacketPosixSetNonBlocking(fd) &&
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) == 0);
+}
+
+inline bool ArdPacketTcp::Connect(const char *host, const uint16_t port)
+{
+    Close();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", static_cast<unsigned int>(port));
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = nullptr;
+
+    int fd = -1;
+    if (getaddrinfo(host, service, &hints, &addresses) == 0)
+    {
+        for (struct addrinfo *address = addresses; address != nullptr && fd < 0; address = address->ai_next)
+        {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd >= 0 && (connect(fd, address->ai_addr, address->ai_addrlen) != 0 || !Setup(fd)))
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+    }
+    SetFd(fd);
+    return (fd >= 0);
+}
+
+inline bool ArdPacketTcp::Accept(const int listen_fd)
+{
+    Close();
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd >= 0 && !Setup(fd))
+    {
+        close(fd);
+        fd = -1;
+    }
+    SetFd(fd);
+    return (fd >= 0);
+}
+
+inline void ArdPacketTcp::Close()
+{
+    if (m_fd >= 0)
+    {
+        Flush();
+        close(m_fd);
+    }
+    SetFd(-1);
+}
+
+inline int ArdPacketTcp::Listen(const char *host, const uint16_t port)
+{
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    int fd = -1;
+    if (host == nullptr || inet_pton(AF_INET, host, &address.sin_addr) == 1)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+    }
+
+    const int reuse = 1;
+    if (fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+                    bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+                    listen(fd, SOMAXCONN) != 0 || !ArdPacketPosixSetNonBlocking(fd)))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+inline uint16_t ArdPacketTcp::LocalPort(const int fd)
+{
+    struct sockaddr_in address = {};
+    socklen_t address_size = sizeof(address);
+    uint16_t port = 0;
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&address), &address_size) == 0)
+    {
+        port = ntohs(address.sin_port);
+    }
+    return port;
+}
+
+// ArdPacketUdp inline methods
+
+inline bool ArdPacketUdp::Open(const char *host, const uint16_t port)
+{
+    Close();
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    int fd = -1;
+    if (host == nullptr || inet_pton(AF_INET, host, &address.sin_addr) == 1)
+    {
+        fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    }
+    if (fd >= 0 && (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+                    !ArdPacketPosixSetNonBlocking(fd)))
+    {
+        close(fd);
+        fd = -1;
+    }
+    m_fd = fd;
+    return (fd >= 0);
+}
+
+inline bool ArdPacketUdp::Connect(const char *host, const uint16_t port)
+{
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    m_connected = (m_fd >= 0 && host != nullptr && inet_pton(AF_INET, host, &address.sin_addr) == 1 &&
+                   connect(m_fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0);
+    if (m_connected)
+    {
+        m_peer = address;
+    }
+    return m_connected;
+}
+
+inline void ArdPacketUdp::Close()
+{
+    if (m_fd >= 0)
+    {
+        FlushDatagrams();
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_connected = false;
+    m_peer = {};
+    m_rx_count = 0;
+    m_rx_next = 0;
+    m_tx_count = 0;
+    m_tx_sent = 0;
+}
+
+inline uint16_t ArdPacketUdp::Port() const
+{
+    return ArdPacketTcp::LocalPort(m_fd);
+}
+
+inline size_t ArdPacketUdp::ReceiveDatagram(uint8_t *buffer, const size_t size)
+{
+    if (m_rx_next == m_rx_count && m_fd >= 0)
+    {
+        // receive a batch
+        for (size_t index = 0; index < kArdPacketUdpBatchSize; ++index)
+        {
+            m_rx_iovecs[index] = {m_rx_buffers[index], kArdPacketUdpMaxDatagramSize};
+            m_rx_messages[index] = {};
+            m_rx_messages[index].msg_hdr.msg_name = &m_rx_addresses[index];
+            m_rx_messages[index].msg_hdr.msg_namelen = sizeof(m_rx_addresses[index]);
+            m_rx_messages[index].msg_hdr.msg_iov = &m_rx_iovecs[index];
+            m_rx_messages[index].msg_hdr.msg_iovlen = 1;
+        }
+        const int count = recvmmsg(m_fd, m_rx_messages, kArdPacketUdpBatchSize, MSG_DONTWAIT, nullptr);
+        m_rx_count = (count > 0 ? static_cast<size_t>(count) : 0);
+        m_rx_next = 0;
+    }
+
+    size_t datagram_size = 0;
+    while (datagram_size == 0 && m_rx_next < m_rx_count)
+    {
+        const struct mmsghdr &message = m_rx_messages[m_rx_next];
+        // truncated datagrams are dropped
+        if ((message.msg_hdr.msg_flags & MSG_TRUNC) == 0 && message.msg_len > 0 && message.msg_len <= size)
+        {
+            datagram_size = message.msg_len;
+            memcpy(buffer, m_rx_buffers[m_rx_next], datagram_size);
+            m_peer = (m_connected ? m_peer : m_rx_addresses[m_rx_next]);
+        }
+        m_rx_next++;
+    }
+    return datagram_size;
+}
+
+inline bool ArdPacketUdp::SendDatagram(const uint8_t *buffer, const size_t size)
+{
+    if (m_tx_count == kArdPacketUdpBatchSize)
+    {
+        FlushDatagrams();
+    }
+    const bool queued = (m_fd >= 0 && m_tx_count < kArdPacketUdpBatchSize && size <= kArdPacketUdpMaxDatagramSize &&
+                         (m_connected || m_peer.sin_family == AF_INET));
+    if (queued)
+    {
+        memcpy(m_tx_buffers[m_tx_count], buffer, size);
+        m_tx_addresses[m_tx_count] = m_peer;
+        m_tx_iovecs[m_tx_count] = {m_tx_buffers[m_tx_count], size};
+        m_tx_messages[m_tx_count] = {};
+        m_tx_messages[m_tx_count].msg_hdr.msg_name = (m_connected ? nullptr : &m_tx_addresses[m_tx_count]);
+        m_tx_messages[m_tx_count].msg_hdr.msg_namelen = (m_connected ? 0 : sizeof(m_tx_addresses[m_tx_count]));
+        m_tx_messages[m_tx_count].msg_hdr.msg_iov = &m_tx_iovecs[m_tx_count];
+        m_tx_messages[m_tx_count].msg_hdr.msg_iovlen = 1;
+        m_tx_count++;
+    }
+    return queued;
+}
+
+inline void ArdPacketUdp::FlushDatagrams()
+{
+    bool continue_send = (m_fd >= 0);
+    while (continue_send && m_tx_sent < m_tx_count)
+    {
+        const int count = sendmmsg(m_fd, &m_tx_messages[m_tx_sent], static_cast<unsigned int>(m_tx_count - m_tx_sent),
+                                   MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (count > 0)
+        {
+            m_tx_sent += static_cast<size_t>(count);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ENOBUFS)
+        {
+            // socket buffer is full, try again later
+            continue_send = (errno == EINTR);
+        }
+        else
+        {
+            // datagrams are unreliable, drop the one that failed (e.g. refused by the peer)
+            m_tx_sent++;
+        }
+    }
+    if (m_tx_sent == m_tx_count)
+    {
+        m_tx_count = 0;
+        m_tx_sent = 0;
+    }
+}
+
+#endif
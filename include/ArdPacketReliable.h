@@ -0,0 +1,682 @@
+
+#ifndef ARD_PACKET_RELIABLE_H
+#define ARD_PACKET_RELIABLE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Largest number of frames in flight
+ *
+ * Sizes the per-frame bookkeeping of @c ArdPacketReliable. Frame data is kept in caller provided storage.
+ */
+#ifndef ARD_PACKET_RELIABLE_MAX_WINDOW_SIZE
+#if defined(__AVR__)
+#define ARD_PACKET_RELIABLE_MAX_WINDOW_SIZE 4
+#else
+#define ARD_PACKET_RELIABLE_MAX_WINDOW_SIZE 32
+#endif
+#endif
+
+/**
+ * @brief Largest number of frames in flight
+ */
+static constexpr size_t kArdPacketReliableMaxWindowSize = ARD_PACKET_RELIABLE_MAX_WINDOW_SIZE;
+
+/**
+ * @brief Size of the sequence number prepended to every data frame payload
+ */
+static constexpr size_t kArdPacketReliableSequenceSize = 1;
+
+/**
+ * @brief Size of an ACK frame payload: cumulative ACK followed by a 32 bit selective ACK bitmap
+ */
+static constexpr size_t kArdPacketReliableAckSize = 5;
+
+static_assert(kArdPacketReliableMaxWindowSize <= 32, "selective ACK bitmap covers 32 frames");
+
+/**
+ * @brief Reliable delivery configuration
+ */
+struct ArdPacketReliableConfig
+{
+    /**
+     * @brief Number of frames sent before waiting for an ACK
+     *
+     * Both ends must use the same window size, up to @c ARD_PACKET_RELIABLE_MAX_WINDOW_SIZE.
+     */
+    uint8_t window_size = 8;
+
+    /**
+     * @brief Maximum size of application payload
+     *
+     * The packet @c max_payload_size must be at least one byte larger for the sequence number.
+     */
+    size_t max_payload_size = 0;
+
+    /**
+     * @brief Message type reserved for ACK frames
+     */
+    uint32_t ack_message_type = 0;
+
+    /**
+     * @brief Retransmit timeout before the first round trip time sample
+     */
+    uint32_t initial_timeout_ms = 250;
+
+    /**
+     * @brief Lower bound of the retransmit timeout
+     */
+    uint32_t min_timeout_ms = 20;
+
+    /**
+     * @brief Upper bound of the retransmit timeout (after backoff)
+     */
+    uint32_t max_timeout_ms = 4000;
+
+    /**
+     * @brief Millisecond clock, defaults to @c millis on Arduino
+     */
+    ArdPacketClock clock = nullptr;
+};
+
+/**
+ * @brief Selective repeat reliable delivery on top of @c ArdPacket
+ *
+ * Data frames carry an 8 bit sequence number in front of the payload. The receiver buffers out of order frames,
+ * delivers them in order and answers with ACK frames holding the next sequence number to deliver (cumulative ACK)
+ * and a bitmap of the frames already buffered after it (selective ACK). Unacknowledged frames are retransmitted
+ * after a timeout adapted to the measured round trip time (RFC 6298, Karn's algorithm, exponential backoff).
+ *
+ * Frames stay in the bounded retransmit buffer until the receiving application has read them, so a slow reader
+ * stalls the sender instead of dropping frames. Call @c Poll regularly to receive ACKs and retransmit.
+ *
+ * A queued frame the packet refuses to write, after the packet was reconfigured, is replaced by a frame of
+ * @c ack_message_type holding only its sequence number. The receiver skips that sequence number, so both windows
+ * keep moving.
+ */
+class ArdPacketReliable
+{
+   public:
+    explicit ArdPacketReliable(ArdPacket &packet) : m_packet(packet) {}
+
+    /**
+     * @brief Storage size needed for the retransmit and reorder buffers
+     *
+     * @param window_size frames in flight
+     * @param max_payload_size maximum size of application payload
+     * @return size in bytes
+     */
+    static size_t StorageSize(size_t window_size, size_t max_payload_size);
+
+    /**
+     * @brief Configure reliable delivery (the packet must already be configured)
+     *
+     * @param config
+     * @param storage at least @c StorageSize bytes, owned by the caller
+     * @param storage_size
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketReliableConfig &config, uint8_t *storage, size_t storage_size);
+
+    /**
+     * @brief Queue payload for reliable delivery and start sending it
+     *
+     * @param info
+     * @param payload copied into the retransmit buffer
+     * @return @c kArdPacketStatusDone when queued, @c kArdPacketStatusWindowFull when the window is full,
+     * @c kArdPacketStatusInvalidMessageType or @c kArdPacketStatusInvalidPayloadSize when the packet cannot carry the
+     * frame
+     */
+    eArdPacketStatus Send(const ArdPacketPayloadInfo &info, const uint8_t *payload);
+
+    /**
+     * @brief Receive the next payload in order
+     *
+     * @param max_payload_size
+     * @param info
+     * @param payload
+     * @return @c kArdPacketStatusDone when a payload is copied, @c kArdPacketStatusNotAvailable otherwise
+     */
+    eArdPacketStatus Receive(size_t max_payload_size, ArdPacketPayloadInfo &info, uint8_t *payload);
+
+    /**
+     * @brief Read incoming frames, send ACKs and retransmit timed out frames
+     */
+    void Poll();
+
+    /**
+     * @brief Number of frames sent and not yet delivered to the receiving application
+     */
+    size_t InFlight() const
+    {
+        return static_cast<uint8_t>(m_tx_next - m_tx_base);
+    }
+
+    /**
+     * @brief Current retransmit timeout
+     */
+    uint32_t RetransmitTimeout() const
+    {
+        return m_timeout_ms;
+    }
+
+    /**
+     * @brief Number of retransmitted frames
+     */
+    uint32_t Retransmissions() const
+    {
+        return m_retransmissions;
+    }
+
+   private:
+    enum eArdPacketReliableWrite
+    {
+        kArdPacketReliableWriteNone,
+        kArdPacketReliableWriteData,
+        kArdPacketReliableWriteAck
+    };
+
+    struct ArdPacketReliableTxSlot
+    {
+        uint32_t message_type = 0;
+        size_t payload_size = 0;
+        uint32_t sent_ms = 0;
+        uint8_t transmissions = 0;
+        bool acked = false;
+        bool pending = false;
+    };
+
+    struct ArdPacketReliableRxSlot
+    {
+        uint32_t message_type = 0;
+        size_t payload_size = 0;
+        bool received = false;
+        bool skipped = false;
+    };
+
+    static size_t FrameSize(size_t max_payload_size);
+
+    size_t TxSlot(size_t offset) const
+    {
+        return (m_tx_base_slot + offset) % m_config.window_size;
+    }
+    size_t RxSlot(size_t offset) const
+    {
+        return (m_rx_base_slot + offset) % m_config.window_size;
+    }
+    uint8_t *TxFrame(size_t slot) const
+    {
+        return &m_storage[slot * m_frame_size];
+    }
+    uint8_t *RxFrame(size_t slot) const
+    {
+        return &m_storage[(m_config.window_size + slot) * m_frame_size];
+    }
+    uint8_t *ScratchFrame() const
+    {
+        return &m_storage[2 * m_config.window_size * m_frame_size];
+    }
+
+    void PollRead();
+    void PollWrite();
+    void CheckTimers();
+    bool FrameAllowed(const ArdPacketPayloadInfo &info) const;
+    void ProcessData(const ArdPacketPayloadInfo &info, const uint8_t *frame);
+    void ProcessAck(const uint8_t *frame, size_t frame_size);
+    void Slide();
+    void UpdateTimeout(uint32_t sample_ms);
+    bool StartWrite();
+
+    // configuration
+    ArdPacketReliableConfig m_config = {};
+    ArdPacketClock m_clock = nullptr;
+    uint8_t *m_storage = nullptr;
+    size_t m_frame_size = 0;
+
+    // transmit window
+    ArdPacketReliableTxSlot m_tx[kArdPacketReliableMaxWindowSize] = {};
+    uint8_t m_tx_base = 0;
+    uint8_t m_tx_next = 0;
+    size_t m_tx_base_slot = 0;
+    size_t m_tx_delivered = 0;
+
+    // receive window
+    ArdPacketReliableRxSlot m_rx[kArdPacketReliableMaxWindowSize] = {};
+    uint8_t m_rx_expected = 0;
+    size_t m_rx_base_slot = 0;
+    bool m_ack_pending = false;
+
+    // frame being read
+    ArdPacketPayloadInfo m_read_info = {};
+
+    // frame being written
+    eArdPacketReliableWrite m_write = kArdPacketReliableWriteNone;
+    size_t m_write_slot = 0;
+    ArdPacketPayloadInfo m_write_info = {};
+    uint8_t m_ack[kArdPacketReliableAckSize] = {0};
+
+    // retransmit timeout
+    uint32_t m_srtt_ms = 0;
+    uint32_t m_rttvar_ms = 0;
+    uint32_t m_timeout_ms = 0;
+    bool m_rtt_valid = false;
+    uint32_t m_retransmissions = 0;
+
+    // packet
+    ArdPacket &m_packet;
+};
+
+// inline methods
+
+inline size_t ArdPacketReliable::FrameSize(const size_t max_payload_size)
+{
+    const size_t data_size = kArdPacketReliableSequenceSize + max_payload_size;
+    return (data_size > kArdPacketReliableAckSize ? data_size : kArdPacketReliableAckSize);
+}
+
+inline size_t ArdPacketReliable::StorageSize(const size_t window_size, const size_t max_payload_size)
+{
+    // retransmit buffer, reorder buffer and one incoming frame
+    return (2 * window_size + 1) * FrameSize(max_payload_size);
+}
+
+inline eArdPacketConfigStatus ArdPacketReliable::Configure(const ArdPacketReliableConfig &config, uint8_t *storage,
+                                                           const size_t storage_size)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    ArdPacketClock clock = config.clock;
+#ifndef NATIVE_TEST_BUILD
+    if (clock == nullptr)
+    {
+        clock = []() -> uint32_t { return static_cast<uint32_t>(millis()); };
+    }
+#endif
+
+    if (config.window_size == 0 || config.window_size > kArdPacketReliableMaxWindowSize)
+    {
+        status = kArdPacketConfigInvalidWindowSize;
+    }
+    else if (config.max_payload_size == 0)
+    {
+        status = kArdPacketConfigInvalidMaxPayloadSize;
+    }
+    else if (storage == nullptr || storage_size < StorageSize(config.window_size, config.max_payload_size))
+    {
+        status = kArdPacketConfigInvalidStorage;
+    }
+    else if (clock == nullptr || config.min_timeout_ms == 0 || config.min_timeout_ms > config.max_timeout_ms)
+    {
+        status = kArdPacketConfigInvalidClock;
+    }
+    else
+    {
+        m_config = config;
+        m_clock = clock;
+        m_storage = storage;
+        m_frame_size = FrameSize(config.max_payload_size);
+
+        for (size_t k = 0; k < kArdPacketReliableMaxWindowSize; ++k)
+        {
+            m_tx[k] = ArdPacketReliableTxSlot();
+            m_rx[k] = ArdPacketReliableRxSlot();
+        }
+        m_tx_base = 0;
+        m_tx_next = 0;
+        m_tx_base_slot = 0;
+        m_tx_delivered = 0;
+        m_rx_expected = 0;
+        m_rx_base_slot = 0;
+        m_ack_pending = false;
+        m_write = kArdPacketReliableWriteNone;
+
+        m_srtt_ms = 0;
+        m_rttvar_ms = 0;
+        m_timeout_ms = config.initial_timeout_ms;
+        m_rtt_valid = false;
+        m_retransmissions = 0;
+    }
+
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketReliable::Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusStart;
+    if (m_storage == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else if (info.message_type == m_config.ack_message_type || info.message_type > m_packet.GetMaxMessageType())
+    {
+        status = kArdPacketStatusInvalidMessageType;
+    }
+    else if (info.payload_size == 0 || info.payload_size > m_config.max_payload_size || !FrameAllowed(info))
+    {
+        status = kArdPacketStatusInvalidPayloadSize;
+    }
+    else if (InFlight() >= m_config.window_size)
+    {
+        status = kArdPacketStatusWindowFull;
+    }
+    else
+    {
+        // copy into retransmit buffer
+        const size_t slot = TxSlot(InFlight());
+        uint8_t *frame = TxFrame(slot);
+        frame[0] = m_tx_next;
+        memcpy(&frame[kArdPacketReliableSequenceSize], payload, info.payload_size);
+        m_tx[slot] = ArdPacketReliableTxSlot();
+        m_tx[slot].message_type = info.message_type;
+        m_tx[slot].payload_size = info.payload_size;
+        m_tx[slot].pending = true;
+        m_tx_next++;
+
+        PollWrite();
+        status = kArdPacketStatusDone;
+    }
+    return status;
+}
+
+inline eArdPacketStatus ArdPacketReliable::Receive(const size_t max_payload_size, ArdPacketPayloadInfo &info,
+                                                   uint8_t *payload)
+{
+    eArdPacketStatus status = kArdPacketStatusNotAvailable;
+    if (m_storage == nullptr)
+    {
+        status = kArdPacketStatusNotConfigured;
+    }
+    else
+    {
+        Poll();
+        while (m_rx[m_rx_base_slot].received && m_rx[m_rx_base_slot].skipped)
+        {
+            // the sender dropped this sequence number, nothing to deliver
+            m_rx[m_rx_base_slot] = ArdPacketReliableRxSlot();
+            m_rx_expected++;
+            m_rx_base_slot = RxSlot(1);
+            m_ack_pending = true;
+        }
+        ArdPacketReliableRxSlot &slot = m_rx[m_rx_base_slot];
+        if (slot.received)
+        {
+            status = (slot.payload_size <= max_payload_size ? kArdPacketStatusDone
+                                                            : kArdPacketStatusInvalidPayloadSize);
+            info.message_type = slot.message_type;
+            info.payload_size = slot.payload_size;
+            if (status == kArdPacketStatusDone)
+            {
+                memcpy(payload, RxFrame(m_rx_base_slot), slot.payload_size);
+            }
+            // delivered (or dropped): advance window and let the sender know
+            slot.received = false;
+            m_rx_expected++;
+            m_rx_base_slot = RxSlot(1);
+            m_ack_pending = true;
+            PollWrite();
+        }
+    }
+    return status;
+}
+
+inline void ArdPacketReliable::Poll()
+{
+    if (m_storage != nullptr)
+    {
+        PollRead();
+        CheckTimers();
+        PollWrite();
+    }
+}
+
+// Private inline methods
+// ----------------------
+
+inline void ArdPacketReliable::PollRead()
+{
+    // bounded so a flood of frames cannot starve the caller
+    const size_t max_frames = 2 * m_config.window_size + 2;
+    uint8_t *frame = ScratchFrame();
+    bool continue_read = true;
+    for (size_t count = 0; count < max_frames && continue_read; ++count)
+    {
+        const eArdPacketStatus status = m_packet.ReceivePayload(m_frame_size, m_read_info, frame);
+        if (status == kArdPacketStatusDone && m_read_info.message_type == m_config.ack_message_type &&
+            m_read_info.payload_size != kArdPacketReliableSequenceSize)
+        {
+            ProcessAck(frame, m_read_info.payload_size);
+        }
+        else if (status == kArdPacketStatusDone)
+        {
+            ProcessData(m_read_info, frame);
+        }
+        // errors consume bytes, keep reading what is left
+        continue_read = ArdPacketStatusFrameConsumed(status);
+    }
+}
+
+inline bool ArdPacketReliable::FrameAllowed(const ArdPacketPayloadInfo &info) const
+{
+    // the sequence number travels in front of the payload
+    ArdPacketPayloadInfo frame_info = info;
+    frame_info.payload_size += kArdPacketReliableSequenceSize;
+    return (frame_info.payload_size <= m_packet.GetMaxPayloadSize(info.message_type) &&
+            m_packet.PayloadSizeAllowed(frame_info));
+}
+
+inline void ArdPacketReliable::ProcessData(const ArdPacketPayloadInfo &info, const uint8_t *frame)
+{
+    // a sequence number alone with the ACK message type marks a frame the sender dropped
+    const bool skipped = (info.message_type == m_config.ack_message_type);
+    if (info.payload_size > kArdPacketReliableSequenceSize || skipped)
+    {
+        const uint8_t sequence = frame[0];
+        const size_t offset = static_cast<uint8_t>(sequence - m_rx_expected);
+        if (offset < m_config.window_size)
+        {
+            const size_t slot = RxSlot(offset);
+            if (!m_rx[slot].received)
+            {
+                m_rx[slot].message_type = info.message_type;
+                m_rx[slot].payload_size = info.payload_size - kArdPacketReliableSequenceSize;
+                m_rx[slot].received = true;
+                m_rx[slot].skipped = skipped;
+                memcpy(RxFrame(slot), &frame[kArdPacketReliableSequenceSize], m_rx[slot].payload_size);
+            }
+            m_ack_pending = true;
+        }
+        else if (static_cast<uint8_t>(m_rx_expected - sequence) <= m_config.window_size)
+        {
+            // already delivered, the ACK was lost
+            m_ack_pending = true;
+        }
+    }
+}
+
+inline void ArdPacketReliable::ProcessAck(const uint8_t *frame, const size_t frame_size)
+{
+    if (frame_size == kArdPacketReliableAckSize)
+    {
+        const size_t cumulative = static_cast<uint8_t>(frame[0] - m_tx_base);
+        const uint32_t selective = static_cast<uint32_t>(frame[1]) | (static_cast<uint32_t>(frame[2]) << 8) |
+                                   (static_cast<uint32_t>(frame[3]) << 16) | (static_cast<uint32_t>(frame[4]) << 24);
+        const size_t in_flight = InFlight();
+        if (cumulative <= in_flight)
+        {
+            const uint32_t now = m_clock();
+            for (size_t offset = 0; offset < in_flight; ++offset)
+            {
+                ArdPacketReliableTxSlot &slot = m_tx[TxSlot(offset)];
+                const bool delivered = (offset < cumulative);
+                const bool buffered = (!delivered && ((selective >> (offset - cumulative)) & 1U) != 0);
+                if ((delivered || buffered) && !slot.acked && slot.transmissions > 0)
+                {
+                    slot.acked = true;
+                    slot.pending = false;
+                    if (slot.transmissions == 1)
+                    {
+                        // Karn: only sample frames sent once
+                        UpdateTimeout(now - slot.sent_ms);
+                    }
+                }
+            }
+            // buffered frames still occupy the receiver window, only delivered frames are released
+            m_tx_delivered = cumulative;
+            Slide();
+        }
+    }
+}
+
+inline void ArdPacketReliable::Slide()
+{
+    // release delivered frames unless the packet is still writing one of them
+    while (m_tx_delivered > 0 && !(m_write == kArdPacketReliableWriteData && m_write_slot == m_tx_base_slot))
+    {
+        m_tx[m_tx_base_slot] = ArdPacketReliableTxSlot();
+        m_tx_base++;
+        m_tx_base_slot = TxSlot(1);
+        m_tx_delivered--;
+    }
+}
+
+inline void ArdPacketReliable::UpdateTimeout(const uint32_t sample_ms)
+{
+    if (!m_rtt_valid)
+    {
+        m_srtt_ms = sample_ms;
+        m_rttvar_ms = sample_ms / 2;
+        m_rtt_valid = true;
+    }
+    else
+    {
+        const uint32_t error = (m_srtt_ms > sample_ms ? m_srtt_ms - sample_ms : sample_ms - m_srtt_ms);
+        m_rttvar_ms = (3 * m_rttvar_ms + error) / 4;
+        m_srtt_ms = (7 * m_srtt_ms + sample_ms) / 8;
+    }
+    uint32_t timeout = m_srtt_ms + (4 * m_rttvar_ms > 1 ? 4 * m_rttvar_ms : 1);
+    timeout = (timeout > m_config.min_timeout_ms ? timeout : m_config.min_timeout_ms);
+    m_timeout_ms = (timeout < m_config.max_timeout_ms ? timeout : m_config.max_timeout_ms);
+}
+
+inline void ArdPacketReliable::CheckTimers()
+{
+    const uint32_t now = m_clock();
+    bool expired = false;
+    const size_t in_flight = InFlight();
+    for (size_t offset = 0; offset < in_flight; ++offset)
+    {
+        const size_t slot_index = TxSlot(offset);
+        ArdPacketReliableTxSlot &slot = m_tx[slot_index];
+        const bool writing = (m_write == kArdPacketReliableWriteData && m_write_slot == slot_index);
+        if (!slot.acked && !slot.pending && !writing && slot.transmissions > 0 &&
+            (now - slot.sent_ms) >= m_timeout_ms)
+        {
+            slot.pending = true;
+            expired = true;
+        }
+    }
+    if (expired)
+    {
+        // back off until a new round trip time sample
+        const uint32_t timeout = 2 * m_timeout_ms;
+        m_timeout_ms = (timeout < m_config.max_timeout_ms ? timeout : m_config.max_timeout_ms);
+    }
+}
+
+inline bool ArdPacketReliable::StartWrite()
+{
+    bool started = false;
+    if (m_ack_pending)
+    {
+        // cumulative ACK and bitmap of frames buffered after it
+        uint32_t selective = 0;
+        for (size_t offset = 0; offset < m_config.window_size; ++offset)
+        {
+            selective |= (m_rx[RxSlot(offset)].received ? (1UL << offset) : 0UL);
+        }
+        m_ack[0] = m_rx_expected;
+        m_ack[1] = static_cast<uint8_t>(selective);
+        m_ack[2] = static_cast<uint8_t>(selective >> 8);
+        m_ack[3] = static_cast<uint8_t>(selective >> 16);
+        m_ack[4] = static_cast<uint8_t>(selective >> 24);
+        m_write_info.message_type = m_config.ack_message_type;
+        m_write_info.payload_size = kArdPacketReliableAckSize;
+        m_write = kArdPacketReliableWriteAck;
+        m_ack_pending = false;
+        started = true;
+    }
+    const size_t in_flight = InFlight();
+    for (size_t offset = 0; offset < in_flight && !started; ++offset)
+    {
+        const size_t slot_index = TxSlot(offset);
+        ArdPacketReliableTxSlot &slot = m_tx[slot_index];
+        if (slot.pending)
+        {
+            slot.pending = false;
+            slot.sent_ms = m_clock();
+            m_retransmissions += (slot.transmissions > 0 ? 1 : 0);
+            slot.transmissions = static_cast<uint8_t>(slot.transmissions < UINT8_MAX ? slot.transmissions + 1
+                                                                                      : UINT8_MAX);
+            m_write_info.message_type = slot.message_type;
+            m_write_info.payload_size = kArdPacketReliableSequenceSize + slot.payload_size;
+            m_write_slot = slot_index;
+            m_write = kArdPacketReliableWriteData;
+            started = true;
+        }
+    }
+    return started;
+}
+
+inline void ArdPacketReliable::PollWrite()
+{
+    bool continue_write = true;
+    while (continue_write)
+    {
+        if (m_write == kArdPacketReliableWriteNone)
+        {
+            continue_write = StartWrite();
+        }
+        if (m_write != kArdPacketReliableWriteNone)
+        {
+            const uint8_t *frame = (m_write == kArdPacketReliableWriteAck ? m_ack : TxFrame(m_write_slot));
+            const eArdPacketStatus status = m_packet.SendPayload(m_write_info, frame);
+            if (status == kArdPacketStatusDone)
+            {
+                m_write = kArdPacketReliableWriteNone;
+                Slide();
+            }
+            else if (status == kArdPacketStatusHeaderInProgress || status == kArdPacketStatusPayloadInProgress ||
+                     status == kArdPacketStatusNotAvailable || status == kArdPacketStatusNotEnoughAvailable)
+            {
+                // stream is full, continue on the next poll
+                continue_write = false;
+            }
+            else
+            {
+                // frame cannot be sent with this packet configuration
+                m_packet.ResetWrite();
+                if (m_write == kArdPacketReliableWriteData &&
+                    m_tx[m_write_slot].message_type != m_config.ack_message_type)
+                {
+                    // send its sequence number alone so the receiver skips it instead of waiting for it
+                    ArdPacketReliableTxSlot &slot = m_tx[m_write_slot];
+                    slot.message_type = m_config.ack_message_type;
+                    slot.payload_size = 0;
+                    slot.transmissions = 0;
+                    slot.pending = true;
+                }
+                else if (m_write == kArdPacketReliableWriteData)
+                {
+                    // not even the skip frame fits, stop retransmitting it
+                    m_tx[m_write_slot].acked = true;
+                }
+                m_write = kArdPacketReliableWriteNone;
+                Slide();
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+
+#ifndef ARD_PACKET_RING_BUFFER_H
+#define ARD_PACKET_RING_BUFFER_H
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Stream reading back the bytes written to it
+ *
+ * Useful as an in-memory loopback between two packet endpoints. The storage is provided by the caller.
+ */
+class ArdPacketRingBuffer : public ArdPacketStreamInterface
+{
+   public:
+    ArdPacketRingBuffer() = default;
+
+    bool set_buffer(uint8_t *buffer, size_t buffer_size)
+    {
+        m_buffer = (buffer_size > 0 ? buffer : nullptr);
+        m_size = (m_buffer != nullptr ? buffer_size : 0);
+        m_read_index = 0;
+        m_count = 0;
+        return m_buffer != nullptr;
+    }
+
+    int available() override
+    {
+        return static_cast<int>(m_count);
+    }
+    int read() override
+    {
+        int retval = -1;
+        if (m_count > 0)
+        {
+            retval = m_buffer[m_read_index];
+            m_read_index = (m_read_index + 1) % m_size;
+            m_count--;
+        }
+        return retval;
+    }
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        const size_t read_size = (size < m_count ? size : m_count);
+        if (read_size > 0)
+        {
+            const size_t first_size = (read_size < m_size - m_read_index ? read_size : m_size - m_read_index);
+            memcpy(buffer, &m_buffer[m_read_index], first_size);
+            memcpy(&buffer[first_size], m_buffer, read_size - first_size);
+            m_read_index = (m_read_index + read_size) % m_size;
+            m_count -= read_size;
+        }
+        return read_size;
+    }
+
+    int availableForWrite() override
+    {
+        return static_cast<int>(m_size - m_count);
+    }
+    size_t write(uint8_t value) override
+    {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        const size_t available_write = m_size - m_count;
+        const size_t write_size = (size < available_write ? size : available_write);
+        if (write_size > 0)
+        {
+            const size_t write_index = (m_read_index + m_count) % m_size;
+            const size_t first_size = (write_size < m_size - write_index ? write_size : m_size - write_index);
+            memcpy(&m_buffer[write_index], buffer, first_size);
+            memcpy(m_buffer, &buffer[first_size], write_size - first_size);
+            m_count += write_size;
+        }
+        return write_size;
+    }
+
+   private:
+    uint8_t *m_buffer = nullptr;
+    size_t m_size = 0;
+    size_t m_read_index = 0;
+    size_t m_count = 0;
+};
+
+#endif
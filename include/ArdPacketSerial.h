@@ -6,6 +6,32 @@
 
 #include "ArdPacket.h"
 
+/**
+ * @brief Copy received bytes straight out of the receive ring of the AVR core's @c HardwareSerial
+ *
+ * The core only reads one byte per call, each one recomputing the ring indexes.
+ */
+#ifndef ARD_PACKET_SERIAL_RING_READ
+#if defined(__AVR__)
+#define ARD_PACKET_SERIAL_RING_READ 1
+#else
+#define ARD_PACKET_SERIAL_RING_READ 0
+#endif
+#endif
+
+#if ARD_PACKET_SERIAL_RING_READ
+/**
+ * @brief Access to the receive ring the core keeps protected
+ *
+ * Never instantiated: member pointers named through a derived class may be applied to any @c HardwareSerial.
+ */
+class ArdPacketSerialRing : public HardwareSerial
+{
+   public:
+    static size_t Read(HardwareSerial &serial, uint8_t *buffer, size_t size);
+};
+#endif
+
 class ArdPacketSerial : public ArdPacketStreamInterface
 {
    public:
@@ -21,8 +47,11 @@ class ArdPacketSerial : public ArdPacketStreamInterface
         return m_serial.read();
     }
 
-#if defined(__AVR__)
-    size_t read(uint8_t *buffer, size_t size) override;
+#if ARD_PACKET_SERIAL_RING_READ
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return ArdPacketSerialRing::Read(m_serial, buffer, size);
+    }
 #else
     size_t read(uint8_t *buffer, size_t size) override
     {
@@ -47,20 +76,34 @@ class ArdPacketSerial : public ArdPacketStreamInterface
     HardwareSerial &m_serial;
 };
 
-#ifdef __AVR__
-inline size_t ArdPacketSerial::read(uint8_t *buffer, size_t size)
+#if ARD_PACKET_SERIAL_RING_READ
+inline size_t ArdPacketSerialRing::Read(HardwareSerial &serial, uint8_t *buffer, const size_t size)
 {
+    unsigned char(HardwareSerial::*ring_member)[SERIAL_RX_BUFFER_SIZE] = &ArdPacketSerialRing::_rx_buffer;
+    volatile rx_buffer_index_t HardwareSerial::*head_member = &ArdPacketSerialRing::_rx_buffer_head;
+    volatile rx_buffer_index_t HardwareSerial::*tail_member = &ArdPacketSerialRing::_rx_buffer_tail;
+    const unsigned char *ring = serial.*ring_member;
+
+    // the receive interrupt moves the head, a 16 bit index is read until two reads agree
+    rx_buffer_index_t head = serial.*head_member;
+    while (sizeof(rx_buffer_index_t) > 1 && head != serial.*head_member)
+    {
+        head = serial.*head_member;
+    }
+    rx_buffer_index_t tail = serial.*tail_member;
+
     size_t read_index = 0;
-    int read_byte = 0;
-    while (read_byte >= 0 && read_index < size)
+    while (read_index < size && tail != head)
     {
-        read_byte = m_serial.read();
-        if (read_byte >= 0)
-        {
-            buffer[read_index] = static_cast<uint8_t>(read_byte);
-            read_index++;
-        }
+        // contiguous run up to the head or the end of the ring
+        const size_t run_end = (head > tail ? head : SERIAL_RX_BUFFER_SIZE);
+        const size_t run_size = (run_end - tail < size - read_index ? run_end - tail : size - read_index);
+        memcpy(&buffer[read_index], &ring[tail], run_size);
+        read_index += run_size;
+        tail = static_cast<rx_buffer_index_t>((tail + run_size) % SERIAL_RX_BUFFER_SIZE);
     }
+    // only this side moves the tail
+    serial.*tail_member = tail;
     return read_index;
 }
 #endif
@@ -0,0 +1,548 @@
+
+#ifndef ARD_PACKET_SERVER_H
+#define ARD_PACKET_SERVER_H
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ArdPacket.h"
+#include "ArdPacketPosix.h"
+
+class ArdPacketServer;
+class ArdPacketServerHandler;
+class ArdPacketUringServer;
+
+/**
+ * @brief Packet connection owned by a server
+ *
+ * Only used from the worker thread it belongs to.
+ */
+class ArdPacketServerConnection
+{
+   public:
+    ArdPacketServerConnection(ArdPacketStreamInterface &stream, const size_t worker, const size_t max_payload_size)
+        : m_worker(worker), m_payload(max_payload_size), m_packet(stream)
+    {
+    }
+
+    /**
+     * @brief Write payload to the connection
+     *
+     * Like @c ArdPacket::SendPayload, call again with the same arguments when the connection is writable while the
+     * packet is in progress.
+     *
+     * @param info
+     * @param payload
+     * @return
+     */
+    eArdPacketStatus Send(const ArdPacketPayloadInfo &info, const uint8_t *payload)
+    {
+        return m_packet.SendPayload(info, payload);
+    }
+
+    /**
+     * @brief Close the connection once the current callback returns
+     */
+    void Close()
+    {
+        m_close = true;
+    }
+
+    /**
+     * @brief Socket of the connection
+     */
+    int Fd() const
+    {
+        return m_fd;
+    }
+
+    /**
+     * @brief Index of the worker thread serving the connection
+     */
+    size_t Worker() const
+    {
+        return m_worker;
+    }
+
+    /**
+     * @brief Application data attached to the connection
+     */
+    void *context = nullptr;
+
+   private:
+    friend class ArdPacketServer;
+    friend class ArdPacketUringServer;
+
+    void ReadPayloads(ArdPacketServerHandler &handler);
+
+    int m_fd = -1;
+    size_t m_worker = 0;
+    bool m_close = false;
+    ArdPacketPayloadInfo m_info = {};
+    std::vector<uint8_t> m_payload;
+    ArdPacket m_packet;
+};
+
+/**
+ * @brief Callbacks of @c ArdPacketServer and @c ArdPacketUringServer
+ *
+ * Called from the worker threads, concurrently for connections of different workers.
+ */
+class ArdPacketServerHandler
+{
+   public:
+    virtual ~ArdPacketServerHandler() = default;
+
+    virtual void OnConnect(ArdPacketServerConnection &connection)
+    {
+        (void)connection;
+    }
+
+    virtual void OnPayload(ArdPacketServerConnection &connection, const ArdPacketPayloadInfo &info,
+                           const uint8_t *payload) = 0;
+
+    /**
+     * @brief The connection can take more bytes, continue a @c Send in progress
+     */
+    virtual void OnWritable(ArdPacketServerConnection &connection)
+    {
+        (void)connection;
+    }
+
+    /**
+     * @brief A packet was dropped, see @c ArdPacketStatusFrameError
+     */
+    virtual void OnReceiveError(ArdPacketServerConnection &connection, const eArdPacketStatus status)
+    {
+        (void)connection;
+        (void)status;
+    }
+
+    virtual void OnDisconnect(ArdPacketServerConnection &connection)
+    {
+        (void)connection;
+    }
+};
+
+/**
+ * @brief Server configuration
+ */
+struct ArdPacketServerConfig
+{
+    /**
+     * @brief Packet configuration of every connection
+     */
+    ArdPacketConfig packet = {};
+
+    /**
+     * @brief Address to listen on, @c nullptr for any
+     */
+    const char *host = nullptr;
+
+    /**
+     * @brief Port to listen on, 0 to choose a free port
+     */
+    uint16_t port = 9040;
+
+    /**
+     * @brief Number of worker threads, each serving its own share of the connections
+     */
+    size_t worker_threads = 1;
+
+    /**
+     * @brief Events handled per wake up of a worker
+     */
+    size_t max_events = 256;
+};
+
+/**
+ * @brief Worker threads shared by @c ArdPacketServer and @c ArdPacketUringServer
+ *
+ * Every worker listens on the same port (@c SO_REUSEPORT, so the kernel shards incoming connections) and is woken
+ * through an eventfd to stop. The servers only open, run and close their own kind of worker.
+ */
+class ArdPacketServerBase
+{
+   public:
+    ArdPacketServerBase(const ArdPacketServerBase &) = delete;
+    ArdPacketServerBase &operator=(const ArdPacketServerBase &) = delete;
+
+    /**
+     * @brief Port the server listens on
+     */
+    uint16_t Port() const
+    {
+        return m_port;
+    }
+
+    /**
+     * @brief Number of open connections
+     */
+    size_t Connections() const;
+
+   protected:
+    struct ArdPacketServerWorkerBase
+    {
+        virtual ~ArdPacketServerWorkerBase() = default;
+
+        size_t index = 0;
+        int listen_fd = -1;
+        int wake_fd = -1;
+        std::thread thread;
+        std::atomic<size_t> connection_count{0};
+    };
+
+    explicit ArdPacketServerBase(ArdPacketServerHandler &handler) : m_handler(handler) {}
+    virtual ~ArdPacketServerBase() = default;
+
+    /**
+     * @brief Open @c worker_threads workers and start them, or close every worker again on failure
+     *
+     * @param config
+     * @param valid whether the server specific configuration is valid
+     * @return
+     */
+    bool StartWorkers(const ArdPacketServerConfig &config, bool valid);
+
+    /**
+     * @brief Wake every worker, wait for it and close it
+     */
+    void StopWorkers();
+
+    /**
+     * @brief Create the listening socket of a worker on the host and port of the server
+     *
+     * @param worker
+     * @param socket_flags extra @c socket type flags, such as @c SOCK_NONBLOCK
+     * @return
+     */
+    bool Listen(ArdPacketServerWorkerBase &worker, int socket_flags) const;
+
+    virtual ArdPacketServerWorkerBase *NewWorker() = 0;
+    virtual bool OpenWorker(ArdPacketServerWorkerBase &worker) = 0;
+    /**
+     * @brief Close the connections of a worker, its listening and wake up descriptors are closed afterwards
+     */
+    virtual void CloseWorker(ArdPacketServerWorkerBase &worker) = 0;
+    virtual void Run(ArdPacketServerWorkerBase &worker) = 0;
+
+    ArdPacketServerConfig m_config = {};
+    std::vector<std::unique_ptr<ArdPacketServerWorkerBase>> m_workers;
+    std::atomic<bool> m_running{false};
+    uint16_t m_port = 0;
+    ArdPacketServerHandler &m_handler;
+};
+
+/**
+ * @brief Event driven packet server for many TCP connections
+ *
+ * Every worker thread runs an edge triggered epoll loop over its own listening socket (@c SO_REUSEPORT, so the
+ * kernel shards incoming connections) and its connections. Packets are only read from readable connections and the
+ * handler is only told about writable ones, so idle connections cost nothing.
+ */
+class ArdPacketServer : public ArdPacketServerBase
+{
+   public:
+    explicit ArdPacketServer(ArdPacketServerHandler &handler) : ArdPacketServerBase(handler) {}
+    ~ArdPacketServer() override
+    {
+        Stop();
+    }
+
+    /**
+     * @brief Listen and start the worker threads
+     *
+     * @param config
+     * @return false if the configuration is invalid or a socket cannot be created
+     */
+    bool Start(const ArdPacketServerConfig &config);
+
+    /**
+     * @brief Stop the worker threads and close every connection
+     */
+    void Stop();
+
+   private:
+    struct ArdPacketServerTcpConnection
+    {
+        ArdPacketServerTcpConnection(const size_t worker, const size_t max_payload_size)
+            : connection(stream, worker, max_payload_size)
+        {
+        }
+
+        ArdPacketTcp stream;
+        ArdPacketServerConnection connection;
+    };
+
+    struct ArdPacketServerWorker : public ArdPacketServerWorkerBase
+    {
+        int epoll_fd = -1;
+        std::unordered_map<int, std::unique_ptr<ArdPacketServerTcpConnection>> connections;
+    };
+
+    ArdPacketServerWorkerBase *NewWorker() override
+    {
+        return new ArdPacketServerWorker();
+    }
+    bool OpenWorker(ArdPacketServerWorkerBase &worker) override;
+    void CloseWorker(ArdPacketServerWorkerBase &worker) override;
+    void Run(ArdPacketServerWorkerBase &worker) override;
+    void Accept(ArdPacketServerWorker &worker);
+    void Disconnect(ArdPacketServerWorker &worker, ArdPacketServerTcpConnection &tcp);
+};
+
+// ArdPacketServerBase inline methods
+
+inline size_t ArdPacketServerBase::Connections() const
+{
+    size_t connections = 0;
+    for (const std::unique_ptr<ArdPacketServerWorkerBase> &worker : m_workers)
+    {
+        connections += worker->connection_count;
+    }
+    return connections;
+}
+
+inline bool ArdPacketServerBase::StartWorkers(const ArdPacketServerConfig &config, const bool valid)
+{
+    StopWorkers();
+
+    ArdPacketFd unused_stream;
+    ArdPacket check(unused_stream);
+    bool success = (valid && config.worker_threads > 0 && check.Configure(config.packet) == kArdPacketConfigSuccess);
+
+    m_config = config;
+    m_port = config.port;
+    for (size_t index = 0; index < config.worker_threads && success; ++index)
+    {
+        // the first worker picks the port when 0, the others share it
+        m_workers.emplace_back(NewWorker());
+        m_workers.back()->index = index;
+        success = OpenWorker(*m_workers.back());
+        m_port = (success && index == 0 ? ArdPacketTcp::LocalPort(m_workers.back()->listen_fd) : m_port);
+    }
+
+    if (success)
+    {
+        m_running = true;
+        for (std::unique_ptr<ArdPacketServerWorkerBase> &worker : m_workers)
+        {
+            ArdPacketServerWorkerBase *worker_pointer = worker.get();
+            worker->thread = std::thread([this, worker_pointer]() { Run(*worker_pointer); });
+        }
+    }
+    else
+    {
+        StopWorkers();
+        m_port = 0;
+    }
+    return success;
+}
+
+inline void ArdPacketServerBase::StopWorkers()
+{
+    m_running = false;
+    for (std::unique_ptr<ArdPacketServerWorkerBase> &worker : m_workers)
+    {
+        const uint64_t wake = 1;
+        if (worker->wake_fd >= 0)
+        {
+            // fails only when the counter is already set, the worker wakes up either way
+            const ssize_t written = ::write(worker->wake_fd, &wake, sizeof(wake));
+            (void)written;
+        }
+    }
+    for (std::unique_ptr<ArdPacketServerWorkerBase> &worker : m_workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+        CloseWorker(*worker);
+        worker->connection_count = 0;
+        for (int *fd : {&worker->listen_fd, &worker->wake_fd})
+        {
+            if (*fd >= 0)
+            {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+    m_workers.clear();
+}
+
+inline bool ArdPacketServerBase::Listen(ArdPacketServerWorkerBase &worker, const int socket_flags) const
+{
+    // every worker binds the same port
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    const bool success = (m_config.host == nullptr || inet_pton(AF_INET, m_config.host, &address.sin_addr) == 1);
+    worker.listen_fd = (success ? socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | socket_flags, 0) : -1);
+
+    const int reuse = 1;
+    return (worker.listen_fd >= 0 &&
+            setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+            setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == 0 &&
+            bind(worker.listen_fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0 &&
+            listen(worker.listen_fd, SOMAXCONN) == 0);
+}
+
+// ArdPacketServer inline methods
+
+inline bool ArdPacketServer::Start(const ArdPacketServerConfig &config)
+{
+    return StartWorkers(config, config.max_events > 0);
+}
+
+inline void ArdPacketServer::Stop()
+{
+    StopWorkers();
+}
+
+// Private inline methods
+// ----------------------
+
+inline bool ArdPacketServer::OpenWorker(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketServerWorker &worker = static_cast<ArdPacketServerWorker &>(worker_base);
+    worker.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    worker.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool success = (worker.epoll_fd >= 0 && worker.wake_fd >= 0 && Listen(worker, SOCK_NONBLOCK));
+
+    // listening and wake up descriptors are told apart by their data pointer
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = &worker.listen_fd;
+    success = success && epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, worker.listen_fd, &event) == 0;
+    event.data.ptr = &worker.wake_fd;
+    success = success && epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, worker.wake_fd, &event) == 0;
+    return success;
+}
+
+inline void ArdPacketServer::CloseWorker(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketServerWorker &worker = static_cast<ArdPacketServerWorker &>(worker_base);
+    for (std::pair<const int, std::unique_ptr<ArdPacketServerTcpConnection>> &tcp : worker.connections)
+    {
+        m_handler.OnDisconnect(tcp.second->connection);
+    }
+    worker.connections.clear();
+    if (worker.epoll_fd >= 0)
+    {
+        close(worker.epoll_fd);
+        worker.epoll_fd = -1;
+    }
+}
+
+inline void ArdPacketServer::Run(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketServerWorker &worker = static_cast<ArdPacketServerWorker &>(worker_base);
+    std::vector<struct epoll_event> events(m_config.max_events);
+    while (m_running)
+    {
+        const int count = epoll_wait(worker.epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        for (int k = 0; k < count; ++k)
+        {
+            const uint32_t flags = events[k].events;
+            void *pointer = events[k].data.ptr;
+            if (pointer == &worker.listen_fd)
+            {
+                Accept(worker);
+            }
+            else if (pointer != &worker.wake_fd)
+            {
+                ArdPacketServerTcpConnection &tcp = *static_cast<ArdPacketServerTcpConnection *>(pointer);
+                ArdPacketServerConnection &connection = tcp.connection;
+                if ((flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    // edge triggered: read until the stream holds no complete packet
+                    connection.ReadPayloads(m_handler);
+                }
+                if ((flags & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    // everything left was read, the far end is gone
+                    connection.m_close = true;
+                }
+                if ((flags & EPOLLOUT) != 0 && !connection.m_close && tcp.stream.Connected())
+                {
+                    tcp.stream.Flush();
+                    m_handler.OnWritable(connection);
+                }
+                if (connection.m_close || !tcp.stream.Connected())
+                {
+                    Disconnect(worker, tcp);
+                }
+            }
+        }
+    }
+}
+
+inline void ArdPacketServer::Accept(ArdPacketServerWorker &worker)
+{
+    // edge triggered: accept until no connection is pending
+    bool continue_accept = true;
+    while (continue_accept)
+    {
+        std::unique_ptr<ArdPacketServerTcpConnection> tcp(
+            new ArdPacketServerTcpConnection(worker.index, m_config.packet.max_payload_size));
+        continue_accept = tcp->stream.Accept(worker.listen_fd);
+        if (continue_accept)
+        {
+            const int fd = tcp->stream.Fd();
+            tcp->connection.m_fd = fd;
+            tcp->connection.m_packet.Configure(m_config.packet);
+            struct epoll_event event = {};
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = tcp.get();
+            if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)
+            {
+                ArdPacketServerConnection &added = tcp->connection;
+                worker.connections[fd] = std::move(tcp);
+                worker.connection_count++;
+                m_handler.OnConnect(added);
+            }
+        }
+    }
+}
+
+inline void ArdPacketServer::Disconnect(ArdPacketServerWorker &worker, ArdPacketServerTcpConnection &tcp)
+{
+    const int fd = tcp.stream.Fd();
+    m_handler.OnDisconnect(tcp.connection);
+    epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    // closes the socket
+    worker.connections.erase(fd);
+    worker.connection_count--;
+}
+
+// ArdPacketServerConnection inline methods
+
+inline void ArdPacketServerConnection::ReadPayloads(ArdPacketServerHandler &handler)
+{
+    // read until the stream holds no complete packet, which may continue with the next bytes
+    bool continue_read = true;
+    while (continue_read && !m_close)
+    {
+        const eArdPacketStatus status = m_packet.ReceivePayload(m_payload.size(), m_info, m_payload.data());
+        if (status == kArdPacketStatusDone)
+        {
+            handler.OnPayload(*this, m_info, m_payload.data());
+        }
+        else if (ArdPacketStatusFrameError(status))
+        {
+            handler.OnReceiveError(*this, status);
+        }
+        continue_read = ArdPacketStatusFrameConsumed(status);
+    }
+}
+
+#endif
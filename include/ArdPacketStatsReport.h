@@ -0,0 +1,169 @@
+
+#ifndef ARD_PACKET_STATS_REPORT_H
+#define ARD_PACKET_STATS_REPORT_H
+
+#include <stdint.h>
+
+#include "ArdPacket.h"
+
+#if ARD_PACKET_STATS
+
+/**
+ * @brief Version of the statistics report payload
+ */
+static constexpr uint8_t kArdPacketStatsReportVersion = 1;
+
+/**
+ * @brief Number of counters in a statistics report, ahead of the histograms
+ */
+static constexpr size_t kArdPacketStatsReportCounters = 13;
+
+/**
+ * @brief Size of a statistics report payload
+ *
+ * Version and bucket count bytes, the counters in @c ArdPacketStats order and both histograms, all 32 bit little
+ * endian.
+ */
+static constexpr size_t kArdPacketStatsReportSize =
+    2 + 4 * (kArdPacketStatsReportCounters + 2 * ARD_PACKET_STATS_BUCKETS);
+
+/**
+ * @brief Sends statistics snapshots of a packet as payloads of a reserved message type
+ *
+ * Lets a collector scrape every device on a link with the packets it already exchanges. The payload needs a
+ * @c max_payload_size of at least @c kArdPacketStatsReportSize on both ends.
+ */
+class ArdPacketStatsReport
+{
+   public:
+    ArdPacketStatsReport(ArdPacket &packet, const uint32_t message_type)
+        : m_packet(packet), m_message_type(message_type)
+    {
+    }
+
+    /**
+     * @brief Send a snapshot taken on the first call, call again while in progress
+     *
+     * @return status of @c ArdPacket::SendPayload
+     */
+    eArdPacketStatus Send();
+
+    /**
+     * @brief Write a report payload
+     *
+     * @param stats
+     * @param payload at least @c kArdPacketStatsReportSize bytes
+     * @return size written
+     */
+    static size_t Encode(const ArdPacketStats &stats, uint8_t *payload);
+
+    /**
+     * @brief Read a received report payload
+     *
+     * @param payload
+     * @param payload_size
+     * @param stats
+     * @return false if the payload is not a report of this version and bucket count
+     */
+    static bool Decode(const uint8_t *payload, size_t payload_size, ArdPacketStats &stats);
+
+   private:
+    static uint8_t *WriteUint32(uint32_t value, uint8_t *data);
+    static const uint8_t *ReadUint32(const uint8_t *data, uint32_t &value);
+
+    ArdPacket &m_packet;
+    const uint32_t m_message_type;
+    bool m_sending = false;
+    uint8_t m_payload[kArdPacketStatsReportSize] = {0};
+};
+
+// inline methods
+
+inline eArdPacketStatus ArdPacketStatsReport::Send()
+{
+    if (!m_sending)
+    {
+        Encode(m_packet.GetStats(), m_payload);
+    }
+    ArdPacketPayloadInfo info;
+    info.message_type = m_message_type;
+    info.payload_size = kArdPacketStatsReportSize;
+    const eArdPacketStatus status = m_packet.SendPayload(info, m_payload);
+    // keep the snapshot until the packet is written or refused
+    m_sending = (status != kArdPacketStatusDone && status != kArdPacketStatusNotConfigured &&
+                 status != kArdPacketStatusInvalidMessageType && status != kArdPacketStatusInvalidPayloadSize);
+    return status;
+}
+
+inline size_t ArdPacketStatsReport::Encode(const ArdPacketStats &stats, uint8_t *payload)
+{
+    uint8_t *data = payload;
+    *data++ = kArdPacketStatsReportVersion;
+    *data++ = ARD_PACKET_STATS_BUCKETS;
+    const uint32_t counters[kArdPacketStatsReportCounters] = {
+        stats.receive_calls, stats.frames_received, stats.frames_skipped, stats.bytes_received,
+        stats.frames_sent, stats.bytes_sent, stats.discarded_bytes, stats.header_crc_failures,
+        stats.payload_crc_failures, stats.invalid_sizes, stats.read_failures, stats.short_writes,
+        stats.frame_timeouts};
+    for (const uint32_t counter : counters)
+    {
+        data = WriteUint32(counter, data);
+    }
+    for (const uint32_t count : stats.payload_size_log2)
+    {
+        data = WriteUint32(count, data);
+    }
+    for (const uint32_t count : stats.receive_time_log2)
+    {
+        data = WriteUint32(count, data);
+    }
+    return static_cast<size_t>(data - payload);
+}
+
+inline bool ArdPacketStatsReport::Decode(const uint8_t *payload, const size_t payload_size, ArdPacketStats &stats)
+{
+    const bool valid = (payload_size == kArdPacketStatsReportSize && payload[0] == kArdPacketStatsReportVersion &&
+                        payload[1] == ARD_PACKET_STATS_BUCKETS);
+    if (valid)
+    {
+        const uint8_t *data = &payload[2];
+        uint32_t *counters[kArdPacketStatsReportCounters] = {
+            &stats.receive_calls, &stats.frames_received, &stats.frames_skipped, &stats.bytes_received,
+            &stats.frames_sent, &stats.bytes_sent, &stats.discarded_bytes, &stats.header_crc_failures,
+            &stats.payload_crc_failures, &stats.invalid_sizes, &stats.read_failures, &stats.short_writes,
+            &stats.frame_timeouts};
+        for (uint32_t *counter : counters)
+        {
+            data = ReadUint32(data, *counter);
+        }
+        for (uint32_t &count : stats.payload_size_log2)
+        {
+            data = ReadUint32(data, count);
+        }
+        for (uint32_t &count : stats.receive_time_log2)
+        {
+            data = ReadUint32(data, count);
+        }
+    }
+    return valid;
+}
+
+inline uint8_t *ArdPacketStatsReport::WriteUint32(const uint32_t value, uint8_t *data)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+    return &data[4];
+}
+
+inline const uint8_t *ArdPacketStatsReport::ReadUint32(const uint8_t *data, uint32_t &value)
+{
+    value = static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+            (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    return &data[4];
+}
+
+#endif
+
+#endif
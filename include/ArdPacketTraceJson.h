@@ -0,0 +1,108 @@
+
+#ifndef ARD_PACKET_TRACE_JSON_H
+#define ARD_PACKET_TRACE_JSON_H
+
+#include <stdio.h>
+
+#include "ArdPacket.h"
+
+#if ARD_PACKET_TRACE
+
+/**
+ * @brief Chrome trace file shared by the @c ArdPacketTraceJson sinks writing to it
+ */
+class ArdPacketTraceJsonFile
+{
+   public:
+    /**
+     * @brief Start a trace
+     *
+     * @param file open for writing, owned by the caller
+     */
+    explicit ArdPacketTraceJsonFile(FILE *file) : m_file(file)
+    {
+        fputs("[", m_file);
+    }
+
+    /**
+     * @brief End the trace, after the last event of every sink
+     */
+    void Finish()
+    {
+        fputs("\n]\n", m_file);
+        fflush(m_file);
+    }
+
+   private:
+    friend class ArdPacketTraceJson;
+
+    /**
+     * @brief Separator in front of the next event, none before the first one written to the file
+     */
+    const char *Separator()
+    {
+        const char *separator = (m_events_written ? ",\n" : "\n");
+        m_events_written = true;
+        return separator;
+    }
+
+    FILE *m_file;
+    bool m_events_written = false;
+};
+
+/**
+ * @brief Trace sink writing Chrome trace events, viewable in chrome://tracing and Perfetto
+ *
+ * Each state is written as a complete event from the time it was entered to the time it was left, on one track for
+ * receiving and one for sending, with the bytes available to it and the bytes it consumed in the last call.
+ * Time spent waiting for bytes between calls counts towards the state the packet waited in. Several packets may
+ * share a file with distinct process ids.
+ */
+class ArdPacketTraceJson : public ArdPacketTraceSink
+{
+   public:
+    /**
+     * @brief Trace a packet into a file
+     *
+     * @param file shared with the other sinks writing to it
+     * @param process_id track group of this packet in the trace
+     */
+    explicit ArdPacketTraceJson(ArdPacketTraceJsonFile &file, const int process_id = 1)
+        : m_file(file), m_process_id(process_id)
+    {
+    }
+
+    void OnStateChange(const ArdPacketTraceEvent &event) override;
+
+   private:
+    ArdPacketTraceJsonFile &m_file;
+    const int m_process_id;
+
+    // entry time of the current state per direction
+    uint32_t m_enter_us[2] = {0, 0};
+    bool m_entered[2] = {false, false};
+};
+
+// inline methods
+
+inline void ArdPacketTraceJson::OnStateChange(const ArdPacketTraceEvent &event)
+{
+    const size_t track = (event.direction == kArdPacketTraceReceive ? 0 : 1);
+    if (m_entered[track])
+    {
+        fprintf(m_file.m_file,
+                "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":%d,\"tid\":%u,"
+                "\"args\":{\"available\":%lu,\"consumed\":%lu}}",
+                m_file.Separator(), ArdPacket::GetStateName(event.from_state), (track == 0 ? "receive" : "send"),
+                static_cast<unsigned long>(m_enter_us[track]),
+                static_cast<unsigned long>(static_cast<uint32_t>(event.time_us - m_enter_us[track])), m_process_id,
+                static_cast<unsigned>(track + 1), static_cast<unsigned long>(event.available),
+                static_cast<unsigned long>(event.consumed));
+    }
+    m_enter_us[track] = event.time_us;
+    m_entered[track] = true;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,943 @@
+
+#ifndef ARD_PACKET_URING_H
+#define ARD_PACKET_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ArdPacket.h"
+#include "ArdPacketPosix.h"
+#include "ArdPacketServer.h"
+
+/**
+ * @brief Submission and completion queues of an io_uring instance (Linux 5.19 or later)
+ *
+ * Thin wrapper over the system calls so no library is needed.
+ */
+class ArdPacketUringQueue
+{
+   public:
+    ArdPacketUringQueue() = default;
+    ~ArdPacketUringQueue()
+    {
+        Close();
+    }
+
+    ArdPacketUringQueue(const ArdPacketUringQueue &) = delete;
+    ArdPacketUringQueue &operator=(const ArdPacketUringQueue &) = delete;
+
+    /**
+     * @brief Create the queues
+     *
+     * @param entries submission queue size, the completion queue is four times larger
+     * @return true on success
+     */
+    bool Setup(uint32_t entries);
+
+    /**
+     * @brief Release the queues
+     */
+    void Close();
+
+    /**
+     * @brief Next free submission entry, cleared (submits queued entries when full)
+     *
+     * @return nullptr when the queue is still full, for example while the kernel refuses submissions with @c EBUSY
+     * until completions are reaped
+     */
+    struct io_uring_sqe *GetSqe();
+
+    /**
+     * @brief Submit queued entries
+     *
+     * @param wait number of completions to wait for
+     * @return false on error
+     */
+    bool Submit(uint32_t wait);
+
+    /**
+     * @brief Take the next completion
+     *
+     * @param cqe
+     * @return false when no completion is ready
+     */
+    bool PopCompletion(struct io_uring_cqe &cqe);
+
+    /**
+     * @brief Register fixed buffers used by @c IORING_OP_WRITE_FIXED
+     */
+    bool RegisterBuffers(const struct iovec *buffers, uint32_t count);
+
+    /**
+     * @brief Register a ring of buffers the kernel picks from for receives
+     */
+    bool RegisterBufferRing(struct io_uring_buf_ring *ring, uint32_t entries, uint16_t group);
+
+   private:
+    int m_fd = -1;
+    void *m_sq_ring = MAP_FAILED;
+    size_t m_sq_ring_size = 0;
+    void *m_cq_ring = MAP_FAILED;
+    size_t m_cq_ring_size = 0;
+    struct io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqes_size = 0;
+
+    uint32_t *m_sq_head = nullptr;
+    uint32_t *m_sq_tail = nullptr;
+    uint32_t *m_sq_array = nullptr;
+    uint32_t m_sq_mask = 0;
+    uint32_t m_sq_entries = 0;
+    uint32_t m_sq_local_tail = 0;
+    uint32_t m_sq_submitted = 0;
+
+    uint32_t *m_cq_head = nullptr;
+    uint32_t *m_cq_tail = nullptr;
+    uint32_t m_cq_mask = 0;
+    struct io_uring_cqe *m_cqes = nullptr;
+};
+
+/**
+ * @brief Buffers provided to the kernel for multishot receives
+ */
+class ArdPacketUringBufferRing
+{
+   public:
+    ArdPacketUringBufferRing() = default;
+    ~ArdPacketUringBufferRing()
+    {
+        UnmapRing();
+    }
+
+    ArdPacketUringBufferRing(const ArdPacketUringBufferRing &) = delete;
+    ArdPacketUringBufferRing &operator=(const ArdPacketUringBufferRing &) = delete;
+
+    /**
+     * @brief Allocate, register and provide every buffer
+     *
+     * @param queue
+     * @param count number of buffers, a power of 2
+     * @param size size of each buffer
+     * @param group buffer group id used by receives
+     * @return true on success
+     */
+    bool Setup(ArdPacketUringQueue &queue, uint16_t count, uint32_t size, uint16_t group);
+
+    /**
+     * @brief Give a buffer back to the kernel
+     */
+    void Recycle(uint16_t id);
+
+    uint8_t *Buffer(const uint16_t id)
+    {
+        return &m_buffers[static_cast<size_t>(id) * m_size];
+    }
+
+   private:
+    void UnmapRing();
+
+    struct io_uring_buf_ring *m_ring = static_cast<struct io_uring_buf_ring *>(MAP_FAILED);
+    size_t m_ring_size = 0;
+    std::vector<uint8_t> m_buffers;
+    uint32_t m_size = 0;
+    uint16_t m_mask = 0;
+    uint16_t m_tail = 0;
+};
+
+/**
+ * @brief Stream of a connection served by @c ArdPacketUringServer
+ *
+ * Reads are served from the buffer the kernel completed a receive into, without system calls. Bytes of a packet
+ * cut at the end of the buffer are kept until the next receive. Writes go to a registered buffer the server sends
+ * with @c IORING_OP_WRITE_FIXED.
+ */
+class ArdPacketUringStream : public ArdPacketStreamInterface
+{
+   public:
+    ArdPacketUringStream() = default;
+
+    int available() override
+    {
+        return static_cast<int>((m_carry.size() - m_carry_index) + (m_chunk_size - m_chunk_index));
+    }
+    int read() override
+    {
+        uint8_t value = 0;
+        return (read(&value, 1) == 1 ? value : -1);
+    }
+    size_t read(uint8_t *buffer, size_t size) override;
+
+    int availableForWrite() override;
+    size_t write(uint8_t value) override
+    {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+   private:
+    friend class ArdPacketUringServer;
+
+    void Reset(uint8_t *write_buffer, size_t write_buffer_size);
+    void Feed(const uint8_t *data, size_t size);
+    void Retain();
+    size_t WritePending() const
+    {
+        return (m_write_in_flight ? 0 : m_write_end - m_write_start);
+    }
+    void WriteDone(size_t size);
+
+    // received bytes
+    std::vector<uint8_t> m_carry;
+    size_t m_carry_index = 0;
+    const uint8_t *m_chunk = nullptr;
+    size_t m_chunk_size = 0;
+    size_t m_chunk_index = 0;
+
+    // registered write buffer
+    uint8_t *m_write_buffer = nullptr;
+    size_t m_write_buffer_size = 0;
+    size_t m_write_start = 0;
+    size_t m_write_end = 0;
+    bool m_write_in_flight = false;
+};
+
+/**
+ * @brief io_uring configuration of @c ArdPacketUringServer
+ */
+struct ArdPacketUringConfig
+{
+    /**
+     * @brief Connections per worker
+     */
+    uint32_t max_connections = 1024;
+
+    /**
+     * @brief Submission queue entries per worker
+     */
+    uint32_t queue_entries = 512;
+
+    /**
+     * @brief Receive buffers per worker, a power of 2
+     */
+    uint16_t buffer_count = 512;
+
+    /**
+     * @brief Size of each receive buffer
+     */
+    uint32_t buffer_size = 2048;
+
+    /**
+     * @brief Registered write buffer per connection
+     */
+    uint32_t write_buffer_size = 4096;
+};
+
+/**
+ * @brief Packet server for many TCP connections on io_uring
+ *
+ * Same handler and sharding as @c ArdPacketServer. Each worker keeps one multishot accept and one multishot receive
+ * per connection armed; received bytes land in a ring of provided buffers and packets are parsed straight from
+ * them. Sends use registered buffers, and all requests of a loop iteration go to the kernel in one system call.
+ */
+class ArdPacketUringServer : public ArdPacketServerBase
+{
+   public:
+    explicit ArdPacketUringServer(ArdPacketServerHandler &handler) : ArdPacketServerBase(handler) {}
+    ~ArdPacketUringServer() override
+    {
+        Stop();
+    }
+
+    /**
+     * @brief True if the kernel supports multishot receives with provided buffer rings
+     */
+    static bool Supported();
+
+    /**
+     * @brief Listen and start the worker threads
+     *
+     * @param config
+     * @param uring_config
+     * @return false if the configuration is invalid or io_uring is not available
+     */
+    bool Start(const ArdPacketServerConfig &config, const ArdPacketUringConfig &uring_config);
+
+    /**
+     * @brief Stop the worker threads and close every connection
+     */
+    void Stop();
+
+   private:
+    enum eArdPacketUringOp
+    {
+        kArdPacketUringOpAccept = 1,
+        kArdPacketUringOpReceive,
+        kArdPacketUringOpWrite,
+        kArdPacketUringOpWake
+    };
+
+    static constexpr uint16_t kArdPacketUringBufferGroup = 0;
+
+    struct ArdPacketUringSlot
+    {
+        ArdPacketUringStream stream;
+        std::unique_ptr<ArdPacketServerConnection> connection;
+        uint32_t generation = 0;
+        bool open = false;
+        bool receive_armed = false;
+        bool deferred = false;
+    };
+
+    struct ArdPacketUringWorker : public ArdPacketServerWorkerBase
+    {
+        uint64_t wake_value = 0;
+        ArdPacketUringQueue queue;
+        ArdPacketUringBufferRing buffers;
+        std::vector<uint8_t> write_buffers;
+        std::vector<ArdPacketUringSlot> slots;
+        std::vector<uint32_t> free_slots;
+        // requests that found the submission queue full, queued again by the next loop iteration
+        std::vector<uint32_t> deferred_slots;
+        bool accept_armed = false;
+        bool wake_armed = false;
+    };
+
+    static uint64_t UserData(eArdPacketUringOp op, uint32_t generation, uint32_t slot)
+    {
+        return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(generation & 0xFFFFFF) << 32) | slot;
+    }
+
+    ArdPacketServerWorkerBase *NewWorker() override
+    {
+        return new ArdPacketUringWorker();
+    }
+    bool OpenWorker(ArdPacketServerWorkerBase &worker) override;
+    void CloseWorker(ArdPacketServerWorkerBase &worker) override;
+    void Run(ArdPacketServerWorkerBase &worker) override;
+    void ArmAccept(ArdPacketUringWorker &worker);
+    void ArmWake(ArdPacketUringWorker &worker);
+    void ArmReceive(ArdPacketUringWorker &worker, uint32_t index);
+    void Defer(ArdPacketUringWorker &worker, uint32_t index);
+    void RetryDeferred(ArdPacketUringWorker &worker);
+    void Accepted(ArdPacketUringWorker &worker, int fd);
+    void Received(ArdPacketUringWorker &worker, uint32_t index, const struct io_uring_cqe &cqe);
+    void Written(ArdPacketUringWorker &worker, uint32_t index, const struct io_uring_cqe &cqe);
+    void Flush(ArdPacketUringWorker &worker, uint32_t index);
+    void CloseSlot(ArdPacketUringWorker &worker, uint32_t index);
+    void ReleaseSlot(ArdPacketUringWorker &worker, uint32_t index);
+
+    ArdPacketUringConfig m_uring_config = {};
+};
+
+// ArdPacketUringQueue inline methods
+
+inline bool ArdPacketUringQueue::Setup(const uint32_t entries)
+{
+    Close();
+    struct io_uring_params params = {};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = 4 * entries;
+    m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    bool success = (m_fd >= 0 && (params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+
+    if (success)
+    {
+        // one mapping holds both rings
+        m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        m_sq_ring_size = (m_sq_ring_size > m_cq_ring_size ? m_sq_ring_size : m_cq_ring_size);
+        m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                         IORING_OFF_SQ_RING);
+        m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                          IORING_OFF_SQES);
+        m_sqes = (sqes != MAP_FAILED ? static_cast<struct io_uring_sqe *>(sqes) : nullptr);
+        success = (m_sq_ring != MAP_FAILED && m_sqes != nullptr);
+    }
+
+    if (success)
+    {
+        uint8_t *ring = static_cast<uint8_t *>(m_sq_ring);
+        m_sq_head = reinterpret_cast<uint32_t *>(ring + params.sq_off.head);
+        m_sq_tail = reinterpret_cast<uint32_t *>(ring + params.sq_off.tail);
+        m_sq_array = reinterpret_cast<uint32_t *>(ring + params.sq_off.array);
+        m_sq_mask = *reinterpret_cast<uint32_t *>(ring + params.sq_off.ring_mask);
+        m_sq_entries = params.sq_entries;
+        m_sq_local_tail = *m_sq_tail;
+        m_sq_submitted = m_sq_local_tail;
+        m_cq_head = reinterpret_cast<uint32_t *>(ring + params.cq_off.head);
+        m_cq_tail = reinterpret_cast<uint32_t *>(ring + params.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<uint32_t *>(ring + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<struct io_uring_cqe *>(ring + params.cq_off.cqes);
+    }
+    else
+    {
+        Close();
+    }
+    return success;
+}
+
+inline void ArdPacketUringQueue::Close()
+{
+    if (m_sqes != nullptr)
+    {
+        munmap(m_sqes, m_sqes_size);
+        m_sqes = nullptr;
+    }
+    if (m_sq_ring != MAP_FAILED)
+    {
+        munmap(m_sq_ring, m_sq_ring_size);
+        m_sq_ring = MAP_FAILED;
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+inline struct io_uring_sqe *ArdPacketUringQueue::GetSqe()
+{
+    if (m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+    {
+        Submit(0);
+    }
+    struct io_uring_sqe *sqe = nullptr;
+    if (m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) < m_sq_entries)
+    {
+        const uint32_t index = m_sq_local_tail & m_sq_mask;
+        sqe = &m_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        m_sq_array[index] = index;
+        m_sq_local_tail++;
+    }
+    return sqe;
+}
+
+inline bool ArdPacketUringQueue::Submit(const uint32_t wait)
+{
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+    const uint32_t to_submit = m_sq_local_tail - m_sq_submitted;
+    const long result = syscall(__NR_io_uring_enter, m_fd, to_submit, wait, (wait > 0 ? IORING_ENTER_GETEVENTS : 0),
+                                nullptr, 0);
+    if (result > 0)
+    {
+        m_sq_submitted += static_cast<uint32_t>(result);
+    }
+    // interrupted or busy: the entries are submitted with the next call
+    return (result >= 0 || errno == EINTR || errno == EAGAIN || errno == EBUSY);
+}
+
+inline bool ArdPacketUringQueue::PopCompletion(struct io_uring_cqe &cqe)
+{
+    const uint32_t head = *m_cq_head;
+    const bool ready = (head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE));
+    if (ready)
+    {
+        cqe = m_cqes[head & m_cq_mask];
+        __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+    return ready;
+}
+
+inline bool ArdPacketUringQueue::RegisterBuffers(const struct iovec *buffers, const uint32_t count)
+{
+    return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+inline bool ArdPacketUringQueue::RegisterBufferRing(struct io_uring_buf_ring *ring, const uint32_t entries,
+                                                    const uint16_t group)
+{
+    struct io_uring_buf_reg registration = {};
+    registration.ring_addr = reinterpret_cast<uint64_t>(ring);
+    registration.ring_entries = entries;
+    registration.bgid = group;
+    return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &registration, 1) == 0;
+}
+
+// ArdPacketUringBufferRing inline methods
+
+inline bool ArdPacketUringBufferRing::Setup(ArdPacketUringQueue &queue, const uint16_t count, const uint32_t size,
+                                            const uint16_t group)
+{
+    UnmapRing();
+    m_buffers.assign(static_cast<size_t>(count) * size, 0);
+    m_size = size;
+    m_mask = static_cast<uint16_t>(count - 1);
+    m_tail = 0;
+
+    // page aligned ring shared with the kernel
+    m_ring_size = count * sizeof(struct io_uring_buf);
+    void *ring = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    m_ring = static_cast<struct io_uring_buf_ring *>(ring);
+    const bool success = (ring != MAP_FAILED && queue.RegisterBufferRing(m_ring, count, group));
+    if (success)
+    {
+        for (uint32_t id = 0; id < count; ++id)
+        {
+            Recycle(static_cast<uint16_t>(id));
+        }
+    }
+    return success;
+}
+
+inline void ArdPacketUringBufferRing::Recycle(const uint16_t id)
+{
+    // entries start at the ring address, the flexible array of the header is offset when compiled as C++
+    struct io_uring_buf &buffer = reinterpret_cast<struct io_uring_buf *>(m_ring)[m_tail & m_mask];
+    buffer.addr = reinterpret_cast<uint64_t>(Buffer(id));
+    buffer.len = m_size;
+    buffer.bid = id;
+    m_tail++;
+    __atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+}
+
+inline void ArdPacketUringBufferRing::UnmapRing()
+{
+    if (m_ring != MAP_FAILED)
+    {
+        munmap(m_ring, m_ring_size);
+        m_ring = static_cast<struct io_uring_buf_ring *>(MAP_FAILED);
+    }
+}
+
+// ArdPacketUringStream inline methods
+
+inline size_t ArdPacketUringStream::read(uint8_t *buffer, const size_t size)
+{
+    size_t bytes_read = 0;
+    const size_t carry_size = m_carry.size() - m_carry_index;
+    if (carry_size > 0)
+    {
+        bytes_read = (size < carry_size ? size : carry_size);
+        memcpy(buffer, &m_carry[m_carry_index], bytes_read);
+        m_carry_index += bytes_read;
+    }
+    const size_t chunk_size = m_chunk_size - m_chunk_index;
+    const size_t chunk_read = (size - bytes_read < chunk_size ? size - bytes_read : chunk_size);
+    if (chunk_read > 0)
+    {
+        memcpy(&buffer[bytes_read], &m_chunk[m_chunk_index], chunk_read);
+        m_chunk_index += chunk_read;
+        bytes_read += chunk_read;
+    }
+    return bytes_read;
+}
+
+inline int ArdPacketUringStream::availableForWrite()
+{
+    // the buffer is compacted once the kernel is done with it
+    const size_t used = (m_write_in_flight ? m_write_end : m_write_end - m_write_start);
+    return static_cast<int>(m_write_buffer_size - used);
+}
+
+inline size_t ArdPacketUringStream::write(const uint8_t *buffer, const size_t size)
+{
+    if (!m_write_in_flight && m_write_start > 0)
+    {
+        memmove(m_write_buffer, &m_write_buffer[m_write_start], m_write_end - m_write_start);
+        m_write_end -= m_write_start;
+        m_write_start = 0;
+    }
+    const size_t free_size = m_write_buffer_size - m_write_end;
+    const size_t bytes_written = (size < free_size ? size : free_size);
+    memcpy(&m_write_buffer[m_write_end], buffer, bytes_written);
+    m_write_end += bytes_written;
+    return bytes_written;
+}
+
+inline void ArdPacketUringStream::Reset(uint8_t *write_buffer, const size_t write_buffer_size)
+{
+    m_carry.clear();
+    m_carry_index = 0;
+    m_chunk = nullptr;
+    m_chunk_size = 0;
+    m_chunk_index = 0;
+    m_write_buffer = write_buffer;
+    m_write_buffer_size = write_buffer_size;
+    m_write_start = 0;
+    m_write_end = 0;
+    m_write_in_flight = false;
+}
+
+inline void ArdPacketUringStream::Feed(const uint8_t *data, const size_t size)
+{
+    m_chunk = data;
+    m_chunk_size = size;
+    m_chunk_index = 0;
+}
+
+inline void ArdPacketUringStream::Retain()
+{
+    // keep the unread bytes (a few header bytes at most) so the receive buffer can be recycled
+    m_carry.erase(m_carry.begin(), m_carry.begin() + static_cast<std::ptrdiff_t>(m_carry_index));
+    m_carry_index = 0;
+    m_carry.insert(m_carry.end(), m_chunk + m_chunk_index, m_chunk + m_chunk_size);
+    m_chunk = nullptr;
+    m_chunk_size = 0;
+    m_chunk_index = 0;
+}
+
+inline void ArdPacketUringStream::WriteDone(const size_t size)
+{
+    m_write_start += size;
+    m_write_in_flight = false;
+    if (m_write_start == m_write_end)
+    {
+        m_write_start = 0;
+        m_write_end = 0;
+    }
+}
+
+// ArdPacketUringServer inline methods
+
+inline bool ArdPacketUringServer::Supported()
+{
+    ArdPacketUringQueue queue;
+    ArdPacketUringBufferRing buffers;
+    return (queue.Setup(4) && buffers.Setup(queue, 4, 64, kArdPacketUringBufferGroup));
+}
+
+inline bool ArdPacketUringServer::Start(const ArdPacketServerConfig &config, const ArdPacketUringConfig &uring_config)
+{
+    const uint16_t buffer_count = uring_config.buffer_count;
+    m_uring_config = uring_config;
+    return StartWorkers(config, uring_config.max_connections > 0 && uring_config.queue_entries > 0 &&
+                                    uring_config.buffer_size > 0 && uring_config.write_buffer_size > 0 &&
+                                    buffer_count > 0 && (buffer_count & (buffer_count - 1)) == 0);
+}
+
+inline void ArdPacketUringServer::Stop()
+{
+    StopWorkers();
+}
+
+// Private inline methods
+// ----------------------
+
+inline bool ArdPacketUringServer::OpenWorker(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketUringWorker &worker = static_cast<ArdPacketUringWorker &>(worker_base);
+    const size_t max_connections = m_uring_config.max_connections;
+    bool success = worker.queue.Setup(m_uring_config.queue_entries) &&
+                   worker.buffers.Setup(worker.queue, m_uring_config.buffer_count, m_uring_config.buffer_size,
+                                        kArdPacketUringBufferGroup);
+
+    // one registered region holds the write buffers of every connection
+    worker.write_buffers.assign(max_connections * m_uring_config.write_buffer_size, 0);
+    struct iovec region = {worker.write_buffers.data(), worker.write_buffers.size()};
+    success = success && worker.queue.RegisterBuffers(&region, 1);
+    worker.slots = std::vector<ArdPacketUringSlot>(max_connections);
+    for (size_t index = max_connections; index > 0; --index)
+    {
+        worker.free_slots.push_back(static_cast<uint32_t>(index - 1));
+    }
+
+    // the listening socket stays blocking, the multishot accept waits on it
+    worker.wake_fd = eventfd(0, EFD_CLOEXEC);
+    return (success && worker.wake_fd >= 0 && Listen(worker, 0));
+}
+
+inline void ArdPacketUringServer::CloseWorker(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketUringWorker &worker = static_cast<ArdPacketUringWorker &>(worker_base);
+    for (ArdPacketUringSlot &slot : worker.slots)
+    {
+        if (slot.open)
+        {
+            m_handler.OnDisconnect(*slot.connection);
+            close(slot.connection->m_fd);
+            slot.open = false;
+        }
+    }
+    // closing the ring cancels every request
+    worker.queue.Close();
+}
+
+inline void ArdPacketUringServer::Run(ArdPacketServerWorkerBase &worker_base)
+{
+    ArdPacketUringWorker &worker = static_cast<ArdPacketUringWorker &>(worker_base);
+    ArmAccept(worker);
+    ArmWake(worker);
+
+    bool success = true;
+    while (m_running && success)
+    {
+        // submit everything queued and sleep until something completes, without the wake read armed only poll
+        RetryDeferred(worker);
+        success = worker.queue.Submit(worker.wake_armed ? 1 : 0);
+        struct io_uring_cqe cqe = {};
+        while (worker.queue.PopCompletion(cqe))
+        {
+            const eArdPacketUringOp op = static_cast<eArdPacketUringOp>(cqe.user_data >> 56);
+            const uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32) & 0xFFFFFF;
+            const uint32_t index = static_cast<uint32_t>(cqe.user_data);
+            const bool current =
+                (index < worker.slots.size() && (worker.slots[index].generation & 0xFFFFFF) == generation);
+            if (op == kArdPacketUringOpAccept)
+            {
+                if (cqe.res >= 0)
+                {
+                    Accepted(worker, cqe.res);
+                }
+                worker.accept_armed = ((cqe.flags & IORING_CQE_F_MORE) != 0);
+                if (!worker.accept_armed && m_running)
+                {
+                    ArmAccept(worker);
+                }
+            }
+            else if (op == kArdPacketUringOpWake)
+            {
+                worker.wake_armed = false;
+            }
+            else if (op == kArdPacketUringOpReceive && current)
+            {
+                Received(worker, index, cqe);
+            }
+            else if (op == kArdPacketUringOpWrite && current)
+            {
+                Written(worker, index, cqe);
+            }
+            else if ((cqe.flags & IORING_CQE_F_BUFFER) != 0)
+            {
+                worker.buffers.Recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        }
+    }
+}
+
+inline void ArdPacketUringServer::ArmAccept(ArdPacketUringWorker &worker)
+{
+    struct io_uring_sqe *sqe = worker.queue.GetSqe();
+    worker.accept_armed = (sqe != nullptr);
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = worker.listen_fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = UserData(kArdPacketUringOpAccept, 0, 0);
+    }
+}
+
+inline void ArdPacketUringServer::ArmWake(ArdPacketUringWorker &worker)
+{
+    struct io_uring_sqe *sqe = worker.queue.GetSqe();
+    worker.wake_armed = (sqe != nullptr);
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = worker.wake_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&worker.wake_value);
+        sqe->len = sizeof(worker.wake_value);
+        sqe->user_data = UserData(kArdPacketUringOpWake, 0, 0);
+    }
+}
+
+inline void ArdPacketUringServer::ArmReceive(ArdPacketUringWorker &worker, const uint32_t index)
+{
+    ArdPacketUringSlot &slot = worker.slots[index];
+    struct io_uring_sqe *sqe = worker.queue.GetSqe();
+    slot.receive_armed = (sqe != nullptr);
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = slot.connection->m_fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kArdPacketUringBufferGroup;
+        sqe->user_data = UserData(kArdPacketUringOpReceive, slot.generation, index);
+    }
+    else
+    {
+        Defer(worker, index);
+    }
+}
+
+inline void ArdPacketUringServer::Defer(ArdPacketUringWorker &worker, const uint32_t index)
+{
+    ArdPacketUringSlot &slot = worker.slots[index];
+    if (!slot.deferred)
+    {
+        slot.deferred = true;
+        worker.deferred_slots.push_back(index);
+    }
+}
+
+inline void ArdPacketUringServer::RetryDeferred(ArdPacketUringWorker &worker)
+{
+    if (!worker.wake_armed && m_running)
+    {
+        ArmWake(worker);
+    }
+    if (!worker.accept_armed && m_running)
+    {
+        ArmAccept(worker);
+    }
+    // requests that still find the queue full are deferred again
+    std::vector<uint32_t> deferred_slots;
+    deferred_slots.swap(worker.deferred_slots);
+    for (const uint32_t index : deferred_slots)
+    {
+        ArdPacketUringSlot &slot = worker.slots[index];
+        slot.deferred = false;
+        if (slot.open && !slot.receive_armed)
+        {
+            ArmReceive(worker, index);
+        }
+        if (slot.open)
+        {
+            Flush(worker, index);
+        }
+        ReleaseSlot(worker, index);
+    }
+}
+
+inline void ArdPacketUringServer::Accepted(ArdPacketUringWorker &worker, const int fd)
+{
+    // sockets stay blocking, io_uring waits for them
+    const int no_delay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    if (worker.free_slots.empty())
+    {
+        close(fd);
+    }
+    else
+    {
+        const uint32_t index = worker.free_slots.back();
+        worker.free_slots.pop_back();
+        ArdPacketUringSlot &slot = worker.slots[index];
+        const size_t write_buffer_size = m_uring_config.write_buffer_size;
+        slot.stream.Reset(&worker.write_buffers[index * write_buffer_size], write_buffer_size);
+        slot.connection.reset(
+            new ArdPacketServerConnection(slot.stream, worker.index, m_config.packet.max_payload_size));
+        slot.connection->m_fd = fd;
+        slot.connection->m_packet.Configure(m_config.packet);
+        slot.generation++;
+        slot.open = true;
+        worker.connection_count++;
+        ArmReceive(worker, index);
+        m_handler.OnConnect(*slot.connection);
+        Flush(worker, index);
+    }
+}
+
+inline void ArdPacketUringServer::Received(ArdPacketUringWorker &worker, const uint32_t index,
+                                           const struct io_uring_cqe &cqe)
+{
+    ArdPacketUringSlot &slot = worker.slots[index];
+    const bool has_buffer = ((cqe.flags & IORING_CQE_F_BUFFER) != 0);
+    const uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    slot.receive_armed = ((cqe.flags & IORING_CQE_F_MORE) != 0);
+
+    if (slot.open && cqe.res > 0 && has_buffer)
+    {
+        // parse straight from the receive buffer
+        slot.stream.Feed(worker.buffers.Buffer(buffer_id), static_cast<size_t>(cqe.res));
+        slot.connection->ReadPayloads(m_handler);
+        slot.stream.Retain();
+    }
+    else if (slot.open && cqe.res != -ENOBUFS)
+    {
+        // end of stream or error
+        slot.connection->m_close = true;
+    }
+    if (has_buffer)
+    {
+        worker.buffers.Recycle(buffer_id);
+    }
+
+    if (slot.open && slot.connection->m_close)
+    {
+        CloseSlot(worker, index);
+    }
+    else if (slot.open)
+    {
+        if (!slot.receive_armed)
+        {
+            // ran out of receive buffers, they are recycled by now
+            ArmReceive(worker, index);
+        }
+        Flush(worker, index);
+    }
+    ReleaseSlot(worker, index);
+}
+
+inline void ArdPacketUringServer::Written(ArdPacketUringWorker &worker, const uint32_t index,
+                                          const struct io_uring_cqe &cqe)
+{
+    ArdPacketUringSlot &slot = worker.slots[index];
+    slot.stream.WriteDone(cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0);
+    if (slot.open && cqe.res <= 0)
+    {
+        CloseSlot(worker, index);
+    }
+    else if (slot.open)
+    {
+        Flush(worker, index);
+        m_handler.OnWritable(*slot.connection);
+        if (slot.connection->m_close)
+        {
+            CloseSlot(worker, index);
+        }
+        else
+        {
+            Flush(worker, index);
+        }
+    }
+    ReleaseSlot(worker, index);
+}
+
+inline void ArdPacketUringServer::Flush(ArdPacketUringWorker &worker, const uint32_t index)
+{
+    ArdPacketUringStream &stream = worker.slots[index].stream;
+    const size_t size = stream.WritePending();
+    if (size > 0)
+    {
+        struct io_uring_sqe *sqe = worker.queue.GetSqe();
+        if (sqe != nullptr)
+        {
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->fd = worker.slots[index].connection->m_fd;
+            sqe->addr = reinterpret_cast<uint64_t>(&stream.m_write_buffer[stream.m_write_start]);
+            sqe->len = static_cast<uint32_t>(size);
+            sqe->buf_index = 0;
+            sqe->user_data = UserData(kArdPacketUringOpWrite, worker.slots[index].generation, index);
+            stream.m_write_in_flight = true;
+        }
+        else
+        {
+            Defer(worker, index);
+        }
+    }
+}
+
+inline void ArdPacketUringServer::CloseSlot(ArdPacketUringWorker &worker, const uint32_t index)
+{
+    // shutting down ends the armed receive, the slot is reused once every request completed
+    ArdPacketUringSlot &slot = worker.slots[index];
+    m_handler.OnDisconnect(*slot.connection);
+    shutdown(slot.connection->m_fd, SHUT_RDWR);
+    close(slot.connection->m_fd);
+    slot.open = false;
+    worker.connection_count--;
+}
+
+inline void ArdPacketUringServer::ReleaseSlot(ArdPacketUringWorker &worker, const uint32_t index)
+{
+    ArdPacketUringSlot &slot = worker.slots[index];
+    if (!slot.open && slot.connection && !slot.receive_armed && !slot.stream.m_write_in_flight && !slot.deferred)
+    {
+        slot.connection.reset();
+        worker.free_slots.push_back(index);
+    }
+}
+
+#endif
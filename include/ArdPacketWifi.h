@@ -4,8 +4,11 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <WiFiUdp.h>
 
 #include "ArdPacket.h"
+#include "ArdPacketDatagram.h"
+#include "ArdPacketWriteEstimate.h"
 
 class ArdPacketWifi : public ArdPacketStreamInterface
 {
@@ -25,38 +28,91 @@ class ArdPacketWifi : public ArdPacketStreamInterface
         return m_wifi.read(buffer, size);
     }
 
-    int availableForWrite() override;
+    int availableForWrite() override
+    {
+        return m_write_estimate.Available();
+    }
     size_t write(uint8_t value) override
     {
-        return m_wifi.write(value);
+        return write(&value, 1);
     }
-    size_t write(const uint8_t *buffer, size_t size) override
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    /**
+     * @brief Use a fixed writable size instead of estimating it
+     *
+     * @param size
+     */
+    void SetAvailableForWrite(int size)
     {
-        return m_wifi.write(buffer, size);
+        m_write_estimate.SetFixed(size);
     }
 
-    void SetAvailableForWrite(int size);
+    /**
+     * @brief Writable size estimate, configure it to tune or restart estimating
+     */
+    ArdPacketWriteEstimate &WriteEstimate()
+    {
+        return m_write_estimate;
+    }
 
    private:
     WiFiClient &m_wifi;
-    int m_available_for_write = 64;
+    ArdPacketWriteEstimate m_write_estimate;
 };
 
-inline int ArdPacketWifi::availableForWrite()
+/**
+ * @brief WiFi UDP socket for @c ArdPacketDatagram
+ *
+ * Datagrams are sent to a fixed peer. Begin the @c WiFiUDP on a local port before use.
+ */
+class ArdPacketWifiUdp : public ArdPacketDatagramInterface
 {
-    return m_available_for_write;
+   public:
+    ArdPacketWifiUdp(WiFiUDP &udp, const IPAddress &peer_ip, const uint16_t peer_port)
+        : m_udp(udp), m_peer_ip(peer_ip), m_peer_port(peer_port)
+    {
+    }
+
+    size_t ReceiveDatagram(uint8_t *buffer, size_t size) override;
+    bool SendDatagram(const uint8_t *buffer, size_t size) override;
+
+   private:
+    WiFiUDP &m_udp;
+    IPAddress m_peer_ip;
+    uint16_t m_peer_port;
+};
+
+inline size_t ArdPacketWifi::write(const uint8_t *buffer, const size_t size)
+{
+    // the stream takes fewer bytes or blocks while the link drains, either shrinks the estimate
+    const uint32_t start_us = m_write_estimate.Now();
+    const size_t written = m_wifi.write(buffer, size);
+    m_write_estimate.Written(size, written, start_us);
+    return written;
 }
 
-inline void ArdPacketWifi::SetAvailableForWrite(const int size)
+inline size_t ArdPacketWifiUdp::ReceiveDatagram(uint8_t *buffer, const size_t size)
 {
-    if (size > 0)
+    size_t datagram_size = 0;
+    const int packet_size = m_udp.parsePacket();
+    if (packet_size > 0 && static_cast<size_t>(packet_size) <= size)
     {
-        m_available_for_write = size;
+        const int read_size = m_udp.read(buffer, size);
+        datagram_size = (read_size == packet_size ? static_cast<size_t>(read_size) : 0);
     }
-    else
+    else if (packet_size > 0)
     {
-        m_available_for_write = 0;
+        // too long, drop it
+        m_udp.flush();
     }
+    return datagram_size;
+}
+
+inline bool ArdPacketWifiUdp::SendDatagram(const uint8_t *buffer, const size_t size)
+{
+    return (m_udp.beginPacket(m_peer_ip, m_peer_port) == 1 && m_udp.write(buffer, size) == size &&
+            m_udp.endPacket() == 1);
 }
 
 #endif
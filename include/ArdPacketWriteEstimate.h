@@ -0,0 +1,196 @@
+
+#ifndef ARD_PACKET_WRITE_ESTIMATE_H
+#define ARD_PACKET_WRITE_ESTIMATE_H
+
+#include <stdint.h>
+
+#include "ArdPacket.h"
+
+/**
+ * @brief Write estimate configuration
+ */
+struct ArdPacketWriteEstimateConfig
+{
+    /**
+     * @brief First estimate in bytes
+     */
+    int initial_size = 64;
+
+    /**
+     * @brief Smallest estimate in bytes
+     */
+    int min_size = 16;
+
+    /**
+     * @brief Largest estimate in bytes
+     */
+    int max_size = 2048;
+
+    /**
+     * @brief Bytes added to the estimate after all of it was accepted without resistance
+     */
+    int increase_size = 64;
+
+    /**
+     * @brief Writes blocking longer than this count as congestion, 0 to only count rejected bytes
+     */
+    uint32_t slow_write_us = 2000;
+
+    /**
+     * @brief Microsecond clock, defaults to @c micros on Arduino
+     */
+    ArdPacketClock clock_us = nullptr;
+};
+
+/**
+ * @brief Writable size estimate for streams that do not report one, such as WiFi and Bluetooth clients
+ *
+ * Additive increase, multiplicative decrease: the estimate grows by @c increase_size each time the stream took all
+ * of it, and is halved when the stream accepts fewer bytes than written or a write blocks while the link drains.
+ * A round runs from one @c Available call to the next.
+ */
+class ArdPacketWriteEstimate
+{
+   public:
+    ArdPacketWriteEstimate()
+    {
+        // the default configuration only lacks a clock natively, timing is then ignored
+        Apply(ArdPacketWriteEstimateConfig());
+    }
+
+    /**
+     * @brief Configure and restart estimating
+     *
+     * @param config
+     * @return
+     */
+    eArdPacketConfigStatus Configure(const ArdPacketWriteEstimateConfig &config);
+
+    /**
+     * @brief Estimate for the next writes, starting a round
+     *
+     * @return size in bytes
+     */
+    int Available();
+
+    /**
+     * @brief Time to pass to @c Written, taken right before writing
+     */
+    uint32_t Now() const
+    {
+        return (m_clock != nullptr ? m_clock() : 0);
+    }
+
+    /**
+     * @brief Account for a write to the stream
+     *
+     * @param requested bytes passed to the stream
+     * @param accepted bytes the stream took
+     * @param start_us @c Now before the write
+     */
+    void Written(size_t requested, size_t accepted, uint32_t start_us);
+
+    /**
+     * @brief Use a fixed size and stop estimating until the next @c Configure
+     *
+     * @param size
+     */
+    void SetFixed(int size);
+
+    /**
+     * @brief Current estimate in bytes
+     */
+    int Estimate() const
+    {
+        return m_estimate;
+    }
+
+   private:
+    void Apply(const ArdPacketWriteEstimateConfig &config);
+
+    ArdPacketWriteEstimateConfig m_config;
+    ArdPacketClock m_clock = nullptr;
+    bool m_adaptive = true;
+    int m_estimate = 0;
+    size_t m_round_used = 0;
+    bool m_round_congested = false;
+};
+
+// inline methods
+
+inline eArdPacketConfigStatus ArdPacketWriteEstimate::Configure(const ArdPacketWriteEstimateConfig &config)
+{
+    eArdPacketConfigStatus status = kArdPacketConfigSuccess;
+    ArdPacketClock clock = config.clock_us;
+#ifndef NATIVE_TEST_BUILD
+    if (clock == nullptr)
+    {
+        clock = []() -> uint32_t { return static_cast<uint32_t>(micros()); };
+    }
+#endif
+
+    if (config.min_size <= 0 || config.initial_size < config.min_size || config.max_size < config.initial_size ||
+        config.increase_size <= 0)
+    {
+        status = kArdPacketConfigInvalidWriteEstimate;
+    }
+    else if (clock == nullptr && config.slow_write_us != 0)
+    {
+        status = kArdPacketConfigInvalidClock;
+    }
+    else
+    {
+        Apply(config);
+    }
+    return status;
+}
+
+inline int ArdPacketWriteEstimate::Available()
+{
+    if (m_adaptive && !m_round_congested && m_round_used >= static_cast<size_t>(m_estimate))
+    {
+        // the whole estimate went out without resistance
+        m_estimate = (m_config.max_size - m_estimate > m_config.increase_size ? m_estimate + m_config.increase_size
+                                                                               : m_config.max_size);
+    }
+    m_round_used = 0;
+    m_round_congested = false;
+    return m_estimate;
+}
+
+inline void ArdPacketWriteEstimate::Written(const size_t requested, const size_t accepted, const uint32_t start_us)
+{
+    m_round_used += accepted;
+    const bool slow = (m_clock != nullptr && m_config.slow_write_us != 0 &&
+                       static_cast<uint32_t>(m_clock() - start_us) > m_config.slow_write_us);
+    if (m_adaptive && !m_round_congested && requested > 0 && (accepted < requested || slow))
+    {
+        // halve once per round
+        m_estimate = (m_estimate / 2 > m_config.min_size ? m_estimate / 2 : m_config.min_size);
+        m_round_congested = true;
+    }
+}
+
+inline void ArdPacketWriteEstimate::SetFixed(const int size)
+{
+    m_adaptive = false;
+    m_estimate = (size > 0 ? size : 0);
+}
+
+inline void ArdPacketWriteEstimate::Apply(const ArdPacketWriteEstimateConfig &config)
+{
+    m_config = config;
+    m_clock = config.clock_us;
+#ifndef NATIVE_TEST_BUILD
+    if (m_clock == nullptr)
+    {
+        m_clock = []() -> uint32_t { return static_cast<uint32_t>(micros()); };
+    }
+#endif
+    m_adaptive = true;
+    m_estimate = config.initial_size;
+    m_round_used = 0;
+    m_round_congested = false;
+}
+
+#endif
@@ -0,0 +1,98 @@
+
+"""Per-symbol flash and RAM report of a firmware or native program.
+
+usage: size_report.py ELF [--nm NM] [--top N]
+
+Also runs as a PlatformIO extra script (extra_scripts = post:scripts/size_report.py) and prints the report after
+every link of the environment.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+# nm symbol types: code and constants stay in flash, initialized data is copied from flash to RAM, the rest is RAM
+FLASH_TYPES = set("tTwWrRvVuU")
+DATA_TYPES = set("dDgG")
+RAM_TYPES = set("bBsScC")
+
+# symbol name prefixes per library feature, checked in order
+FEATURES = [
+    ("crc", ("crc_",)),
+    ("cobs", ("ArdPacketCobs",)),
+    ("fec", ("ArdPacketFec", "kArdPacketFec")),
+    ("lzss", ("ArdPacketLzss", "ArdPacketCompress")),
+    ("delta", ("ArdPacketDelta",)),
+    ("stats", ("ArdPacketStats",)),
+    ("trace", ("ArdPacketTrace",)),
+    ("packet", ("ArdPacket",)),
+]
+
+
+def feature_of(name):
+    for feature, prefixes in FEATURES:
+        if name.startswith(prefixes) or any(("::" + prefix) in name for prefix in prefixes):
+            return feature
+    return "other"
+
+
+def read_symbols(elf, nm):
+    output = subprocess.run(
+        [nm, "--demangle", "--print-size", "--size-sort", elf], check=True, capture_output=True, text=True
+    ).stdout
+    symbols = []
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4:
+            size = int(fields[1], 16)
+            kind = fields[2]
+            flash = size if (kind in FLASH_TYPES or kind in DATA_TYPES) else 0
+            ram = size if (kind in DATA_TYPES or kind in RAM_TYPES) else 0
+            symbols.append((fields[3], kind, flash, ram))
+    return symbols
+
+
+def report(elf, nm, top):
+    symbols = read_symbols(elf, nm)
+    totals = {}
+    for name, _, flash, ram in symbols:
+        feature = feature_of(name)
+        flash_total, ram_total = totals.get(feature, (0, 0))
+        totals[feature] = (flash_total + flash, ram_total + ram)
+
+    print("Size report: %s" % elf)
+    print("%-10s %10s %10s" % ("feature", "flash", "ram"))
+    for feature, (flash, ram) in sorted(totals.items(), key=lambda item: -item[1][0]):
+        print("%-10s %10d %10d" % (feature, flash, ram))
+    print("%-10s %10d %10d" % ("total", sum(t[0] for t in totals.values()), sum(t[1] for t in totals.values())))
+
+    print("\n%-10s %8s %8s  %s" % ("feature", "flash", "ram", "symbol"))
+    library = [s for s in symbols if feature_of(s[0]) != "other"]
+    for name, _, flash, ram in sorted(library, key=lambda s: -(s[2] + s[3]))[:top]:
+        print("%-10s %8d %8d  %s" % (feature_of(name), flash, ram, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf")
+    parser.add_argument("--nm", default="nm", help="nm of the target toolchain, such as avr-nm")
+    parser.add_argument("--top", type=int, default=25, help="number of library symbols to list")
+    arguments = parser.parse_args()
+    report(arguments.elf, arguments.nm, arguments.top)
+
+
+def platformio_post_action(target, source, env):
+    # nm sits next to the compiler of the toolchain: avr-gcc -> avr-nm, gcc -> nm
+    compiler = env.subst("$CC")
+    nm = os.path.join(os.path.dirname(compiler), os.path.basename(compiler)[: -len("gcc")] + "nm")
+    nm = nm if os.path.dirname(compiler) else os.path.basename(nm)
+    report(str(target[0]), nm, 25)
+
+
+try:
+    Import("env")  # noqa: F821 (defined by PlatformIO)
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}${PROGSUFFIX}", platformio_post_action)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        main()
@@ -1,8 +1,10 @@
 
 import socket
+import sys
 
-HOST = "192.168.2.100"
-PORT = 9040
+# usage: tcp_echo_server.py [host] [port]
+HOST = sys.argv[1] if len(sys.argv) > 1 else "192.168.2.100"
+PORT = int(sys.argv[2]) if len(sys.argv) > 2 else 9040
 
 with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
     s.bind((HOST, PORT))
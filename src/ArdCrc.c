@@ -17,12 +17,47 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+/* keep the table in flash instead of copying it to RAM at startup */
+#define ARD_CRC_TABLE_ATTR PROGMEM
+#define ARD_CRC_TABLE_READ(index) pgm_read_word(&crc_table[index])
+#else
+#define ARD_CRC_TABLE_ATTR
+#define ARD_CRC_TABLE_READ(index) crc_table[index]
+#endif
 
 
+#if ARD_CRC_TABLE_BITS == 4
+
+/**
+ * Static table used for the table_driven implementation, one entry per nibble.
+ */
+static const uint16_t crc_table[16] ARD_CRC_TABLE_ATTR = {
+    0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+    0x8408, 0x9489, 0xa50a, 0xb58b, 0xc60c, 0xd68d, 0xe70e, 0xf78f
+};
+
+
+crc_t crc_update(crc_t crc, const void *data, size_t data_len)
+{
+    const unsigned char *d = (const unsigned char *)data;
+
+    while (data_len--) {
+        crc ^= *d;
+        crc = ARD_CRC_TABLE_READ(crc & 0x0f) ^ (crc >> 4);
+        crc = ARD_CRC_TABLE_READ(crc & 0x0f) ^ (crc >> 4);
+        d++;
+    }
+    return crc & 0xffff;
+}
+
+#else
+
 /**
  * Static table used for the table_driven implementation.
  */
-static const crc_t crc_table[256] = {
+static const uint16_t crc_table[256] ARD_CRC_TABLE_ATTR = {
     0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
     0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
     0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
@@ -65,8 +100,10 @@ crc_t crc_update(crc_t crc, const void *data, size_t data_len)
 
     while (data_len--) {
         tbl_idx = (crc ^ *d) & 0xff;
-        crc = (crc_table[tbl_idx] ^ (crc >> 8)) & 0xffff;
+        crc = (ARD_CRC_TABLE_READ(tbl_idx) ^ (crc >> 8)) & 0xffff;
         d++;
     }
     return crc & 0xffff;
 }
+
+#endif
@@ -1,7 +1,27 @@
+#include <stdlib.h>
 #include <unity.h>
 
+// trace hooks are compiled in for the tests only
+#define ARD_PACKET_TRACE 1
+
+#include <vector>
+
 #include "ArdPacketBuffer.h"
 #include "ArdPacket.h"
+#include "ArdPacketCompress.h"
+#include "ArdPacketCredit.h"
+#include "ArdPacketDelta.h"
+#include "ArdPacketDatagram.h"
+#include "ArdPacketDispatch.h"
+#include "ArdPacketForward.h"
+#include "ArdPacketPoller.h"
+#include "ArdPacketPosix.h"
+#include "ArdPacketServer.h"
+#include "ArdPacketStatsReport.h"
+#include "ArdPacketTraceJson.h"
+#include "ArdPacketUring.h"
+#include "ArdPacketReliable.h"
+#include "ArdPacketRingBuffer.h"
 
 // void setUp(void) {
 // // set stuff up here
@@ -18,6 +38,19 @@
 
 // utility
 
+// fake clocks, advanced by the tests
+static uint32_t test_clock_ms = 0;
+static uint32_t ArdPacketTestClock()
+{
+    return test_clock_ms;
+}
+
+static uint32_t test_clock_us = 0;
+static uint32_t ArdPacketTestClockUs()
+{
+    return test_clock_us;
+}
+
 static size_t ArdPacketGetHeaderSizeUtility(const ArdPacketConfig &config)
 {
     size_t header_size = 1 + config.message_type_bytes + config.payload_size_bytes;
@@ -38,6 +71,256 @@ static size_t ArdPacketGetPacketSizeUtility(const ArdPacketConfig &config, const
     return packet_size;
 }
 
+// loopback end corrupting every n-th written byte
+class ArdPacketLossyLink : public ArdPacketStreamInterface
+{
+   public:
+    ArdPacketLossyLink(ArdPacketRingBuffer &rx, ArdPacketRingBuffer &tx, const size_t corrupt_period)
+        : m_rx(rx), m_tx(tx), m_corrupt_period(corrupt_period)
+    {
+    }
+
+    int available() override
+    {
+        return m_rx.available();
+    }
+    int read() override
+    {
+        return m_rx.read();
+    }
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return m_rx.read(buffer, size);
+    }
+
+    int availableForWrite() override
+    {
+        return m_tx.availableForWrite();
+    }
+    size_t write(uint8_t value) override
+    {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t written = 0;
+        while (written < size && m_tx.availableForWrite() > 0)
+        {
+            m_written++;
+            const uint8_t value =
+                (m_corrupt_period > 0 && m_written % m_corrupt_period == 0 ? buffer[written] ^ 0x24 : buffer[written]);
+            written += m_tx.write(value);
+        }
+        return written;
+    }
+
+   private:
+    ArdPacketRingBuffer &m_rx;
+    ArdPacketRingBuffer &m_tx;
+    size_t m_corrupt_period = 0;
+    size_t m_written = 0;
+};
+
+// loopback end hiding how much room the far end has, bytes that do not fit are dropped
+class ArdPacketOverrunLink : public ArdPacketStreamInterface
+{
+   public:
+    ArdPacketOverrunLink(ArdPacketRingBuffer &rx, ArdPacketRingBuffer &tx) : m_rx(rx), m_tx(tx) {}
+
+    int available() override
+    {
+        return m_rx.available();
+    }
+    int read() override
+    {
+        return m_rx.read();
+    }
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return m_rx.read(buffer, size);
+    }
+
+    int availableForWrite() override
+    {
+        return 1024;
+    }
+    size_t write(uint8_t value) override
+    {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        const size_t written = m_tx.write(buffer, size);
+        dropped += size - written;
+        return size;
+    }
+
+    size_t dropped = 0;
+
+   private:
+    ArdPacketRingBuffer &m_rx;
+    ArdPacketRingBuffer &m_tx;
+};
+
+// send frames from one stream to the other and check they arrive in order
+static void ArdPacketExchangeUtility(ArdPacketStreamInterface &sender_stream, ArdPacketStreamInterface &receiver_stream,
+                                     const uint32_t frames, const size_t max_payload_size)
+{
+    ArdPacket sender(sender_stream);
+    ArdPacket receiver(receiver_stream);
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = max_payload_size;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+
+    uint8_t payload[1024];
+    uint8_t receive_buffer[1024];
+    TEST_ASSERT_TRUE(max_payload_size <= sizeof(payload));
+    ArdPacketPayloadInfo input_info;
+    ArdPacketPayloadInfo receive_info;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    for (size_t step = 0; step < 1000000 && received < frames; ++step)
+    {
+        if (sent < frames)
+        {
+            input_info.message_type = sent;
+            input_info.payload_size = 1 + (sent * 37) % max_payload_size;
+            memset(payload, static_cast<int>(sent), input_info.payload_size);
+            sent += (sender.SendPayload(input_info, payload) == kArdPacketStatusDone ? 1 : 0);
+        }
+        else
+        {
+            // buffered streams send the rest when polled
+            sender_stream.availableForWrite();
+        }
+        if (receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(received, receive_info.message_type);
+            TEST_ASSERT_EQUAL(1 + (received * 37) % max_payload_size, receive_info.payload_size);
+            TEST_ASSERT_EQUAL(static_cast<uint8_t>(received), receive_buffer[receive_info.payload_size - 1]);
+            received++;
+        }
+    }
+    TEST_ASSERT_EQUAL(frames, received);
+}
+
+// records payloads per endpoint
+class ArdPacketPollerRecorder : public ArdPacketPollerHandler
+{
+   public:
+    void OnPayload(ArdPacketPollerEndpoint &endpoint, const ArdPacketPayloadInfo &info, const uint8_t *payload) override
+    {
+        (void)payload;
+        std::vector<uint32_t> &types = *static_cast<std::vector<uint32_t> *>(endpoint.context);
+        types.push_back(info.message_type);
+    }
+};
+
+// keeps traced transitions
+class ArdPacketTraceRecorder : public ArdPacketTraceSink
+{
+   public:
+    void OnStateChange(const ArdPacketTraceEvent &event) override
+    {
+        events.push_back(event);
+    }
+
+    std::vector<ArdPacketTraceEvent> events;
+};
+
+// counts dispatched payloads and keeps the last one
+struct ArdPacketDispatchRecord
+{
+    uint32_t calls = 0;
+    uint32_t message_type = 0;
+    uint8_t payload[32] = {0};
+};
+
+static void ArdPacketDispatchRecordUtility(const ArdPacketPayloadInfo &info, const uint8_t *payload, void *context)
+{
+    ArdPacketDispatchRecord &record = *static_cast<ArdPacketDispatchRecord *>(context);
+    record.calls++;
+    record.message_type = info.message_type;
+    memcpy(record.payload, payload, info.payload_size < sizeof(record.payload) ? info.payload_size : sizeof(record.payload));
+}
+
+// datagrams kept in memory, optionally corrupting one of them
+class ArdPacketDatagramLink : public ArdPacketDatagramInterface
+{
+   public:
+    size_t ReceiveDatagram(uint8_t *buffer, size_t size) override
+    {
+        size_t datagram_size = 0;
+        if (m_next < m_datagrams.size() && m_datagrams[m_next].size() <= size)
+        {
+            datagram_size = m_datagrams[m_next].size();
+            memcpy(buffer, m_datagrams[m_next].data(), datagram_size);
+        }
+        m_next += (m_next < m_datagrams.size() ? 1 : 0);
+        return datagram_size;
+    }
+    bool SendDatagram(const uint8_t *buffer, size_t size) override
+    {
+        m_datagrams.emplace_back(buffer, buffer + size);
+        if (m_datagrams.size() == corrupt_datagram)
+        {
+            m_datagrams.back()[size / 2] ^= 0x5A;
+        }
+        return true;
+    }
+
+    size_t Count() const
+    {
+        return m_datagrams.size();
+    }
+
+    size_t corrupt_datagram = 0;
+
+   private:
+    std::vector<std::vector<uint8_t>> m_datagrams;
+    size_t m_next = 0;
+};
+
+// server handler sending every payload back, runs on worker threads so failures are counted and asserted later
+class ArdPacketEchoHandler : public ArdPacketServerHandler
+{
+   public:
+    void OnConnect(ArdPacketServerConnection &connection) override
+    {
+        (void)connection;
+        connects++;
+    }
+    void OnPayload(ArdPacketServerConnection &connection, const ArdPacketPayloadInfo &info,
+                   const uint8_t *payload) override
+    {
+        // small payloads always fit in the write buffer
+        send_failures += (connection.Send(info, payload) != kArdPacketStatusDone ? 1 : 0);
+        payloads++;
+    }
+    void OnReceiveError(ArdPacketServerConnection &connection, const eArdPacketStatus status) override
+    {
+        (void)connection;
+        (void)status;
+        errors++;
+    }
+    void OnDisconnect(ArdPacketServerConnection &connection) override
+    {
+        (void)connection;
+        disconnects++;
+    }
+
+    std::atomic<size_t> connects{0};
+    std::atomic<size_t> payloads{0};
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> send_failures{0};
+    std::atomic<size_t> disconnects{0};
+};
+
 // Create and configure
 static void test_packet_configure_pass(void)
 {
@@ -252,20 +535,2400 @@ static void test_packet_pass_static_write_read(void)
     TEST_ASSERT_EQUAL(7, payload_index);
 }
 
-int main(void)
+// Write and read consecutive messages from one stream
+static void test_packet_pass_write_read_sequence(void)
 {
-    UNITY_BEGIN();
+    uint8_t stream_buffer[2 * TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
 
-    // Run Tests
-    // ---------
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
 
-    RUN_TEST(test_packet_configure_pass);
-    RUN_TEST(test_packet_configure_fail_payload_bytes);
-    RUN_TEST(test_packet_configure_fail_message_type);
-    RUN_TEST(test_packet_configure_fail_max_payload);
-    RUN_TEST(test_packet_pass_write_read);
+    // write two packets
+    packet_buffer.set_write_buffer(stream_buffer, sizeof(stream_buffer));
+    const ArdPacketPayloadInfo first_info = {.message_type = 1, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    const ArdPacketPayloadInfo second_info = {.message_type = 2, .payload_size = 4};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.SendPayload(first_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.SendPayload(second_info, reinterpret_cast<const uint8_t *>("abc")));
+    const size_t stream_size = 2 * ArdPacketGetPacketSizeUtility(config, 0) + first_info.payload_size + 4;
 
-    RUN_TEST(test_packet_pass_static_write_read);
+    // read two packets
+    packet_buffer.set_read_buffer(stream_buffer, stream_size);
+    uint8_t receive_buffer[32] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(1, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING("abc", receive_buffer);
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable,
+                      packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+}
+
+// COBS framing never puts the delimiter inside a packet
+static void test_packet_cobs_write_read(void)
+{
+    uint8_t stream_buffer[2 * TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = 64;
+    config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // payload with delimiters and zeros
+    const uint8_t input_payload[] = {'|', 0, 'a', '|', '|', 0, 0, 'b', '|'};
+    const ArdPacketPayloadInfo input_info = {.message_type = '|', .payload_size = sizeof(input_payload)};
+
+    // write with small chunks
+    size_t stream_size = 0;
+    eArdPacketStatus send_status = kArdPacketStatusStart;
+    while (send_status != kArdPacketStatusDone)
+    {
+        packet_buffer.set_write_buffer(&stream_buffer[stream_size], 3);
+        send_status = packet.SendPayload(input_info, input_payload);
+        stream_size += 3 - packet_buffer.availableForWrite();
+    }
+    TEST_ASSERT_EQUAL('|', stream_buffer[0]);
+    for (size_t k = 1; k < stream_size; ++k)
+    {
+        TEST_ASSERT_NOT_EQUAL('|', stream_buffer[k]);
+    }
+
+    // read with small chunks
+    uint8_t receive_buffer[sizeof(input_payload)] = {0};
+    ArdPacketPayloadInfo receive_info;
+    eArdPacketStatus recv_status = kArdPacketStatusStart;
+    size_t read_index = 0;
+    while (recv_status != kArdPacketStatusDone && read_index < stream_size)
+    {
+        const size_t read_size = (stream_size - read_index < 2 ? stream_size - read_index : 2);
+        packet_buffer.set_read_buffer(&stream_buffer[read_index], read_size);
+        recv_status = packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer);
+        read_index += read_size - packet_buffer.available();
+    }
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, recv_status);
+    TEST_ASSERT_EQUAL(stream_size, read_index);
+    TEST_ASSERT_EQUAL('|', receive_info.message_type);
+    TEST_ASSERT_EQUAL(sizeof(input_payload), receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(input_payload, receive_buffer, sizeof(input_payload));
+}
+
+// COBS framing resynchronizes on the packet following a truncated packet
+static void test_packet_cobs_resync(void)
+{
+    uint8_t stream_buffer[2 * TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = 0;
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // two packets
+    packet_buffer.set_write_buffer(stream_buffer, sizeof(stream_buffer));
+    const ArdPacketPayloadInfo first_info = {.message_type = 1, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    const ArdPacketPayloadInfo second_info = {.message_type = 2, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.SendPayload(first_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.SendPayload(second_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    const size_t stream_size = sizeof(stream_buffer) - packet_buffer.availableForWrite();
+
+    // drop a payload byte from the first packet
+    memmove(&stream_buffer[10], &stream_buffer[11], stream_size - 11);
+    packet_buffer.set_read_buffer(stream_buffer, stream_size - 1);
+
+    uint8_t receive_buffer[32] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidFraming,
+                      packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+}
+
+// COBS framing with external packet buffer
+static void test_packet_cobs_static_write_read(void)
+{
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = 0;
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = 600;
+    config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // long runs without zeros and runs of zeros
+    uint8_t input_payload[600];
+    for (size_t k = 0; k < sizeof(input_payload); ++k)
+    {
+        input_payload[k] = (k < 300 ? static_cast<uint8_t>(1 + k % 255) : static_cast<uint8_t>(k % 7 == 0 ? 0 : k));
+    }
+    const ArdPacketPayloadInfo input_info = {.message_type = 0, .payload_size = sizeof(input_payload)};
+
+    uint8_t packet_data[sizeof(input_payload) + 16] = {0};
+    size_t packet_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusPacketSizeTooSmall,
+                      packet.WritePacketToBuffer(input_info, input_payload, 608, packet_data, packet_size));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.WritePacketToBuffer(input_info, input_payload, sizeof(packet_data),
+                                                                       packet_data, packet_size));
+    TEST_ASSERT_LESS_OR_EQUAL(1 + ArdPacketCobsMaxEncodedSize(4 + sizeof(input_payload) + 2), packet_size);
+    TEST_ASSERT_NULL(memchr(&packet_data[1], 0, packet_size - 1));
+
+    uint8_t receive_buffer[sizeof(input_payload)] = {0};
+    ArdPacketPayloadInfo receive_info;
+    size_t payload_index = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidFraming,
+                      packet.ReadPacketFromBuffer(packet_data, packet_size, receive_info, payload_index));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReadPacketFromBuffer(packet_data, packet_size, sizeof(receive_buffer),
+                                                                        receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(sizeof(input_payload), receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(input_payload, receive_buffer, sizeof(input_payload));
+
+    // corrupt payload
+    packet_data[100] ^= 0x10;
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed, packet.ReadPacketFromBuffer(packet_data, packet_size,
+                                                                             sizeof(receive_buffer), receive_info,
+                                                                             receive_buffer));
+}
+
+// Packet right after a false delimiter is not lost
+static void test_packet_resync_false_delimiter(void)
+{
+    uint8_t stream_buffer[TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // noise with a delimiter followed by a packet
+    memcpy(stream_buffer, "|a", 2);
+    packet_buffer.set_write_buffer(&stream_buffer[2], sizeof(stream_buffer) - 2);
+    const ArdPacketPayloadInfo input_info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.SendPayload(input_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    const size_t stream_size = sizeof(stream_buffer) - packet_buffer.availableForWrite();
+
+    packet_buffer.set_read_buffer(stream_buffer, stream_size);
+    uint8_t receive_buffer[32] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize,
+                      packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+}
+
+// Packet following a truncated packet is not lost
+static void test_packet_resync_truncated_packet(void)
+{
+    uint8_t stream_buffer[2 * TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // three packets
+    packet_buffer.set_write_buffer(stream_buffer, sizeof(stream_buffer));
+    for (uint32_t message_type = 1; message_type <= 3; ++message_type)
+    {
+        const ArdPacketPayloadInfo input_info = {.message_type = message_type,
+                                                 .payload_size = sizeof(TEST_MESSAGE_STRING)};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                          packet.SendPayload(input_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    }
+    const size_t stream_size = sizeof(stream_buffer) - packet_buffer.availableForWrite();
+
+    // drop a payload byte from the first packet
+    memmove(&stream_buffer[8], &stream_buffer[9], stream_size - 9);
+    packet_buffer.set_read_buffer(stream_buffer, stream_size - 1);
+
+    uint8_t receive_buffer[32] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed,
+                      packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+}
+
+// Variable length header fields, streamed a byte at a time and through static buffers
+static void test_packet_varint_header(void)
+{
+    uint8_t ring_buffer[1100];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(ring_buffer, sizeof(ring_buffer));
+    ArdPacket packet(ring);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = 1024;
+    config.header_encoding = kArdPacketHeaderVarint;
+    ArdPacketConfig cobs_config = config;
+    cobs_config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidFraming, packet.Configure(cobs_config));
+    ArdPacketConfig fec_config = config;
+    fec_config.fec_parity_bytes = 4;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidFec, packet.Configure(fec_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+    TEST_ASSERT_EQUAL(1 + 3 + 3 + 2 + 8 + 2, packet.GetMaxPacketSize(8));
+
+    uint8_t payload[1000];
+    for (size_t index = 0; index < sizeof(payload); ++index)
+    {
+        payload[index] = static_cast<uint8_t>(index * 7);
+    }
+
+    // small frames take one byte per field, large ones two
+    uint8_t packet_data[1100];
+    size_t packet_size = 0;
+    const ArdPacketPayloadInfo small_info = {.message_type = 5, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.WritePacketToBuffer(small_info, payload, sizeof(packet_data), packet_data, packet_size));
+    TEST_ASSERT_EQUAL(1 + 1 + 1 + 2 + 8 + 2, packet_size);
+    const ArdPacketPayloadInfo large_info = {.message_type = 300, .payload_size = 1000};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      packet.WritePacketToBuffer(large_info, payload, sizeof(packet_data), packet_data, packet_size));
+    TEST_ASSERT_EQUAL(1 + 2 + 2 + 2 + 1000 + 2, packet_size);
+    TEST_ASSERT_EQUAL_HEX8(0xac, packet_data[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, packet_data[2]);
+
+    uint8_t receive_buffer[1000];
+    ArdPacketPayloadInfo receive_info;
+    size_t packet_used = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReadPacketFromBuffer(packet_data, packet_size, sizeof(receive_buffer),
+                                                                         receive_info, receive_buffer, packet_used));
+    TEST_ASSERT_EQUAL(300, receive_info.message_type);
+    TEST_ASSERT_EQUAL(1000, receive_info.payload_size);
+    TEST_ASSERT_EQUAL(packet_size, packet_used);
+    TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, 1000);
+    TEST_ASSERT_EQUAL(kArdPacketStatusPacketSizeTooSmall,
+                      packet.ReadPacketFromBuffer(packet_data, 6, sizeof(receive_buffer), receive_info, receive_buffer,
+                                                  packet_used));
+
+    // streamed, the fields arrive one byte per call
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.SendPayload(large_info, payload));
+    TEST_ASSERT_EQUAL(packet_size, ring.available());
+    ring.read(packet_data, packet_size);
+    for (size_t index = 0; index < 8; ++index)
+    {
+        ring.write(&packet_data[index], 1);
+        const eArdPacketStatus status = packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer);
+        TEST_ASSERT_TRUE(status == kArdPacketStatusHeaderInProgress || status == kArdPacketStatusNotEnoughAvailable ||
+                         status == kArdPacketStatusPayloadInProgress);
+    }
+    ring.write(&packet_data[8], packet_size - 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(300, receive_info.message_type);
+    TEST_ASSERT_EQUAL(1000, receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, 1000);
+
+    // a message type too large for two bytes is dropped and the next packet still arrives
+    const uint8_t overlong[] = {'|', 0xff, 0xff, 0x7f, 0x01};
+    ring.write(overlong, sizeof(overlong));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.SendPayload(small_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType,
+                      packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(5, receive_info.message_type);
+    TEST_ASSERT_EQUAL(8, receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, 8);
+}
+
+// Forwarded packets are reframed for the egress while the ingress still receives them
+static void test_packet_forward_reframe(void)
+{
+    uint8_t ingress_buffer[64];
+    uint8_t egress_buffer[64];
+    ArdPacketRingBuffer ingress_ring;
+    ArdPacketRingBuffer egress_ring;
+    ingress_ring.set_buffer(ingress_buffer, sizeof(ingress_buffer));
+    egress_ring.set_buffer(egress_buffer, sizeof(egress_buffer));
+    ArdPacket sender(ingress_ring);
+    ArdPacket ingress(ingress_ring);
+    ArdPacket egress(egress_ring);
+    ArdPacket receiver(egress_ring);
+
+    // one byte fields and crc on the uart, two byte fields on the tcp side
+    ArdPacketConfig uart_config;
+    uart_config.crc = true;
+    uart_config.delimiter = '|';
+    uart_config.message_type_bytes = 1;
+    uart_config.payload_size_bytes = 1;
+    uart_config.max_payload_size = 200;
+    ArdPacketConfig tcp_config = uart_config;
+    tcp_config.delimiter = 0;
+    tcp_config.message_type_bytes = 2;
+    tcp_config.payload_size_bytes = 2;
+    tcp_config.max_payload_size = 1024;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(uart_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, ingress.Configure(uart_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress.Configure(tcp_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(tcp_config));
+
+    ArdPacketForward forward(ingress, egress);
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable, forward.Forward());
+
+    uint8_t payload[200];
+    uint8_t receive_buffer[200];
+    ArdPacketPayloadInfo receive_info;
+    for (uint32_t frame = 0; frame < 6; ++frame)
+    {
+        for (size_t index = 0; index < sizeof(payload); ++index)
+        {
+            payload[index] = static_cast<uint8_t>(index + frame);
+        }
+        const ArdPacketPayloadInfo info = {.message_type = frame, .payload_size = 50 + frame * 30};
+        eArdPacketStatus send_status = kArdPacketStatusStart;
+        eArdPacketStatus forward_status = kArdPacketStatusStart;
+        eArdPacketStatus receive_status = kArdPacketStatusStart;
+        for (int step = 0; step < 100 && receive_status != kArdPacketStatusDone; ++step)
+        {
+            if (send_status != kArdPacketStatusDone)
+            {
+                send_status = sender.SendPayload(info, payload);
+            }
+            if (forward_status != kArdPacketStatusDone)
+            {
+                forward_status = forward.Forward();
+            }
+            receive_status = receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer);
+        }
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, receive_status);
+        TEST_ASSERT_EQUAL(frame, receive_info.message_type);
+        TEST_ASSERT_EQUAL(info.payload_size, receive_info.payload_size);
+        TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, info.payload_size);
+    }
+
+    // the egress gets the header and payload before the ingress packet is complete
+    const ArdPacketPayloadInfo info = {.message_type = 7, .payload_size = 40};
+    uint8_t packet_data[64];
+    size_t packet_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      sender.WritePacketToBuffer(info, payload, sizeof(packet_data), packet_data, packet_size));
+    ingress_ring.write(packet_data, 20);
+    TEST_ASSERT_EQUAL(kArdPacketStatusPayloadInProgress, forward.Forward());
+    TEST_ASSERT_EQUAL(1 + 2 + 2 + 2 + 20 - 5, egress_ring.available());
+    ingress_ring.write(&packet_data[20], packet_size - 20);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, forward.Forward());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(7, receive_info.message_type);
+    TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, 40);
+
+    // message types the egress can not carry are dropped
+    ArdPacketConfig narrow_config = tcp_config;
+    narrow_config.message_type_bytes = 1;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress.Configure(narrow_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, ingress.Configure(tcp_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(tcp_config));
+    const ArdPacketPayloadInfo wide_info = {.message_type = 300, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(wide_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType, forward.Forward());
+    TEST_ASSERT_EQUAL(0, egress_ring.available());
+
+    ArdPacketConfig cobs_config = tcp_config;
+    cobs_config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress.Configure(cobs_config));
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidFraming, forward.Forward());
+}
+
+// Receive-only and send-only endpoints exchange packets and forward from a receiver to a sender
+static void test_packet_receiver_sender(void)
+{
+    uint8_t link_buffer[128];
+    uint8_t egress_buffer[128];
+    ArdPacketRingBuffer link_ring;
+    ArdPacketRingBuffer egress_ring;
+    link_ring.set_buffer(link_buffer, sizeof(link_buffer));
+    egress_ring.set_buffer(egress_buffer, sizeof(egress_buffer));
+    ArdPacketSender sender(link_ring);
+    ArdPacketReceiver receiver(link_ring);
+    TEST_ASSERT_LESS_THAN(sizeof(ArdPacket), sizeof(ArdPacketSender));
+    TEST_ASSERT_LESS_THAN(sizeof(ArdPacket), sizeof(ArdPacketReceiver));
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 64;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+
+    // round trip
+    const ArdPacketPayloadInfo info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      sender.SendPayload(info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    uint8_t receive_buffer[64] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+
+    // forward from the receiver to a sender with two byte fields
+    ArdPacketSender egress(egress_ring);
+    ArdPacketReceiver egress_receiver(egress_ring);
+    ArdPacketConfig egress_config = config;
+    egress_config.message_type_bytes = 2;
+    egress_config.payload_size_bytes = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress.Configure(egress_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress_receiver.Configure(egress_config));
+    ArdPacketForward forward(receiver, egress);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      sender.SendPayload(info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, forward.Forward());
+    memset(receive_buffer, 0, sizeof(receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      egress_receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+}
+
+// Corrupted payloads reach the egress with a failing crc and the next packet is not lost
+static void test_packet_forward_crc(void)
+{
+    uint8_t ingress_buffer[256];
+    uint8_t egress_buffer[256];
+    ArdPacketRingBuffer ingress_ring;
+    ArdPacketRingBuffer egress_ring;
+    ingress_ring.set_buffer(ingress_buffer, sizeof(ingress_buffer));
+    egress_ring.set_buffer(egress_buffer, sizeof(egress_buffer));
+    ArdPacket sender(ingress_ring);
+    ArdPacket ingress(ingress_ring);
+    ArdPacket egress(egress_ring);
+    ArdPacket receiver(egress_ring);
+
+    ArdPacketConfig ingress_config;
+    ingress_config.crc = true;
+    ingress_config.delimiter = '|';
+    ingress_config.message_type_bytes = 1;
+    ingress_config.payload_size_bytes = 1;
+    ingress_config.max_payload_size = 64;
+    ArdPacketConfig egress_config = ingress_config;
+    egress_config.payload_size_bytes = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(ingress_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, ingress.Configure(ingress_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, egress.Configure(egress_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(egress_config));
+    ArdPacketForward forward(ingress, egress);
+
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    uint8_t packet_data[64];
+    size_t packet_size = 0;
+    const ArdPacketPayloadInfo info = {.message_type = 1, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      sender.WritePacketToBuffer(info, payload, sizeof(packet_data), packet_data, packet_size));
+    packet_data[8] ^= 0x01;
+    ingress_ring.write(packet_data, packet_size);
+    const ArdPacketPayloadInfo next_info = {.message_type = 2, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(next_info, payload));
+
+    uint8_t receive_buffer[64] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed, forward.Forward());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, forward.Forward());
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed,
+                      receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+
+    // an egress crc is computed when the ingress has none
+    ingress_config.crc = false;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(ingress_config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, ingress.Configure(ingress_config));
+    const ArdPacketPayloadInfo plain_info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(plain_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, forward.Forward());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+}
+
+// A flooded stream gets no more than its quantum per poll, so the others are served right away
+static void test_poller_fairness(void)
+{
+    static uint8_t rx_buffers[3][512];
+    static uint8_t tx_buffers[3][512];
+    ArdPacketRingBuffer rx[3];
+    ArdPacketRingBuffer tx[3];
+    std::vector<ArdPacketLossyLink> links;
+    std::vector<ArdPacketLossyLink> peer_links;
+    links.reserve(3);
+    peer_links.reserve(3);
+    for (size_t index = 0; index < 3; ++index)
+    {
+        rx[index].set_buffer(rx_buffers[index], sizeof(rx_buffers[index]));
+        tx[index].set_buffer(tx_buffers[index], sizeof(tx_buffers[index]));
+        links.emplace_back(rx[index], tx[index], 0);
+        peer_links.emplace_back(tx[index], rx[index], 0);
+    }
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 128;
+    ArdPacketPollerEndpoint busy(links[0]);
+    ArdPacketPollerEndpoint first(links[1]);
+    ArdPacketPollerEndpoint second(links[2]);
+    uint8_t storage[3][128];
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidQuantum, busy.Configure(config, 0, storage[0], sizeof(storage[0])));
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, busy.Configure(config, 32, storage[0], 16));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, busy.Configure(config, 32, storage[0], sizeof(storage[0])));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, first.Configure(config, 32, storage[1], sizeof(storage[1])));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, second.Configure(config, 32, storage[2], sizeof(storage[2])));
+    std::vector<uint32_t> received[3];
+    busy.context = &received[0];
+    first.context = &received[1];
+    second.context = &received[2];
+
+    ArdPacketPollerRecorder recorder;
+    ArdPacketPoller poller(recorder);
+    ArdPacketPollerEndpoint *endpoints[] = {&busy, &first, &second};
+    ArdPacketPollerConfig poller_config;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidClock, poller.Configure(poller_config, endpoints, 3));
+    poller_config.clock_us = ArdPacketTestClockUs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, poller.Configure(poller_config, endpoints, 0));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, poller.Configure(poller_config, endpoints, 3));
+
+    // 20 packets of 23 bytes on the busy link, one on each of the others
+    std::vector<ArdPacket> peers;
+    peers.reserve(3);
+    for (size_t index = 0; index < 3; ++index)
+    {
+        peers.emplace_back(peer_links[index]);
+        TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, peers[index].Configure(config));
+    }
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING "abcd");
+    for (uint32_t message_type = 0; message_type < 20; ++message_type)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = message_type, .payload_size = 16};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, peers[0].SendPayload(info, payload));
+    }
+    const ArdPacketPayloadInfo info = {.message_type = 100, .payload_size = 16};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, peers[1].SendPayload(info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, peers[2].SendPayload(info, payload));
+
+    test_clock_us = 1000;
+    poller.Poll();
+    TEST_ASSERT_EQUAL(1, received[0].size());
+    TEST_ASSERT_EQUAL(32, busy.Stats().bytes);
+    TEST_ASSERT_EQUAL(1, received[1].size());
+    TEST_ASSERT_EQUAL(1, received[2].size());
+    TEST_ASSERT_EQUAL(0, first.Stats().last_latency_us);
+
+    // the busy link drains over the next polls, left over budget carries
+    for (int poll = 0; poll < 20; ++poll)
+    {
+        test_clock_us += 1000;
+        poller.Poll();
+        TEST_ASSERT_TRUE(busy.Stats().bytes <= 32u * static_cast<uint32_t>(poll + 2));
+    }
+    TEST_ASSERT_EQUAL(20, received[0].size());
+    for (uint32_t message_type = 0; message_type < 20; ++message_type)
+    {
+        TEST_ASSERT_EQUAL(message_type, received[0][message_type]);
+    }
+    TEST_ASSERT_EQUAL(20, busy.Stats().packets_received);
+    TEST_ASSERT_TRUE(busy.Stats().max_latency_us >= 1000);
+    TEST_ASSERT_TRUE(busy.Stats().average_latency_us > 0);
+
+    // sending is budgeted the same way
+    uint8_t large[100];
+    memset(large, 0x5A, sizeof(large));
+    const ArdPacketPayloadInfo large_info = {.message_type = 7, .payload_size = sizeof(large)};
+    TEST_ASSERT_TRUE(first.Send(large_info, large));
+    TEST_ASSERT_FALSE(first.Send(large_info, large));
+    int polls = 0;
+    while (first.Sending() && polls < 10)
+    {
+        test_clock_us += 1000;
+        poller.Poll();
+        polls++;
+    }
+    TEST_ASSERT_EQUAL(4, polls);
+    TEST_ASSERT_EQUAL(1, first.Stats().packets_sent);
+    TEST_ASSERT_EQUAL(3000, first.Stats().last_latency_us);
+    uint8_t receive_buffer[128];
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, peers[1].ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL_MEMORY(large, receive_buffer, sizeof(large));
+}
+
+// Packet quanta serve one packet per poll from each busy link
+static void test_poller_packets(void)
+{
+    uint8_t rx_buffer[2][256];
+    uint8_t tx_buffer[2][256];
+    ArdPacketRingBuffer rx[2];
+    ArdPacketRingBuffer tx[2];
+    for (size_t index = 0; index < 2; ++index)
+    {
+        rx[index].set_buffer(rx_buffer[index], sizeof(rx_buffer[index]));
+        tx[index].set_buffer(tx_buffer[index], sizeof(tx_buffer[index]));
+    }
+    ArdPacketLossyLink link_a(rx[0], tx[0], 0);
+    ArdPacketLossyLink link_b(rx[1], tx[1], 0);
+    ArdPacketLossyLink peer_link_a(tx[0], rx[0], 0);
+    ArdPacketLossyLink peer_link_b(tx[1], rx[1], 0);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    ArdPacketPollerEndpoint endpoint_a(link_a);
+    ArdPacketPollerEndpoint endpoint_b(link_b);
+    uint8_t storage[2][32];
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, endpoint_a.Configure(config, 1, storage[0], sizeof(storage[0])));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, endpoint_b.Configure(config, 2, storage[1], sizeof(storage[1])));
+    std::vector<uint32_t> received[2];
+    endpoint_a.context = &received[0];
+    endpoint_b.context = &received[1];
+
+    ArdPacketPollerRecorder recorder;
+    ArdPacketPoller poller(recorder);
+    ArdPacketPollerEndpoint *endpoints[] = {&endpoint_a, &endpoint_b};
+    ArdPacketPollerConfig poller_config;
+    poller_config.unit = kArdPacketPollerUnitPackets;
+    poller_config.clock_us = ArdPacketTestClockUs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, poller.Configure(poller_config, endpoints, 2));
+
+    ArdPacket peer_a(peer_link_a);
+    ArdPacket peer_b(peer_link_b);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, peer_a.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, peer_b.Configure(config));
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    for (uint32_t message_type = 0; message_type < 6; ++message_type)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = message_type, .payload_size = 8};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, peer_a.SendPayload(info, payload));
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, peer_b.SendPayload(info, payload));
+    }
+    for (size_t poll = 1; poll <= 3; ++poll)
+    {
+        poller.Poll();
+        TEST_ASSERT_EQUAL(poll, received[0].size());
+        TEST_ASSERT_EQUAL(2 * poll, received[1].size());
+    }
+}
+
+// Payloads of unsubscribed types are skipped without touching the receive buffer
+static void test_dispatch_direct(void)
+{
+    uint8_t stream_buffer[512];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(ring);
+    ArdPacket receiver(ring);
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 200;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+
+    static ArdPacketDispatchEntry entries[256];
+    uint8_t storage[16];
+    ArdPacketDispatch dispatch(receiver);
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, dispatch.Configure(entries, 256, storage, 0));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, dispatch.Configure(entries, 256, storage, sizeof(storage)));
+    ArdPacketDispatchRecord status_record;
+    ArdPacketDispatchRecord command_record;
+    TEST_ASSERT_FALSE(dispatch.Subscribe(2, 32, ArdPacketDispatchRecordUtility, &status_record));
+    TEST_ASSERT_TRUE(dispatch.Subscribe(2, 16, ArdPacketDispatchRecordUtility, &status_record));
+    TEST_ASSERT_TRUE(dispatch.Subscribe(4, 8, ArdPacketDispatchRecordUtility, &command_record));
+
+    // traffic for other nodes is larger than the receive buffer
+    uint8_t payload[200];
+    for (size_t index = 0; index < sizeof(payload); ++index)
+    {
+        payload[index] = static_cast<uint8_t>('a' + index % 26);
+    }
+    const uint32_t types[] = {1, 2, 3, 4, 5};
+    for (const uint32_t message_type : types)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = message_type,
+                                           .payload_size = (message_type % 2 == 0 ? 8u : 150u)};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(info, payload));
+    }
+    memset(storage, 0xEE, sizeof(storage));
+    TEST_ASSERT_EQUAL(2, dispatch.Poll());
+    TEST_ASSERT_EQUAL(3, dispatch.Skipped());
+    TEST_ASSERT_EQUAL(1, status_record.calls);
+    TEST_ASSERT_EQUAL(1, command_record.calls);
+    TEST_ASSERT_EQUAL(4, command_record.message_type);
+    TEST_ASSERT_EQUAL_MEMORY(payload, command_record.payload, 8);
+    TEST_ASSERT_EQUAL(0xEE, storage[8]);
+
+    // over the limit of its type, skipped with a bad crc, then delivered again
+    const ArdPacketPayloadInfo large_info = {.message_type = 4, .payload_size = 12};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(large_info, payload));
+    uint8_t packet_data[64];
+    size_t packet_size = 0;
+    const ArdPacketPayloadInfo skipped_info = {.message_type = 9, .payload_size = 40};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                      sender.WritePacketToBuffer(skipped_info, payload, sizeof(packet_data), packet_data, packet_size));
+    packet_data[20] ^= 0x01;
+    ring.write(packet_data, packet_size);
+    const ArdPacketPayloadInfo status_info = {.message_type = 2, .payload_size = 16};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(status_info, &payload[1]));
+    uint8_t receive_buffer[16];
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize,
+                      receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed,
+                      receiver.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(1, dispatch.Poll());
+    TEST_ASSERT_EQUAL(2, status_record.calls);
+    TEST_ASSERT_EQUAL_MEMORY(&payload[1], status_record.payload, 16);
+
+    TEST_ASSERT_TRUE(dispatch.Unsubscribe(2));
+    TEST_ASSERT_FALSE(dispatch.Unsubscribe(2));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(status_info, payload));
+    TEST_ASSERT_EQUAL(0, dispatch.Poll());
+    TEST_ASSERT_EQUAL(4, dispatch.Skipped());
+}
+
+// Wide message types are hashed into a small table
+static void test_dispatch_hashed(void)
+{
+    uint8_t stream_buffer[256];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(ring);
+    ArdPacket receiver(ring);
+    ArdPacketConfig config;
+    config.crc = false;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+
+    ArdPacketDispatchEntry entries[4];
+    uint8_t storage[32];
+    ArdPacketDispatch dispatch(receiver);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, dispatch.Configure(entries, 4, storage, sizeof(storage)));
+    ArdPacketDispatchRecord records[5];
+    const uint32_t types[] = {1000, 2000, 3000, 4000, 5000};
+    for (size_t index = 0; index < 4; ++index)
+    {
+        TEST_ASSERT_TRUE(dispatch.Subscribe(types[index], 32, ArdPacketDispatchRecordUtility, &records[index]));
+    }
+    TEST_ASSERT_FALSE(dispatch.Subscribe(types[4], 32, ArdPacketDispatchRecordUtility, &records[4]));
+    TEST_ASSERT_TRUE(dispatch.Unsubscribe(types[1]));
+    TEST_ASSERT_TRUE(dispatch.Subscribe(types[4], 32, ArdPacketDispatchRecordUtility, &records[4]));
+    TEST_ASSERT_EQUAL(0, dispatch.MaxPayloadSize(types[1]));
+
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    for (const uint32_t message_type : types)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = message_type, .payload_size = 8};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(info, payload));
+    }
+    TEST_ASSERT_EQUAL(4, dispatch.Poll());
+    TEST_ASSERT_EQUAL(1, dispatch.Skipped());
+    TEST_ASSERT_EQUAL(0, records[1].calls);
+    for (const size_t index : {0, 2, 3, 4})
+    {
+        TEST_ASSERT_EQUAL(1, records[index].calls);
+        TEST_ASSERT_EQUAL(types[index], records[index].message_type);
+    }
+}
+
+// Payload sizes outside the range of their message type are rejected right after the header
+static void test_size_limits(void)
+{
+    uint8_t stream_buffer[128];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(ring);
+    ArdPacket receiver(ring);
+    ArdPacketConfig config;
+    config.crc = false;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+
+    const ArdPacketSizeLimit unsorted[] = {{.message_type = 2, .min_payload_size = 4, .max_payload_size = 4},
+                                           {.message_type = 1, .min_payload_size = 2, .max_payload_size = 8}};
+    config.size_limits = unsorted;
+    config.size_limit_count = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidSizeLimits, receiver.Configure(config));
+    const ArdPacketSizeLimit too_large[] = {{.message_type = 1, .min_payload_size = 2, .max_payload_size = 33}};
+    config.size_limits = too_large;
+    config.size_limit_count = 1;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidSizeLimits, receiver.Configure(config));
+
+    const ArdPacketSizeLimit limits[] = {{.message_type = 1, .min_payload_size = 2, .max_payload_size = 8},
+                                         {.message_type = 2, .min_payload_size = 4, .max_payload_size = 4}};
+    config.size_limits = limits;
+    config.size_limit_count = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+    TEST_ASSERT_EQUAL(8, receiver.GetMaxPayloadSize(1));
+    TEST_ASSERT_EQUAL(4, receiver.GetMaxPayloadSize(2));
+    TEST_ASSERT_EQUAL(32, receiver.GetMaxPayloadSize(3));
+
+    // rejected with only the header on the stream
+    const uint8_t header[] = {'|', 2, 5};
+    ring.write(header, sizeof(header));
+    uint8_t payload[32];
+    ArdPacketPayloadInfo info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(0, ring.available());
+
+    const uint8_t *message = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    const ArdPacketPayloadInfo sizes[] = {{.message_type = 1, .payload_size = 1},
+                                          {.message_type = 1, .payload_size = 8},
+                                          {.message_type = 2, .payload_size = 4},
+                                          {.message_type = 3, .payload_size = 13}};
+    const eArdPacketStatus expected[] = {kArdPacketStatusInvalidPayloadSize, kArdPacketStatusDone,
+                                         kArdPacketStatusDone, kArdPacketStatusDone};
+    for (size_t index = 0; index < 4; ++index)
+    {
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(sizes[index], message));
+        TEST_ASSERT_EQUAL(expected[index], receiver.ReceivePayload(sizeof(payload), info, payload));
+        if (expected[index] == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(sizes[index].message_type, info.message_type);
+            TEST_ASSERT_EQUAL(sizes[index].payload_size, info.payload_size);
+        }
+    }
+
+    // same check when reading a delimited packet from a buffer, which also refuses empty payloads
+    uint8_t packet_data[64];
+    size_t packet_size = 0;
+    for (size_t index = 0; index < 4; ++index)
+    {
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.WritePacketToBuffer(sizes[index], message, sizeof(packet_data),
+                                                                          packet_data, packet_size));
+        TEST_ASSERT_EQUAL(expected[index],
+                          receiver.ReadPacketFromBuffer(packet_data, packet_size, sizeof(payload), info, payload));
+    }
+    const uint8_t empty[] = {'|', 3, 0, 0};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize,
+                      receiver.ReadPacketFromBuffer(empty, sizeof(empty), sizeof(payload), info, payload));
+
+    // same check on decoded COBS headers
+    config.framing = kArdPacketFramingCobs;
+    config.size_limits = nullptr;
+    config.size_limit_count = 0;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    config.size_limits = limits;
+    config.size_limit_count = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+    for (size_t index = 0; index < 4; ++index)
+    {
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(sizes[index], message));
+        TEST_ASSERT_EQUAL(expected[index], receiver.ReceivePayload(sizeof(payload), info, payload));
+    }
+}
+
+// A packet cut off by its sender is dropped after the frame timeout instead of swallowing the next packet
+static void test_frame_timeout(void)
+{
+    uint8_t scratch_buffer[64];
+    ArdPacketRingBuffer scratch;
+    scratch.set_buffer(scratch_buffer, sizeof(scratch_buffer));
+    uint8_t stream_buffer[64];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(scratch);
+    ArdPacket receiver(ring);
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    config.frame_timeout_ms = 50;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidClock, receiver.Configure(config));
+    config.clock = ArdPacketTestClock;
+    test_clock_ms = 1000;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+
+    const uint8_t *message = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    const ArdPacketPayloadInfo input_info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    uint8_t packet[64];
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(input_info, message));
+    const size_t packet_size = scratch.read(packet, sizeof(packet));
+
+    // slow but within the timeout
+    uint8_t payload[32];
+    ArdPacketPayloadInfo info;
+    ring.write(packet, 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusPayloadInProgress, receiver.ReceivePayload(sizeof(payload), info, payload));
+    test_clock_ms += 49;
+    ring.write(&packet[8], packet_size - 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+
+    // the rest is already waiting when a late call comes
+    ring.write(packet, 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusPayloadInProgress, receiver.ReceivePayload(sizeof(payload), info, payload));
+    ring.write(&packet[8], packet_size - 8);
+    test_clock_ms += 200;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(0, receiver.GetFrameTimeouts());
+
+    // the sender stops mid packet and restarts later
+    ring.write(packet, 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusPayloadInProgress, receiver.ReceivePayload(sizeof(payload), info, payload));
+    test_clock_ms += 10;
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable, receiver.ReceivePayload(sizeof(payload), info, payload));
+    test_clock_ms += 50;
+    TEST_ASSERT_EQUAL(kArdPacketStatusFrameTimeout, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(1, receiver.GetFrameTimeouts());
+    ring.write(packet, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(input_info.message_type, info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, payload);
+
+    // the sender stops within the payload CRC, its last byte waits in the stream without completing it
+    ring.write(packet, packet_size - 1);
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotEnoughAvailable,
+                      receiver.ReceivePayload(sizeof(payload), info, payload));
+    test_clock_ms += 60;
+    TEST_ASSERT_EQUAL(kArdPacketStatusFrameTimeout, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(2, receiver.GetFrameTimeouts());
+    ring.write(packet, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+
+    // idle between packets is not a timeout
+    test_clock_ms += 1000;
+    ring.write(packet, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(2, receiver.GetFrameTimeouts());
+}
+
+#if ARD_PACKET_STATS
+// Statistics count every outcome and travel as a report payload
+static void test_stats(void)
+{
+    uint8_t scratch_buffer[64];
+    ArdPacketRingBuffer scratch;
+    scratch.set_buffer(scratch_buffer, sizeof(scratch_buffer));
+    uint8_t stream_buffer[256];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(scratch);
+    ArdPacket receiver(ring);
+    ArdPacket collector(ring);
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 255;
+    config.clock_us = ArdPacketTestClockUs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, collector.Configure(config));
+
+    const uint8_t *message = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    const ArdPacketPayloadInfo input_info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    uint8_t packet[64];
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(input_info, message));
+    const size_t packet_size = scratch.read(packet, sizeof(packet));
+    TEST_ASSERT_EQUAL(1, sender.GetStats().frames_sent);
+    TEST_ASSERT_EQUAL(packet_size, sender.GetStats().bytes_sent);
+
+    // noise, then a packet arriving in two parts 300 us apart
+    uint8_t payload[255];
+    ArdPacketPayloadInfo info;
+    const uint8_t noise[] = {'a', 'b'};
+    ring.write(noise, sizeof(noise));
+    ring.write(packet, 8);
+    test_clock_us = 1000;
+    TEST_ASSERT_EQUAL(kArdPacketStatusPayloadInProgress, receiver.ReceivePayload(sizeof(payload), info, payload));
+    test_clock_us = 1300;
+    ring.write(&packet[8], packet_size - 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+
+    // corrupted payload, corrupted header and a payload too large for the caller
+    uint8_t corrupted[64];
+    memcpy(corrupted, packet, packet_size);
+    corrupted[6] ^= 0x01;
+    ring.write(corrupted, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed, receiver.ReceivePayload(sizeof(payload), info, payload));
+    memcpy(corrupted, packet, packet_size);
+    corrupted[1] ^= 0x01;
+    ring.write(corrupted, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusCrcFailed, receiver.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusNoDelimiter, receiver.ReceivePayload(sizeof(payload), info, payload));
+    ring.write(packet, packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize, receiver.ReceivePayload(8, info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusNoDelimiter, receiver.ReceivePayload(sizeof(payload), info, payload));
+
+    const ArdPacketStats stats = receiver.GetStats();
+    TEST_ASSERT_EQUAL(7, stats.receive_calls);
+    TEST_ASSERT_EQUAL(1, stats.frames_received);
+    TEST_ASSERT_EQUAL(0, stats.frames_skipped);
+    TEST_ASSERT_EQUAL(sizeof(noise) + 4 * packet_size, stats.bytes_received);
+    TEST_ASSERT_EQUAL(1, stats.header_crc_failures);
+    TEST_ASSERT_EQUAL(1, stats.payload_crc_failures);
+    TEST_ASSERT_EQUAL(1, stats.invalid_sizes);
+    TEST_ASSERT_EQUAL(0, stats.read_failures);
+    TEST_ASSERT_EQUAL(1, stats.payload_size_log2[4]);
+    TEST_ASSERT_EQUAL(1, stats.receive_time_log2[9]);
+    TEST_ASSERT_TRUE(stats.discarded_bytes >= sizeof(noise));
+
+    // report to the collector on the other end
+    ArdPacketStatsReport report(receiver, 250);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, report.Send());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, collector.ReceivePayload(sizeof(payload), info, payload));
+    TEST_ASSERT_EQUAL(250, info.message_type);
+    ArdPacketStats reported;
+    TEST_ASSERT_TRUE(ArdPacketStatsReport::Decode(payload, info.payload_size, reported));
+    TEST_ASSERT_EQUAL(0, memcmp(&stats, &reported, sizeof(stats)));
+    TEST_ASSERT_FALSE(ArdPacketStatsReport::Decode(payload, info.payload_size - 1, reported));
+
+    TEST_ASSERT_EQUAL(1, receiver.GetStats().frames_sent);
+    receiver.ResetStats();
+    TEST_ASSERT_EQUAL(0, receiver.GetStats().frames_received);
+    TEST_ASSERT_EQUAL(0, receiver.GetStats().frames_sent);
+}
+#endif
+
+// Every state transition reaches the trace sink
+static void test_trace(void)
+{
+    uint8_t stream_buffer[64];
+    ArdPacketRingBuffer ring;
+    ring.set_buffer(stream_buffer, sizeof(stream_buffer));
+    ArdPacket sender(ring);
+    ArdPacket receiver(ring);
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    config.clock_us = []() -> uint32_t { return test_clock_us++; };
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver.Configure(config));
+    ArdPacketTraceRecorder send_trace;
+    ArdPacketTraceRecorder receive_trace;
+    sender.SetTraceSink(&send_trace);
+    receiver.SetTraceSink(&receive_trace);
+
+    const uint8_t *message = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    const ArdPacketPayloadInfo input_info = {.message_type = 3, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    uint8_t payload[32];
+    ArdPacketPayloadInfo info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(input_info, message));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+
+    const char *const states[] = {"Delimiter", "MessageType", "PayloadSize", "HeaderCrc",
+                                  "Payload",   "PayloadCrc",  "Done"};
+    for (const std::vector<ArdPacketTraceEvent> *events : {&send_trace.events, &receive_trace.events})
+    {
+        TEST_ASSERT_EQUAL(6, events->size());
+        for (size_t index = 0; index < events->size(); ++index)
+        {
+            TEST_ASSERT_EQUAL_STRING(states[index], ArdPacket::GetStateName((*events)[index].from_state));
+            TEST_ASSERT_EQUAL_STRING(states[index + 1], ArdPacket::GetStateName((*events)[index].to_state));
+        }
+    }
+    TEST_ASSERT_EQUAL(kArdPacketTraceReceive, receive_trace.events[4].direction);
+    TEST_ASSERT_EQUAL(sizeof(TEST_MESSAGE_STRING), receive_trace.events[4].consumed);
+    TEST_ASSERT_TRUE(receive_trace.events[5].time_us > receive_trace.events[0].time_us);
+
+    // chrome trace events, separated only between events actually written by the sinks sharing the file
+    char *json = nullptr;
+    size_t json_size = 0;
+    FILE *file = open_memstream(&json, &json_size);
+    ArdPacketTraceJsonFile json_file(file);
+    ArdPacketTraceJson send_json_trace(json_file, 1);
+    ArdPacketTraceJson json_trace(json_file, 2);
+    sender.SetTraceSink(nullptr);
+    receiver.SetTraceSink(&json_trace);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(input_info, message));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+    sender.SetTraceSink(&send_json_trace);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.SendPayload(input_info, message));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.ReceivePayload(sizeof(payload), info, payload));
+    json_file.Finish();
+    fclose(file);
+    TEST_ASSERT_EQUAL_MEMORY("[\n{\"name\":", json, 10);
+    TEST_ASSERT_NOT_NULL(strstr(json, "{\"name\":\"Payload\",\"cat\":\"receive\",\"ph\":\"X\""));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"args\":{\"available\":16,\"consumed\":14}"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"pid\":1,"));
+    TEST_ASSERT_NULL(strstr(json, ",\n,"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "}\n]\n"));
+    free(json);
+}
+
+// Forward error correction corrects corrupted bytes in every block
+static void test_packet_fec_write_read(void)
+{
+    uint8_t stream_buffer[2 * TEST_WRITE_BUFFER_SIZE] = {'\0'};
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    config.fec_parity_bytes = 3;
+    config.fec_block_size = 8;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidFec, packet.Configure(config));
+    config.fec_parity_bytes = 4;
+    config.framing = kArdPacketFramingCobs;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidFec, packet.Configure(config));
+    config.framing = kArdPacketFramingDelimiter;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // write with small chunks
+    const ArdPacketPayloadInfo input_info = {.message_type = 7, .payload_size = sizeof(TEST_MESSAGE_STRING)};
+    size_t stream_size = 0;
+    eArdPacketStatus send_status = kArdPacketStatusStart;
+    while (send_status != kArdPacketStatusDone)
+    {
+        packet_buffer.set_write_buffer(&stream_buffer[stream_size], 5);
+        send_status = packet.SendPayload(input_info, reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING));
+        stream_size += 5 - packet_buffer.availableForWrite();
+    }
+    // delimiter, header block and two payload blocks of 8 bytes, each with 4 parity bytes
+    TEST_ASSERT_EQUAL(1 + 4 + 4 + sizeof(TEST_MESSAGE_STRING) + 2 + 2 * 4, stream_size);
+
+    // two corrupted bytes in the header block and in each payload block
+    const size_t corrupted[] = {1, 6, 9, 16, 21, 26};
+    for (const size_t index : corrupted)
+    {
+        stream_buffer[index] ^= 0x5A;
+    }
+
+    // read with small chunks
+    uint8_t receive_buffer[32] = {0};
+    ArdPacketPayloadInfo receive_info;
+    eArdPacketStatus recv_status = kArdPacketStatusStart;
+    size_t read_index = 0;
+    while (recv_status != kArdPacketStatusDone && read_index < stream_size)
+    {
+        const size_t read_size = (stream_size - read_index < 3 ? stream_size - read_index : 3);
+        packet_buffer.set_read_buffer(&stream_buffer[read_index], read_size);
+        recv_status = packet.ReceivePayload(sizeof(receive_buffer), receive_info, receive_buffer);
+        read_index += read_size - packet_buffer.available();
+    }
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, recv_status);
+    TEST_ASSERT_EQUAL(stream_size, read_index);
+    TEST_ASSERT_EQUAL(7, receive_info.message_type);
+    TEST_ASSERT_EQUAL_STRING(TEST_MESSAGE_STRING, receive_buffer);
+}
+
+// Forward error correction with external packet buffer
+static void test_packet_fec_static_write_read(void)
+{
+    ArdPacketBuffer packet_buffer;
+    ArdPacket packet(packet_buffer);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = 300;
+    config.fec_parity_bytes = 8;
+    config.fec_block_size = 64;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    uint8_t input_payload[300];
+    for (size_t k = 0; k < sizeof(input_payload); ++k)
+    {
+        input_payload[k] = static_cast<uint8_t>(k * 7);
+    }
+    const ArdPacketPayloadInfo input_info = {.message_type = 300, .payload_size = sizeof(input_payload)};
+
+    uint8_t packet_data[400] = {0};
+    size_t packet_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusPacketSizeTooSmall,
+                      packet.WritePacketToBuffer(input_info, input_payload, 350, packet_data, packet_size));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.WritePacketToBuffer(input_info, input_payload, sizeof(packet_data),
+                                                                       packet_data, packet_size));
+    TEST_ASSERT_EQUAL(1 + ArdPacketFecEncodedSize(6, sizeof(input_payload) + 2, 8, 64), packet_size);
+
+    uint8_t receive_buffer[sizeof(input_payload)] = {0};
+    ArdPacketPayloadInfo receive_info;
+    size_t payload_index = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidFraming,
+                      packet.ReadPacketFromBuffer(packet_data, packet_size, receive_info, payload_index));
+
+    // four corrupted bytes in a block are corrected
+    for (size_t k = 0; k < 4; ++k)
+    {
+        packet_data[20 + 10 * k] = static_cast<uint8_t>(~packet_data[20 + 10 * k]);
+    }
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReadPacketFromBuffer(packet_data, packet_size, sizeof(receive_buffer),
+                                                                        receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(300, receive_info.message_type);
+    TEST_ASSERT_EQUAL_MEMORY(input_payload, receive_buffer, sizeof(input_payload));
+
+    // a fifth is not
+    packet_data[70] = static_cast<uint8_t>(~packet_data[70]);
+    TEST_ASSERT_EQUAL(kArdPacketStatusFecFailed, packet.ReadPacketFromBuffer(packet_data, packet_size,
+                                                                             sizeof(receive_buffer), receive_info,
+                                                                             receive_buffer));
+}
+
+// Reliable delivery keeps order and honors the window
+static void test_packet_reliable_window(void)
+{
+    uint8_t forward_buffer[128];
+    uint8_t backward_buffer[128];
+    ArdPacketRingBuffer forward;
+    ArdPacketRingBuffer backward;
+    TEST_ASSERT_TRUE(forward.set_buffer(forward_buffer, sizeof(forward_buffer)));
+    TEST_ASSERT_TRUE(backward.set_buffer(backward_buffer, sizeof(backward_buffer)));
+    ArdPacketLossyLink sender_link(backward, forward, 0);
+    ArdPacketLossyLink receiver_link(forward, backward, 0);
+    ArdPacket sender_packet(sender_link);
+    ArdPacket receiver_packet(receiver_link);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 17;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender_packet.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver_packet.Configure(config));
+
+    ArdPacketReliable sender(sender_packet);
+    ArdPacketReliable receiver(receiver_packet);
+    ArdPacketReliableConfig reliable_config;
+    reliable_config.window_size = 4;
+    reliable_config.max_payload_size = 16;
+    reliable_config.ack_message_type = 0xFF;
+    reliable_config.clock = ArdPacketTestClock;
+    uint8_t sender_storage[ArdPacketReliable::StorageSize(4, 16)];
+    uint8_t receiver_storage[ArdPacketReliable::StorageSize(4, 16)];
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage,
+                      sender.Configure(reliable_config, sender_storage, sizeof(sender_storage) - 1));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(reliable_config, sender_storage, sizeof(sender_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      receiver.Configure(reliable_config, receiver_storage, sizeof(receiver_storage)));
+
+    // window fills until the receiving application reads
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    for (uint32_t message_type = 0; message_type < 4; ++message_type)
+    {
+        const ArdPacketPayloadInfo input_info = {.message_type = message_type, .payload_size = 4 + message_type};
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(input_info, payload));
+    }
+    const ArdPacketPayloadInfo ack_info = {.message_type = 0xFF, .payload_size = 4};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType, sender.Send(ack_info, payload));
+    receiver.Poll();
+    sender.Poll();
+    TEST_ASSERT_EQUAL(4, sender.InFlight());
+    const ArdPacketPayloadInfo extra_info = {.message_type = 4, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusWindowFull, sender.Send(extra_info, payload));
+
+    uint8_t receive_buffer[16] = {0};
+    ArdPacketPayloadInfo receive_info;
+    for (uint32_t message_type = 0; message_type < 4; ++message_type)
+    {
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+        TEST_ASSERT_EQUAL(message_type, receive_info.message_type);
+        TEST_ASSERT_EQUAL(4 + message_type, receive_info.payload_size);
+        TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, receive_info.payload_size);
+    }
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable,
+                      receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    sender.Poll();
+    TEST_ASSERT_EQUAL(0, sender.InFlight());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(extra_info, payload));
+    TEST_ASSERT_EQUAL(0, sender.Retransmissions());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    sender.Poll();
+    TEST_ASSERT_EQUAL(0, sender.InFlight());
+
+    // frames the packet cannot carry are refused before they take a window slot
+    const ArdPacketPayloadInfo wide_info = {.message_type = 300, .payload_size = 4};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType, sender.Send(wide_info, payload));
+    const ArdPacketSizeLimit limits[] = {{.message_type = 3, .min_payload_size = 1, .max_payload_size = 5}};
+    config.size_limits = limits;
+    config.size_limit_count = 1;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender_packet.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver_packet.Configure(config));
+    const ArdPacketPayloadInfo limited_info = {.message_type = 3, .payload_size = 5};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidPayloadSize, sender.Send(limited_info, payload));
+    TEST_ASSERT_EQUAL(0, sender.InFlight());
+
+    // a queued frame the reconfigured packet refuses is skipped by both ends, not retransmitted forever
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(extra_info, payload));
+    uint8_t lost[64];
+    TEST_ASSERT_TRUE(forward.read(lost, sizeof(lost)) > 0);
+    config.size_limits = nullptr;
+    config.size_limit_count = 0;
+    config.max_payload_size = 8;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender_packet.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, receiver_packet.Configure(config));
+    const ArdPacketPayloadInfo next_info = {.message_type = 2, .payload_size = 6};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(next_info, payload));
+    test_clock_ms += 1000;
+    sender.Poll();
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL(6, receive_info.payload_size);
+    sender.Poll();
+    TEST_ASSERT_EQUAL(0, sender.InFlight());
+}
+
+// Reliable delivery over a link corrupting bytes
+static void test_packet_reliable_lossy(void)
+{
+    uint8_t forward_buffer[128];
+    uint8_t backward_buffer[128];
+    ArdPacketRingBuffer forward;
+    ArdPacketRingBuffer backward;
+    forward.set_buffer(forward_buffer, sizeof(forward_buffer));
+    backward.set_buffer(backward_buffer, sizeof(backward_buffer));
+    ArdPacketLossyLink sender_link(backward, forward, 97);
+    ArdPacketLossyLink receiver_link(forward, backward, 89);
+    ArdPacket sender_packet(sender_link);
+    ArdPacket receiver_packet(receiver_link);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 33;
+    sender_packet.Configure(config);
+    receiver_packet.Configure(config);
+
+    ArdPacketReliable sender(sender_packet);
+    ArdPacketReliable receiver(receiver_packet);
+    ArdPacketReliableConfig reliable_config;
+    reliable_config.window_size = 8;
+    reliable_config.max_payload_size = 32;
+    reliable_config.ack_message_type = 0xFFFF;
+    reliable_config.initial_timeout_ms = 40;
+    reliable_config.min_timeout_ms = 5;
+    reliable_config.clock = ArdPacketTestClock;
+    uint8_t sender_storage[ArdPacketReliable::StorageSize(8, 32)];
+    uint8_t receiver_storage[ArdPacketReliable::StorageSize(8, 32)];
+    sender.Configure(reliable_config, sender_storage, sizeof(sender_storage));
+    receiver.Configure(reliable_config, receiver_storage, sizeof(receiver_storage));
+
+    // every payload arrives once and in order
+    const uint32_t frames = 300;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    for (size_t step = 0; step < 100000 && received < frames; ++step)
+    {
+        test_clock_ms++;
+        uint8_t payload[32];
+        memset(payload, static_cast<int>(sent), sizeof(payload));
+        const ArdPacketPayloadInfo input_info = {.message_type = sent, .payload_size = 1 + sent % 32};
+        if (sent < frames && sender.Send(input_info, payload) == kArdPacketStatusDone)
+        {
+            sent++;
+        }
+        sender.Poll();
+
+        uint8_t receive_buffer[32] = {0};
+        ArdPacketPayloadInfo receive_info;
+        while (receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(received, receive_info.message_type);
+            TEST_ASSERT_EQUAL(1 + received % 32, receive_info.payload_size);
+            uint8_t expected[32];
+            memset(expected, static_cast<int>(received), sizeof(expected));
+            TEST_ASSERT_EQUAL_MEMORY(expected, receive_buffer, receive_info.payload_size);
+            received++;
+        }
+    }
+    TEST_ASSERT_EQUAL(frames, received);
+    TEST_ASSERT_GREATER_THAN(0, sender.Retransmissions());
+}
+
+// Credit flow control in frames
+static void test_packet_credit_frames(void)
+{
+    uint8_t forward_buffer[128];
+    uint8_t backward_buffer[128];
+    ArdPacketRingBuffer forward;
+    ArdPacketRingBuffer backward;
+    forward.set_buffer(forward_buffer, sizeof(forward_buffer));
+    backward.set_buffer(backward_buffer, sizeof(backward_buffer));
+    ArdPacketLossyLink sender_link(backward, forward, 0);
+    ArdPacketLossyLink receiver_link(forward, backward, 0);
+    ArdPacket sender_packet(sender_link);
+    ArdPacket receiver_packet(receiver_link);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 16;
+    sender_packet.Configure(config);
+    receiver_packet.Configure(config);
+
+    ArdPacketCredit sender(sender_packet);
+    ArdPacketCredit receiver(receiver_packet);
+    ArdPacketCreditConfig credit_config;
+    credit_config.unit = kArdPacketCreditUnitFrames;
+    credit_config.receive_credit = 2;
+    credit_config.max_payload_size = 16;
+    credit_config.credit_message_type = 0xFF;
+    credit_config.refresh_interval_ms = 0;
+    uint8_t sender_storage[ArdPacketCredit::StorageSize(16)];
+    uint8_t receiver_storage[ArdPacketCredit::StorageSize(16)];
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, sender.Configure(credit_config, sender_storage, 4));
+    credit_config.receive_credit = 0;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidCredit,
+                      sender.Configure(credit_config, sender_storage, sizeof(sender_storage)));
+    credit_config.receive_credit = 2;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(credit_config, sender_storage, sizeof(sender_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      receiver.Configure(credit_config, receiver_storage, sizeof(receiver_storage)));
+
+    // no credit until the receiver advertises
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(TEST_MESSAGE_STRING);
+    const ArdPacketPayloadInfo input_info = {.message_type = 1, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusNoCredit, sender.Send(input_info, payload));
+    const ArdPacketPayloadInfo credit_info = {.message_type = 0xFF, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType, sender.Send(credit_info, payload));
+    receiver.Poll();
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(input_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(input_info, payload));
+    TEST_ASSERT_EQUAL(0, sender.Credit());
+    TEST_ASSERT_EQUAL(kArdPacketStatusNoCredit, sender.Send(input_info, payload));
+
+    // reading returns credit
+    uint8_t receive_buffer[16] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(1, receive_info.message_type);
+    TEST_ASSERT_EQUAL(8, receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(payload, receive_buffer, 8);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(input_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusNoCredit, sender.Send(input_info, payload));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable,
+                      receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    sender.Poll();
+    TEST_ASSERT_EQUAL(2, sender.Credit());
+}
+
+// Credit flow control in bytes keeps a small receive buffer from overrunning
+static void test_packet_credit_bytes(void)
+{
+    uint8_t forward_buffer[64];
+    uint8_t backward_buffer[64];
+    ArdPacketRingBuffer forward;
+    ArdPacketRingBuffer backward;
+    forward.set_buffer(forward_buffer, sizeof(forward_buffer));
+    backward.set_buffer(backward_buffer, sizeof(backward_buffer));
+    ArdPacketOverrunLink sender_link(backward, forward);
+    ArdPacketOverrunLink receiver_link(forward, backward);
+    ArdPacket sender_packet(sender_link);
+    ArdPacket receiver_packet(receiver_link);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 2;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 32;
+    sender_packet.Configure(config);
+    receiver_packet.Configure(config);
+
+    // room for one credit frame of the sender is left in the buffer
+    ArdPacketCredit sender(sender_packet);
+    ArdPacketCredit receiver(receiver_packet);
+    ArdPacketCreditConfig credit_config;
+    credit_config.unit = kArdPacketCreditUnitBytes;
+    credit_config.max_payload_size = 32;
+    credit_config.credit_message_type = 0xFFFF;
+    credit_config.receive_credit = static_cast<uint32_t>(
+        sizeof(forward_buffer) - sender_packet.GetMaxPacketSize(kArdPacketCreditControlSize));
+    credit_config.refresh_interval_ms = 0;
+    uint8_t sender_storage[ArdPacketCredit::StorageSize(32)];
+    uint8_t receiver_storage[ArdPacketCredit::StorageSize(32)];
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, sender.Configure(credit_config, sender_storage, sizeof(sender_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      receiver.Configure(credit_config, receiver_storage, sizeof(receiver_storage)));
+    TEST_ASSERT_EQUAL(1 + 2 + 1 + 2 + 32 + 2, sender.Cost(32));
+
+    // the sender floods, the receiver reads one frame every few steps
+    const uint32_t frames = 200;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    for (size_t step = 0; step < 10000 && received < frames; ++step)
+    {
+        bool send = true;
+        while (sent < frames && send)
+        {
+            uint8_t payload[32];
+            memset(payload, static_cast<int>(sent), sizeof(payload));
+            const ArdPacketPayloadInfo input_info = {.message_type = sent, .payload_size = 1 + sent % 32};
+            send = (sender.Send(input_info, payload) == kArdPacketStatusDone);
+            sent += (send ? 1 : 0);
+        }
+
+        uint8_t receive_buffer[32] = {0};
+        ArdPacketPayloadInfo receive_info;
+        if (step % 4 == 0 && receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer) ==
+                                 kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(received, receive_info.message_type);
+            TEST_ASSERT_EQUAL(1 + received % 32, receive_info.payload_size);
+            received++;
+        }
+    }
+    TEST_ASSERT_EQUAL(frames, received);
+    TEST_ASSERT_EQUAL(0, sender_link.dropped);
+    TEST_ASSERT_EQUAL(0, receiver_link.dropped);
+}
+
+// LZSS round trip in chunks of any size, with bounded output and corrupt streams
+static void test_lzss_round_trip(void)
+{
+    const char *text = "sensor=12 state=ok sensor=13 state=ok sensor=14 state=ok sensor=15 state=fault";
+    const size_t text_size = strlen(text);
+    uint8_t random_data[200];
+    srand(7);
+    for (uint8_t &value : random_data)
+    {
+        value = static_cast<uint8_t>(rand());
+    }
+    ArdPacketLzssEncoder encoder;
+    ArdPacketLzssDecoder decoder;
+    uint8_t compressed[256];
+    uint8_t decompressed[256];
+    TEST_ASSERT_FALSE(encoder.Begin(kArdPacketLzssMinWindowBits - 1, compressed, sizeof(compressed)));
+    TEST_ASSERT_FALSE(decoder.Begin(kArdPacketLzssMaxWindowBits + 1, decompressed, sizeof(decompressed)));
+
+    const struct
+    {
+        const uint8_t *data;
+        size_t size;
+    } inputs[] = {{reinterpret_cast<const uint8_t *>(text), text_size}, {random_data, sizeof(random_data)}};
+    for (const auto &input : inputs)
+    {
+        for (size_t window_bits = kArdPacketLzssMinWindowBits; window_bits <= kArdPacketLzssMaxWindowBits;
+             ++window_bits)
+        {
+            for (size_t chunk = 1; chunk <= 32; chunk *= 2)
+            {
+                TEST_ASSERT_TRUE(encoder.Begin(window_bits, compressed, sizeof(compressed)));
+                for (size_t index = 0; index < input.size; index += chunk)
+                {
+                    const size_t size = (input.size - index < chunk ? input.size - index : chunk);
+                    TEST_ASSERT_TRUE(encoder.Sink(&input.data[index], size));
+                }
+                TEST_ASSERT_TRUE(encoder.Finish());
+                const size_t compressed_size = encoder.Size();
+
+                TEST_ASSERT_TRUE(decoder.Begin(window_bits, decompressed, sizeof(decompressed)));
+                for (size_t index = 0; index < compressed_size; index += chunk)
+                {
+                    const size_t size = (compressed_size - index < chunk ? compressed_size - index : chunk);
+                    TEST_ASSERT_TRUE(decoder.Decode(&compressed[index], size));
+                }
+                TEST_ASSERT_TRUE(decoder.Finish());
+                TEST_ASSERT_EQUAL(input.size, decoder.Size());
+                TEST_ASSERT_EQUAL_MEMORY(input.data, decompressed, input.size);
+            }
+        }
+    }
+
+    // repeats shrink, random data grows by at most one bit per byte
+    TEST_ASSERT_TRUE(encoder.Begin(kArdPacketLzssMaxWindowBits, compressed, sizeof(compressed)));
+    TEST_ASSERT_TRUE(encoder.Sink(reinterpret_cast<const uint8_t *>(text), text_size));
+    TEST_ASSERT_TRUE(encoder.Finish());
+    TEST_ASSERT_LESS_THAN(text_size * 3 / 4, encoder.Size());
+    TEST_ASSERT_TRUE(encoder.Begin(kArdPacketLzssMaxWindowBits, compressed, sizeof(compressed)));
+    TEST_ASSERT_TRUE(encoder.Sink(random_data, sizeof(random_data)));
+    TEST_ASSERT_TRUE(encoder.Finish());
+    TEST_ASSERT_LESS_OR_EQUAL((sizeof(random_data) * 9 + 7) / 8, encoder.Size());
+
+    // output limits
+    TEST_ASSERT_TRUE(encoder.Begin(kArdPacketLzssMaxWindowBits, compressed, 8));
+    TEST_ASSERT_FALSE(encoder.Sink(random_data, sizeof(random_data)) && encoder.Finish());
+    TEST_ASSERT_LESS_OR_EQUAL(8, encoder.Size());
+    TEST_ASSERT_TRUE(encoder.Begin(kArdPacketLzssMaxWindowBits, compressed, sizeof(compressed)));
+    TEST_ASSERT_TRUE(encoder.Sink(reinterpret_cast<const uint8_t *>(text), text_size));
+    TEST_ASSERT_TRUE(encoder.Finish());
+    TEST_ASSERT_TRUE(decoder.Begin(kArdPacketLzssMaxWindowBits, decompressed, text_size - 1));
+    TEST_ASSERT_FALSE(decoder.Decode(compressed, encoder.Size()));
+
+    // a back reference before the start, a truncated token
+    const uint8_t reference_first[] = {0x00, 0x00};
+    TEST_ASSERT_TRUE(decoder.Begin(kArdPacketLzssMinWindowBits, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_FALSE(decoder.Decode(reference_first, sizeof(reference_first)));
+    const uint8_t truncated[] = {0xC0};
+    TEST_ASSERT_TRUE(decoder.Begin(kArdPacketLzssMinWindowBits, decompressed, sizeof(decompressed)));
+    TEST_ASSERT_TRUE(decoder.Decode(truncated, sizeof(truncated)));
+    TEST_ASSERT_FALSE(decoder.Finish());
+}
+
+// Compressed and raw frames share the stream, flagged in the message type
+static void test_packet_compress(void)
+{
+    uint8_t buffer[512];
+    ArdPacketRingBuffer stream;
+    stream.set_buffer(buffer, sizeof(buffer));
+    ArdPacket sender_packet(stream);
+    ArdPacket receiver_packet(stream);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 128;
+    sender_packet.Configure(config);
+    receiver_packet.Configure(config);
+
+    ArdPacketCompress sender(sender_packet);
+    ArdPacketCompress receiver(receiver_packet);
+    ArdPacketCompressConfig compress_config;
+    compress_config.max_payload_size = 128;
+    uint8_t sender_storage[ArdPacketCompress::StorageSize(128)];
+    uint8_t receiver_storage[ArdPacketCompress::StorageSize(128)];
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidCompression,
+                      sender.Configure(compress_config, sender_storage, sizeof(sender_storage)));
+    compress_config.compressed_flag = 0x100;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidCompression,
+                      sender.Configure(compress_config, sender_storage, sizeof(sender_storage)));
+    compress_config.compressed_flag = 0xC0;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidCompression,
+                      sender.Configure(compress_config, sender_storage, sizeof(sender_storage)));
+    compress_config.compressed_flag = 0x80;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, sender.Configure(compress_config, sender_storage, 128));
+    compress_config.max_payload_size = 129;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidMaxPayloadSize,
+                      sender.Configure(compress_config, sender_storage, sizeof(sender_storage)));
+    compress_config.max_payload_size = 128;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      sender.Configure(compress_config, sender_storage, sizeof(sender_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      receiver.Configure(compress_config, receiver_storage, sizeof(receiver_storage)));
+
+    // text shrinks, random data and short payloads go raw
+    uint8_t text[96];
+    for (size_t index = 0; index < sizeof(text); ++index)
+    {
+        text[index] = static_cast<uint8_t>("temp=21.5;hum=40;"[index % 17]);
+    }
+    uint8_t random_data[96];
+    srand(11);
+    for (uint8_t &value : random_data)
+    {
+        value = static_cast<uint8_t>(rand());
+    }
+    const ArdPacketPayloadInfo flagged_info = {.message_type = 0x81, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType, sender.Send(flagged_info, text));
+    const ArdPacketPayloadInfo text_info = {.message_type = 1, .payload_size = sizeof(text)};
+    const ArdPacketPayloadInfo random_info = {.message_type = 2, .payload_size = sizeof(random_data)};
+    const ArdPacketPayloadInfo short_info = {.message_type = 3, .payload_size = 8};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(text_info, text));
+    const size_t text_packet_size = stream.available();
+    TEST_ASSERT_LESS_THAN(sender_packet.GetMaxPacketSize(sizeof(text)) / 2, text_packet_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(random_info, random_data));
+    TEST_ASSERT_EQUAL(text_packet_size + sender_packet.GetMaxPacketSize(sizeof(random_data)), stream.available());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(short_info, text));
+    TEST_ASSERT_EQUAL(sizeof(text) + sizeof(random_data) + 8, sender.GetPayloadBytes());
+    TEST_ASSERT_LESS_THAN(sender.GetPayloadBytes(), sender.GetSentBytes() + sizeof(text) / 2);
+
+    uint8_t receive_buffer[128] = {0};
+    ArdPacketPayloadInfo receive_info;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(1, receive_info.message_type);
+    TEST_ASSERT_EQUAL(sizeof(text), receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(text, receive_buffer, sizeof(text));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL(sizeof(random_data), receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(random_data, receive_buffer, sizeof(random_data));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL(8, receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(text, receive_buffer, 8);
+
+    // a compressed frame that does not fit the receive buffer
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(text_info, text));
+    TEST_ASSERT_EQUAL(kArdPacketStatusCompressionFailed, receiver.Receive(32, receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(kArdPacketStatusNotAvailable,
+                      receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+}
+
+// Delta coding sends only the changed bytes of each message type and recovers from a lost frame
+static void test_packet_delta(void)
+{
+    uint8_t forward_buffer[256];
+    uint8_t backward_buffer[256];
+    ArdPacketRingBuffer forward;
+    ArdPacketRingBuffer backward;
+    forward.set_buffer(forward_buffer, sizeof(forward_buffer));
+    backward.set_buffer(backward_buffer, sizeof(backward_buffer));
+    ArdPacketLossyLink sender_link(backward, forward, 0);
+    ArdPacketLossyLink receiver_link(forward, backward, 0);
+    ArdPacket sender_packet(sender_link);
+    ArdPacket receiver_packet(receiver_link);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 64;
+    sender_packet.Configure(config);
+    receiver_packet.Configure(config);
+
+    ArdPacketDelta sender(sender_packet);
+    ArdPacketDelta receiver(receiver_packet);
+    ArdPacketDeltaConfig delta_config;
+    delta_config.control_message_type = 0x7F;
+    delta_config.max_payload_size = 48;
+    delta_config.tx_streams = 2;
+    delta_config.rx_streams = 2;
+    delta_config.keyframe_interval = 8;
+    uint8_t sender_storage[ArdPacketDelta::StorageSize(48, 2, 2)];
+    uint8_t receiver_storage[ArdPacketDelta::StorageSize(48, 2, 2)];
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidDelta,
+                      sender.Configure(delta_config, sender_storage, sizeof(sender_storage)));
+    delta_config.delta_flag = 0x80;
+    delta_config.control_message_type = 0xFF;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidDelta,
+                      sender.Configure(delta_config, sender_storage, sizeof(sender_storage)));
+    delta_config.control_message_type = 0x7F;
+    delta_config.max_payload_size = 64;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidMaxPayloadSize,
+                      sender.Configure(delta_config, sender_storage, sizeof(sender_storage)));
+    delta_config.max_payload_size = 48;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, sender.Configure(delta_config, sender_storage, 2 * 49));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      sender.Configure(delta_config, sender_storage, sizeof(sender_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      receiver.Configure(delta_config, receiver_storage, sizeof(receiver_storage)));
+
+    // joint states: one position moves a little each frame
+    int32_t joints[12] = {0};
+    const ArdPacketPayloadInfo joint_info = {.message_type = 1, .payload_size = sizeof(joints)};
+    uint8_t receive_buffer[48] = {0};
+    ArdPacketPayloadInfo receive_info;
+    const ArdPacketPayloadInfo flagged_info = {.message_type = 0x81, .payload_size = 4};
+    const ArdPacketPayloadInfo control_info = {.message_type = 0x7F, .payload_size = 4};
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType,
+                      sender.Send(flagged_info, reinterpret_cast<const uint8_t *>(joints)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusInvalidMessageType,
+                      sender.Send(control_info, reinterpret_cast<const uint8_t *>(joints)));
+    for (size_t frame = 0; frame < 16; ++frame)
+    {
+        joints[frame % 12] += 3;
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone,
+                          receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+        TEST_ASSERT_EQUAL(1, receive_info.message_type);
+        TEST_ASSERT_EQUAL(sizeof(joints), receive_info.payload_size);
+        TEST_ASSERT_EQUAL_MEMORY(joints, receive_buffer, sizeof(joints));
+    }
+    // two keyframes of 49 bytes, deltas of a sequence byte, a 6 byte bitmap and one changed byte
+    TEST_ASSERT_EQUAL(16 * sizeof(joints), sender.GetPayloadBytes());
+    TEST_ASSERT_EQUAL(2 * 49 + 14 * 8, sender.GetSentBytes());
+
+    // streams are full, a third message type is sent raw
+    const uint8_t battery[4] = {12, 34, 56, 78};
+    const ArdPacketPayloadInfo status_info = {.message_type = 2, .payload_size = sizeof(battery)};
+    const ArdPacketPayloadInfo battery_info = {.message_type = 3, .payload_size = sizeof(battery)};
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(status_info, battery));
+    const int available = forward.available();
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(battery_info, battery));
+    TEST_ASSERT_EQUAL(sender_packet.GetMaxPacketSize(sizeof(battery)), forward.available() - available);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(2, receive_info.message_type);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(3, receive_info.message_type);
+    TEST_ASSERT_EQUAL(sizeof(battery), receive_info.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(battery, receive_buffer, sizeof(battery));
+
+    // a lost delta drops the next one until the requested keyframe
+    joints[0] += 3;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    joints[1] += 3;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+    while (forward.available() > 0)
+    {
+        forward.read();
+    }
+    joints[2] += 3;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+    TEST_ASSERT_EQUAL(kArdPacketStatusDeltaBaseMissing,
+                      receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL(1, receive_info.message_type);
+    sender.Poll();
+    const uint32_t sent_bytes = sender.GetSentBytes();
+    joints[3] += 3;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+    TEST_ASSERT_EQUAL(sent_bytes + 49, sender.GetSentBytes());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL_MEMORY(joints, receive_buffer, sizeof(joints));
+    joints[4] += 3;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, sender.Send(joint_info, reinterpret_cast<const uint8_t *>(joints)));
+    TEST_ASSERT_EQUAL(sent_bytes + 49 + 8, sender.GetSentBytes());
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, receiver.Receive(sizeof(receive_buffer), receive_info, receive_buffer));
+    TEST_ASSERT_EQUAL_MEMORY(joints, receive_buffer, sizeof(joints));
+}
+
+// POSIX file descriptor stream over a socket pair with small kernel buffers
+static void test_posix_socketpair(void)
+{
+    int fds[2] = {-1, -1};
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    const int buffer_size = 4096;
+    for (const int fd : fds)
+    {
+        TEST_ASSERT_TRUE(ArdPacketPosixSetNonBlocking(fd));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    }
+    ArdPacketFd first(fds[0]);
+    ArdPacketFd second(fds[1]);
+    TEST_ASSERT_EQUAL(0, first.available());
+    TEST_ASSERT_EQUAL(kArdPacketPosixWriteBufferSize, first.availableForWrite());
+
+    ArdPacketExchangeUtility(first, second, 500, 1000);
+    ArdPacketExchangeUtility(second, first, 500, 1000);
+
+    // end of stream
+    close(fds[1]);
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(0, first.read(&value, 1));
+    TEST_ASSERT_FALSE(first.Connected());
+    TEST_ASSERT_EQUAL(0, first.availableForWrite());
+    close(fds[0]);
+}
+
+// POSIX serial port over a pseudo terminal
+static void test_posix_tty(void)
+{
+    const int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    TEST_ASSERT_TRUE(master_fd >= 0);
+    TEST_ASSERT_EQUAL(0, grantpt(master_fd));
+    TEST_ASSERT_EQUAL(0, unlockpt(master_fd));
+    TEST_ASSERT_TRUE(ArdPacketPosixSetNonBlocking(master_fd));
+    ArdPacketFd master(master_fd);
+
+    ArdPacketTty tty;
+    TEST_ASSERT_EQUAL(B0, ArdPacketTty::Speed(12345));
+    TEST_ASSERT_FALSE(tty.Open(ptsname(master_fd), 12345));
+    TEST_ASSERT_TRUE(tty.Open(ptsname(master_fd), 115200));
+
+    // raw mode passes every byte value unchanged
+    ArdPacketExchangeUtility(tty, master, 200, 300);
+    ArdPacketExchangeUtility(master, tty, 200, 300);
+    tty.Close();
+    TEST_ASSERT_EQUAL(-1, tty.Fd());
+    close(master_fd);
+}
+
+// UDP datagrams over loopback, replies go to the sender
+static void test_posix_udp(void)
+{
+    ArdPacketUdp server_udp;
+    ArdPacketUdp client_udp;
+    TEST_ASSERT_TRUE(server_udp.Open("127.0.0.1", 0));
+    TEST_ASSERT_TRUE(server_udp.Port() != 0);
+    TEST_ASSERT_TRUE(client_udp.Open("127.0.0.1", 0));
+    TEST_ASSERT_TRUE(client_udp.Connect("127.0.0.1", server_udp.Port()));
+
+    ArdPacketDatagramConfig config;
+    config.packet.crc = true;
+    config.packet.delimiter = '|';
+    config.packet.message_type_bytes = 2;
+    config.packet.payload_size_bytes = 2;
+    config.packet.max_payload_size = 1024;
+    uint8_t server_storage[2 * 1472];
+    uint8_t client_storage[2 * 1472];
+    ArdPacketDatagram server(server_udp);
+    ArdPacketDatagram client(client_udp);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, server.Configure(config, server_storage, sizeof(server_storage)));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, client.Configure(config, client_storage, sizeof(client_storage)));
+
+    // nobody to reply to yet
+    TEST_ASSERT_FALSE(server_udp.SendDatagram(server_storage, 1));
+    uint8_t payload[1024] = {0};
+    ArdPacketPayloadInfo info;
+
+    // one datagram per packet, more than a batch
+    const uint32_t frames = 40;
+    for (uint32_t frame = 0; frame < frames; ++frame)
+    {
+        info.message_type = frame;
+        info.payload_size = 1 + (frame * 97) % 1024;
+        memset(payload, static_cast<int>(frame), info.payload_size);
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, client.SendPayload(info, payload));
+    }
+    TEST_ASSERT_TRUE(client.Flush());
+
+    uint32_t echoed = 0;
+    uint32_t received = 0;
+    for (size_t step = 0; step < 100000 && received < frames; ++step)
+    {
+        if (server.ReceivePayload(sizeof(payload), info, payload) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(echoed, info.message_type);
+            TEST_ASSERT_EQUAL(1 + (echoed * 97) % 1024, info.payload_size);
+            TEST_ASSERT_EQUAL(static_cast<uint8_t>(echoed), payload[info.payload_size - 1]);
+            TEST_ASSERT_EQUAL(kArdPacketStatusDone, server.SendPayload(info, payload));
+            echoed++;
+        }
+        server.Flush();
+        if (client.ReceivePayload(sizeof(payload), info, payload) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(received, info.message_type);
+            TEST_ASSERT_EQUAL(static_cast<uint8_t>(info.message_type), payload[info.payload_size - 1]);
+            received++;
+        }
+    }
+    TEST_ASSERT_EQUAL(frames, echoed);
+    TEST_ASSERT_EQUAL(frames, received);
+}
+
+// POSIX TCP connection over loopback
+static void test_posix_tcp(void)
+{
+    const int listen_fd = ArdPacketTcp::Listen("127.0.0.1", 0);
+    TEST_ASSERT_TRUE(listen_fd >= 0);
+    const uint16_t port = ArdPacketTcp::LocalPort(listen_fd);
+    TEST_ASSERT_TRUE(port != 0);
+
+    ArdPacketTcp server;
+    ArdPacketTcp client;
+    TEST_ASSERT_FALSE(server.Accept(listen_fd));
+    TEST_ASSERT_TRUE(client.Connect("127.0.0.1", port));
+    TEST_ASSERT_TRUE(server.Accept(listen_fd));
+
+    ArdPacketExchangeUtility(client, server, 2000, 1024);
+    ArdPacketExchangeUtility(server, client, 2000, 1024);
+
+    // the far end closing is detected on read
+    client.Close();
+    uint8_t value = 0;
+    TEST_ASSERT_EQUAL(0, server.read(&value, 1));
+    TEST_ASSERT_FALSE(server.Connected());
+    server.Close();
+    close(listen_fd);
+}
+
+// Several packets per datagram in every framing, a corrupted datagram only loses its own packets
+static void test_packet_datagram_aggregate(void)
+{
+    ArdPacketDatagramConfig config;
+    config.packet.crc = true;
+    config.packet.delimiter = '|';
+    config.packet.message_type_bytes = 2;
+    config.packet.payload_size_bytes = 1;
+    config.packet.max_payload_size = 40;
+    config.max_datagram_size = 200;
+    config.aggregate = true;
+    uint8_t storage[400];
+
+    ArdPacketDatagramLink unused_link;
+    ArdPacketDatagram unused(unused_link);
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidStorage, unused.Configure(config, storage, 399));
+    config.max_datagram_size = 40;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidMaxPayloadSize, unused.Configure(config, storage, sizeof(storage)));
+    config.max_datagram_size = 200;
+
+    for (int framing = 0; framing < 3; ++framing)
+    {
+        config.packet.framing = (framing == 1 ? kArdPacketFramingCobs : kArdPacketFramingDelimiter);
+        config.packet.fec_parity_bytes = (framing == 2 ? 4 : 0);
+        ArdPacketDatagramLink link;
+        link.corrupt_datagram = 3;
+        ArdPacketDatagram datagram(link);
+        TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, datagram.Configure(config, storage, sizeof(storage)));
+
+        const uint32_t frames = 40;
+        uint8_t payload[40];
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            const ArdPacketPayloadInfo info = {.message_type = frame, .payload_size = 1 + (frame * 7) % 40};
+            memset(payload, static_cast<int>(frame), info.payload_size);
+            TEST_ASSERT_EQUAL(kArdPacketStatusDone, datagram.SendPayload(info, payload));
+        }
+        TEST_ASSERT_TRUE(datagram.Flush());
+        TEST_ASSERT_TRUE(link.Count() < frames / 2);
+
+        // frames arrive in order, with a gap for the corrupted datagram
+        uint32_t received = 0;
+        uint32_t next_frame = 0;
+        size_t failures = 0;
+        ArdPacketPayloadInfo info;
+        eArdPacketStatus status = kArdPacketStatusStart;
+        while ((status = datagram.ReceivePayload(sizeof(payload), info, payload)) != kArdPacketStatusNotAvailable)
+        {
+            if (status == kArdPacketStatusDone)
+            {
+                TEST_ASSERT_TRUE(info.message_type >= next_frame);
+                TEST_ASSERT_EQUAL(1 + (info.message_type * 7) % 40, info.payload_size);
+                TEST_ASSERT_EQUAL(static_cast<uint8_t>(info.message_type), payload[info.payload_size - 1]);
+                next_frame = info.message_type + 1;
+                received++;
+            }
+            else
+            {
+                failures++;
+            }
+        }
+        TEST_ASSERT_EQUAL(frames, next_frame);
+        // forward error correction repairs the corrupted byte
+        TEST_ASSERT_EQUAL((framing == 2 ? 0 : 1), failures);
+        TEST_ASSERT_TRUE(received < frames || framing == 2);
+        TEST_ASSERT_TRUE(received > frames - 10);
+    }
+}
+
+// Event driven server echoing payloads to many clients
+static void test_server_echo(void)
+{
+    ArdPacketEchoHandler handler;
+    ArdPacketServer server(handler);
+    ArdPacketServerConfig config;
+    config.packet.crc = true;
+    config.packet.delimiter = '|';
+    config.packet.message_type_bytes = 2;
+    config.packet.payload_size_bytes = 1;
+    config.packet.max_payload_size = 64;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.worker_threads = 0;
+    TEST_ASSERT_FALSE(server.Start(config));
+    config.worker_threads = 3;
+    TEST_ASSERT_TRUE(server.Start(config));
+    TEST_ASSERT_TRUE(server.Port() != 0);
+
+    const size_t clients = 40;
+    const uint32_t messages = 20;
+    ArdPacketTcp streams[clients];
+    std::unique_ptr<ArdPacket> packets[clients];
+    ArdPacketPayloadInfo infos[clients];
+    uint8_t payloads[clients][64];
+    uint32_t received[clients] = {0};
+    for (size_t client = 0; client < clients; ++client)
+    {
+        TEST_ASSERT_TRUE(streams[client].Connect("127.0.0.1", server.Port()));
+        packets[client].reset(new ArdPacket(streams[client]));
+        packets[client]->Configure(config.packet);
+    }
+
+    // every client sends a message once the previous one came back
+    uint8_t payload[64];
+    size_t done = 0;
+    for (size_t client = 0; client < clients; ++client)
+    {
+        const ArdPacketPayloadInfo input_info = {.message_type = static_cast<uint32_t>(client),
+                                                 .payload_size = 1 + client};
+        memset(payload, static_cast<int>(client), input_info.payload_size);
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, packets[client]->SendPayload(input_info, payload));
+    }
+    for (size_t step = 0; step < 2000000 && done < clients; ++step)
+    {
+        // packets in progress keep their own info
+        const size_t client = step % clients;
+        ArdPacketPayloadInfo &info = infos[client];
+        uint8_t *payload = payloads[client];
+        if (packets[client]->ReceivePayload(sizeof(payloads[client]), info, payload) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(client, info.message_type);
+            TEST_ASSERT_EQUAL(1 + client, info.payload_size);
+            TEST_ASSERT_EQUAL(static_cast<uint8_t>(client), payload[client]);
+            received[client]++;
+            done += (received[client] == messages ? 1 : 0);
+            if (received[client] < messages)
+            {
+                TEST_ASSERT_EQUAL(kArdPacketStatusDone, packets[client]->SendPayload(info, payload));
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(clients, done);
+    TEST_ASSERT_EQUAL(clients * messages, handler.payloads);
+    TEST_ASSERT_EQUAL(clients, handler.connects);
+    TEST_ASSERT_EQUAL(clients, server.Connections());
+
+    // closing clients closes their connections
+    for (size_t client = 0; client < clients / 2; ++client)
+    {
+        streams[client].Close();
+    }
+    for (size_t step = 0; step < 1000 && server.Connections() > clients / 2; ++step)
+    {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL(clients / 2, server.Connections());
+    server.Stop();
+    TEST_ASSERT_EQUAL(clients, handler.disconnects);
+    TEST_ASSERT_EQUAL(0, handler.send_failures);
+}
+
+// Frames after a dropped one arrive in the same read and are still delivered
+static void test_server_receive_error(void)
+{
+    ArdPacketEchoHandler handler;
+    ArdPacketServer server(handler);
+    ArdPacketServerConfig config;
+    config.packet.crc = true;
+    config.packet.delimiter = '|';
+    config.packet.message_type_bytes = 1;
+    config.packet.payload_size_bytes = 1;
+    config.packet.max_payload_size = 64;
+    config.packet.header_encoding = kArdPacketHeaderVarint;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.worker_threads = 1;
+    TEST_ASSERT_TRUE(server.Start(config));
+
+    ArdPacketTcp stream;
+    TEST_ASSERT_TRUE(stream.Connect("127.0.0.1", server.Port()));
+    ArdPacket packet(stream);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config.packet));
+
+    // a message type too large for its field, then two valid frames, in one write
+    uint8_t data[64] = {'|', 0x81, 0x7f};
+    size_t data_size = 3;
+    const uint8_t payload[4] = {1, 2, 3, 4};
+    for (uint32_t message_type = 1; message_type <= 2; ++message_type)
+    {
+        const ArdPacketPayloadInfo info = {.message_type = message_type, .payload_size = sizeof(payload)};
+        size_t packet_size = 0;
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.WritePacketToBuffer(info, payload, sizeof(data) - data_size,
+                                                                          &data[data_size], packet_size));
+        data_size += packet_size;
+    }
+    TEST_ASSERT_EQUAL(data_size, stream.write(data, data_size));
+
+    ArdPacketPayloadInfo info;
+    uint8_t receive_buffer[64];
+    uint32_t received = 0;
+    for (size_t step = 0; step < 1000 && received < 2; ++step)
+    {
+        if (packet.ReceivePayload(sizeof(receive_buffer), info, receive_buffer) == kArdPacketStatusDone)
+        {
+            received++;
+            TEST_ASSERT_EQUAL(received, info.message_type);
+        }
+        else
+        {
+            usleep(1000);
+        }
+    }
+    TEST_ASSERT_EQUAL(2, received);
+    TEST_ASSERT_EQUAL(1, handler.errors);
+    server.Stop();
+    TEST_ASSERT_EQUAL(0, handler.send_failures);
+}
+
+// io_uring server echoing payloads cut across small receive buffers
+static void test_uring_echo(void)
+{
+    if (!ArdPacketUringServer::Supported())
+    {
+        TEST_IGNORE_MESSAGE("io_uring is not available");
+    }
+    ArdPacketEchoHandler handler;
+    ArdPacketUringServer server(handler);
+    ArdPacketServerConfig config;
+    config.packet.crc = true;
+    config.packet.delimiter = '|';
+    config.packet.message_type_bytes = 2;
+    config.packet.payload_size_bytes = 1;
+    config.packet.max_payload_size = 64;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.worker_threads = 2;
+    ArdPacketUringConfig uring_config;
+    uring_config.max_connections = 32;
+    // a few submission entries, so requests regularly find the queue full
+    uring_config.queue_entries = 4;
+    uring_config.buffer_count = 6;
+    TEST_ASSERT_FALSE(server.Start(config, uring_config));
+    uring_config.buffer_count = 8;
+    uring_config.buffer_size = 16;
+    uring_config.write_buffer_size = 256;
+    TEST_ASSERT_TRUE(server.Start(config, uring_config));
+    TEST_ASSERT_TRUE(server.Port() != 0);
+
+    const size_t clients = 40;
+    const uint32_t messages = 20;
+    ArdPacketTcp streams[clients];
+    std::unique_ptr<ArdPacket> packets[clients];
+    ArdPacketPayloadInfo infos[clients];
+    uint8_t payloads[clients][64];
+    uint32_t received[clients] = {0};
+    for (size_t client = 0; client < clients; ++client)
+    {
+        TEST_ASSERT_TRUE(streams[client].Connect("127.0.0.1", server.Port()));
+        packets[client].reset(new ArdPacket(streams[client]));
+        packets[client]->Configure(config.packet);
+    }
+
+    uint8_t payload[64];
+    size_t done = 0;
+    for (size_t client = 0; client < clients; ++client)
+    {
+        const ArdPacketPayloadInfo input_info = {.message_type = static_cast<uint32_t>(client),
+                                                 .payload_size = 1 + client};
+        memset(payload, static_cast<int>(client), input_info.payload_size);
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, packets[client]->SendPayload(input_info, payload));
+    }
+    for (size_t step = 0; step < 2000000 && done < clients; ++step)
+    {
+        const size_t client = step % clients;
+        ArdPacketPayloadInfo &info = infos[client];
+        uint8_t *payload = payloads[client];
+        if (packets[client]->ReceivePayload(sizeof(payloads[client]), info, payload) == kArdPacketStatusDone)
+        {
+            TEST_ASSERT_EQUAL(client, info.message_type);
+            TEST_ASSERT_EQUAL(1 + client, info.payload_size);
+            TEST_ASSERT_EQUAL(static_cast<uint8_t>(client), payload[client]);
+            received[client]++;
+            done += (received[client] == messages ? 1 : 0);
+            if (received[client] < messages)
+            {
+                TEST_ASSERT_EQUAL(kArdPacketStatusDone, packets[client]->SendPayload(info, payload));
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(clients, done);
+    TEST_ASSERT_EQUAL(clients * messages, handler.payloads);
+    TEST_ASSERT_EQUAL(clients, handler.connects);
+    TEST_ASSERT_EQUAL(clients, server.Connections());
+
+    // closing clients closes their connections
+    for (size_t client = 0; client < clients / 2; ++client)
+    {
+        streams[client].Close();
+    }
+    for (size_t step = 0; step < 1000 && server.Connections() > clients / 2; ++step)
+    {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL(clients / 2, server.Connections());
+    server.Stop();
+    TEST_ASSERT_EQUAL(clients, handler.disconnects);
+    TEST_ASSERT_EQUAL(0, handler.send_failures);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    // Run Tests
+    // ---------
+
+    RUN_TEST(test_packet_configure_pass);
+    RUN_TEST(test_packet_configure_fail_payload_bytes);
+    RUN_TEST(test_packet_configure_fail_message_type);
+    RUN_TEST(test_packet_configure_fail_max_payload);
+    RUN_TEST(test_packet_pass_write_read);
+
+    RUN_TEST(test_packet_pass_static_write_read);
+    RUN_TEST(test_packet_pass_write_read_sequence);
+    RUN_TEST(test_packet_resync_false_delimiter);
+    RUN_TEST(test_packet_resync_truncated_packet);
+    RUN_TEST(test_packet_varint_header);
+    RUN_TEST(test_packet_forward_reframe);
+    RUN_TEST(test_packet_forward_crc);
+    RUN_TEST(test_packet_receiver_sender);
+    RUN_TEST(test_poller_fairness);
+    RUN_TEST(test_poller_packets);
+    RUN_TEST(test_dispatch_direct);
+    RUN_TEST(test_dispatch_hashed);
+    RUN_TEST(test_size_limits);
+    RUN_TEST(test_frame_timeout);
+#if ARD_PACKET_STATS
+    RUN_TEST(test_stats);
+#endif
+    RUN_TEST(test_trace);
+
+    RUN_TEST(test_packet_cobs_write_read);
+    RUN_TEST(test_packet_cobs_resync);
+    RUN_TEST(test_packet_cobs_static_write_read);
+
+    RUN_TEST(test_packet_fec_write_read);
+    RUN_TEST(test_packet_fec_static_write_read);
+
+    RUN_TEST(test_packet_reliable_window);
+    RUN_TEST(test_packet_reliable_lossy);
+
+    RUN_TEST(test_packet_credit_frames);
+    RUN_TEST(test_packet_credit_bytes);
+
+    RUN_TEST(test_lzss_round_trip);
+    RUN_TEST(test_packet_compress);
+    RUN_TEST(test_packet_delta);
+
+    RUN_TEST(test_packet_datagram_aggregate);
+
+    RUN_TEST(test_posix_socketpair);
+    RUN_TEST(test_posix_tty);
+    RUN_TEST(test_posix_tcp);
+    RUN_TEST(test_posix_udp);
+
+    RUN_TEST(test_server_echo);
+    RUN_TEST(test_server_receive_error);
+    RUN_TEST(test_uring_echo);
 
     // Done
     // ----
@@ -0,0 +1,91 @@
+// Native stand-in for the parts of the Arduino core used by the stream adapters
+
+#ifndef ARD_PACKET_MOCK_ARDUINO_H
+#define ARD_PACKET_MOCK_ARDUINO_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+// same receive ring as the AVR core's HardwareSerial
+#define SERIAL_RX_BUFFER_SIZE 64
+typedef uint8_t rx_buffer_index_t;
+
+class HardwareSerial
+{
+   public:
+    int available()
+    {
+        return (SERIAL_RX_BUFFER_SIZE + _rx_buffer_head - _rx_buffer_tail) % SERIAL_RX_BUFFER_SIZE;
+    }
+    int read()
+    {
+        int value = -1;
+        byte_reads++;
+        if (_rx_buffer_head != _rx_buffer_tail)
+        {
+            value = _rx_buffer[_rx_buffer_tail];
+            _rx_buffer_tail = static_cast<rx_buffer_index_t>((_rx_buffer_tail + 1) % SERIAL_RX_BUFFER_SIZE);
+        }
+        return value;
+    }
+    size_t read(uint8_t *buffer, size_t size)
+    {
+        size_t read_index = 0;
+        for (int value = 0; read_index < size && (value = read()) >= 0; ++read_index)
+        {
+            buffer[read_index] = static_cast<uint8_t>(value);
+        }
+        return read_index;
+    }
+
+    int availableForWrite()
+    {
+        return 64;
+    }
+    size_t write(uint8_t value)
+    {
+        written.push_back(value);
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        written.insert(written.end(), buffer, buffer + size);
+        return size;
+    }
+
+    // receive interrupt: bytes are dropped when the ring is full
+    void Receive(const uint8_t value)
+    {
+        const rx_buffer_index_t next = static_cast<rx_buffer_index_t>((_rx_buffer_head + 1) % SERIAL_RX_BUFFER_SIZE);
+        if (next != _rx_buffer_tail)
+        {
+            _rx_buffer[_rx_buffer_head] = value;
+            _rx_buffer_head = next;
+        }
+    }
+
+    size_t byte_reads = 0;
+    std::vector<uint8_t> written;
+
+   protected:
+    volatile rx_buffer_index_t _rx_buffer_head = 0;
+    volatile rx_buffer_index_t _rx_buffer_tail = 0;
+    unsigned char _rx_buffer[SERIAL_RX_BUFFER_SIZE] = {0};
+};
+
+extern HardwareSerial Serial;
+
+// microsecond clock, the stand-ins advance it while a write blocks
+inline uint32_t &mock_micros()
+{
+    static uint32_t now = 0;
+    return now;
+}
+inline unsigned long micros()
+{
+    return mock_micros();
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Native stand-in for the ESP32 BluetoothSerial
+
+#ifndef ARD_PACKET_MOCK_BLUETOOTH_SERIAL_H
+#define ARD_PACKET_MOCK_BLUETOOTH_SERIAL_H
+
+#include <Arduino.h>
+
+#include <deque>
+#include <vector>
+
+class BluetoothSerial
+{
+   public:
+    int available()
+    {
+        return static_cast<int>(received.size());
+    }
+    int read()
+    {
+        int value = -1;
+        byte_reads++;
+        if (!received.empty())
+        {
+            value = received.front();
+            received.pop_front();
+        }
+        return value;
+    }
+    // waits for the timeout when fewer bytes arrived, so blocking reads fail the test
+    size_t readBytes(uint8_t *buffer, size_t length)
+    {
+        bulk_reads++;
+        blocked = blocked || (length > received.size());
+        size_t read_index = 0;
+        for (; read_index < length && !received.empty(); ++read_index)
+        {
+            buffer[read_index] = received.front();
+            received.pop_front();
+        }
+        return read_index;
+    }
+
+    size_t write(uint8_t value)
+    {
+        return write(&value, 1);
+    }
+    // takes up to accept_size bytes, blocking for write_delay_us
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        const size_t write_size = (size < accept_size ? size : accept_size);
+        written.insert(written.end(), buffer, buffer + write_size);
+        mock_micros() += write_delay_us;
+        return write_size;
+    }
+
+    std::deque<uint8_t> received;
+    std::vector<uint8_t> written;
+    size_t byte_reads = 0;
+    size_t bulk_reads = 0;
+    bool blocked = false;
+    size_t accept_size = SIZE_MAX;
+    uint32_t write_delay_us = 0;
+};
+
+#endif
@@ -0,0 +1,67 @@
+// Native stand-in for the ESP32 WiFiClient
+
+#ifndef ARD_PACKET_MOCK_WIFI_H
+#define ARD_PACKET_MOCK_WIFI_H
+
+#include <Arduino.h>
+
+#include <deque>
+#include <vector>
+
+class IPAddress
+{
+   public:
+    IPAddress() = default;
+    IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) : octets{first, second, third, fourth} {}
+
+    uint8_t octets[4] = {0};
+};
+
+class WiFiClient
+{
+   public:
+    int available()
+    {
+        return static_cast<int>(received.size());
+    }
+    int read()
+    {
+        int value = -1;
+        if (!received.empty())
+        {
+            value = received.front();
+            received.pop_front();
+        }
+        return value;
+    }
+    int read(uint8_t *buffer, size_t size)
+    {
+        size_t read_index = 0;
+        for (; read_index < size && !received.empty(); ++read_index)
+        {
+            buffer[read_index] = received.front();
+            received.pop_front();
+        }
+        return static_cast<int>(read_index);
+    }
+
+    size_t write(uint8_t value)
+    {
+        return write(&value, 1);
+    }
+    // takes up to accept_size bytes, blocking for write_delay_us
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        const size_t write_size = (size < accept_size ? size : accept_size);
+        written.insert(written.end(), buffer, buffer + write_size);
+        mock_micros() += write_delay_us;
+        return write_size;
+    }
+
+    std::deque<uint8_t> received;
+    std::vector<uint8_t> written;
+    size_t accept_size = SIZE_MAX;
+    uint32_t write_delay_us = 0;
+};
+
+#endif
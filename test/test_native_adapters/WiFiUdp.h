@@ -0,0 +1,61 @@
+// Native stand-in for the ESP32 WiFiUDP
+
+#ifndef ARD_PACKET_MOCK_WIFI_UDP_H
+#define ARD_PACKET_MOCK_WIFI_UDP_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <deque>
+#include <vector>
+
+class WiFiUDP
+{
+   public:
+    int parsePacket()
+    {
+        m_current.clear();
+        if (!received.empty())
+        {
+            m_current = received.front();
+            received.pop_front();
+        }
+        return static_cast<int>(m_current.size());
+    }
+    int read(uint8_t *buffer, size_t size)
+    {
+        const size_t read_size = (m_current.size() < size ? m_current.size() : size);
+        memcpy(buffer, m_current.data(), read_size);
+        m_current.clear();
+        return static_cast<int>(read_size);
+    }
+    void flush()
+    {
+        m_current.clear();
+    }
+
+    int beginPacket(const IPAddress &ip, uint16_t port)
+    {
+        (void)ip;
+        (void)port;
+        sent.emplace_back();
+        return 1;
+    }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        sent.back().insert(sent.back().end(), buffer, buffer + size);
+        return size;
+    }
+    int endPacket()
+    {
+        return 1;
+    }
+
+    std::deque<std::vector<uint8_t>> received;
+    std::vector<std::vector<uint8_t>> sent;
+
+   private:
+    std::vector<uint8_t> m_current;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <unity.h>
+
+// AVR receive ring path, against the HardwareSerial stand-in
+#define ARD_PACKET_SERIAL_RING_READ 1
+
+#include "ArdPacket.h"
+#include "ArdPacketBluetooth.h"
+#include "ArdPacketSerial.h"
+#include "ArdPacketWifi.h"
+#include "ArdPacketWriteEstimate.h"
+
+HardwareSerial Serial;
+
+// utility
+
+static ArdPacketConfig ArdPacketAdapterConfig()
+{
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 2;
+    config.max_payload_size = 512;
+    return config;
+}
+
+static ArdPacketWriteEstimateConfig ArdPacketAdapterWriteEstimateConfig()
+{
+    ArdPacketWriteEstimateConfig config;
+    config.initial_size = 64;
+    config.min_size = 16;
+    config.max_size = 256;
+    config.increase_size = 64;
+    config.slow_write_us = 2000;
+    config.clock_us = []() -> uint32_t { return static_cast<uint32_t>(micros()); };
+    return config;
+}
+
+// Bulk reads drain the ring across its end without the per byte read
+static void test_serial_ring_read(void)
+{
+    HardwareSerial serial;
+    ArdPacketSerial stream(serial);
+    uint8_t buffer[128];
+
+    TEST_ASSERT_EQUAL(0, stream.read(buffer, sizeof(buffer)));
+    for (int value = 0; value < 50; ++value)
+    {
+        serial.Receive(static_cast<uint8_t>(value));
+    }
+    TEST_ASSERT_EQUAL(40, stream.read(buffer, 40));
+    TEST_ASSERT_EQUAL(10, stream.available());
+
+    // wraps around the end of the ring, one slot always stays free
+    for (int value = 50; value < 150; ++value)
+    {
+        serial.Receive(static_cast<uint8_t>(value));
+    }
+    TEST_ASSERT_EQUAL(SERIAL_RX_BUFFER_SIZE - 1, stream.available());
+    TEST_ASSERT_EQUAL(SERIAL_RX_BUFFER_SIZE - 1, stream.read(&buffer[40], sizeof(buffer) - 40));
+    for (int index = 0; index < 40 + SERIAL_RX_BUFFER_SIZE - 1; ++index)
+    {
+        TEST_ASSERT_EQUAL(index, buffer[index]);
+    }
+    TEST_ASSERT_EQUAL(0, stream.available());
+    TEST_ASSERT_EQUAL(0, serial.byte_reads);
+}
+
+// Packet larger than the ring arrives while it is read
+static void test_serial_ring_packet(void)
+{
+    HardwareSerial serial;
+    ArdPacketSerial stream(serial);
+    ArdPacket packet(stream);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(ArdPacketAdapterConfig()));
+
+    uint8_t payload[512];
+    for (size_t index = 0; index < sizeof(payload); ++index)
+    {
+        payload[index] = static_cast<uint8_t>(index * 7);
+    }
+    const ArdPacketPayloadInfo info = {.message_type = 3, .payload_size = sizeof(payload)};
+    uint8_t encoded[600];
+    size_t encoded_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.WritePacketToBuffer(info, payload, sizeof(encoded), encoded,
+                                                                       encoded_size));
+
+    uint8_t received[512];
+    ArdPacketPayloadInfo received_info;
+    eArdPacketStatus status = kArdPacketStatusStart;
+    size_t fed = 0;
+    while (status != kArdPacketStatusDone && fed <= encoded_size)
+    {
+        // the interrupt delivers a few bytes between calls
+        for (size_t count = 0; count < 20 && fed < encoded_size; ++count, ++fed)
+        {
+            serial.Receive(encoded[fed]);
+        }
+        status = packet.ReceivePayload(sizeof(received), received_info, received);
+        fed += (fed == encoded_size ? 1 : 0);
+    }
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, status);
+    TEST_ASSERT_EQUAL(3, received_info.message_type);
+    TEST_ASSERT_EQUAL_MEMORY(payload, received, sizeof(payload));
+    TEST_ASSERT_TRUE(serial.byte_reads < 16);
+}
+
+// Bluetooth payloads are read in bulk without waiting for missing bytes
+static void test_bluetooth_bulk_read(void)
+{
+    BluetoothSerial bt;
+    ArdPacketBluetooth stream(bt);
+    ArdPacket packet(stream);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(ArdPacketAdapterConfig()));
+
+    uint8_t payload[512];
+    for (size_t index = 0; index < sizeof(payload); ++index)
+    {
+        payload[index] = static_cast<uint8_t>(index * 3);
+    }
+    const ArdPacketPayloadInfo info = {.message_type = 9, .payload_size = sizeof(payload)};
+    uint8_t encoded[600];
+    size_t encoded_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.WritePacketToBuffer(info, payload, sizeof(encoded), encoded,
+                                                                       encoded_size));
+
+    // half of the packet first
+    uint8_t received[512];
+    ArdPacketPayloadInfo received_info;
+    bt.received.insert(bt.received.end(), encoded, encoded + encoded_size / 2);
+    TEST_ASSERT_NOT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(received), received_info, received));
+    bt.received.insert(bt.received.end(), encoded + encoded_size / 2, encoded + encoded_size);
+    TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(received), received_info, received));
+    TEST_ASSERT_EQUAL(9, received_info.message_type);
+    TEST_ASSERT_EQUAL_MEMORY(payload, received, sizeof(payload));
+
+    TEST_ASSERT_FALSE(bt.blocked);
+    TEST_ASSERT_TRUE(bt.bulk_reads > 0);
+    TEST_ASSERT_TRUE(bt.byte_reads < 16);
+
+    uint8_t buffer[8];
+    TEST_ASSERT_EQUAL(0, stream.read(buffer, sizeof(buffer)));
+    TEST_ASSERT_FALSE(bt.blocked);
+}
+
+// Estimate grows while writes are taken whole and halves on rejected bytes or blocking writes
+static void test_write_estimate(void)
+{
+    ArdPacketWriteEstimate estimate;
+    ArdPacketWriteEstimateConfig config = ArdPacketAdapterWriteEstimateConfig();
+    config.min_size = 0;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidWriteEstimate, estimate.Configure(config));
+    config = ArdPacketAdapterWriteEstimateConfig();
+    config.clock_us = nullptr;
+    TEST_ASSERT_EQUAL(kArdPacketConfigInvalidClock, estimate.Configure(config));
+    config.slow_write_us = 0;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, estimate.Configure(config));
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, estimate.Configure(ArdPacketAdapterWriteEstimateConfig()));
+
+    // additive increase up to the largest estimate
+    const int grown[] = {64, 128, 192, 256, 256};
+    for (const int size : grown)
+    {
+        TEST_ASSERT_EQUAL(size, estimate.Available());
+        estimate.Written(static_cast<size_t>(size), static_cast<size_t>(size), estimate.Now());
+    }
+
+    // a round that does not use the whole estimate keeps it
+    TEST_ASSERT_EQUAL(256, estimate.Available());
+    estimate.Written(10, 10, estimate.Now());
+    TEST_ASSERT_EQUAL(256, estimate.Available());
+
+    // rejected bytes halve it once per round
+    estimate.Written(200, 100, estimate.Now());
+    estimate.Written(56, 0, estimate.Now());
+    TEST_ASSERT_EQUAL(128, estimate.Estimate());
+    TEST_ASSERT_EQUAL(128, estimate.Available());
+
+    // so does a write that blocks
+    const uint32_t start_us = estimate.Now();
+    mock_micros() += 5000;
+    estimate.Written(128, 128, start_us);
+    TEST_ASSERT_EQUAL(64, estimate.Available());
+
+    for (int round = 0; round < 8; ++round)
+    {
+        estimate.Written(64, 1, estimate.Now());
+        estimate.Available();
+    }
+    TEST_ASSERT_EQUAL(16, estimate.Available());
+
+    estimate.SetFixed(100);
+    estimate.Written(100, 1, estimate.Now());
+    TEST_ASSERT_EQUAL(100, estimate.Available());
+}
+
+// WiFi packets need fewer calls as the estimate grows, and back off when the link drains slowly
+static void test_wifi_write_estimate(void)
+{
+    WiFiClient client;
+    ArdPacketWifi stream(client);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      stream.WriteEstimate().Configure(ArdPacketAdapterWriteEstimateConfig()));
+    ArdPacket packet(stream);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(ArdPacketAdapterConfig()));
+
+    uint8_t payload[512];
+    for (size_t index = 0; index < sizeof(payload); ++index)
+    {
+        payload[index] = static_cast<uint8_t>(index * 5);
+    }
+    const ArdPacketPayloadInfo info = {.message_type = 4, .payload_size = sizeof(payload)};
+    int calls[4] = {0};
+    for (int &packet_calls : calls)
+    {
+        while (packet.SendPayload(info, payload) != kArdPacketStatusDone)
+        {
+            packet_calls++;
+        }
+    }
+    TEST_ASSERT_TRUE(calls[3] < calls[0]);
+    TEST_ASSERT_EQUAL(256, stream.WriteEstimate().Estimate());
+
+    // every byte arrived
+    client.received.insert(client.received.end(), client.written.begin(), client.written.end());
+    uint8_t received[512];
+    ArdPacketPayloadInfo received_info;
+    for (int index = 0; index < 4; ++index)
+    {
+        TEST_ASSERT_EQUAL(kArdPacketStatusDone, packet.ReceivePayload(sizeof(received), received_info, received));
+        TEST_ASSERT_EQUAL_MEMORY(payload, received, sizeof(payload));
+    }
+
+    client.write_delay_us = 5000;
+    TEST_ASSERT_NOT_EQUAL(kArdPacketStatusDone, packet.SendPayload(info, payload));
+    TEST_ASSERT_EQUAL(128, stream.WriteEstimate().Estimate());
+
+    stream.SetAvailableForWrite(32);
+    TEST_ASSERT_NOT_EQUAL(kArdPacketStatusDone, packet.SendPayload(info, payload));
+    TEST_ASSERT_EQUAL(32, stream.availableForWrite());
+}
+
+// Bluetooth estimate settles around what the link takes per write
+static void test_bluetooth_write_estimate(void)
+{
+    BluetoothSerial bt;
+    ArdPacketBluetooth stream(bt);
+    TEST_ASSERT_EQUAL(64, stream.availableForWrite());
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess,
+                      stream.WriteEstimate().Configure(ArdPacketAdapterWriteEstimateConfig()));
+    ArdPacket packet(stream);
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(ArdPacketAdapterConfig()));
+
+    uint8_t payload[512] = {0};
+    const ArdPacketPayloadInfo info = {.message_type = 2, .payload_size = sizeof(payload)};
+    bt.accept_size = 40;
+    for (int call = 0; call < 64; ++call)
+    {
+        packet.SendPayload(info, payload);
+        TEST_ASSERT_TRUE(stream.WriteEstimate().Estimate() >= 16);
+        TEST_ASSERT_TRUE(stream.WriteEstimate().Estimate() <= 128);
+    }
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    // Run Tests
+    // ---------
+
+    RUN_TEST(test_serial_ring_read);
+    RUN_TEST(test_serial_ring_packet);
+    RUN_TEST(test_bluetooth_bulk_read);
+    RUN_TEST(test_write_estimate);
+    RUN_TEST(test_wifi_write_estimate);
+    RUN_TEST(test_bluetooth_write_estimate);
+
+    // Done
+    // ----
+
+    UNITY_END();
+
+    return 0;
+}
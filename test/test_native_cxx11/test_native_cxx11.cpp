@@ -0,0 +1,68 @@
+#include <unity.h>
+
+// Every portable library header, built with -std=gnu++11 (the avr-gcc default) by env:native_cxx11
+#include "ArdCrc.h"
+#include "ArdPacket.h"
+#include "ArdPacketBuffer.h"
+#include "ArdPacketCobs.h"
+#include "ArdPacketCompress.h"
+#include "ArdPacketCredit.h"
+#include "ArdPacketDatagram.h"
+#include "ArdPacketDelta.h"
+#include "ArdPacketDispatch.h"
+#include "ArdPacketFec.h"
+#include "ArdPacketForward.h"
+#include "ArdPacketLzss.h"
+#include "ArdPacketPoller.h"
+#include "ArdPacketReliable.h"
+#include "ArdPacketRingBuffer.h"
+#include "ArdPacketStatsReport.h"
+#include "ArdPacketTraceJson.h"
+#include "ArdPacketWriteEstimate.h"
+
+// Credit frames go out and are read back under C++11
+static void test_cxx11_credit(void)
+{
+    uint8_t buffer[64];
+    ArdPacketRingBuffer stream;
+    stream.set_buffer(buffer, sizeof(buffer));
+    ArdPacket packet(stream);
+
+    ArdPacketConfig config;
+    config.crc = true;
+    config.delimiter = '|';
+    config.message_type_bytes = 1;
+    config.payload_size_bytes = 1;
+    config.max_payload_size = 16;
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, packet.Configure(config));
+
+    // the packet talks to itself, so it advertises credit to itself
+    ArdPacketCredit credit(packet);
+    ArdPacketCreditConfig credit_config;
+    credit_config.receive_credit = 2;
+    credit_config.max_payload_size = 16;
+    credit_config.credit_message_type = 0xFF;
+    credit_config.refresh_interval_ms = 0;
+    uint8_t storage[16];
+    TEST_ASSERT_EQUAL(kArdPacketConfigSuccess, credit.Configure(credit_config, storage, sizeof(storage)));
+    credit.Poll();
+    credit.Poll();
+    TEST_ASSERT_EQUAL(2, credit.Credit());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+
+    // Run Tests
+    // ---------
+
+    RUN_TEST(test_cxx11_credit);
+
+    // Done
+    // ----
+
+    UNITY_END();
+
+    return 0;
+}